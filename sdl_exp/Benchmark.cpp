@@ -0,0 +1,830 @@
+#include "Benchmark.h"
+#include "TwoPassScene.h"
+#include "visualisation/Visualisation.h"
+#include "visualisation/util/Profiler.h"
+#include "visualisation/shader/buffer/ShaderStorageBuffer.h"
+#include "visualisation/shader/buffer/UniformBlockAllocator.h"
+#include "visualisation/shader/GaussianBlur.h"
+#include "visualisation/util/JobSystem.h"
+#include "visualisation/util/RayCaster.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+    /**
+     * Default count of each workload, indexed by BenchmarkScene::Workload
+     */
+    const unsigned int DEFAULT_COUNTS[] = { 100, 100000, 1024, 1 };
+    /**
+     * Names of the component microbenchmarks, see Benchmark::runComponent()
+     */
+    const char *COMPONENTS[] = { "blur", "jobs", "buffers", "raycast", "prepass" };
+    bool isComponent(const char *name)
+    {
+        for (const char *c : COMPONENTS)
+            if (!strcmp(c, name))
+                return true;
+        return false;
+    }
+    /**
+     * Synthetic CPU bound work, used by the jobs component
+     */
+    float spin(float x, unsigned int iterations)
+    {
+        for (unsigned int i = 0; i < iterations; ++i)
+            x = x * 0.9999f + 0.0001f * sinf(x);
+        return x;
+    }
+    /**
+     * @return The fastest of repeats runs of f, in milliseconds
+     */
+    double bestOf(unsigned int repeats, const std::function<void()> &f)
+    {
+        double best = -1.0;
+        for (unsigned int r = 0; r < repeats; ++r)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            f();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = best < 0 || ms < best ? ms : best;
+        }
+        return best;
+    }
+    /**
+     * Changes smaller than this (in milliseconds) are never reported as regressions, as they are within timer noise
+     */
+    const double NOISE_FLOOR = 0.05;
+    /**
+     * The default orbit is kept within FAR_CLIP of the workload
+     */
+    const float MAX_ORBIT_RADIUS = 300.0f;
+    /**
+     * Returns the p'th percentile of sorted samples, by nearest rank
+     */
+    double percentile(const std::vector<double> &sorted, double p)
+    {
+        const size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+        return sorted[glm::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+    void writeSummaryJSON(FILE *f, const char *name, const Benchmark::Summary &s)
+    {
+        fprintf(f, "  \"%s\": {\"samples\": %u, \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}", name, s.samples, s.mean, s.min, s.p50, s.p95, s.p99, s.max);
+    }
+    /**
+     * Reads the value following "key": within the object named "name", from a JSON document written by Benchmark
+     */
+    bool readJSONValue(const std::string &json, const char *name, const char *key, double &value)
+    {
+        const size_t object = json.find(std::string("\"") + name + "\"");
+        if (object == std::string::npos)
+            return false;
+        const size_t end = json.find('}', object);
+        const size_t k = json.find(std::string("\"") + key + "\":", object);
+        if (k == std::string::npos || k > end)
+            return false;
+        return sscanf(json.c_str() + k + strlen(key) + 3, "%lf", &value) == 1;
+    }
+}
+
+int Benchmark::main(int argc, char **argv)
+{
+    Options options;
+    if (argc >= 1 && isComponent(argv[0]))
+        options.component = argv[0];
+    else if (argc < 1 || !BenchmarkScene::parseWorkload(argv[0], options.workload))
+    {
+        usage();
+        return 2;
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        //Every option other than --windowed and --deferred takes a value
+        if (arg == "--windowed")
+        {
+            options.headless = false;
+            continue;
+        }
+        if (arg == "--deferred")
+        {
+            options.deferred = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Benchmark: Option '%s' requires a value.\n", arg.c_str());
+            usage();
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--count")
+            options.count = (unsigned int)atoi(value);
+        else if (arg == "--frames")
+            options.frames = (unsigned int)glm::max(atoi(value), 1);
+        else if (arg == "--warmup")
+            options.warmup = (unsigned int)glm::max(atoi(value), 0);
+        else if (arg == "--frame-time")
+            options.frameTime = (unsigned int)glm::max(atoi(value), 1);
+        else if (arg == "--size")
+        {
+            if (sscanf(value, "%ux%u", &options.dims.x, &options.dims.y) != 2)
+            {
+                fprintf(stderr, "Benchmark: Size '%s' should be formatted WIDTHxHEIGHT.\n", value);
+                return 2;
+            }
+        }
+        else if (arg == "--path")
+            options.cameraPath = value;
+        else if (arg == "--model")
+            options.modelPath = value;
+        else if (arg == "--json")
+            options.jsonPath = value;
+        else if (arg == "--csv")
+            options.csvPath = value;
+        else if (arg == "--baseline")
+            options.baselinePath = value;
+        else if (arg == "--threshold")
+            options.threshold = (float)atof(value);
+        else
+        {
+            fprintf(stderr, "Benchmark: Unknown option '%s'.\n", arg.c_str());
+            usage();
+            return 2;
+        }
+    }
+    return options.component.empty() ? run(options) : runComponent(options);
+}
+void Benchmark::usage()
+{
+    fprintf(stderr,
+        "Usage: sdl_exp bench <crowd|instances|lights|city> [options]\n"
+        "       sdl_exp bench <blur|jobs|buffers|raycast|prepass> [--csv FILE] [--size WxH] [--windowed]\n"
+        "  --count N         Workload size (models, instances, lights or city tiles)\n"
+        "  --frames N        Measured frames (default 600)\n"
+        "  --warmup N        Unmeasured frames rendered first (default 60)\n"
+        "  --frame-time MS   Simulated milliseconds per frame (default 16)\n"
+        "  --size WxH        Render resolution (default 1280x720)\n"
+        "  --path FILE       Camera path to follow (see CameraPath), default orbits the workload\n"
+        "  --model FILE      OBJ rendered by the city workload\n"
+        "  --json FILE       Write results as JSON\n"
+        "  --csv FILE        Write the summary as CSV\n"
+        "  --baseline FILE   Compare against the JSON or CSV results of an earlier run\n"
+        "  --threshold PCT   Percentage increase reported as a regression (default 10)\n"
+        "  --windowed        Render to a window, rather than headless\n"
+        "  --deferred        Render the lights workload with deferred shading\n"
+        "Components:\n"
+        "  blur              GaussianBlur filters by format, resolution and radius\n"
+        "  jobs              JobSystem parallelFor() and task graph scaling, 1 to 32 threads\n"
+        "  buffers           Upload stalls and bandwidth of each BufferCore usage mode\n"
+        "  raycast           RayCaster BVH build times and ray throughput\n"
+        "  prepass           Shading cost of a scaled up TwoPassScene, with and without a DepthPrePass\n");
+}
+int Benchmark::run(const Options &options)
+{
+    const unsigned int count = options.count ? options.count : DEFAULT_COUNTS[options.workload];
+    Visualisation v("Benchmark", options.dims.x, options.dims.y, options.headless);
+    if (options.headless && !v.getHeadlessFrameBuffer())
+    {
+        fprintf(stderr, "Benchmark: Failed to create a headless GL context.\n");
+        return 2;
+    }
+    if (options.workload == BenchmarkScene::CITY)
+    {
+        const char *model = options.modelPath.empty() ? Stock::Models::ROTHWELL.modelPath : options.modelPath.c_str();
+        if (!std::ifstream(model))
+        {
+            fprintf(stderr, "Benchmark: City model '%s' was not found, provide one with --model.\n", model);
+            return 2;
+        }
+    }
+    if (options.deferred && options.workload != BenchmarkScene::LIGHTS)
+        fprintf(stderr, "Benchmark: --deferred only applies to the lights workload, it will be ignored.\n");
+    std::unique_ptr<BenchmarkScene> ownedScene = std::make_unique<BenchmarkScene>(v, options.workload, count, options.modelPath, options.deferred);
+    const BenchmarkScene *scene = ownedScene.get();
+    v.setScene(std::move(ownedScene));
+    std::shared_ptr<CameraPath> path;
+    try
+    {
+        if (options.cameraPath.empty())
+        {
+            const float radius = glm::min(scene->getRadius(), MAX_ORBIT_RADIUS);
+            path = std::make_shared<CameraPath>(CameraPath::orbit(scene->getCenter(), radius, radius * 0.4f, options.frames * options.frameTime / 1000.0f));
+        }
+        else
+            path = std::make_shared<CameraPath>(options.cameraPath);
+    }
+    catch (std::runtime_error &e)
+    {
+        fprintf(stderr, "Benchmark: %s\n", e.what());
+        return 2;
+    }
+    printf("Benchmark: %s x%u, %u frames (+%u warmup) at %ums, %ux%u, %s\n", BenchmarkScene::nameOf(options.workload), count, options.frames, options.warmup, options.frameTime, options.dims.x, options.dims.y, (const char*)glGetString(GL_RENDERER));
+    Profiler::setEnabled(true);
+    v.setCameraPath(path);
+    v.step(options.frameTime, options.warmup);
+    //Restart the path and discard the warmup's timings, so that the measured frames follow the whole path
+    GL_CALL(glFinish());
+    Profiler::clear();
+    v.setCameraPath(path);
+    std::vector<double> cpu, gpu;
+    unsigned long long nextIndex = 0;
+    auto collect = [&]()
+    {
+        for (auto &&frame : Profiler::getHistory())
+        {
+            if (frame.index < nextIndex || cpu.size() >= options.frames)
+                continue;
+            nextIndex = frame.index + 1;
+            cpu.push_back(frame.cpuTime);
+            if (frame.gpuTime >= 0)
+                gpu.push_back(frame.gpuTime);
+        }
+    };
+    unsigned long long uniformBinds = 0, redundantUniformBinds = 0;
+    for (unsigned int i = 0; i < options.frames; ++i)
+    {
+        v.step(options.frameTime);
+        //Without a swap, nothing bounds how far the driver queues ahead, waiting ensures every frame's timer queries resolve
+        GL_CALL(glFinish());
+        collect();
+        uniformBinds += UniformBlockAllocator::getFrameStats().binds;
+        redundantUniformBinds += UniformBlockAllocator::getFrameStats().redundantBinds;
+    }
+    //Empty frames resolve the final frames' queries, these are excluded by the frame limit of collect()
+    for (unsigned int i = 0; i < Profiler::BUFFERED_FRAMES; ++i)
+    {
+        Profiler::beginFrame();
+        Profiler::endFrame();
+    }
+    collect();
+    v.setCameraPath(nullptr);
+    if (gpu.size() < cpu.size())
+        fprintf(stderr, "Benchmark: GPU timings were unavailable for %u frames.\n", (unsigned int)(cpu.size() - gpu.size()));
+    const Summary cpuSummary = summarise(cpu);
+    const Summary gpuSummary = summarise(gpu);
+    printf("%-4s %9s %9s %9s %9s %9s %9s\n", "ms", "mean", "min", "p50", "p95", "p99", "max");
+    for (auto &&s : { std::make_pair("cpu", cpuSummary), std::make_pair("gpu", gpuSummary) })
+        printf("%-4s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", s.first, s.second.mean, s.second.min, s.second.p50, s.second.p95, s.second.p99, s.second.max);
+    if (options.frames)
+        printf("Uniform block binds per frame: %.1f (%.1f redundant, skipped)\n", (double)uniformBinds / options.frames, (double)redundantUniformBinds / options.frames);
+    if (options.workload == BenchmarkScene::LIGHTS)
+    {
+        //Includes the directional sun, compare forward and --deferred runs of equal count
+        printf("GPU per light: %.3f us\n", gpuSummary.mean * 1000.0 / (count + 1));
+        if (auto lighting = scene->getDeferredLighting())
+        {
+            //The G-buffer is written once, then read by light binning (depth only) and lighting (every target)
+            const double pixels = (double)options.dims.x * options.dims.y;
+            const double written = GBufferPass::BYTES_PER_PIXEL * pixels;
+            const double read = written + sizeof(float) * pixels;
+            printf("G-buffer: %u bytes/pixel, %.2f MB written, %.2f MB read per frame (%.2f GB/s at mean GPU time)\n",
+                GBufferPass::BYTES_PER_PIXEL, written / (1024 * 1024), read / (1024 * 1024), gpuSummary.mean > 0 ? (written + read) / (gpuSummary.mean * 1e6) : 0.0);
+            printf("Mean lights per lit tile: %.1f\n", lighting->getMeanLightsPerTile());
+        }
+    }
+    //Read the baseline before writing, in case they are the same file
+    Summary baseCpu, baseGpu;
+    const bool hasBaseline = !options.baselinePath.empty() && readBaseline(options.baselinePath, baseCpu, baseGpu);
+    bool success = true;
+    if (!options.jsonPath.empty())
+        success &= writeJSON(options.jsonPath, options, cpu, gpu);
+    if (!options.csvPath.empty())
+        success &= writeCSV(options.csvPath, cpu, gpu);
+    if (!success || (!options.baselinePath.empty() && !hasBaseline))
+        return 2;
+    if (hasBaseline && compare(options, cpuSummary, gpuSummary, baseCpu, baseGpu))
+        return 1;
+    return 0;
+}
+int Benchmark::runComponent(const Options &options)
+{
+    FILE *out = stdout;
+    if (!options.csvPath.empty() && !(out = fopen(options.csvPath.c_str(), "w")))
+    {
+        fprintf(stderr, "Benchmark: Unable to write '%s'.\n", options.csvPath.c_str());
+        return 2;
+    }
+    int result = 0;
+    //CPU only components require no GL context
+    if (options.component == "jobs")
+        jobs(out);
+    else if (options.component == "raycast")
+        raycast(out);
+    else
+    {
+        Visualisation v("Benchmark", options.dims.x, options.dims.y, options.headless);
+        if (options.headless && !v.getHeadlessFrameBuffer())
+        {
+            fprintf(stderr, "Benchmark: Failed to create a headless GL context.\n");
+            result = 2;
+        }
+        else if (options.component == "blur")
+            blur(out);
+        else if (options.component == "buffers")
+            buffers(out);
+        else if (options.component == "prepass")
+            prePass(v, out);
+    }
+    if (out != stdout)
+        fclose(out);
+    return result;
+}
+void Benchmark::blur(FILE *out)
+{
+    const unsigned int radii[] = { 2, 4, 8, 16, 32, 64, 128 };
+    const unsigned int resolutions[] = { 512, 1024, 2048 };
+    const GLenum formats[] = { GL_R32F, GL_RGBA16F, GL_RGBA8 };
+    const unsigned int REPEATS = 10;
+    const unsigned int MAX_ITERATIONS = 6;
+    GaussianBlur blur(1);
+    GLuint query = 0;
+    GL_CALL(glGenQueries(1, &query));
+    //Returns the mean GPU time of f, in milliseconds
+    auto time = [&](const std::function<void()> &f)
+    {
+        f();//Warm up, builds the shaders and intermediate images
+        GL_CALL(glBeginQuery(GL_TIME_ELAPSED, query));
+        for (unsigned int i = 0; i < REPEATS; ++i)
+            f();
+        GL_CALL(glEndQuery(GL_TIME_ELAPSED));
+        GLuint64 ns = 0;
+        GL_CALL(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns));
+        return ns / (1000000.0f * REPEATS);
+    };
+    fprintf(out, "filter,format,resolution,size,ms,maxError\n");
+    for (GLenum format : formats)
+    {
+        const unsigned int channels = format == GL_R32F ? 1 : 4;
+        const GLenum pixelFormat = channels == 1 ? GL_RED : GL_RGBA;
+        for (unsigned int resolution : resolutions)
+        {
+            const glm::uvec2 dims(resolution);
+            //Random input in the range 0-1, so that it is representable by every format
+            std::vector<float> input(dims.x * dims.y * channels);
+            for (auto &&v : input)
+                v = rand() / (float)RAND_MAX;
+            GLint previous = 0;
+            GLuint textures[2] = { 0, 0 };
+            GL_CALL(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous));
+            GL_CALL(glGenTextures(2, textures));
+            for (GLuint t : textures)
+            {
+                GL_CALL(glBindTexture(GL_TEXTURE_2D, t));
+                GL_CALL(glTexStorage2D(GL_TEXTURE_2D, 1, format, dims.x, dims.y));
+            }
+            GL_CALL(glBindTexture(GL_TEXTURE_2D, textures[0]));
+            GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, dims.x, dims.y, pixelFormat, GL_FLOAT, input.data()));
+            //Only the smallest resolution is validated, the CPU reference is slow
+            const bool validate = resolution == resolutions[0];
+            std::vector<float> result(validate ? input.size() : 0), expected(validate ? input.size() : 0);
+            for (unsigned int radius : radii)
+            {
+                //3 sigma covers the filter's width
+                blur.setFilter(radius, glm::max(radius / 3.0f, 1.0f));
+                const float ms = time([&](){ blur.blur(textures[0], textures[1], dims, format); });
+                float maxError = -1.0f;
+                if (validate && radius <= GaussianBlur::MAX_PASS_RADIUS)
+                {
+                    GL_CALL(glBindTexture(GL_TEXTURE_2D, textures[1]));
+                    GL_CALL(glGetTexImage(GL_TEXTURE_2D, 0, pixelFormat, GL_FLOAT, result.data()));
+                    GaussianBlur::reference(input.data(), expected.data(), dims, channels, radius, blur.getSigma());
+                    maxError = 0.0f;
+                    for (size_t i = 0; i < result.size(); ++i)
+                        maxError = glm::max(maxError, std::abs(result[i] - expected[i]));
+                }
+                fprintf(out, "gaussian,%s,%u,%u,%.3f,", GaussianBlur::formatQualifier(format), resolution, radius, ms);
+                if (maxError >= 0)
+                    fprintf(out, "%g\n", maxError);
+                else
+                    fprintf(out, "\n");
+            }
+            for (unsigned int iterations = 1; iterations <= MAX_ITERATIONS; ++iterations)
+            {
+                const float ms = time([&](){ blur.dualFilter(textures[0], textures[1], dims, format, iterations); });
+                fprintf(out, "dual,%s,%u,%u,%.3f,\n", GaussianBlur::formatQualifier(format), resolution, iterations, ms);
+            }
+            GL_CALL(glBindTexture(GL_TEXTURE_2D, previous));
+            GL_CALL(glDeleteTextures(2, textures));
+            fflush(out);
+        }
+    }
+    GL_CALL(glDeleteQueries(1, &query));
+}
+void Benchmark::jobs(FILE *out)
+{
+    const unsigned int MAX_THREADS = 32;
+    const unsigned int ELEMENTS = 1 << 18;
+    const unsigned int ELEMENT_ITERATIONS = 16;
+    const unsigned int ENTITIES = 1024;
+    const unsigned int STAGE_ITERATIONS = 2000;
+    const unsigned int REPEATS = 5;
+    std::vector<float> data(ELEMENTS);
+    std::vector<float> stages(ENTITIES * 4);
+    fprintf(out, "threads,parallel_for_ms,graph_ms,parallel_for_speedup,graph_speedup\n");
+    double baseFor = 0.0, baseGraph = 0.0;
+    for (unsigned int threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        JobSystem jobs(threads);
+        //Independent elements, e.g. transforming lights
+        const double forMs = bestOf(REPEATS, [&]{
+            jobs.parallelFor(0, ELEMENTS, 0, [&](unsigned int begin, unsigned int end){
+                for (unsigned int i = begin; i < end; ++i)
+                    data[i] = spin((float)i, ELEMENT_ITERATIONS);
+            });
+        });
+        //Per entity chains (animation -> bounds -> culling), joined by building the draw list
+        const double graphMs = bestOf(REPEATS, [&]{
+            std::vector<JobSystem::TaskHandle> culled;
+            culled.reserve(ENTITIES);
+            for (unsigned int e = 0; e < ENTITIES; ++e)
+            {
+                JobSystem::TaskHandle animate = jobs.submit([&, e]{ stages[e * 4 + 0] = spin((float)e, STAGE_ITERATIONS); });
+                JobSystem::TaskHandle bounds = jobs.submit([&, e]{ stages[e * 4 + 1] = spin(stages[e * 4 + 0], STAGE_ITERATIONS); }, { animate });
+                culled.push_back(jobs.submit([&, e]{ stages[e * 4 + 2] = spin(stages[e * 4 + 1], STAGE_ITERATIONS); }, { bounds }));
+            }
+            jobs.wait(jobs.submit([&]{
+                for (unsigned int e = 0; e < ENTITIES; ++e)
+                    stages[e * 4 + 3] = stages[e * 4 + 2] > 0.0f ? 1.0f : 0.0f;
+            }, culled));
+        });
+        if (threads == 1)
+        {
+            baseFor = forMs;
+            baseGraph = graphMs;
+        }
+        fprintf(out, "%u,%.3f,%.3f,%.2f,%.2f\n", threads, forMs, graphMs, baseFor / forMs, baseGraph / graphMs);
+        fflush(out);
+    }
+}
+void Benchmark::buffers(FILE *out)
+{
+    const size_t SIZES[] = { 4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+    const BufferCore::Usage USAGES[] = { BufferCore::MUTABLE, BufferCore::IMMUTABLE, BufferCore::ORPHAN, BufferCore::STREAM };
+    const char *USAGE_NAMES[] = { "mutable", "immutable", "orphan", "stream" };
+    const unsigned int FRAMES = 240;
+    fprintf(out, "usage,bytes,set_data_us,frame_us,mb_per_s\n");
+    for (size_t bytes : SIZES)
+    {
+        std::vector<unsigned char> data(bytes);
+        //The GPU copies each frame's contents here, so that it reads the buffer whilst later frames are written
+        GLuint scratch = 0;
+        GL_CALL(glGenBuffers(1, &scratch));
+        GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, scratch));
+        GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_COPY));
+        for (unsigned int u = 0; u < sizeof(USAGES) / sizeof(BufferCore::Usage); ++u)
+        {
+            ShaderStorageBuffer buffer(bytes, nullptr, USAGES[u]);
+            double setDataTime = 0;
+            GL_CALL(glFinish());
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned int frame = 0; frame < FRAMES; ++frame)
+            {
+                std::fill(data.begin(), data.end(), (unsigned char)frame);
+                const auto writeStart = std::chrono::steady_clock::now();
+                buffer.setData(data.data());
+                setDataTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - writeStart).count();
+                GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, buffer.getName()));
+                GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, scratch));
+                GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, buffer.getOffset(), 0, bytes));
+                GL_CALL(glFlush());
+            }
+            GL_CALL(glFinish());
+            const double total = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            fprintf(out, "%s,%llu,%.2f,%.2f,%.1f\n", USAGE_NAMES[u], (unsigned long long)bytes, setDataTime / FRAMES, total / FRAMES, (bytes * (double)FRAMES) / total);
+            fflush(out);
+        }
+        GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+        GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+        GL_CALL(glDeleteBuffers(1, &scratch));
+    }
+}
+void Benchmark::raycast(FILE *out)
+{
+    const unsigned int TERRAIN_RES = 512;
+    const unsigned int SPHERES = 256;
+    const unsigned int IMAGE_RES = 1024;
+    const unsigned int REPEATS = 3;
+    //Rolling terrain over [-1, 1], and a unit sphere instanced across it
+    auto height = [](float x, float z) { return 0.1f * sinf(x * 7.0f) * cosf(z * 5.0f) + 0.05f * sinf((x + z) * 23.0f); };
+    std::vector<glm::vec3> terrainVertices, sphereVertices;
+    std::vector<unsigned int> terrainIndices, sphereIndices;
+    for (unsigned int z = 0; z < TERRAIN_RES; ++z)
+    {
+        for (unsigned int x = 0; x < TERRAIN_RES; ++x)
+        {
+            const float fx = 2.0f * x / (TERRAIN_RES - 1) - 1.0f, fz = 2.0f * z / (TERRAIN_RES - 1) - 1.0f;
+            terrainVertices.push_back(glm::vec3(fx, height(fx, fz), fz));
+            if (x + 1 < TERRAIN_RES && z + 1 < TERRAIN_RES)
+            {
+                const unsigned int i = z * TERRAIN_RES + x;
+                terrainIndices.insert(terrainIndices.end(), { i, i + TERRAIN_RES, i + 1, i + 1, i + TERRAIN_RES, i + TERRAIN_RES + 1 });
+            }
+        }
+    }
+    const unsigned int SLICES = 32, STACKS = 16;
+    for (unsigned int s = 0; s <= STACKS; ++s)
+    {
+        for (unsigned int l = 0; l <= SLICES; ++l)
+        {
+            const float theta = glm::pi<float>() * s / STACKS, phi = 2.0f * glm::pi<float>() * l / SLICES;
+            sphereVertices.push_back(glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+            if (s < STACKS && l < SLICES)
+            {
+                const unsigned int i = s * (SLICES + 1) + l;
+                sphereIndices.insert(sphereIndices.end(), { i, i + SLICES + 1, i + 1, i + 1, i + SLICES + 1, i + SLICES + 2 });
+            }
+        }
+    }
+    const unsigned int triangles = (unsigned int)(terrainIndices.size() + sphereIndices.size() * SPHERES) / 3;
+    //Coherent rays, a pinhole camera looking down across the terrain
+    std::vector<Ray> coherent, incoherent;
+    coherent.reserve(IMAGE_RES * IMAGE_RES);
+    const glm::vec3 eye(0.0f, 1.5f, 2.0f);
+    for (unsigned int y = 0; y < IMAGE_RES; ++y)
+    {
+        for (unsigned int x = 0; x < IMAGE_RES; ++x)
+        {
+            const float u = x / (float)IMAGE_RES - 0.5f, v = y / (float)IMAGE_RES - 0.5f;
+            coherent.push_back(Ray(eye, glm::normalize(glm::vec3(u, -0.6f - v, -1.0f))));
+        }
+    }
+    //Reorder into 2x2 tiles, so each packet of 4 rays is a tile
+    {
+        std::vector<Ray> tiled;
+        tiled.reserve(coherent.size());
+        for (unsigned int y = 0; y < IMAGE_RES; y += 2)
+            for (unsigned int x = 0; x < IMAGE_RES; x += 2)
+                for (unsigned int t = 0; t < 4; ++t)
+                    tiled.push_back(coherent[(y + (t >> 1)) * IMAGE_RES + x + (t & 1)]);
+        coherent.swap(tiled);
+    }
+    //Incoherent rays, random origins above the terrain and random directions
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    incoherent.reserve(coherent.size());
+    for (size_t i = 0; i < coherent.size(); ++i)
+    {
+        glm::vec3 d(uniform(rng), uniform(rng), uniform(rng));
+        if (d == glm::vec3(0))
+            d = glm::vec3(0, -1, 0);
+        incoherent.push_back(Ray(glm::vec3(uniform(rng), 0.5f + 0.5f * uniform(rng), uniform(rng)), glm::normalize(d)));
+    }
+    //Spheres rest on the terrain
+    std::vector<glm::mat4> placements;
+    for (unsigned int i = 0; i < SPHERES; ++i)
+    {
+        const glm::vec2 p(uniform(rng), uniform(rng));
+        placements.push_back(glm::scale(glm::translate(glm::mat4(1), glm::vec3(p.x, height(p.x, p.y), p.y)), glm::vec3(0.03f)));
+    }
+    std::vector<RayHit> hits(coherent.size());
+    fprintf(out, "workload,triangles,threads,build_ms,single_mrays_per_s,packet_mrays_per_s,hit_rate\n");
+    std::vector<unsigned int> threadCounts = { 1 };
+    if (std::thread::hardware_concurrency() > 1)
+        threadCounts.push_back(std::thread::hardware_concurrency());
+    for (unsigned int threads : threadCounts)
+    {
+        JobSystem jobs(threads);
+        //Build every mesh, including the terrain, as the scene would, 1 BVH per sphere so builds run in parallel
+        RayCaster scene(jobs);
+        const double buildMs = bestOf(REPEATS, [&]{
+            RayCaster s(jobs);
+            s.add([&](){ return std::make_shared<MeshBVH>(terrainVertices.data(), terrainIndices.data(), (unsigned int)terrainIndices.size() / 3); }, nullptr);
+            for (unsigned int i = 0; i < SPHERES; ++i)
+                s.add([&](){ return std::make_shared<MeshBVH>(sphereVertices.data(), sphereIndices.data(), (unsigned int)sphereIndices.size() / 3); }, nullptr);
+            s.update();
+        });
+        scene.add([&](){ return std::make_shared<MeshBVH>(terrainVertices.data(), terrainIndices.data(), (unsigned int)terrainIndices.size() / 3); }, nullptr);
+        const auto sphere = std::make_shared<MeshBVH>(sphereVertices.data(), sphereIndices.data(), (unsigned int)sphereIndices.size() / 3);
+        for (auto &&m : placements)
+            scene.add(sphere, [m](){ return m; });
+        scene.update();
+        for (int w = 0; w < 2; ++w)
+        {
+            const std::vector<Ray> &rays = w ? incoherent : coherent;
+            const unsigned int count = (unsigned int)rays.size();
+            const double singleMs = bestOf(REPEATS, [&]{
+                jobs.parallelFor(0, count, 1024, [&](unsigned int begin, unsigned int end){
+                    for (unsigned int i = begin; i < end; ++i)
+                        hits[i] = scene.intersect(rays[i]);
+                });
+            });
+            const double packetMs = bestOf(REPEATS, [&]{
+                jobs.parallelFor(0, count / 4, 256, [&](unsigned int begin, unsigned int end){
+                    scene.intersect(&rays[begin * 4], &hits[begin * 4], (end - begin) * 4);
+                });
+            });
+            unsigned int hit = 0;
+            for (auto &&h : hits)
+                hit += h.hit();
+            fprintf(out, "%s,%u,%u,%.3f,%.2f,%.2f,%.3f\n", w ? "incoherent" : "coherent", triangles, threads, buildMs, count / (singleMs * 1000.0), count / (packetMs * 1000.0), hit / (float)count);
+            fflush(out);
+        }
+    }
+}
+void Benchmark::prePass(Visualisation &visualisation, FILE *out)
+{
+    const unsigned int WARMUP_FRAMES = 30, FRAMES = 120;
+    Profiler::setEnabled(true);
+    fprintf(out, "scale,objects,depth_prepass,samples_shaded,composite_gpu_ms,prepass_gpu_ms,frame_gpu_ms\n");
+    for (unsigned int scale : { 1u, 4u, 8u })
+    {
+        for (bool depthPrePass : { false, true })
+        {
+            auto scene = std::make_unique<TwoPassScene>(visualisation, scale, depthPrePass);
+            const TwoPassScene &s = *scene;
+            visualisation.setScene(std::move(scene));
+            visualisation.step(16, WARMUP_FRAMES);
+            GLuint64 samples = 0;
+            for (unsigned int i = 0; i < FRAMES; ++i)
+            {
+                visualisation.step(16);
+                samples += s.getSamplesShaded();
+            }
+            //Mean the GPU times of the profiled frames, scopes are named after the pass's class
+            double compositeMs = 0, prePassMs = 0, frameMs = 0;
+            unsigned int timedFrames = 0;
+            const auto &history = Profiler::getHistory();
+            for (size_t i = history.size() > FRAMES ? history.size() - FRAMES : 0; i < history.size(); ++i)
+            {
+                if (history[i].gpuTime < 0)
+                    continue;
+                for (auto &&e : history[i].events)
+                {
+                    if (e.gpuBegin < 0)
+                        continue;
+                    if (strstr(e.name, "CompositePass"))
+                        compositeMs += e.gpuEnd - e.gpuBegin;
+                    else if (strstr(e.name, "DepthPrePass"))
+                        prePassMs += e.gpuEnd - e.gpuBegin;
+                }
+                frameMs += history[i].gpuTime;
+                ++timedFrames;
+            }
+            timedFrames = std::max(1u, timedFrames);
+            fprintf(out, "%u,%u,%d,%llu,%f,%f,%f\n", scale, scale * scale * 2 + 2, depthPrePass ? 1 : 0, (unsigned long long)(samples / FRAMES),
+                compositeMs / timedFrames, prePassMs / timedFrames, frameMs / timedFrames);
+            fflush(out);
+        }
+    }
+}
+Benchmark::Summary Benchmark::summarise(std::vector<double> samples)
+{
+    Summary s;
+    if (samples.empty())
+        return s;
+    std::sort(samples.begin(), samples.end());
+    s.samples = (unsigned int)samples.size();
+    double total = 0;
+    for (double d : samples)
+        total += d;
+    s.mean = total / samples.size();
+    s.min = samples.front();
+    s.max = samples.back();
+    s.p50 = percentile(samples, 50);
+    s.p95 = percentile(samples, 95);
+    s.p99 = percentile(samples, 99);
+    return s;
+}
+bool Benchmark::writeJSON(const std::string &path, const Options &options, const std::vector<double> &cpu, const std::vector<double> &gpu)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f)
+    {
+        fprintf(stderr, "Benchmark::writeJSON(): Unable to open '%s' for writing.\n", path.c_str());
+        return false;
+    }
+    const char *renderer = (const char*)glGetString(GL_RENDERER);
+    fprintf(f, "{\n");
+    fprintf(f, "  \"workload\": \"%s\",\n", BenchmarkScene::nameOf(options.workload));
+    fprintf(f, "  \"count\": %u,\n", options.count ? options.count : DEFAULT_COUNTS[options.workload]);
+    fprintf(f, "  \"frames\": %u,\n  \"warmup\": %u,\n  \"frameTime\": %u,\n", options.frames, options.warmup, options.frameTime);
+    fprintf(f, "  \"width\": %u,\n  \"height\": %u,\n", options.dims.x, options.dims.y);
+    fprintf(f, "  \"deferred\": %s,\n", options.deferred ? "true" : "false");
+    fprintf(f, "  \"renderer\": \"");
+    for (const char *c = renderer ? renderer : ""; *c; ++c)
+    {
+        if (*c != '"' && *c != '\\')
+            fputc(*c, f);
+    }
+    fprintf(f, "\",\n");
+    writeSummaryJSON(f, "cpu", summarise(cpu));
+    fprintf(f, ",\n");
+    writeSummaryJSON(f, "gpu", summarise(gpu));
+    //Raw samples, for plotting
+    for (auto &&s : { std::make_pair("cpuFrames", &cpu), std::make_pair("gpuFrames", &gpu) })
+    {
+        fprintf(f, ",\n  \"%s\": [", s.first);
+        for (size_t i = 0; i < s.second->size(); ++i)
+            fprintf(f, "%s%.4f", i ? ", " : "", (*s.second)[i]);
+        fprintf(f, "]");
+    }
+    fprintf(f, "\n}\n");
+    const bool success = !ferror(f);
+    fclose(f);
+    return success;
+}
+bool Benchmark::writeCSV(const std::string &path, const std::vector<double> &cpu, const std::vector<double> &gpu)
+{
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f)
+    {
+        fprintf(stderr, "Benchmark::writeCSV(): Unable to open '%s' for writing.\n", path.c_str());
+        return false;
+    }
+    const Summary c = summarise(cpu), g = summarise(gpu);
+    fprintf(f, "statistic,cpu_ms,gpu_ms\n");
+    fprintf(f, "samples,%u,%u\n", c.samples, g.samples);
+    fprintf(f, "mean,%.4f,%.4f\n", c.mean, g.mean);
+    fprintf(f, "min,%.4f,%.4f\n", c.min, g.min);
+    fprintf(f, "p50,%.4f,%.4f\n", c.p50, g.p50);
+    fprintf(f, "p95,%.4f,%.4f\n", c.p95, g.p95);
+    fprintf(f, "p99,%.4f,%.4f\n", c.p99, g.p99);
+    fprintf(f, "max,%.4f,%.4f\n", c.max, g.max);
+    const bool success = !ferror(f);
+    fclose(f);
+    return success;
+}
+bool Benchmark::readBaseline(const std::string &path, Summary &cpu, Summary &gpu)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        fprintf(stderr, "Benchmark::readBaseline(): Unable to open '%s' for reading.\n", path.c_str());
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    const std::string contents = buffer.str();
+    bool success = true;
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0)
+    {
+        std::istringstream lines(contents);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            char name[32];
+            double c = 0, g = 0;
+            if (sscanf(line.c_str(), "%31[^,],%lf,%lf", name, &c, &g) != 3)
+                continue;
+            const std::string n = name;
+            if (n == "samples") { cpu.samples = (unsigned int)c; gpu.samples = (unsigned int)g; }
+            else if (n == "p50") { cpu.p50 = c; gpu.p50 = g; }
+            else if (n == "p95") { cpu.p95 = c; gpu.p95 = g; }
+            else if (n == "p99") { cpu.p99 = c; gpu.p99 = g; }
+        }
+    }
+    else
+    {
+        for (auto &&s : { std::make_pair("cpu", &cpu), std::make_pair("gpu", &gpu) })
+        {
+            double samples = 0;
+            success &= readJSONValue(contents, s.first, "samples", samples);
+            success &= readJSONValue(contents, s.first, "p50", s.second->p50);
+            success &= readJSONValue(contents, s.first, "p95", s.second->p95);
+            success &= readJSONValue(contents, s.first, "p99", s.second->p99);
+            s.second->samples = (unsigned int)samples;
+        }
+    }
+    if (!success || !cpu.samples)
+    {
+        fprintf(stderr, "Benchmark::readBaseline(): '%s' does not contain benchmark results.\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+bool Benchmark::compare(const Options &options, const Summary &cpu, const Summary &gpu, const Summary &baseCpu, const Summary &baseGpu)
+{
+    bool regressed = false;
+    printf("Comparison against '%s' (threshold %.1f%%)\n", options.baselinePath.c_str(), options.threshold);
+    printf("%-8s %10s %10s %9s\n", "", "baseline", "current", "change");
+    const struct { const char *name; const Summary &current, &baseline; } sets[] = { { "cpu", cpu, baseCpu }, { "gpu", gpu, baseGpu } };
+    for (auto &&set : sets)
+    {
+        //GPU timings may be unavailable on either side
+        if (!set.current.samples || !set.baseline.samples)
+            continue;
+        const double current[] = { set.current.p50, set.current.p95, set.current.p99 };
+        const double baseline[] = { set.baseline.p50, set.baseline.p95, set.baseline.p99 };
+        const char *names[] = { "p50", "p95", "p99" };
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            const double change = baseline[i] > 0 ? (current[i] - baseline[i]) / baseline[i] * 100.0 : 0.0;
+            const bool regression = change > options.threshold && current[i] - baseline[i] > NOISE_FLOOR;
+            regressed |= regression;
+            printf("%s %-4s %10.3f %10.3f %+8.1f%%%s\n", set.name, names[i], baseline[i], current[i], change, regression ? "  REGRESSION" : "");
+        }
+    }
+    return regressed;
+}
@@ -0,0 +1,131 @@
+#ifndef __Benchmark_h__
+#define __Benchmark_h__
+
+#include "BenchmarkScene.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+Reproducible benchmark runner, renders a BenchmarkScene along a camera path with a fixed timestep
+Per frame CPU and GPU times are taken from Profiler's timer queries, and summarised as percentiles
+Results are written as JSON and/or CSV, and may be compared against a baseline from an earlier run
+Components (e.g. blur) are instead timed by their own microbenchmark, which reports a CSV table, see runComponent()
+Usage: sdl_exp bench <crowd|instances|lights|city|blur|jobs|buffers|raycast|prepass> [options], see usage() for the options
+*/
+class Benchmark
+{
+public:
+    /**
+     * Statistics of a set of frame times, in milliseconds
+     */
+    struct Summary
+    {
+        unsigned int samples = 0;
+        double mean = 0, min = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+    };
+    struct Options
+    {
+        BenchmarkScene::Workload workload = BenchmarkScene::CROWD;
+        /**
+         * Name of the component microbenchmark to run in place of the workload, empty if a workload is to be rendered
+         */
+        std::string component;
+        /**
+         * Size of the workload, 0 selects the workload's default
+         */
+        unsigned int count = 0;
+        unsigned int frames = 600;
+        /**
+         * Frames rendered before measurement begins, these fill caches and build shader variants
+         */
+        unsigned int warmup = 60;
+        /**
+         * Simulated milliseconds per frame
+         */
+        unsigned int frameTime = 16;
+        glm::uvec2 dims = glm::uvec2(1280, 720);
+        bool headless = true;
+        /**
+         * Render the lights workload with deferred shading, rather than clustered forward shading
+         */
+        bool deferred = false;
+        /**
+         * CameraPath file to follow, if empty the camera orbits the workload once over the measured frames
+         */
+        std::string cameraPath;
+        std::string modelPath;
+        std::string jsonPath;
+        std::string csvPath;
+        std::string baselinePath;
+        /**
+         * Percentage increase over the baseline, beyond which a percentile is reported as a regression
+         */
+        float threshold = 10.0f;
+    };
+    /**
+     * Entry point, parses the command line and runs the benchmark
+     * @param argc Number of arguments, excluding the program name and "bench"
+     * @param argv Arguments following "bench"
+     * @return 0 on success, 1 if a regression against the baseline was detected, 2 on error
+     */
+    static int main(int argc, char **argv);
+    /**
+     * Runs the benchmark described by options, then writes and compares the results
+     * @return As main()
+     */
+    static int run(const Options &options);
+    /**
+     * Runs the component microbenchmark named by options.component, writing its CSV to options.csvPath (else stdout)
+     * Only the csvPath, dims and headless options apply
+     * @return 0 on success, 2 on error
+     */
+    static int runComponent(const Options &options);
+    /**
+     * Computes statistics of samples, percentiles use the nearest rank method
+     */
+    static Summary summarise(std::vector<double> samples);
+private:
+    static void usage();
+    /**
+     * Times GaussianBlur::blur() and dualFilter() across each format, resolution and radius
+     * The smallest resolution is also compared against GaussianBlur::reference()
+     * @note Requires a current OpenGL context
+     */
+    static void blur(FILE *out);
+    /**
+     * Times a JobSystem parallelFor() and a task graph workload, with 1 to 32 threads
+     */
+    static void jobs(FILE *out);
+    /**
+     * Compares the BufferCore usage modes, by writing a shader storage buffer of each size whole once per frame
+     * Each frame the GPU copies the buffer's contents, so that writes contend with in flight reads
+     * Reports the mean CPU time spent in setData() (the stall) and the achieved upload bandwidth
+     * @note Requires a current OpenGL context
+     */
+    static void buffers(FILE *out);
+    /**
+     * Reports RayCaster build times, and single ray and packet throughput (millions of rays per second) of coherent and incoherent rays
+     * Queries are made with 1 thread, and with every thread of a JobSystem
+     */
+    static void raycast(FILE *out);
+    /**
+     * Renders a TwoPassScene scaled up, with and without a DepthPrePass, reporting the cost of its CompositePass
+     * Samples shaded is measured with GL_SAMPLES_PASSED, GPU times are the mean of the profiler's timings
+     * @param visualisation The visualisation to host the scenes
+     */
+    static void prePass(Visualisation &visualisation, FILE *out);
+    static bool writeJSON(const std::string &path, const Options &options, const std::vector<double> &cpu, const std::vector<double> &gpu);
+    static bool writeCSV(const std::string &path, const std::vector<double> &cpu, const std::vector<double> &gpu);
+    /**
+     * Reads the CPU and GPU summaries from a file written by writeJSON() or writeCSV()
+     */
+    static bool readBaseline(const std::string &path, Summary &cpu, Summary &gpu);
+    /**
+     * Prints the change of each percentile relative to the baseline
+     * @return True if any percentile regressed beyond options.threshold
+     */
+    static bool compare(const Options &options, const Summary &cpu, const Summary &gpu, const Summary &baseCpu, const Summary &baseGpu);
+};
+
+#endif //__Benchmark_h__
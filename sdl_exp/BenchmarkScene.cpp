@@ -0,0 +1,270 @@
+#include "BenchmarkScene.h"
+#include "visualisation/Visualisation.h"
+#include "visualisation/shader/lights/LightsBuffer.h"
+#include <glm/gtc/constants.hpp>
+#include <cstring>
+
+namespace
+{
+    const char *WORKLOAD_NAMES[] = { "crowd", "instances", "lights", "city" };
+    /**
+     * Spacing of the grids which models are laid out on
+     */
+    const float CROWD_SPACING = 12.0f;
+    const float INSTANCE_SPACING = 3.0f;
+    /**
+     * Instances written per job
+     */
+    const unsigned int INSTANCE_GRAIN = 4096;
+    const float LIGHTS_GROUND_SIZE = 400.0f;
+    const unsigned int LIGHTS_SPHERE_GRID = 16;
+    /**
+     * Fixed seed, so that generated layouts and colours are identical between runs
+     */
+    const unsigned int SEED = 12345;
+    /**
+     * Returns the side of the smallest square grid holding count elements
+     */
+    unsigned int gridSide(unsigned int count)
+    {
+        return (unsigned int)ceil(sqrt((double)glm::max(count, 1u)));
+    }
+    /**
+     * Returns the side of the smallest cube holding count elements
+     */
+    unsigned int gridCube(unsigned int count)
+    {
+        return (unsigned int)ceil(cbrt((double)glm::max(count, 1u)));
+    }
+    /**
+     * Deterministic [0, 1) random numbers, rand() differs between platforms
+     */
+    float nextRandom(unsigned int &state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / 16777216.0f;
+    }
+}
+
+bool BenchmarkScene::parseWorkload(const char *name, Workload &workload)
+{
+    for (unsigned int i = 0; i < sizeof(WORKLOAD_NAMES) / sizeof(char*); ++i)
+    {
+        if (!strcmp(name, WORKLOAD_NAMES[i]))
+        {
+            workload = (Workload)i;
+            return true;
+        }
+    }
+    return false;
+}
+const char *BenchmarkScene::nameOf(Workload workload)
+{
+    return WORKLOAD_NAMES[workload];
+}
+BenchmarkScene::BenchmarkScene(Visualisation &visualisation, Workload workload, unsigned int count, const std::string &modelPath, bool deferred)
+    : BasicScene(visualisation)
+    , workload(workload)
+    , count(glm::max(count, 1u))
+    , deferred(deferred && workload == LIGHTS)
+    , time(0.0f)
+    , center(0.0f)
+    , radius(50.0f)
+{
+    this->setSkybox(false);
+    this->setRenderAxis(false);
+    this->visualisation.setWindowTitle("Benchmark");
+    DirectionalLight sun = Lights()->addDirectionalLight();
+    sun.Direction(glm::normalize(glm::vec3(-1, -1, 1)));
+    sun.Ambient(glm::vec3(0.2f));
+    sun.Diffuse(glm::vec3(0.8f));
+    sun.Specular(glm::vec3(0.2f));
+    switch (workload)
+    {
+    case CROWD:
+        initCrowd();
+        break;
+    case INSTANCES:
+        initInstances();
+        break;
+    case LIGHTS:
+        initLights();
+        break;
+    case CITY:
+        initCity(modelPath);
+        break;
+    }
+}
+void BenchmarkScene::initCrowd()
+{
+    bob = std::make_shared<Model>("../models/bob/bob.md5mesh", 10.0f);
+    //Agents animate on the spot, otherwise they would walk out of the camera path
+    bob->disableAnimationTravel(true);
+    registerEntity(bob);
+    const unsigned int side = gridSide(count);
+    const float half = (side - 1) * CROWD_SPACING / 2.0f;
+    for (unsigned int i = 0; i < count; ++i)
+        locations.push_back(glm::vec3((i % side) * CROWD_SPACING - half, 0.0f, (i / side) * CROWD_SPACING - half));
+    center = glm::vec3(0.0f, 5.0f, 0.0f);
+    radius = glm::max(half * 1.5f, 20.0f);
+}
+void BenchmarkScene::initInstances()
+{
+    instancedSphere = std::make_shared<Entity>(Stock::Models::ICOSPHERE, 1.0f, Stock::Shaders::INSTANCED);
+    registerEntity(instancedSphere);
+    instancedSphere->setMaterial(glm::vec3(0.05f, 0.1f, 0.2f), glm::vec3(0.25f, 0.5f, 1.0f), glm::vec3(1.0f));
+    //Sized up front, so the first frame doesn't grow the buffers
+    instancedSphere->Instances().map(count);
+    radius = glm::max((gridCube(count) - 1) * INSTANCE_SPACING * 1.25f, 20.0f);
+}
+void BenchmarkScene::writeInstances(InstanceBuffer::Instance *instances, unsigned int begin, unsigned int end) const
+{
+    //Instances fill a cube, each bobbing and spinning with its own phase
+    const unsigned int side = gridCube(count);
+    const float half = (side - 1) * INSTANCE_SPACING / 2.0f;
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        const float phase = time + i * 0.61f;
+        const glm::vec3 lattice((i % side) * INSTANCE_SPACING - half, ((i / side) % side) * INSTANCE_SPACING - half, (i / (side * side)) * INSTANCE_SPACING - half);
+        const float angle = phase * 0.5f;
+        InstanceBuffer::Instance &instance = instances[i];
+        instance.location = glm::vec4(lattice + glm::vec3(0.0f, sin(phase) * INSTANCE_SPACING * 0.25f, 0.0f), 0.75f + 0.25f * sin(phase * 1.3f));
+        instance.rotation = glm::vec4(0.0f, sin(angle), 0.0f, cos(angle));
+        instance.color = glm::vec4(0.5f + 0.5f * sin(phase), 0.5f + 0.5f * sin(phase + 2.1f), 0.5f + 0.5f * sin(phase + 4.2f), 1.0f);
+        instance.state = glm::uvec4(i, 0, 0, 0);
+    }
+}
+void BenchmarkScene::initLights()
+{
+    //Beyond MAX_LIGHTS, lights are only visible to shaders built with CLUSTERED
+    Lights()->setClustered(true);
+    const Shaders::Defines clustered = { { "CLUSTERED", "" } };
+    if (deferred)
+    {
+        //G-buffer shaders don't light, so don't read the lights
+        ground = std::make_shared<Entity>(Stock::Models::PLANE, LIGHTS_GROUND_SIZE, Stock::Shaders::FLAT_GBUFFER);
+        sphere = std::make_shared<Entity>(Stock::Models::SPHERE, 8.0f, Stock::Shaders::PHONG_GBUFFER);
+    }
+    else
+    {
+        ground = std::make_shared<Entity>(Stock::Models::PLANE, LIGHTS_GROUND_SIZE, std::make_shared<Shaders>(Stock::Shaders::FLAT, clustered));
+        sphere = std::make_shared<Entity>(Stock::Models::SPHERE, 8.0f, std::make_shared<Shaders>(Stock::Shaders::PHONG, clustered));
+    }
+    registerEntity(ground);
+    registerEntity(sphere);
+    ground->setMaterial(glm::vec3(0.02f), glm::vec3(0.6f), glm::vec3(0.1f));
+    sphere->setMaterial(glm::vec3(0.02f), glm::vec3(0.8f), glm::vec3(0.5f), 40.0f);
+    const float spacing = LIGHTS_GROUND_SIZE / LIGHTS_SPHERE_GRID;
+    for (unsigned int i = 0; i < LIGHTS_SPHERE_GRID * LIGHTS_SPHERE_GRID; ++i)
+        locations.push_back(glm::vec3(((i % LIGHTS_SPHERE_GRID) + 0.5f) * spacing, 4.0f, ((i / LIGHTS_SPHERE_GRID) + 0.5f) * spacing) - glm::vec3(LIGHTS_GROUND_SIZE / 2.0f, 0.0f, LIGHTS_GROUND_SIZE / 2.0f));
+    unsigned int state = SEED;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        PointLight p = Lights()->addPointLight();
+        const glm::vec3 color = glm::vec3(nextRandom(state), nextRandom(state), nextRandom(state));
+        p.Ambient(glm::vec3(0.0f));
+        p.Diffuse(color);
+        p.Specular(color);
+        p.ConstantAttenuation(1.0f);
+        p.LinearAttenuation(0.0f);
+        p.QuadraticAttenuation(0.02f);
+    }
+    if (deferred)
+    {
+        gBuffer = std::make_shared<GBufferPass>();
+        gBuffer->addOpaque([this](){ renderLightsGeometry(); });
+        gBuffer->resize(visualisation.getWindowDims());
+        //The back buffer has already been cleared by BasicScene
+        deferredLighting = std::make_shared<DeferredLightingPass>(gBuffer, Lights(), visualisation.getProjectionMatPtr(), std::make_shared<BackBuffer>(false));
+    }
+    center = glm::vec3(0.0f, 0.0f, 0.0f);
+    radius = LIGHTS_GROUND_SIZE * 0.6f;
+    //Place lights before the first frame
+    update(0);
+}
+void BenchmarkScene::initCity(const std::string &modelPath)
+{
+    city = std::make_shared<Entity>(modelPath.empty() ? Stock::Models::ROTHWELL.modelPath : modelPath.c_str(), 300.0f, Stock::Shaders::PHONG);
+    registerEntity(city);
+    const glm::vec3 dims = city->getDimensions();
+    const unsigned int side = gridSide(count);
+    const glm::vec2 half = glm::vec2(dims.x, dims.z) * ((side - 1) / 2.0f);
+    for (unsigned int i = 0; i < count; ++i)
+        locations.push_back(glm::vec3((i % side) * dims.x - half.x, 0.0f, (i / side) * dims.z - half.y));
+    center = glm::vec3(0.0f, dims.y / 2.0f, 0.0f);
+    radius = glm::max(glm::length(glm::vec2(dims.x, dims.z)) * side * 0.6f, 50.0f);
+}
+void BenchmarkScene::update(const unsigned int &frameTime)
+{
+    this->time += frameTime / 1000.0f;
+    if (workload == LIGHTS)
+    {
+        //Each light circles its own point, at its own rate
+        unsigned int state = SEED;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            const glm::vec3 origin = (glm::vec3(nextRandom(state), 0.0f, nextRandom(state)) - glm::vec3(0.5f, 0.0f, 0.5f)) * LIGHTS_GROUND_SIZE;
+            const float phase = nextRandom(state) * glm::two_pi<float>();
+            const float rate = 0.2f + nextRandom(state);
+            //The first light is the directional sun
+            Lights()->getPointLight(i + 1).Position(origin + glm::vec3(10.0f * sin(phase + rate * time), 6.0f, 10.0f * cos(phase + rate * time)));
+        }
+    }
+}
+void BenchmarkScene::render()
+{
+    switch (workload)
+    {
+    case CROWD:
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            //Offset each agent's animation, so that their bone transforms differ
+            bob->setLocation(locations[i]);
+            bob->update(time + i * 0.37f);
+            bob->render();
+        }
+        break;
+    case INSTANCES:
+    {
+        InstanceBuffer::Instance *instances = instancedSphere->Instances().map(count);
+        if (instances)
+        {
+            Jobs().parallelFor(0, count, INSTANCE_GRAIN, [this, instances](unsigned int begin, unsigned int end){
+                writeInstances(instances, begin, end);
+            });
+        }
+        instancedSphere->renderInstanceData();
+        break;
+    }
+    case LIGHTS:
+        if (deferred)
+        {
+            gBuffer->executeRender();
+            deferredLighting->executeRender();
+        }
+        else
+            renderLightsGeometry();
+        break;
+    case CITY:
+        for (auto &&l : locations)
+        {
+            city->setLocation(l);
+            city->render();
+        }
+        break;
+    }
+}
+void BenchmarkScene::renderLightsGeometry()
+{
+    ground->render();
+    for (auto &&l : locations)
+    {
+        sphere->setLocation(l);
+        sphere->render();
+    }
+}
+void BenchmarkScene::resize(const glm::uvec2 &dims)
+{
+    if (gBuffer)
+        gBuffer->resize(dims);
+}
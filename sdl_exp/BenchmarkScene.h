@@ -0,0 +1,106 @@
+#ifndef __BenchmarkScene_h__
+#define __BenchmarkScene_h__
+
+#include "visualisation/BasicScene.h"
+#include "visualisation/Entity.h"
+#include "visualisation/model/Model.h"
+#include "visualisation/multipass/GBufferPass.h"
+#include "visualisation/multipass/DeferredLightingPass.h"
+#include <string>
+#include <vector>
+
+/*
+Parameterised workloads for Benchmark, each stresses a different part of the renderer
+Animation is driven solely by the frame times passed to update(), so that runs are reproducible
+*/
+class BenchmarkScene : public BasicScene
+{
+public:
+    enum Workload
+    {
+        /**
+         * count skinned bob models, each animated independently (CPU bone transforms, one draw per model)
+         */
+        CROWD,
+        /**
+         * count animated icospheres, written to a streamed instance buffer in parallel, GPU culled and drawn with a single indirect draw
+         */
+        INSTANCES,
+        /**
+         * count animated point lights, binned by clustered lighting, over a ground plane and grid of spheres
+         * If deferred, they are instead binned per screen tile and lit from a G-buffer (GBufferPass, DeferredLightingPass)
+         */
+        LIGHTS,
+        /**
+         * A large OBJ model (the Rothwell town model by default), tiled count times
+         */
+        CITY
+    };
+    /**
+     * @param name Name of the workload, as returned by nameOf()
+     * @param workload Returns the matching workload
+     * @return False if name does not match a workload
+     */
+    static bool parseWorkload(const char *name, Workload &workload);
+    static const char *nameOf(Workload workload);
+    /**
+     * @param visualisation The visualisation which will render the scene
+     * @param workload The workload to build
+     * @param count The workload's size (models, instances, lights or tiles)
+     * @param modelPath The OBJ to load for the CITY workload, if empty Stock::Models::ROTHWELL is used
+     * @param deferred If true, the LIGHTS workload is rendered with deferred shading, other workloads ignore this
+     */
+    BenchmarkScene(Visualisation &visualisation, Workload workload, unsigned int count, const std::string &modelPath = "", bool deferred = false);
+
+    void render() override;
+    void update(const unsigned int &frameTime) override;
+    void resize(const glm::uvec2 &dims) override;
+    /**
+     * Returns the deferred lighting pass, nullptr unless the LIGHTS workload is deferred
+     */
+    std::shared_ptr<DeferredLightingPass> getDeferredLighting() const { return deferredLighting; }
+    /**
+     * Returns the centre and radius of a bounding sphere of the workload, used to build the default camera path
+     */
+    glm::vec3 getCenter() const { return center; }
+    float getRadius() const { return radius; }
+private:
+    void initCrowd();
+    void initInstances();
+    void initLights();
+    void initCity(const std::string &modelPath);
+    /**
+     * Draws the ground and spheres of the LIGHTS workload
+     */
+    void renderLightsGeometry();
+    /**
+     * Writes the instances [begin, end) for the current time
+     */
+    void writeInstances(InstanceBuffer::Instance *instances, unsigned int begin, unsigned int end) const;
+    const Workload workload;
+    const unsigned int count;
+    const bool deferred;
+    /**
+     * Simulated time in seconds, accumulated from frame times
+     */
+    float time;
+    glm::vec3 center;
+    float radius;
+    //Crowd
+    std::shared_ptr<Model> bob;
+    //Instances
+    std::shared_ptr<Entity> instancedSphere;
+    //Lights
+    std::shared_ptr<Entity> ground;
+    std::shared_ptr<Entity> sphere;
+    std::shared_ptr<GBufferPass> gBuffer;
+    std::shared_ptr<DeferredLightingPass> deferredLighting;
+    //City
+    std::shared_ptr<Entity> city;
+    /**
+     * Locations at which bob, sphere or city are drawn
+     */
+    std::vector<glm::vec3> locations;
+};
+
+#endif //__BenchmarkScene_h__
@@ -0,0 +1,159 @@
+#include "LineScene.h"
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+const unsigned int LineScene::TRAIL_LENGTH = 100;
+
+LineScene::LineScene(Visualisation &visualisation)
+	: BasicScene(visualisation)
+	, pen(std::make_shared<Draw>())
+	, agentCount(10000)
+	, trailHead(0)
+	, activeQuery(0)
+	, gpuSegments(0)
+	, gpuNanoseconds(0)
+	, cpuSegments(0)
+	, cpuMicroseconds(0)
+	, reportTimer(0)
+{
+	registerEntity(pen);
+	pen->setWideLines(true);
+	this->setSkybox(false);
+	this->setRenderAxis(true);
+	this->visualisation.setWindowTitle("Line Render Sample");
+	GL_CALL(glGenQueries(2, timerQueries));
+	queryPending[0] = queryPending[1] = false;
+	querySegments[0] = querySegments[1] = 0;
+	resetAgents();
+}
+LineScene::~LineScene()
+{
+	GL_CALL(glDeleteQueries(2, timerQueries));
+}
+void LineScene::resetAgents()
+{
+	trailHead = 0;
+	trails.assign(agentCount * (TRAIL_LENGTH + 1), glm::vec3(0));
+	velocities.resize(agentCount);
+	for (unsigned int i = 0; i < agentCount; ++i)
+	{
+		glm::vec3 start(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+		start = (start - 0.5f) * 100.0f;
+		for (unsigned int j = 0; j <= TRAIL_LENGTH; ++j)
+			trails[(i * (TRAIL_LENGTH + 1)) + j] = start;
+		velocities[i] = glm::vec3(0);
+	}
+}
+/*
+Called once per frame when Scene animation calls should be 
+@param Milliseconds since last time this method was called
+*/
+void LineScene::update(const unsigned int &frameTime)
+{
+	const float dt = frameTime / 1000.0f;
+	const unsigned int prevHead = trailHead;
+	trailHead = (trailHead + 1) % (TRAIL_LENGTH + 1);
+	for (unsigned int i = 0; i < agentCount; ++i)
+	{
+		glm::vec3 &v = velocities[i];
+		v += (glm::vec3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX) - 0.5f) * 20.0f * dt;
+		v = glm::clamp(v, glm::vec3(-5.0f), glm::vec3(5.0f));
+		glm::vec3 p = trails[(i * (TRAIL_LENGTH + 1)) + prevHead] + v * dt;
+		//Bounce off the bounds
+		for (int k = 0; k < 3; ++k)
+			if (std::abs(p[k]) > 50.0f)
+				v[k] = -v[k];
+		trails[(i * (TRAIL_LENGTH + 1)) + trailHead] = glm::clamp(p, glm::vec3(-50.0f), glm::vec3(50.0f));
+	}
+	//Report throughput once per second
+	reportTimer += frameTime;
+	if (reportTimer >= 1000 && cpuSegments)
+	{
+		char buffer[256];
+		sprintf(buffer, "Line Render Sample: %llu segments/ms (GPU), %llu segments/ms (CPU submit)",
+			gpuNanoseconds ? (gpuSegments * 1000000) / gpuNanoseconds : 0,
+			cpuMicroseconds ? (cpuSegments * 1000) / cpuMicroseconds : 0);
+		printf("%s [%u segments per frame, %s]\n", buffer, agentCount * TRAIL_LENGTH, pen->getWideLines() ? "wide lines" : "glLineWidth");
+		this->visualisation.setWindowTitle(buffer);
+		reportTimer = 0;
+		gpuSegments = 0;
+		gpuNanoseconds = 0;
+		cpuSegments = 0;
+		cpuMicroseconds = 0;
+	}
+}
+/*
+Called once per frame when Scene render calls should be executed
+*/
+void LineScene::render()
+{
+	//Collect the result of the query issued last frame, if it has completed
+	const unsigned int prevQuery = 1 - activeQuery;
+	if (queryPending[prevQuery])
+	{
+		GLint available = 0;
+		GL_CALL(glGetQueryObjectiv(timerQueries[prevQuery], GL_QUERY_RESULT_AVAILABLE, &available));
+		if (available)
+		{
+			GLuint64 ns = 0;
+			GL_CALL(glGetQueryObjectui64v(timerQueries[prevQuery], GL_QUERY_RESULT, &ns));
+			gpuNanoseconds += ns;
+			gpuSegments += querySegments[prevQuery];
+			queryPending[prevQuery] = false;
+		}
+	}
+	const bool timeGPU = !queryPending[activeQuery];
+	auto cpuStart = std::chrono::high_resolution_clock::now();
+	if (timeGPU)
+		GL_CALL(glBeginQuery(GL_TIME_ELAPSED, timerQueries[activeQuery]));
+	//Trails fade from their head, and thin towards their tail
+	pen->begin(Draw::Lines);
+	for (unsigned int i = 0; i < agentCount; ++i)
+	{
+		const glm::vec3 *trail = &trails[i * (TRAIL_LENGTH + 1)];
+		const float hue = i / (float)agentCount;
+		const glm::vec3 c = glm::abs(glm::fract(glm::vec3(hue) + glm::vec3(1.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f;
+		for (unsigned int j = 0; j < TRAIL_LENGTH; ++j)
+		{
+			const unsigned int a = (trailHead + TRAIL_LENGTH + 1 - j) % (TRAIL_LENGTH + 1);
+			const unsigned int b = (a + TRAIL_LENGTH) % (TRAIL_LENGTH + 1);
+			const float age = j / (float)TRAIL_LENGTH;
+			pen->color(glm::vec4(glm::clamp(c, 0.0f, 1.0f), 1.0f - age));
+			pen->width(4.0f * (1.0f - age) + 1.0f);
+			pen->vertex(trail[a]);
+			pen->vertex(trail[b]);
+		}
+	}
+	pen->end();
+	if (timeGPU)
+	{
+		GL_CALL(glEndQuery(GL_TIME_ELAPSED));
+		queryPending[activeQuery] = true;
+		querySegments[activeQuery] = agentCount * TRAIL_LENGTH;
+		cpuSegments += agentCount * TRAIL_LENGTH;
+		cpuMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - cpuStart).count();
+	}
+	activeQuery = prevQuery;
+}
+bool LineScene::keypress(SDL_Keycode keycode, int x, int y)
+{
+	switch (keycode)
+	{
+	case SDLK_l:
+		pen->setWideLines(!pen->getWideLines());
+		break;
+	case SDLK_KP_PLUS:
+		agentCount *= 2;
+		resetAgents();
+		break;
+	case SDLK_KP_MINUS:
+		agentCount = agentCount > 1 ? agentCount / 2 : 1;
+		resetAgents();
+		break;
+	default:
+		//Permit the keycode to be processed if we haven't handled personally
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,55 @@
+#ifndef __LineScene_h__
+#define __LineScene_h__
+
+#include "visualisation/BasicScene.h"
+#include "visualisation/Draw.h"
+
+/**
+ * Example scene to demonstrate (and benchmark) high segment count rendering with Draw
+ * Agents random walk, leaving trails which are redrawn every frame as transient wide lines
+ * Throughput (segments per millisecond) is reported to stdout and the window title once per second
+ */
+class LineScene : public BasicScene
+{
+public:
+	LineScene(Visualisation &visualisation);
+	~LineScene();
+
+	void render() override;
+	void update(const unsigned int &frameTime) override;
+	bool keypress(SDL_Keycode keycode, int x, int y) override;
+private:
+	/**
+	 * Resets agents and their trails
+	 */
+	void resetAgents();
+	std::shared_ptr<Draw> pen;
+	/**
+	 * Number of agents, each contributes TRAIL_LENGTH segments per frame
+	 */
+	unsigned int agentCount;
+	static const unsigned int TRAIL_LENGTH;
+	/**
+	 * Trails are stored as per agent rings of TRAIL_LENGTH+1 points, trailHead is the most recent point
+	 */
+	std::vector<glm::vec3> trails;
+	std::vector<glm::vec3> velocities;
+	unsigned int trailHead;
+	/**
+	 * GL_TIME_ELAPSED queries, alternated so the previous frame's result can be read without stalling
+	 */
+	GLuint timerQueries[2];
+	unsigned int activeQuery;
+	bool queryPending[2];
+	/**
+	 * Segments drawn within each query, so that GPU time is attributed to the frame it measured
+	 */
+	unsigned int querySegments[2];
+	/**
+	 * Accumulated stats since the last report, GPU stats only include frames whose query has been collected
+	 */
+	unsigned long long gpuSegments, gpuNanoseconds, cpuSegments, cpuMicroseconds;
+	unsigned int reportTimer;
+};
+
+#endif //__LineScene_h__
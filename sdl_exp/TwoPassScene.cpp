@@ -3,19 +3,24 @@
 #include "visualisation/multipass/BackBuffer.h"
 #include <glm/gtc/matrix_transform.inl>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+namespace
+{
+	//Spacing of the grid of deer and spheres, when the scene is scaled up
+	const float CROWD_SPACING = 30.0f;
+}
 //Create content struct
-TwoPassScene::SceneContent::SceneContent(std::shared_ptr<LightsBuffer> lights)
+//Depth shaders (index 0) render the shadow maps, material shaders (index 1) receive them, depth shaders (index 2) render the depth pre-pass
+TwoPassScene::SceneContent::SceneContent(std::shared_ptr<LightsBuffer> lights, unsigned int scale)
 	: lights(lights)
-	, deerModel(new Entity(Stock::Models::DEER, 25.0f, { Stock::Shaders::LINEAR_DEPTH, Stock::Shaders::PHONG_SHADOW }))
-    , sphereModel(new Entity(Stock::Models::SPHERE, 10.0f, { Stock::Shaders::LINEAR_DEPTH, Stock::Shaders::FLAT_SHADOW }))
-    , planeModel(new Entity(Stock::Models::PLANE, 100.0f, { Stock::Shaders::LINEAR_DEPTH, Stock::Shaders::PHONG_SHADOW }))
-	, bob(new Model("..\\models\\bob\\bob.md5mesh", 35.0f, true, { Stock::Shaders::BONE_LINEAR_DEPTH, Stock::Shaders::BONE_SHADOW }))
-    , blur(new GaussianBlur(5,1.75f))
+	, deerModel(new Entity(Stock::Models::DEER, 25.0f, { Stock::Shaders::DEPTH, Stock::Shaders::PHONG_SHADOW_MAPS, Stock::Shaders::DEPTH }))
+    , sphereModel(new Entity(Stock::Models::SPHERE, 10.0f, { Stock::Shaders::DEPTH, Stock::Shaders::FLAT_SHADOW_MAPS, Stock::Shaders::DEPTH }))
+    , planeModel(new Entity(Stock::Models::PLANE, std::max(100.0f, 2 * CROWD_SPACING * scale), { Stock::Shaders::DEPTH, Stock::Shaders::PHONG_SHADOW_MAPS, Stock::Shaders::DEPTH }))
+	, bob(new Model("..\\models\\bob\\bob.md5mesh", 35.0f, true, { Stock::Shaders::BONE_DEPTH, Stock::Shaders::BONE_SHADOW_MAPS, Stock::Shaders::BONE_DEPTH }))
+	, depthPrePass(false)
     , pointlightPos(75, 100, 0)//100 units up, radius of 75
     , pointlightTarget(0)
-    , shadowDims(2048)
-	, shadowIn()
-    , shadowOut(Texture2D::make(shadowDims, { GL_RED, GL_R32F, sizeof(float), GL_FLOAT }, nullptr, Texture::FILTER_MIN_LINEAR_MIPMAP_LINEAR | Texture::FILTER_MAG_LINEAR | Texture::WRAP_CLAMP_TO_EDGE))
 {
 	planeModel->setMaterial(Stock::Materials::RED_PLASTIC);
 	sphereModel->setMaterial(Stock::Materials::COPPER);
@@ -23,28 +28,51 @@ TwoPassScene::SceneContent::SceneContent(std::shared_ptr<LightsBuffer> lights)
     sphereModel->exportModel();
     sphereModel->setLocation(glm::vec3(10, 5, 10));
 	bob->setLocation(glm::vec3(-20,0,10));
+	//Rows of deer and spheres behind the original pair, which they partially occlude
+	for (unsigned int i = 0; i + 1 < scale * scale; ++i)
+	{
+		const glm::vec3 offset((i % scale - (scale - 1) * 0.5f) * CROWD_SPACING, 0, -(float)(i / scale + 1) * CROWD_SPACING);
+		auto deer = std::make_shared<Entity>(Stock::Models::DEER, 25.0f, std::initializer_list<const Stock::Shaders::ShaderSet>{ Stock::Shaders::DEPTH, Stock::Shaders::PHONG_SHADOW_MAPS, Stock::Shaders::DEPTH });
+		auto sphere = std::make_shared<Entity>(Stock::Models::SPHERE, 10.0f, std::initializer_list<const Stock::Shaders::ShaderSet>{ Stock::Shaders::DEPTH, Stock::Shaders::FLAT_SHADOW_MAPS, Stock::Shaders::DEPTH });
+		sphere->setMaterial(Stock::Materials::COPPER);
+		deer->setLocation(offset);
+		sphere->setLocation(offset + glm::vec3(10, 5, 10));
+		crowd.push_back(deer);
+		crowd.push_back(sphere);
+	}
 }
-TwoPassScene::TwoPassScene(Visualisation &visualisation)
+TwoPassScene::TwoPassScene(Visualisation &visualisation, unsigned int scale, bool depthPrePass)
 	: MultiPassScene(visualisation)
-	, content(std::make_shared<SceneContent>(Lights()))
-    , sPass(std::make_shared<ShadowPass>(content))
-    , cPass(std::make_shared<CompositePass>(content))
+	, content(std::make_shared<SceneContent>(Lights(), std::max(1u, scale)))
+    , sPass(std::make_shared<ShadowPass>(Lights(), visualisation.getCamera()->getViewMatPtr(), visualisation.getProjectionMatPtr()))
 	, tick(0.0f)
 	, tick2(0.0f)
 	, polarity(-1)
 {
+	content->depthPrePass = depthPrePass;
+	cPass = std::make_shared<CompositePass>(content);
 	//Register models
     registerEntity(content->deerModel);
     registerEntity(content->sphereModel);
     registerEntity(content->planeModel);
 	registerEntity(content->bob);
+	for (auto &&e : content->crowd)
+		registerEntity(e);
 	////Register render passes in correct order
 	addPass(0, sPass);
-	addPass(1, cPass);
-    //Put a preview of the depth texture on the HUD
-	shadowMapPreview = std::make_shared<Sprite2D>(content->shadowOut, std::make_shared<Shaders>(Stock::Shaders::SPRITE2D_HEAT), glm::uvec2(256, 256));
-    if(auto a = this->visualisation.getHUD().lock())
-        a->add(shadowMapPreview, HUD::AnchorV::South, HUD::AnchorH::East);
+	addPass(2, cPass);
+	if (depthPrePass)
+	{
+		//The pre-pass clears the BackBuffer, the CompositePass then shades only the visible surfaces
+		dPass = std::make_shared<DepthPrePass>(std::make_shared<BackBuffer>());
+		dPass->addOccluder(content->deerModel, 2);
+		dPass->addOccluder(content->sphereModel, 2);
+		dPass->addOccluder(content->planeModel, 2);
+		dPass->addOccluder(content->bob, 2);
+		for (auto &&e : content->crowd)
+			dPass->addOccluder(e, 2);
+		setDepthPrePass(1, dPass, 2);
+	}
 	//Enable defaults
 	this->visualisation.setWindowTitle("MultiPass Render Sample");
 
@@ -57,39 +85,39 @@ TwoPassScene::TwoPassScene(Visualisation &visualisation)
 	p.Direction(this->content->pointlightTarget - this->content->pointlightPos);
 	p.CutOff(15.0f);
 	p.Exponent(70.0f);
+	p.CastShadows(true);
 
-    //Spotlight camera at pointlightPos looking in pointlightTarget, with up vector looking up y axis
-    //These must be set *AFTER* the parent entities have been registered (need to fiddle with shaders to better handle this use case)
-	auto deer0 = content->deerModel->getShaders(0);
-	auto sphere0 = content->sphereModel->getShaders(0);
-	auto plane0 = content->planeModel->getShaders(0);
-	auto bob0 = content->bob->getShaders(0);
-	auto deer1 = content->deerModel->getShaders(1);
-	auto sphere1 = content->sphereModel->getShaders(1);
-	auto plane1 = content->planeModel->getShaders(1);
-	auto bob1 = content->bob->getShaders(1);
+	DirectionalLight d = Lights()->addDirectionalLight();
+	d.Direction(glm::vec3(-1, -2, -1));
+	d.Diffuse(glm::vec3(0.3f));
+	d.Specular(glm::vec3(0.3f));
+	d.CastShadows(true);
 
-	deer0->setViewMatPtr(&this->content->pointlightV);
-	sphere0->setViewMatPtr(&this->content->pointlightV);
-	plane0->setViewMatPtr(&this->content->pointlightV);
-	bob0->setViewMatPtr(&this->content->pointlightV);
-	//
-	deer1->addDynamicUniform("spotlightViewMat", &this->content->pointlightV);
-	sphere1->addDynamicUniform("spotlightViewMat", &this->content->pointlightV);
-	plane1->addDynamicUniform("spotlightViewMat", &this->content->pointlightV);
-	bob1->addDynamicUniform("spotlightViewMat", &this->content->pointlightV);
-    //Define the entire space the light touches
-    this->content->pointlightP = glm::ortho(-71.0, 71.0, -71.0, 71.0, 82.0, 180.0);
-	//Specify where we are rendering from to gen linear depth map
-	deer0->setProjectionMatPtr(&this->content->pointlightP);
-	sphere0->setProjectionMatPtr(&this->content->pointlightP);
-	plane0->setProjectionMatPtr(&this->content->pointlightP);
-	bob0->setProjectionMatPtr(&this->content->pointlightP);
-	//
-	deer1->addDynamicUniform("spotlightProjectionMat", &this->content->pointlightP);
-	sphere1->addDynamicUniform("spotlightProjectionMat", &this->content->pointlightP);
-	plane1->addDynamicUniform("spotlightProjectionMat", &this->content->pointlightP);
-	bob1->addDynamicUniform("spotlightProjectionMat", &this->content->pointlightP);
+	//Depth shaders (index 0) render the shadow maps, material shaders (index 1) receive them
+	//These must be set *AFTER* the parent entities have been registered, otherwise the casters' matrices are overwritten
+	sPass->addCaster(content->deerModel, 0);
+	sPass->addCaster(content->sphereModel, 0);
+	sPass->addCaster(content->planeModel, 0);
+	sPass->addCaster(content->bob, 0);
+	sPass->addReceiver(content->deerModel, 1);
+	sPass->addReceiver(content->sphereModel, 1);
+	sPass->addReceiver(content->planeModel, 1);
+	sPass->addReceiver(content->bob, 1);
+	for (auto &&e : content->crowd)
+	{
+		sPass->addCaster(e, 0);
+		sPass->addReceiver(e, 1);
+	}
+	//Depth only shaders fetch from compact position only vertex buffers
+	for (unsigned int shaderIndex : { 0u, 2u })
+	{
+		content->deerModel->usePositionStream(shaderIndex);
+		content->sphereModel->usePositionStream(shaderIndex);
+		content->planeModel->usePositionStream(shaderIndex);
+		content->bob->usePositionStream(shaderIndex);
+		for (auto &&e : content->crowd)
+			e->usePositionStream(shaderIndex);
+	}
 }
 /*
 Called once per frame when Scene animation calls should be
@@ -106,11 +134,6 @@ void TwoPassScene::update(const unsigned int &frameTime)
     //Move spotlight
     const float SPOTLIGHT_RAD = 70.0f;
     this->content->pointlightPos = glm::vec3(SPOTLIGHT_RAD * sin(this->tick), 100, SPOTLIGHT_RAD * cos(this->tick));
-    this->content->pointlightV = glm::lookAt(
-        content->pointlightPos,
-        content->pointlightTarget,
-        glm::vec3(0, 1, 0)
-        );
 
 	if (!this->bobPause)
 		this->content->bob->update((SDL_GetTicks() / 1000.0f) - this->bobAnimOffset);
@@ -141,51 +164,41 @@ bool TwoPassScene::keypress(SDL_Keycode keycode, int x, int y)
 
 void TwoPassScene::reload()
 {
-    content->blur->reload();
 }
 
-TwoPassScene::ShadowPass::ShadowPass(std::shared_ptr<SceneContent> content)
-    : RenderPass(std::make_shared<FrameBuffer>(content->shadowDims, FBAFactory::ManagedColorTexture(GL_R32F, GL_RED, GL_FLOAT), FBAFactory::ManagedDepthRenderBuffer(), FBAFactory::Disabled(), 0, true, glm::vec3(1.0f)))
+
+TwoPassScene::CompositePass::CompositePass(std::shared_ptr<SceneContent> content)
+	: RenderPass(std::make_shared<BackBuffer>(!content->depthPrePass))//The DepthPrePass clears the frame
 	, content(content)
+	, samplesQuery(0)
 {
-    //Pass the shadow texture to the second shader of each model
-    std::shared_ptr<FrameBuffer> t = std::dynamic_pointer_cast<FrameBuffer>(getFrameBuffer());
-    if (t)
-    {
-		content->shadowIn = std::dynamic_pointer_cast<Texture2D>(t->getColorTexture());
-        //content->shadowOut = content->shadowIn;//Uses the pre blur shadow map (aka hard shadows)
-    }
-	content->deerModel->getShaders(1)->addTexture("_shadowMap", content->shadowOut);
-	content->sphereModel->getShaders(1)->addTexture("_shadowMap", content->shadowOut);
-	content->planeModel->getShaders(1)->addTexture("_shadowMap", content->shadowOut);
-	content->bob->getShaders(1)->addTexture("_shadowMap", content->shadowOut);
+	GL_CALL(glGenQueries(1, &samplesQuery));
 }
-TwoPassScene::CompositePass::CompositePass(std::shared_ptr<SceneContent> content)
-	: RenderPass(std::make_shared<BackBuffer>())
-	, content(content)
-	
+TwoPassScene::CompositePass::~CompositePass()
 {
+	GL_CALL(glDeleteQueries(1, &samplesQuery));
 }
-//Renders the scene to a depth texture from the lights perspective
-void TwoPassScene::ShadowPass::render()
+GLuint64 TwoPassScene::CompositePass::getSamplesShaded() const
 {
-    content->deerModel->render(0);
-    content->sphereModel->render(0);
-	content->planeModel->render(0);
-	content->bob->render(0);
+	GLuint64 samples = 0;
+	GL_CALL(glGetQueryObjectui64v(samplesQuery, GL_QUERY_RESULT, &samples));
+	return samples;
 }
 //Uses the shadow map to render the normal scene
 void TwoPassScene::CompositePass::render()
 {
-	//Slightly blur shadow map to reduce harshness of edges
-	content->blur->blurR32F(content->shadowIn, content->shadowOut);
-	//Generate mip-map
-	content->shadowOut->updateMipMap();
-	//Render models using shadow map
+	GL_CALL(glBeginQuery(GL_SAMPLES_PASSED, samplesQuery));
+	//Render models using shadow maps
     content->deerModel->render(1);
     content->sphereModel->render(1);
 	content->planeModel->render(1);
 	content->bob->render(1);
+	for (auto &&e : content->crowd)
+		e->render(1);
+	GL_CALL(glEndQuery(GL_SAMPLES_PASSED));
+	//The light markers aren't drawn by the pre-pass, so are depth tested normally
+	if (content->depthPrePass)
+		DepthPrePass::endColourPasses();
 	//Render something at the lights location
 	content->lights->render();
 }
\ No newline at end of file
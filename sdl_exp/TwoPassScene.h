@@ -2,15 +2,14 @@
 #define __TwoPassScene_h__
 #include "visualisation/multipass/MultiPassScene.h"
 #include "visualisation/Entity.h"
-#include "visualisation/Sprite2D.h"
-#include "visualisation/shader/GaussianBlur.h"
 #include "visualisation/model/Model.h"
+#include "visualisation/multipass/ShadowPass.h"
+#include "visualisation/multipass/DepthPrePass.h"
 
 /**
  * Provides an example of how multi pass rendering can be used within sdl_exp
- * This scene provides a basic implementation of exponential shadow mapping
- * It doesn't implement detection and replacement of failure as described in section 3 of the paper
- * It also doesn't support spot lights, only point lights (had some issues handling perspectie projection mat's)
+ * A ShadowPass renders shadow maps for a moving spot light and a directional light (as cascades), the second pass renders the shadowed scene
+ * Optionally a DepthPrePass precedes the second pass, so that each visible pixel is only shaded once
  */
 class TwoPassScene : public MultiPassScene
 {
@@ -19,51 +18,49 @@ class TwoPassScene : public MultiPassScene
 	 */
 	struct SceneContent
 	{
-		SceneContent(std::shared_ptr<LightsBuffer> lights);
+		SceneContent(std::shared_ptr<LightsBuffer> lights, unsigned int scale);
 		std::shared_ptr<LightsBuffer> lights;
 		//Models used
         std::shared_ptr<Entity> deerModel;
         std::shared_ptr<Entity> sphereModel;
         std::shared_ptr<Entity> planeModel;
 		std::shared_ptr<Model> bob;
-		//Blur provider
-        std::shared_ptr<GaussianBlur> blur;
-		//Texture we will blur into
-        std::shared_ptr<Texture2D> gaussTex;
-		//Point light position, target, view and projection matrices
+		//Additional deer and spheres, arranged in a grid behind the original pair when the scene is scaled up
+		std::vector<std::shared_ptr<Entity>> crowd;
+		//Whether a DepthPrePass has written the depth of the models, before the CompositePass
+		bool depthPrePass;
+		//Spot light position and target
         glm::vec3 pointlightPos, pointlightTarget;
-        glm::mat4 pointlightV;
-        glm::mat4 pointlightP;
-		//Dimensions of the shadow texture
-        glm::uvec2 shadowDims;
-		//GL names of the rendered to and blurred to shadow textures
-		std::shared_ptr<Texture2D> shadowIn, shadowOut;
 	};
 	/**
-	 * This is the first render pass, we use to to generate the shadow map
-	 */
-	class ShadowPass : public RenderPass
-	{
-	public:
-        ShadowPass(std::shared_ptr<SceneContent> content);
-    protected:
-		void render() override;
-	private:
-		std::shared_ptr<SceneContent> content;
-	};
-	/**
-	 * This is the second render pass, we use to render the objects, passing the shadow map texture as a parameter
+	 * This is the second render pass, we use to render the objects, the ShadowPass passes them the shadow maps
 	 */
 	class CompositePass : public RenderPass
 	{
 	public:
         CompositePass(std::shared_ptr<SceneContent> content);
+		~CompositePass();
+		/**
+		 * @return The number of samples which passed the depth test whilst rendering the models in the most recent render()
+		 * @note This waits for the GPU to complete the render
+		 */
+		GLuint64 getSamplesShaded() const;
 	protected:
 		void render() override;
 		std::shared_ptr<SceneContent> content;
+		GLuint samplesQuery;
 	};
 public:
-	TwoPassScene(Visualisation &visualisation);
+	/**
+	 * @param visualisation The visualisation hosting the scene
+	 * @param scale The scene contains a scale x scale grid of deer and spheres, 1 is the original scene
+	 * @param depthPrePass Whether to render the models' depth in a DepthPrePass, before shading them
+	 */
+	TwoPassScene(Visualisation &visualisation, unsigned int scale = 1, bool depthPrePass = false);
+	/**
+	 * @return The number of samples shaded by the CompositePass in the most recent frame, see CompositePass::getSamplesShaded()
+	 */
+	GLuint64 getSamplesShaded() const { return cPass->getSamplesShaded(); }
 	void reload() override;
 	bool keypress(SDL_Keycode keycode, int x, int y) override;
 	void update(const unsigned int &frameTime) override;
@@ -72,7 +69,7 @@ private:
 
     std::shared_ptr<ShadowPass> sPass;
     std::shared_ptr<CompositePass> cPass;
-    std::shared_ptr<Sprite2D> shadowMapPreview;
+	std::shared_ptr<DepthPrePass> dPass;
 
 	float tick;
 	float tick2;
@@ -1,13 +1,22 @@
 #include "EntityScene.h"
 #include "TwoPassScene.h"
+#include "LineScene.h"
+#include "Benchmark.h"
 #include "visualisation/multipass/FrameBufferAttachment.h"
+#include <cstring>
 
 int main(int count, char **args)
 {
+    //"bench <workload> [options]" runs the benchmark harness instead, see Benchmark::usage()
+    if (count > 1 && !strcmp(args[1], "bench"))
+        return Benchmark::main(count - 2, args + 2);
     int sceneId = 0;
     if (count > 1)
         sceneId = atoi(args[1]);
-    Visualisation v = Visualisation("Visulisation Example", 1280, 720);
+    //Optional second arg: "headless", renders 600 frames offscreen at a simulated 60fps, then exits
+    //Optional third arg: path of a .y4m video to record the frames to
+    const bool headless = count > 2 && !strcmp(args[2], "headless");
+    Visualisation v = Visualisation("Visulisation Example", 1280, 720, headless);
     switch (sceneId)
     {
         case 0:
@@ -15,6 +24,11 @@ int main(int count, char **args)
                 v.setScene(std::make_unique<EntityScene>(v));
             }
             break;
+        case 2:
+            {
+                v.setScene(std::make_unique<LineScene>(v));
+            }
+            break;
         case 1:
         default:
             {
@@ -22,7 +36,13 @@ int main(int count, char **args)
             }
             break;
     }
-    v.run();
+    if (count > 3)
+        v.startCapture(args[3]);
+    if (headless)
+        v.step(16, 600);
+    else
+        v.run();
+    v.stopCapture();
 
     return 0;
 }
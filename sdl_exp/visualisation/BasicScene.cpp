@@ -1,5 +1,6 @@
 #include "BasicScene.h"
 #include "shader/lights/LightsBuffer.h"
+#include "util/JobSystem.h"
 
 BasicScene::BasicScene(ViewportExt& vis)
 	: Scene(vis)
@@ -9,6 +10,7 @@ BasicScene::BasicScene(ViewportExt& vis)
 	, skybox(std::make_unique<Skybox>())
 	, lighting(std::make_shared<LightsBuffer>(vis.getCamera()->getViewMatPtr()))
 {
+	lighting->setProjectionMatPtr(this->visualisation.getProjectionMatPtr());
 	registerEntity(axis);
 	this->skybox->setViewMatPtr(this->visualisation.getCamera());
     this->skybox->setProjectionMatPtr(this->visualisation.getProjectionMatPtr());
@@ -61,6 +63,33 @@ void BasicScene::_reload()
 	}
 	reload();
 }
+void BasicScene::_update(const unsigned int &frameTime)
+{
+	update(frameTime);
+	//Work deferred by update() (e.g. posing models) is independent per entity
+	Jobs().parallelFor(0, (unsigned int)entities.size(), 0, [this](unsigned int begin, unsigned int end){
+		for (unsigned int i = begin; i < end; ++i)
+			entities[i]->prepare();
+	});
+}
+void BasicScene::_commitTick()
+{
+	for (auto &&e : entities)
+		e->commitTick();
+}
+void BasicScene::_interpolateTick(float alpha)
+{
+	//Interpolation (and posing of models) is independent per entity
+	Jobs().parallelFor(0, (unsigned int)entities.size(), 0, [this, alpha](unsigned int begin, unsigned int end){
+		for (unsigned int i = begin; i < end; ++i)
+			entities[i]->interpolateTick(alpha);
+	});
+}
+void BasicScene::_resetTicks()
+{
+	for (auto &&e : entities)
+		e->resetTicks();
+}
 void BasicScene::setSkybox(bool state){
 	this->renderSkyboxState = state;
 }
@@ -5,6 +5,7 @@
 #include "Axis.h"
 #include "Visualisation.h"
 #include "shader/lights/LightsBuffer.h"
+#include "util/JobSystem.h"
 /**
  * This class provides a baseclass for Scenes which only require single pass rendering
  * Natively includes a Skybox and Axis
@@ -32,6 +33,14 @@ protected:
 	 * @return True if you wish to allow the keypress to be handled elsewhere
 	 */
 	virtual bool keypress(SDL_Keycode keycode, int x, int y){ return true; };
+	/**
+	 * Called when mouse buttons are pressed
+	 * @param button The SDL button index of the button pressed
+	 * @param x X coordinate of the mouse relative to the window
+	 * @param y Y coordinate of the mouse relative to the window
+	 * @return True if you wish to allow the press to be handled elsewhere
+	 */
+	virtual bool mousePress(Uint8 button, int x, int y){ return true; };
 	/**
 	 * Called when the window is resized
 	 * @param dims The new window width and height
@@ -44,6 +53,8 @@ protected:
 	/**
 	 * Called when you should update your scene
 	 * @param frameTime The number of milliseconds since the last time this method was called
+	 * @note If the visualisation runs a fixed timestep (Visualisation::setSimulationTimestep()), this is called on the simulation thread
+	 * @note In which case, only modify state which is interpolated (the location and rotation of entities and models, Model::update())
 	 */
 	virtual void update(const unsigned int &frameTime){};
 	/**
@@ -58,6 +69,10 @@ protected:
 	void setRenderAxis(bool state);
     
 	std::shared_ptr<LightsBuffer> Lights(){ return lighting; }
+	/**
+	 * The job system used for the scene's built in per frame work, update() may also submit work to it
+	 */
+	JobSystem &Jobs(){ return JobSystem::global(); }
 private:
 	bool renderAxisState, renderSkyboxState;
 	std::shared_ptr<Axis> axis;
@@ -70,6 +85,10 @@ private:
 	 * Internal keypress functionality, calls keypress()
 	 */
 	bool _keypress(SDL_Keycode keycode, int x, int y) override final;
+	/**
+	 * Internal mouse press functionality, calls mousePress()
+	 */
+	bool _mousePress(Uint8 button, int x, int y) override final { return mousePress(button, x, y); }
 	/**
 	 * Internal resize functionality, calls resize()
 	 */
@@ -79,9 +98,21 @@ private:
 	 */
 	void _reload() override final;
 	/**
-	 * Internal update functionality, calls update()
+	 * Internal update functionality, calls update() then prepares registered entities in parallel
+	 */
+	void _update(const unsigned int &frameTime) override final;
+	/**
+	 * Latches the transforms of registered entities
+	 */
+	void _commitTick() override final;
+	/**
+	 * Interpolates the transforms of registered entities
+	 */
+	void _interpolateTick(float alpha) override final;
+	/**
+	 * Discards the latched transforms of registered entities
 	 */
-	inline virtual void _update(const unsigned int &frameTime) override final { update(frameTime); };
+	void _resetTicks() override final;
 	/**
 	 * Holds registered entities so the BasicScene can automatically reload them
 	 */
@@ -1,7 +1,10 @@
 #include "Draw.h"
 #include "util/StringUtils.h"
+#include "shader/buffer/ShaderStorageBuffer.h"
+#include <algorithm>
 
 const unsigned int Draw::DEFAULT_INITIAL_VBO_LENGTH = 1024;
+const unsigned int Draw::DEFAULT_RING_SECTION_LENGTH = 16384;
 const float Draw::STORAGE_MUTLIPLIER = 2.0f;
 Draw::Draw(const unsigned int &bufferLength, const glm::vec4 &initialColor, const float &initialWidth)
 	: tName()
@@ -11,37 +14,71 @@ Draw::Draw(const unsigned int &bufferLength, const glm::vec4 &initialColor, cons
 	, shaders(std::make_shared<Shaders>(Stock::Shaders::COLOR_NOSHADE))
 	, vertices(GL_FLOAT, 3, sizeof(float))
 	, colors(GL_FLOAT, 4, sizeof(float))
+	, widths(GL_FLOAT, 1, sizeof(float))
 	, vboLen(bufferLength == 0 ? DEFAULT_INITIAL_VBO_LENGTH : bufferLength)
 	, vboOffset(0)
 	, requiredLength(0)
+	, ringShaders(std::make_shared<Shaders>(Stock::Shaders::COLOR_NOSHADE))
+	, ringVertices(GL_FLOAT, 3, sizeof(float))
+	, ringColors(GL_FLOAT, 4, sizeof(float))
+	, ringWidths(GL_FLOAT, 1, sizeof(float))
+	, ringVbo(0)
+	, ringSectionLen(0)
+	, ringSection(0)
+	, ringSectionOffset(0)
+	, ringPtr(nullptr)
+	, wideLines(false)
+	, wideShaders(nullptr)
+	, drawStateVbo(0)
+	, indirectVbo(0)
+	, viewMatPtr(nullptr)
+	, projectionMatPtr(nullptr)
 {
 	assert(STORAGE_MUTLIPLIER > 1.0f);
+	for (unsigned int i = 0; i < RING_SECTIONS; ++i)
+		ringFences[i] = nullptr;
+	for (auto &bp : wideBindPoints)
+		bp = -1;
 	//Vertices vbo
-	unsigned int vboSize = DEFAULT_INITIAL_VBO_LENGTH * sizeof(glm::vec3);
+	unsigned int vboSize = vboLen * sizeof(glm::vec3);
 	GL_CALL(glGenBuffers(1, &vertices.vbo));
 	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vertices.vbo));
 	GL_CALL(glBufferData(GL_ARRAY_BUFFER, vboSize, nullptr, GL_STATIC_DRAW));
 	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
 	//Colors vbo
-	unsigned int cvboSize = DEFAULT_INITIAL_VBO_LENGTH * sizeof(glm::vec4);
+	unsigned int cvboSize = vboLen * sizeof(glm::vec4);
 	GL_CALL(glGenBuffers(1, &colors.vbo));
 	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, colors.vbo));
 	GL_CALL(glBufferData(GL_ARRAY_BUFFER, cvboSize, nullptr, GL_STATIC_DRAW));
 	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	//Widths vbo (only read by wide lines)
+	unsigned int wvboSize = vboLen * sizeof(float);
+	GL_CALL(glGenBuffers(1, &widths.vbo));
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, widths.vbo));
+	GL_CALL(glBufferData(GL_ARRAY_BUFFER, wvboSize, nullptr, GL_STATIC_DRAW));
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
 
-	vertices.count = DEFAULT_INITIAL_VBO_LENGTH;
+	vertices.count = vboLen;
 	vertices.data = nullptr;
 
-	colors.count = DEFAULT_INITIAL_VBO_LENGTH;
+	colors.count = vboLen;
 	colors.data = nullptr;
 
+	widths.count = vboLen;
+	widths.data = nullptr;
+
 	shaders->setPositionsAttributeDetail(vertices, false);
 	shaders->setColorsAttributeDetail(colors);
+	//Ring buffer for transient draw states
+	createRing(DEFAULT_RING_SECTION_LENGTH);
 }
 Draw::~Draw()
 {
 	GL_CALL(glDeleteBuffers(1, &vertices.vbo));
 	GL_CALL(glDeleteBuffers(1, &colors.vbo));
+	GL_CALL(glDeleteBuffers(1, &widths.vbo));
+	deleteRing();
+	setWideLines(false);
 }
 void Draw::begin(Type type, const std::string &name)
 {
@@ -57,8 +94,11 @@ void Draw::end(bool replaceExisting)
 		throw std::runtime_error("Draw::end() cannot be called whilst the draw state is not open.\n");
 	if (tName.empty())
 	{
-		State s = _save(true);
-		render(s);
+		State s = _saveTransient();
+		if (wideLines)
+			renderWide({ &s }, true);
+		else
+			render(s, ringShaders);
 	}
 	else
 	{
@@ -73,9 +113,7 @@ void Draw::save(bool replaceExisting)
 		throw std::runtime_error("Draw::save() cannot be called whilst the draw state is not open.\n");
 	if (tName.empty())
 		throw std::runtime_error("Draw::save() cannot be called to close anonymous draw states.\n");
-	//Save draw state
-	State tState = _save(false);
-	//Store draw state in map
+	//Check for an existing draw state before allocating, so a rejected save doesn't leak storage
 	auto f = stateDirectory.find(tName);
 	if (f != stateDirectory.end())
 	{
@@ -85,83 +123,265 @@ void Draw::save(bool replaceExisting)
 		}
 		else
 		{
-			vboGaps.push_back({ f->second.offset, f->second.count });
+			addGap(f->second.offset, f->second.count);
 			requiredLength -= f->second.count;
-			stateDirectory.erase(tName);
+			stateDirectory.erase(f);
 		}
 	}
+	//Save draw state
+	std::string stateName = tName;
+	State tState = _save();
+	//Store draw state in map
 	requiredLength += tState.count;
-	stateDirectory.insert({ tName, std::move(tState) });
+	stateDirectory.insert({ stateName, std::move(tState) });
 }
-Draw::State Draw::_save(bool isTemporary)
+void Draw::_close()
 {
 	if (tType == Lines && tVertices.size() % 2 != 0)
 		throw std::runtime_error("Line drawings require an even number of vertices.\n");
 	assert(tVertices.size() == tColors.size());
+	assert(tVertices.size() == tWidths.size());
+	isDrawing = false;
+}
+Draw::State Draw::_save()
+{
+	_close();
+	const unsigned int count = (unsigned int)tVertices.size();
 	//Select the smallest gap which is big enough
-	unsigned int best = UINT_MAX;
-	unsigned int bestCt = UINT_MAX;
-	for (unsigned int i = 0; i < vboGaps.size(); ++i)
-	{
-		unsigned int count = std::get<1>(vboGaps[i]);
-		if (count>tVertices.size())
-		{
-			if (bestCt < count)
-				continue;
-			best = i;
-			bestCt = count;
-		}
-	}
-	//If we found a suitable gap
-	unsigned int bufferPos;
-	if (best<vboGaps.size())
-	{//We shall use a gap, so remove it from gap list
-		unsigned int offset = std::get<0>(vboGaps[best]);
-		bufferPos = offset;
-		if (!isTemporary)
-		{
-			unsigned int count = std::get<1>(vboGaps[best]);
-			vboGaps.erase(vboGaps.begin() + best);
-			if (count >tVertices.size())
-			{//Add remainder of gap back to gap list
-				vboGaps.push_back({ offset + (unsigned int)tVertices.size(), count - (unsigned int)tVertices.size() });
-			}
-		}
-	}
-	else
-	{//No suitable gap, resize buffer
-		if (vboOffset + tVertices.size()>vboLen)
+	unsigned int bufferPos = 0;
+	if (count && !takeGap(count, bufferPos))
+	{//No suitable gap, append to end of buffer
+		if (vboOffset + count > vboLen)
 		{
 			//Resize buffer
 			unsigned int newLen = vboLen;
-			while (requiredLength + tVertices.size()>newLen)
+			while (requiredLength + count > newLen)
 			{
 				newLen = (unsigned int)(newLen * STORAGE_MUTLIPLIER);
 			}
 			resize(newLen);
 		}
 		bufferPos = vboOffset;
-		vboOffset += (unsigned int)tVertices.size();
+		vboOffset += count;
 	}
 	//Close and package draw state
 	State rtn;
-	rtn.count = (unsigned int)tVertices.size();
+	rtn.count = count;
 	rtn.offset = bufferPos;
 	rtn.mType = tType;
 	rtn.mWidth = tWidth;
 	//Fill VBO
-	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vertices.vbo));
-	GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, bufferPos*sizeof(glm::vec3), rtn.count*sizeof(glm::vec3), tVertices.data()));
-	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, colors.vbo));
-	GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, bufferPos*sizeof(glm::vec4), rtn.count*sizeof(glm::vec4), tColors.data()));
-	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	if (count)
+	{
+		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vertices.vbo));
+		GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, bufferPos*sizeof(glm::vec3), rtn.count*sizeof(glm::vec3), tVertices.data()));
+		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, colors.vbo));
+		GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, bufferPos*sizeof(glm::vec4), rtn.count*sizeof(glm::vec4), tColors.data()));
+		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, widths.vbo));
+		GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, bufferPos*sizeof(float), rtn.count*sizeof(float), tWidths.data()));
+		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	}
 	//Clear temporary structures
 	tVertices.clear();
 	tColors.clear();
-	isDrawing = false;
+	tWidths.clear();
 	//Return
 	return rtn;
 }
+Draw::State Draw::_saveTransient()
+{
+	_close();
+	const unsigned int count = (unsigned int)tVertices.size();
+	State rtn;
+	rtn.count = count;
+	rtn.offset = count ? ringAlloc(count) : 0;
+	rtn.mType = tType;
+	rtn.mWidth = tWidth;
+	if (count)
+	{
+		const size_t vOffset = rtn.offset * sizeof(glm::vec3);
+		const size_t cOffset = ringColors.offset + rtn.offset * sizeof(glm::vec4);
+		const size_t wOffset = ringWidths.offset + rtn.offset * sizeof(float);
+		if (ringPtr)
+		{//Persistent coherent mapping, write straight through
+			memcpy(ringPtr + vOffset, tVertices.data(), count * sizeof(glm::vec3));
+			memcpy(ringPtr + cOffset, tColors.data(), count * sizeof(glm::vec4));
+			memcpy(ringPtr + wOffset, tWidths.data(), count * sizeof(float));
+		}
+		else
+		{//Fences already guarantee the range is free, so map it unsynchronized
+			const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+			GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, ringVbo));
+			void *v = glMapBufferRange(GL_ARRAY_BUFFER, vOffset, count * sizeof(glm::vec3), access);
+			GL_CHECK();
+			memcpy(v, tVertices.data(), count * sizeof(glm::vec3));
+			GL_CALL(glUnmapBuffer(GL_ARRAY_BUFFER));
+			void *c = glMapBufferRange(GL_ARRAY_BUFFER, cOffset, count * sizeof(glm::vec4), access);
+			GL_CHECK();
+			memcpy(c, tColors.data(), count * sizeof(glm::vec4));
+			GL_CALL(glUnmapBuffer(GL_ARRAY_BUFFER));
+			void *w = glMapBufferRange(GL_ARRAY_BUFFER, wOffset, count * sizeof(float), access);
+			GL_CHECK();
+			memcpy(w, tWidths.data(), count * sizeof(float));
+			GL_CALL(glUnmapBuffer(GL_ARRAY_BUFFER));
+			GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+		}
+	}
+	//Clear temporary structures (capacity is retained for the next frame)
+	tVertices.clear();
+	tColors.clear();
+	tWidths.clear();
+	return rtn;
+}
+unsigned int Draw::gapClass(unsigned int count)
+{
+	assert(count > 0);
+	unsigned int c = 0;
+	while (count >>= 1)
+		++c;
+	return c;
+}
+void Draw::addGap(unsigned int offset, unsigned int count)
+{
+	if (count)
+		vboGaps[gapClass(count)].push_back({ offset, count });
+}
+bool Draw::takeGap(unsigned int count, unsigned int &offset)
+{
+	const unsigned int c = gapClass(count);
+	//Gaps in the matching class may be too small, so select the smallest which fits
+	{
+		auto &list = vboGaps[c];
+		unsigned int best = UINT_MAX;
+		unsigned int bestCt = UINT_MAX;
+		for (unsigned int i = 0; i < list.size(); ++i)
+		{
+			if (list[i].second >= count && list[i].second < bestCt)
+			{
+				best = i;
+				bestCt = list[i].second;
+				if (bestCt == count)
+					break;
+			}
+		}
+		if (best < list.size())
+		{
+			offset = list[best].first;
+			list[best] = list.back();
+			list.pop_back();
+			addGap(offset + count, bestCt - count);
+			return true;
+		}
+	}
+	//Every gap in a larger class fits, so take the first non-empty one
+	for (unsigned int i = c + 1; i < GAP_CLASSES; ++i)
+	{
+		auto &list = vboGaps[i];
+		if (!list.empty())
+		{
+			std::pair<unsigned int, unsigned int> gap = list.back();
+			list.pop_back();
+			offset = gap.first;
+			addGap(offset + count, gap.second - count);
+			return true;
+		}
+	}
+	return false;
+}
+void Draw::createRing(unsigned int sectionLength)
+{
+	ringSectionLen = sectionLength;
+	ringSection = 0;
+	ringSectionOffset = 0;
+	const unsigned int ringLen = ringSectionLen * RING_SECTIONS;
+	//Regions are aligned so they can each be bound as storage buffers
+	const unsigned int ALIGN = (unsigned int)std::max(BufferCore::offsetAlignment(GL_SHADER_STORAGE_BUFFER), 1);
+	const unsigned int colorsOffset = ((ringLen * sizeof(glm::vec3)) + ALIGN - 1) / ALIGN * ALIGN;
+	const unsigned int widthsOffset = ((colorsOffset + ringLen * sizeof(glm::vec4)) + ALIGN - 1) / ALIGN * ALIGN;
+	const GLsizeiptr ringSize = widthsOffset + ringLen * sizeof(float);
+	GL_CALL(glGenBuffers(1, &ringVbo));
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, ringVbo));
+	if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GL_CALL(glBufferStorage(GL_ARRAY_BUFFER, ringSize, nullptr, flags));
+		ringPtr = static_cast<char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, ringSize, flags));
+		GL_CHECK();
+	}
+	else
+	{
+		GL_CALL(glBufferData(GL_ARRAY_BUFFER, ringSize, nullptr, GL_STREAM_DRAW));
+		ringPtr = nullptr;
+	}
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	//Vertices, colours and widths share the buffer
+	ringVertices.vbo = ringVbo;
+	ringVertices.count = ringLen;
+	ringVertices.offset = 0;
+	ringColors.vbo = ringVbo;
+	ringColors.count = ringLen;
+	ringColors.offset = colorsOffset;
+	ringWidths.vbo = ringVbo;
+	ringWidths.count = ringLen;
+	ringWidths.offset = widthsOffset;
+	ringShaders->setPositionsAttributeDetail(ringVertices, false);
+	ringShaders->setColorsAttributeDetail(ringColors);
+}
+void Draw::deleteRing()
+{
+	for (unsigned int i = 0; i < RING_SECTIONS; ++i)
+	{
+		if (ringFences[i])
+		{
+			GL_CALL(glDeleteSync(ringFences[i]));
+			ringFences[i] = nullptr;
+		}
+	}
+	if (ringPtr)
+	{
+		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, ringVbo));
+		GL_CALL(glUnmapBuffer(GL_ARRAY_BUFFER));
+		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+		ringPtr = nullptr;
+	}
+	GL_CALL(glDeleteBuffers(1, &ringVbo));
+	ringVbo = 0;
+}
+unsigned int Draw::ringAlloc(unsigned int count)
+{
+	if (count > ringSectionLen)
+	{//Drawing won't fit in a section, grow the ring
+		//The old buffer's deletion is deferred by GL until pending draws have completed
+		unsigned int newLen = ringSectionLen;
+		while (count > newLen)
+			newLen = (unsigned int)(newLen * STORAGE_MUTLIPLIER);
+		deleteRing();
+		createRing(newLen);
+	}
+	else if (ringSectionOffset + count > ringSectionLen)
+	{//Section exhausted, fence it (all draws reading it have been issued) and move to the next
+		ringFences[ringSection] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		GL_CHECK();
+		ringSection = (ringSection + 1) % RING_SECTIONS;
+		ringSectionOffset = 0;
+		if (ringFences[ringSection])
+		{//Wait for the GPU to finish with the section before overwriting it
+			GLenum waitResult = GL_TIMEOUT_EXPIRED;
+			while (waitResult == GL_TIMEOUT_EXPIRED)
+			{
+				waitResult = glClientWaitSync(ringFences[ringSection], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				GL_CHECK();
+			}
+			if (waitResult == GL_WAIT_FAILED)
+				fprintf(stderr, "Draw: glClientWaitSync() failed whilst waiting for ring section %u.\n", ringSection);
+			GL_CALL(glDeleteSync(ringFences[ringSection]));
+			ringFences[ringSection] = nullptr;
+		}
+	}
+	unsigned int rtn = (ringSection * ringSectionLen) + ringSectionOffset;
+	ringSectionOffset += count;
+	return rtn;
+}
 void Draw::render(const std::string &name)
 {
 	auto f = stateDirectory.find(name);
@@ -169,14 +389,150 @@ void Draw::render(const std::string &name)
 	{
 		throw std::runtime_error(su::format("Draw state '%s' was not found for rendering().\n", name.c_str()));
 	}
-	render(f->second);
+	if (wideLines)
+		renderWide({ &f->second }, false);
+	else
+		render(f->second, shaders);
+}
+void Draw::render(const std::vector<std::string> &names)
+{
+	std::vector<const State *> states;
+	states.reserve(names.size());
+	for (auto &name : names)
+	{
+		auto f = stateDirectory.find(name);
+		if (f == stateDirectory.end())
+		{
+			throw std::runtime_error(su::format("Draw state '%s' was not found for rendering().\n", name.c_str()));
+		}
+		states.push_back(&f->second);
+	}
+	if (wideLines)
+		renderWide(states, false);
+	else
+		for (auto &s : states)
+			render(*s, shaders);
+}
+void Draw::renderAll()
+{
+	std::vector<const State *> states;
+	states.reserve(stateDirectory.size());
+	for (auto &a : stateDirectory)
+		states.push_back(&a.second);
+	if (wideLines)
+		renderWide(states, false);
+	else
+		for (auto &s : states)
+			render(*s, shaders);
+}
+void Draw::renderWide(const std::vector<const State *> &states, bool transient)
+{
+	//Layout matches the struct consumed by glMultiDrawArraysIndirect()
+	struct DrawArraysIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+	std::vector<DrawArraysIndirectCommand> commands;
+	std::vector<glm::uvec2> drawStates;
+	commands.reserve(states.size());
+	drawStates.reserve(states.size());
+	for (auto &s : states)
+	{
+		const unsigned int segments = segmentCount(*s);
+		if (!segments)
+			continue;
+		//baseInstance selects the per draw attribute, as gl_DrawID requires GL 4.6
+		commands.push_back({ segments * 6, 1, 0, (GLuint)drawStates.size() });
+		drawStates.push_back(glm::uvec2(s->offset, (unsigned int)s->mType));
+	}
+	if (commands.empty())
+		return;
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, drawStateVbo));
+	GL_CALL(glBufferData(GL_ARRAY_BUFFER, drawStates.size() * sizeof(glm::uvec2), drawStates.data(), GL_STREAM_DRAW));
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectVbo));
+	GL_CALL(glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawArraysIndirectCommand), commands.data(), GL_STREAM_DRAW));
+	//Bind the vertex data as storage
+	if (transient)
+	{
+		GL_CALL(glBindBufferRange(GL_SHADER_STORAGE_BUFFER, wideBindPoints[0], ringVbo, ringVertices.offset, ringVertices.count * sizeof(glm::vec3)));
+		GL_CALL(glBindBufferRange(GL_SHADER_STORAGE_BUFFER, wideBindPoints[1], ringVbo, ringColors.offset, ringColors.count * sizeof(glm::vec4)));
+		GL_CALL(glBindBufferRange(GL_SHADER_STORAGE_BUFFER, wideBindPoints[2], ringVbo, ringWidths.offset, ringWidths.count * sizeof(float)));
+	}
+	else
+	{
+		GL_CALL(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, wideBindPoints[0], vertices.vbo));
+		GL_CALL(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, wideBindPoints[1], colors.vbo));
+		GL_CALL(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, wideBindPoints[2], widths.vbo));
+	}
+	GLint viewport[4];
+	GL_CALL(glGetIntegerv(GL_VIEWPORT, viewport));
+	viewportDims[0] = (GLfloat)viewport[2];
+	viewportDims[1] = (GLfloat)viewport[3];
+	wideShaders->useProgram();
+	GL_CALL(glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, (GLsizei)commands.size(), 0));
+	wideShaders->clearProgram();
+	GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
+unsigned int Draw::segmentCount(const State &state)
+{
+	if (state.mType == Points)
+		return state.count;
+	else if (state.mType == Lines)
+		return state.count / 2;
+	else if (state.mType == Polyline)
+		return state.count > 1 ? state.count - 1 : 0;
+	throw std::runtime_error("Unexpected Type passed to Draw::segmentCount()\n");
+}
+void Draw::setWideLines(const bool &enabled)
+{
+	if (enabled == wideLines)
+		return;
+	wideLines = enabled;
+	if (enabled)
+	{
+		wideShaders = std::make_shared<Shaders>(Stock::Shaders::DRAW_WIDE);
+		GL_CALL(glGenBuffers(1, &drawStateVbo));
+		GL_CALL(glGenBuffers(1, &indirectVbo));
+		Shaders::VertexAttributeDetail drawState(GL_UNSIGNED_INT, 2, sizeof(unsigned int));
+		drawState.vbo = drawStateVbo;
+		drawState.divisor = 1;
+		wideShaders->addGenericAttributeDetail("_drawState", drawState);
+		wideBindPoints[0] = ShaderStorageBuffer::allocateBindPoint();
+		wideBindPoints[1] = ShaderStorageBuffer::allocateBindPoint();
+		wideBindPoints[2] = ShaderStorageBuffer::allocateBindPoint();
+		wideShaders->addBuffer("_drawVertices", GL_SHADER_STORAGE_BUFFER, wideBindPoints[0]);
+		wideShaders->addBuffer("_drawColors", GL_SHADER_STORAGE_BUFFER, wideBindPoints[1]);
+		wideShaders->addBuffer("_drawWidths", GL_SHADER_STORAGE_BUFFER, wideBindPoints[2]);
+		wideShaders->addDynamicUniform("_viewportDims", viewportDims, 2);
+		wideShaders->setViewMatPtr(viewMatPtr);
+		wideShaders->setProjectionMatPtr(projectionMatPtr);
+	}
+	else
+	{
+		wideShaders.reset();
+		GL_CALL(glDeleteBuffers(1, &drawStateVbo));
+		GL_CALL(glDeleteBuffers(1, &indirectVbo));
+		drawStateVbo = 0;
+		indirectVbo = 0;
+		for (auto &bp : wideBindPoints)
+		{
+			ShaderStorageBuffer::releaseBindPoint(bp);
+			bp = -1;
+		}
+	}
 }
-void Draw::render(const State &state) const
+void Draw::render(const State &state, const std::shared_ptr<Shaders> &s) const
 {
+	if (!state.count)
+		return;
 	setWidth(state.mType, state.mWidth);
-	shaders->useProgram();
+	s->useProgram();
 	GL_CALL(glDrawArrays(toGL(state.mType), state.offset, state.count));
-	shaders->clearProgram();
+	s->clearProgram();
 	clearWidth(state.mType);
 }
 GLenum Draw::toGL(const Type &t)
@@ -231,9 +587,9 @@ void Draw::clearWidth(const Type &t)
 }
 void Draw::resize(unsigned int newLength)
 {
-	assert(newLength > requiredLength);
+	assert(newLength >= requiredLength);
 	/**
-	* Allocate new vbos of double size
+	* Allocate new vbos
 	*/
 	//Vertices vbo
 	GLuint _vbo = 0, _cvbo = 0;
@@ -248,45 +604,70 @@ void Draw::resize(unsigned int newLength)
 	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, _cvbo));
 	GL_CALL(glBufferData(GL_ARRAY_BUFFER, cvboSize, nullptr, GL_STATIC_DRAW));
 	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	/**
-	* Copy back data
-	*/
-	unsigned int _vboSize = vboLen * sizeof(glm::vec3);
-	unsigned int _cvboSize = vboLen * sizeof(glm::vec4);
-	glm::vec3 *_vertices = (glm::vec3 *)malloc(_vboSize);
-	glm::vec4 *_colors = (glm::vec4 *)malloc(_cvboSize);
-	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, _vbo));
-	GL_CALL(glGetBufferSubData(GL_ARRAY_BUFFER, 0, _vboSize, _vertices));
-	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, _cvbo));
-	GL_CALL(glGetBufferSubData(GL_ARRAY_BUFFER, 0, _cvboSize, _colors));
+	//Widths vbo
+	GLuint _wvbo = 0;
+	unsigned int wvboSize = newLength * sizeof(float);
+	GL_CALL(glGenBuffers(1, &_wvbo));
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, _wvbo));
+	GL_CALL(glBufferData(GL_ARRAY_BUFFER, wvboSize, nullptr, GL_STATIC_DRAW));
 	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	unsigned int _offset = 0;
 	/**
-	* Defragment from old into new
+	* Plan defragmentation, packing states in their current order
+	* States which are already contiguous are merged into a single copy
 	*/
+	std::vector<State *> ordered;
+	ordered.reserve(stateDirectory.size());
 	for (auto &a : stateDirectory)
+		if (a.second.count)
+			ordered.push_back(&a.second);
+	std::sort(ordered.begin(), ordered.end(), [](const State *a, const State *b){ return a->offset < b->offset; });
+	struct Copy{ unsigned int src, dst, count; };
+	std::vector<Copy> copies;
+	unsigned int _offset = 0;
+	for (auto &a : ordered)
 	{
-		//Copy back to vbo
-		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, _vbo));
-		GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, _offset*sizeof(glm::vec3), a.second.count*sizeof(glm::vec3), &_vertices[a.second.offset]));
-		GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, _cvbo));
-		GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, _offset*sizeof(glm::vec4), a.second.count*sizeof(glm::vec4), &_colors[a.second.offset]));
-		a.second.offset = _offset;
-		_offset += a.second.count;
+		if (!copies.empty() && copies.back().src + copies.back().count == a->offset)
+			copies.back().count += a->count;
+		else
+			copies.push_back({ a->offset, _offset, a->count });
+		a->offset = _offset;
+		_offset += a->count;
 	}
 	assert(_offset == requiredLength);
+	/**
+	* Defragment from old into new, without leaving the GPU
+	*/
+	const struct { GLuint src, dst; size_t elementSize; } buffers[] = {
+		{ vertices.vbo, _vbo, sizeof(glm::vec3) },
+		{ colors.vbo, _cvbo, sizeof(glm::vec4) },
+		{ widths.vbo, _wvbo, sizeof(float) },
+	};
+	for (auto &b : buffers)
+	{
+		GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, b.src));
+		GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, b.dst));
+		for (auto &c : copies)
+		{
+			GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, c.src*b.elementSize, c.dst*b.elementSize, c.count*b.elementSize));
+		}
+	}
+	GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
 	vboOffset = _offset;
-	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	free(_vertices);
-	free(_colors);
-	vboGaps.clear();
+	for (auto &g : vboGaps)
+		g.clear();
 	/**
 	* Delete and replace old vbos
 	*/
 	GL_CALL(glDeleteBuffers(1, &vertices.vbo));
 	GL_CALL(glDeleteBuffers(1, &colors.vbo));
+	GL_CALL(glDeleteBuffers(1, &widths.vbo));
 	vertices.vbo = _vbo;
+	vertices.count = newLength;
 	colors.vbo = _cvbo;
+	colors.count = newLength;
+	widths.vbo = _wvbo;
+	widths.count = newLength;
 	shaders->setPositionsAttributeDetail(vertices, false);
 	shaders->setColorsAttributeDetail(colors);
 	vboLen = newLength;
@@ -294,16 +675,28 @@ void Draw::resize(unsigned int newLength)
 void Draw::reload()
 {
 	shaders->reload();
+	ringShaders->reload();
+	if (wideShaders)
+		wideShaders->reload();
 }
 void Draw::setViewMatPtr(glm::mat4 const *viewMat)
 {
+	viewMatPtr = viewMat;
 	shaders->setViewMatPtr(viewMat);
+	ringShaders->setViewMatPtr(viewMat);
+	if (wideShaders)
+		wideShaders->setViewMatPtr(viewMat);
 }
 void Draw::setProjectionMatPtr(glm::mat4 const *projectionMat)
 {
+	projectionMatPtr = projectionMat;
 	shaders->setProjectionMatPtr(projectionMat);
+	ringShaders->setProjectionMatPtr(projectionMat);
+	if (wideShaders)
+		wideShaders->setProjectionMatPtr(projectionMat);
 }
 void Draw::setLightsBuffer(const GLuint &bufferBindingPoint)
 {
 	shaders->setLightsBuffer(bufferBindingPoint);
-}
\ No newline at end of file
+	ringShaders->setLightsBuffer(bufferBindingPoint);
+}
@@ -2,14 +2,17 @@
 #define __Draw_h__
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "interface/Renderable.h"
 #include "shader/Shaders.h"
 
 /**
  * Class for automatically managing VAO's and VBO's for drawing points, lines and polylines at runtime
  * If draw routines include a string when opened, they be recalled which is more performant than recreating them from scratch if drawing static structures
+ * Anonymous (transient) drawings are streamed through a persistently mapped ring buffer, so they never stall on, or fragment, the saved state storage
+ * Optionally, lines and points can be expanded to screen space quads by the GPU (setWideLines()), as core profile drivers may clamp glLineWidth() to 1.0
  */
-class Draw : Renderable
+class Draw : public Renderable
 {
 public:
 	enum Type
@@ -66,6 +69,28 @@ public:
 	 * @param name The name of the draw state to render
 	 */
 	void render(const std::string &name);
+	/**
+	 * Renders multiple saved drawstates
+	 * When wide lines are enabled, this is a single multi-draw
+	 * @param names The names of the draw states to render
+	 */
+	void render(const std::vector<std::string> &names);
+	/**
+	 * Renders all saved drawstates
+	 * When wide lines are enabled, this is a single multi-draw
+	 */
+	void renderAll();
+	/**
+	 * Toggles rendering lines and points as screen space quads expanded from storage buffers
+	 * This supports widths beyond the driver's glLineWidth() limit, and per vertex widths
+	 * @param enabled The desired state
+	 * @note Requires GL 4.3 (vertex pulling from shader storage, glMultiDrawArraysIndirect())
+	 */
+	void setWideLines(const bool &enabled);
+	/**
+	 * @return Whether lines and points are being rendered as screen space quads
+	 */
+	bool getWideLines() const { return wideLines; }
 	/**
 	 * Reloads the shader
 	 */
@@ -86,8 +111,8 @@ public:
 	 */
     void setLightsBuffer(const GLuint &bufferBindingPoint) override;
 	/**
-	 * Sets the width to use for the current drawing
-	 * The last value set before end() or save() will be taken
+	 * Sets the width to use for subsequent vertices
+	 * When wide lines are disabled, the last value set before end() or save() will be taken for the whole drawing
 	 */
 	void width(const float &w) { tWidth = w; }
 	/**
@@ -127,6 +152,7 @@ public:
 			throw std::runtime_error("Draw::vertex() may only be called between Draw::begin() and Draw::end() or Draw::save()\n");
 		tVertices.push_back(v);
 		tColors.push_back(tColor);
+		tWidths.push_back(tWidth);
 	}
 	void vertex(const glm::vec4 &v) { vertex(glm::vec3(v)); }
 	/**
@@ -160,22 +186,77 @@ private:
 	/**
 	 * Renders the provided draw state
 	 * @param state The draw state to be rendered
+	 * @param s The shaders (and hence VAO) which the state's offset refers to
 	 */
-	void render(const State &state) const;
+	void render(const State &state, const std::shared_ptr<Shaders> &s) const;
 	/**
 	 * Holds all created draw states
 	 */
 	std::unordered_map<std::string, State> stateDirectory;
 	/**
-	 * Holds a list of pairs stating where gaps can be found in the current vbo
+	 * Number of gap size classes, class n holds gaps of [2^n, 2^(n+1)) vertices
+	 */
+	static const unsigned int GAP_CLASSES = 32;
+	/**
+	 * Segregated free lists stating where gaps can be found in the current vbo
 	 * @note Pair structure is {offset, count}
 	 */
-	std::vector<std::pair<unsigned int, unsigned int>> vboGaps;
+	std::vector<std::pair<unsigned int, unsigned int>> vboGaps[GAP_CLASSES];
+	/**
+	 * Renders the provided draw states as screen space quads, with a single multi-draw
+	 * @param states The draw states to be rendered
+	 * @param transient If true the states' offsets refer to the ring, rather than the vbo
+	 */
+	void renderWide(const std::vector<const State *> &states, bool transient);
+	/**
+	 * @return The number of quads required to render the state via renderWide()
+	 */
+	static unsigned int segmentCount(const State &state);
+	/**
+	 * @return The size class which a gap of count vertices belongs to (floor(log2(count)))
+	 */
+	static unsigned int gapClass(unsigned int count);
+	/**
+	 * Adds a gap to the relevant free list
+	 */
+	void addGap(unsigned int offset, unsigned int count);
+	/**
+	 * Removes a gap of atleast count vertices from the free lists, returning any remainder to them
+	 * @param count The number of vertices required
+	 * @param offset Returns the offset of the claimed gap
+	 * @return True if a suitable gap was found
+	 */
+	bool takeGap(unsigned int count, unsigned int &offset);
 	/*
-	 * Saves the current in progress draw state returning the create draw state struct
-	 * @param isTemporary Specifies whether the create state is temporary (passing false will cause gapList to be updated)
+	 * Saves the current in progress draw state into the vbo returning the created draw state struct
 	 */
-	State _save(bool isTemporary);
+	State _save();
+	/*
+	 * Streams the current in progress draw state into the ring buffer returning the created draw state struct
+	 */
+	State _saveTransient();
+	/**
+	 * Checks the draw state is valid and closes it
+	 * @note Temporary structures must be cleared by the caller after they are consumed
+	 */
+	void _close();
+	/**
+	 * Creates the ring buffer used for transient draw states
+	 * Where buffer storage is available (GL 4.4/ARB_buffer_storage) the buffer is mapped once, persistently
+	 * @param sectionLength The number of vertices in each section of the ring
+	 */
+	void createRing(unsigned int sectionLength);
+	/**
+	 * Unmaps and deletes the ring buffer, and any outstanding fences
+	 */
+	void deleteRing();
+	/**
+	 * Claims space for count vertices within the ring
+	 * If the current section is exhausted it is fenced, and the next section is waited on before reuse
+	 * @param count The number of vertices required
+	 * @return The offset (in vertices) of the claimed space
+	 */
+	unsigned int ringAlloc(unsigned int count);
 	/*
 	 * Flags whether we are currently drawing
 	 */
@@ -186,11 +267,12 @@ private:
 	Type tType;
 	std::vector<glm::vec3> tVertices;
 	std::vector<glm::vec4> tColors;
+	std::vector<float> tWidths;
 	/**
 	 * Data required for rendering
 	 */
 	std::shared_ptr<Shaders> shaders;
-	Shaders::VertexAttributeDetail vertices, colors;
+	Shaders::VertexAttributeDetail vertices, colors, widths;
 	/**
 	 * Data required for managing storage
 	 */
@@ -198,6 +280,35 @@ private:
 	const static unsigned int DEFAULT_INITIAL_VBO_LENGTH;
 	const static float STORAGE_MUTLIPLIER;
 	unsigned int requiredLength;
+	/**
+	 * Data required for rendering transient draw states
+	 * The ring holds all vertices, followed by all colours and widths, within a single buffer
+	 */
+	std::shared_ptr<Shaders> ringShaders;
+	Shaders::VertexAttributeDetail ringVertices, ringColors, ringWidths;
+	/**
+	 * Data required for managing the ring
+	 * The ring is split into RING_SECTIONS, each of which is fenced when writing moves on from it
+	 */
+	const static unsigned int RING_SECTIONS = 3;
+	const static unsigned int DEFAULT_RING_SECTION_LENGTH;
+	GLuint ringVbo;
+	unsigned int ringSectionLen, ringSection, ringSectionOffset;
+	GLsync ringFences[RING_SECTIONS];
+	/**
+	 * Persistent mapping of the ring buffer, nullptr if buffer storage is unavailable
+	 */
+	char *ringPtr;
+	/**
+	 * Data required for rendering wide lines
+	 * The vertex, colour and width buffers are read as storage buffers, a per draw attribute identifies each state
+	 */
+	bool wideLines;
+	std::shared_ptr<Shaders> wideShaders;
+	GLuint drawStateVbo, indirectVbo;
+	GLint wideBindPoints[3];
+	GLfloat viewportDims[2];
+	const glm::mat4 *viewMatPtr, *projectionMatPtr;
 	/**
 	 * @return The GLenum which matches Type t
 	 */
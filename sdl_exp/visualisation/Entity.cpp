@@ -113,7 +113,6 @@ Entity::Entity(
 	model.modelPath,
 	material,
 	modelScale) { }
-const unsigned int MAX_OBJ_MATERIALS = 10;
 Entity::Entity(
 	const char *modelPath,
 	Stock::Materials::Material const material,
@@ -127,9 +126,8 @@ Entity::Entity(
 	, vn_count(0)
 	, SCALE(modelScale)
 	, modelPath(modelPath)
-	, materialBuffer(std::make_shared<UniformBuffer>(sizeof(MaterialProperties) * MAX_OBJ_MATERIALS))
-	, location(0.0f)
-	, rotation(0.0f, 0.0f, 1.0f, 0.0f)
+	, location(glm::vec3(0.0f))
+	, rotation(glm::vec4(0.0f, 0.0f, 1.0f, 0.0f))
 	, shaders()
 	, texture(nullptr)
 	, cullFace(true)
@@ -147,7 +145,7 @@ Entity::Entity(
 		//Override material
 		for (unsigned int i = 0; i < matSize; ++i)
 		{
-			this->materials.push_back(Material(materialBuffer, (unsigned int)materials.size(), material));
+			this->materials.push_back(Material(material));
 			if (positions.data)
 			{
 				auto it = materials[i].getShaders();
@@ -155,7 +153,6 @@ Entity::Entity(
 				it->setNormalsAttributeDetail(normals);
 				it->setColorsAttributeDetail(colors);
 				it->setTexCoordsAttributeDetail(texcoords);
-				it->setMaterialBuffer(materialBuffer);
 				it->setFaceVBO(faces.vbo);
 			}
 			materials[i].bake();
@@ -188,9 +185,8 @@ Entity::Entity(
 	, vn_count(0)
 	, SCALE(modelScale)
 	, modelPath(modelPath)
-	, materialBuffer(std::make_shared<UniformBuffer>(sizeof(MaterialProperties) * MAX_OBJ_MATERIALS))
-    , location(0.0f)
-    , rotation(0.0f, 0.0f, 1.0f, 0.0f)
+    , location(glm::vec3(0.0f))
+    , rotation(glm::vec4(0.0f, 0.0f, 1.0f, 0.0f))
     , shaders(shaders)
     , texture(texture)
     , cullFace(true)
@@ -204,10 +200,11 @@ Entity::Entity(
     //If texture has been provided, set up
 	if (!materials.size())
 	{
-		this->materials.push_back(Material(materialBuffer, (unsigned int)materials.size()));
+		this->materials.push_back(Material());
 		materials[0].bake();
 	}
-    if (texture)
+    //Only 2D textures can be packed into the material, others (e.g. Skybox's cube map) are bound directly to the custom shaders below
+    if (texture && texture->getType() == GL_TEXTURE_2D)
     {
 		Material::TextureFrame frame = Material::TextureFrame();
 		frame.texture = texture;
@@ -222,7 +219,7 @@ Entity::Entity(
 			it->setNormalsAttributeDetail(normals);
 			it->setColorsAttributeDetail(colors);
 			it->setTexCoordsAttributeDetail(texcoords);
-			it->setMaterialBuffer(materialBuffer);
+			materials[0].attach(it);
 			it->setFaceVBO(faces.vbo);
 			if (texture)
 				it->addTexture("t_diffuse", texture);
@@ -237,7 +234,6 @@ Entity::Entity(
 			it->setNormalsAttributeDetail(normals);
 			it->setColorsAttributeDetail(colors);
 			it->setTexCoordsAttributeDetail(texcoords);
-			it->setMaterialBuffer(materialBuffer);
 			it->setFaceVBO(faces.vbo);
 		}
 		m.setCustomShaders(this->shaders);
@@ -253,24 +249,25 @@ Entity::Entity(
 Destructor, free's memory allocated to store the model and its material
 */
 Entity::~Entity(){
-	//All attribs (except faces) share the same vbo, so delete once
-	deleteVertexBufferObject(&positions.vbo);
-	deleteVertexBufferObject(&faces.vbo);
+	//Release the entity's range of the geometry arena
+	geometry.reset();
+	positionGeometry.reset();
 	//All attribs (except faces) share the same malloc, so delete once
 	free(positions.data);
 	free(faces.data);
-	materialBuffer.reset();
 	materials.clear();
 	texture.reset();
 }
 glm::mat4 Entity::getModelMat() const
 {
 	//Apply world transforms (in reverse order that we wish for them to be applied)
-	glm::mat4 modelMat = glm::translate(glm::mat4(1), this->location);
+	const glm::vec3 &location = this->location.get();
+	const glm::vec4 &rotation = this->rotation.get();
+	glm::mat4 modelMat = glm::translate(glm::mat4(1), location);
 
 	//Check we actually have a rotation (providing no axis == error)
-	if ((this->rotation.x != 0 || this->rotation.y != 0 || this->rotation.z != 0) && this->rotation.w != 0)
-		modelMat = glm::rotate(modelMat, glm::radians(this->rotation.w), glm::vec3(this->rotation));
+	if ((rotation.x != 0 || rotation.y != 0 || rotation.z != 0) && rotation.w != 0)
+		modelMat = glm::rotate(modelMat, glm::radians(rotation.w), glm::vec3(rotation));
 
 	//Only bother scaling if we were asked to
 	if (this->scaleFactor != 1.0f)
@@ -283,12 +280,15 @@ Calls the necessary code to render a single instance of the entity
 @param normalLocation The shader attribute location to pass normals
 */
 void Entity::render(unsigned int shaderIndex){
+	if (!this->materials[0].isRenderable())
+		return;
 	glm::mat4 m = getModelMat();
 	this->materials[0].use(m, shaderIndex, true);
 
 	if (!cullFace)
 		GL_CALL(glDisable(GL_CULL_FACE));
-    GL_CALL(glDrawElements(GL_TRIANGLES, faces.count * faces.components, GL_UNSIGNED_INT, 0));
+	if (const auto &g = getGeometry(shaderIndex))
+		g->draw(GL_TRIANGLES);
     if (!cullFace)
         GL_CALL(glEnable(GL_CULL_FACE));
 
@@ -302,37 +302,68 @@ The index of the instance being rendered can be identified within the vertex sha
 @param normalLocation The shader attribute location to pass normals
 */
 void Entity::renderInstances(int count, unsigned int shaderIndex){
+	if (!this->materials[0].isRenderable())
+		return;
 	glm::mat4 m = getModelMat();
 	this->materials[0].use(m, shaderIndex, true);
 
     if (!cullFace)
         GL_CALL(glEnable(GL_CULL_FACE));
-    GL_CALL(glDrawElementsInstanced(GL_TRIANGLES, faces.count * faces.components, GL_UNSIGNED_INT, 0, count));
+	if (const auto &g = getGeometry(shaderIndex))
+		g->draw(GL_TRIANGLES, 0, 0, count);
     if (!cullFace)
 		GL_CALL(glDisable(GL_CULL_FACE));
 
 	this->materials[0].clear();
 }
-/*
-Creates a vertex buffer object of the specified size
-@param vbo The pointer to store the buffer objects location in
-@param target The type of buffer to bind the buffer object (e.g. GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER)
-@param size The size of the buffer in bytes
-*/
-void Entity::createVertexBufferObject(GLuint *vbo, GLenum target, GLuint size, void *data){
-	GL_CALL(glGenBuffers(1, vbo));
-	GL_CALL(glBindBuffer(target, *vbo));
-	GL_CALL(glBufferData(target, size, data, GL_STATIC_DRAW));
-	GL_CALL(glBindBuffer(target, 0));
+InstanceBuffer &Entity::Instances()
+{
+	if (!instances)
+	{
+		instances = std::make_unique<InstanceBuffer>();
+		bindInstances();
+	}
+	return *instances;
+}
+void Entity::bindInstances()
+{
+	if (!instances)
+		return;
+	//Materials draw with clones of the entity's shaders, so bind to those too
+	for (unsigned int i = 0; i < shaders.size(); ++i)
+	{
+		auto s = getShaders(i);
+		s->addBuffer(Shaders::INSTANCE_DATA_BLOCK_NAME, instances->getVisible());
+		s->addBuffer(Shaders::INSTANCE_INDEX_BLOCK_NAME, instances->getVisibleIndices());
+	}
+	for (auto &m : materials)
+	{
+		m.getShaders()->addBuffer(Shaders::INSTANCE_DATA_BLOCK_NAME, instances->getVisible());
+		m.getShaders()->addBuffer(Shaders::INSTANCE_INDEX_BLOCK_NAME, instances->getVisibleIndices());
+	}
 }
 /*
-Deallocates the specified vertex buffer object
-@param vbo A pointer to the buffer objects location
+Culls and renders the instances written to Instances()
+@param shaderIndex The index of the custom shader to render with
 */
-void Entity::deleteVertexBufferObject(GLuint *vbo){
-	GL_CALL(glDeleteBuffers(1, vbo));
-}
+void Entity::renderInstanceData(unsigned int shaderIndex){
+	if (!instances || !instances->getCount() || !geometry || !this->materials[0].isRenderable())
+		return;
+	glm::mat4 m = getModelMat();
+	//Mesh bounds, instance scale is applied by the cull shader
+	const float radius = glm::max(glm::length(modelMin), glm::length(modelMax));
+	instances->setCulling(viewMatPtr && projectionMatPtr);
+	instances->cull(viewMatPtr && projectionMatPtr ? (*projectionMatPtr) * (*viewMatPtr) * m : m, radius, getGeometry(shaderIndex)->command());
+	this->materials[0].use(m, shaderIndex, true);
 
+	if (!cullFace)
+		GL_CALL(glDisable(GL_CULL_FACE));
+	instances->draw();
+	if (!cullFace)
+		GL_CALL(glEnable(GL_CULL_FACE));
+
+	this->materials[0].clear();
+}
 /*
 Used by loadModelFromFile() in a hashmap of vertex-normal pairs
 */
@@ -1059,9 +1090,8 @@ void Entity::loadMaterialFromFile(const char *objPath, const char *materialFilen
 		if (fscanf(file, "%s", buffer) == 1){
 			if (strcmp(buffer, MATERIAL_NAME_IDENTIFIER) == 0){
 				if (fscanf(file, "%s", &temp) == 1){
-					this->materials.push_back(Material(materialBuffer, (unsigned int)materials.size()));
+					this->materials.push_back(Material());
 					materials[materials.size()-1].setName(temp);
-					assert(materials.size() < MAX_OBJ_MATERIALS);
 				}
 				else {
 					printf("Bad material file...");
@@ -1179,7 +1209,7 @@ void Entity::setMaterial(const glm::vec3 &ambient, const glm::vec3 &diffuse, con
 	//Override material
 	for (unsigned int i = 0; i < matSize; ++i)
 	{
-		this->materials.push_back(Material(materialBuffer, (unsigned int)materials.size(), {"", ambient, diffuse, specular, shininess, opacity}));
+		this->materials.push_back(Material({"", ambient, diffuse, specular, shininess, opacity}));
 		if (positions.data)
 		{
 			auto it = materials[i].getShaders();
@@ -1187,7 +1217,6 @@ void Entity::setMaterial(const glm::vec3 &ambient, const glm::vec3 &diffuse, con
 			it->setNormalsAttributeDetail(normals);
 			it->setColorsAttributeDetail(colors);
 			it->setTexCoordsAttributeDetail(texcoords);
-			it->setMaterialBuffer(materialBuffer);
 			it->setFaceVBO(faces.vbo);
 		}
 		materials[i].setCustomShaders(this->shaders);
@@ -1199,6 +1228,7 @@ void Entity::setMaterial(const glm::vec3 &ambient, const glm::vec3 &diffuse, con
 			materials[i].setLightsBuffer(lightBufferBindPt);
 		materials[i].bake();
 	}
+	bindInstances();
 }
 void Entity::setMaterial(const Stock::Materials::Material &mat)
 {
@@ -1206,16 +1236,29 @@ void Entity::setMaterial(const Stock::Materials::Material &mat)
 }
 /*
 Set the location of the model in world space
+@note When the visualisation runs a fixed timestep, this should be called from update(), the rendered location lags by a tick
 */
 void Entity::setLocation(glm::vec3 location){
-	this->location = location;
+	this->location.set(location);
 }
 /*
 Set the rotation of the model in world space
 @param rotation glm::vec4(axis.x, axis.y, axis.z, degrees)
 */
 void Entity::setRotation(glm::vec4 rotation){
-	this->rotation = rotation;
+	this->rotation.set(rotation);
+}
+void Entity::commitTick(){
+	this->location.commit();
+	this->rotation.commit();
+}
+void Entity::interpolateTick(float alpha){
+	this->location.interpolate(alpha);
+	this->rotation.interpolate(alpha);
+}
+void Entity::resetTicks(){
+	this->location.reset();
+	this->rotation.reset();
 }
 /*
 Returns the location of the entity
@@ -1223,7 +1266,7 @@ Returns the location of the entity
 */
 glm::vec3 Entity::getLocation() const
 {
-	return this->location;
+	return this->location.getSimulated();
 }
 /*
 Returns the rotation of the entity
@@ -1231,7 +1274,7 @@ Returns the rotation of the entity
 */
 glm::vec4 Entity::getRotation() const
 {
-	return this->rotation;
+	return this->rotation.getSimulated();
 }
 /*
 Exports the current model to a faster loading binary format which represents a direct copy of the buffers required by the model
@@ -1509,35 +1552,49 @@ Creates the necessary vertex buffer objects, and fills them with the relevant in
 */
 void Entity::generateVertexBufferObjects()
 {
-	unsigned int bufferSize = 0;
-	bufferSize += positions.count * positions.components * positions.componentSize;//Positions required
-	bufferSize += normals.count *   normals.components *   normals.componentSize;
-	bufferSize += colors.count *    colors.components *    colors.componentSize;
-	bufferSize += texcoords.count * texcoords.components * texcoords.componentSize;
-	createVertexBufferObject(&positions.vbo, GL_ARRAY_BUFFER, bufferSize, positions.data);
-	unsigned int offset = vn_count*positions.components*positions.componentSize;
+	//Entities with the same attributes share an arena, and hence their buffers
+	const GeometryArena::Layout layout = {
+		positions.components,
+		normals.count ? normals.components : 0,
+		colors.count ? colors.components : 0,
+		texcoords.count ? texcoords.components : 0,
+		false
+	};
+	geometry = GeometryArena::get(layout)->allocate(vn_count, faces.count * faces.components);
+	if (!geometry)
+		return;
+	geometry->setVertices(positions.data, normals.count ? normals.data : nullptr, colors.count ? colors.data : nullptr, texcoords.count ? texcoords.data : nullptr);
+	geometry->setIndices(static_cast<GLuint *>(faces.data));
+	const GeometryArena &arena = geometry->getArena();
+	arena.attach(GeometryArena::POSITION, positions);
 	if (normals.count)
-	{
-		normals.vbo = positions.vbo;
-		//redundant
-		normals.offset = offset;
-		offset += normals.count*normals.components*normals.componentSize;
-	}
+		arena.attach(GeometryArena::NORMAL, normals);
 	if (colors.count)
-	{
-		colors.vbo = positions.vbo;
-		//redundant
-		colors.offset = offset;
-		offset += colors.count*colors.components*colors.componentSize;
-	}
+		arena.attach(GeometryArena::COLOR, colors);
 	if (texcoords.count)
+		arena.attach(GeometryArena::TEXCOORD, texcoords);
+	faces.vbo = arena.getIndexBuffer();
+}
+void Entity::usePositionStream(unsigned int shaderIndex)
+{
+	if (!positions.data || !geometry)
+		return;
+	if (!positionGeometry)
 	{
-		texcoords.vbo = positions.vbo;
-		//redundant
-		texcoords.offset = offset;
-		//offset += texcoords.count*texcoords.components*texcoords.componentSize;
+		const GeometryArena::Layout layout = { positions.components, 0, 0, 0, false };
+		positionGeometry = GeometryArena::get(layout)->allocate(vn_count, faces.count * faces.components);
+		if (!positionGeometry)
+			return;
+		positionGeometry->setVertices(positions.data);
+		positionGeometry->setIndices(static_cast<GLuint *>(faces.data));
 	}
-	createVertexBufferObject(&faces.vbo, GL_ELEMENT_ARRAY_BUFFER, faces.count*faces.components*faces.componentSize, faces.data);
+	Shaders::VertexAttributeDetail compactPositions = positions;
+	positionGeometry->getArena().attach(GeometryArena::POSITION, compactPositions);
+	//Materials draw with clones of the entity's shaders, so update those too
+	auto s = getShaders(shaderIndex);
+	s->setPositionsAttributeDetail(compactPositions);
+	s->setFaceVBO(positionGeometry->getArena().getIndexBuffer());
+	positionStreams.insert(shaderIndex);
 }
 /*
 Returns a shared pointer to this entities shaders
@@ -1562,6 +1619,8 @@ void Entity::reload()
 			it->reload();
 	for (auto &&it : materials)
 			it.reload();
+	if (instances)
+		instances->reload();
 }
 /*
 Sets the pointer to the view matrix used by this entitiy (in the shader)
@@ -1619,10 +1678,11 @@ void Entity::flipVertexOrder()
 			faceData[((i + 1)*faces.components) - j - 1] = temp;
 		}
 	}
-	//Copy the new face order to the vbo
-	GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faces.vbo));
-	GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.count*faces.components*faces.componentSize, faces.data, GL_STATIC_DRAW));
-	GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faces.vbo));
+	//Copy the new face order to the arena
+	if (geometry)
+		geometry->setIndices(faceData);
+	if (positionGeometry)
+		positionGeometry->setIndices(faceData);
 }
 /*
 Disables or enables face culling
@@ -4,6 +4,7 @@
 #include "util/GLcheck.h"
 
 #include <memory>
+#include <set>
 #include <glm/glm.hpp>
 
 #include "shader/Shaders.h"
@@ -11,6 +12,11 @@
 #include "interface/Renderable.h"
 #include "model/Material.h"
 #include "shader/ShadersVec.h"
+#include "util/Interpolated.h"
+#include "InstanceBuffer.h"
+#include "model/GeometryArena.h"
+
+class MeshBVH;
 
 namespace Stock
 {
@@ -106,6 +112,24 @@ public:
     virtual ~Entity();
 	virtual void render(unsigned int shaderIndex = 0);
 	void renderInstances(int count, unsigned int shaderIndex = 0);
+	/**
+	 * Returns the entity's per instance data, creating it on first use
+	 * The compacted instances are bound to Shaders::INSTANCE_DATA_BLOCK_NAME of the entity's shaders
+	 * @see renderInstanceData()
+	 */
+	InstanceBuffer &Instances();
+	/**
+	 * Frustum culls the instances written to Instances() on the GPU and draws the survivors with a single indirect draw
+	 * Instances are transformed by the entity's model matrix, after their own transform
+	 * @note Culling is skipped if the entity has no view or projection matrix
+	 */
+	void renderInstanceData(unsigned int shaderIndex = 0);
+	/**
+	 * Draws the shaders at shaderIndex from a compact copy of the entity's positions, allocated from a position only GeometryArena
+	 * Depth only shaders (built with DEPTH_ONLY, e.g. Stock::Shaders::DEPTH) then fetch 12 bytes per vertex, rather than the full interleaved vertex
+	 * @see DepthPrePass
+	 */
+	void usePositionStream(unsigned int shaderIndex);
 	/**
 	 * Overrides the material in use, this will lose any textures from the exiting material
 	 */
@@ -117,6 +141,9 @@ public:
     glm::vec4 getRotation() const;
     void exportModel() const;
 	void reload() override;
+	void commitTick() override;
+	void interpolateTick(float alpha) override;
+	void resetTicks() override;
 	/**
 	 * Ensure updateShaders() is called after making changes to shaders returned by this method
 	 */
@@ -133,6 +160,17 @@ public:
 	glm::vec3 getMin() const { return modelMin; }
 	glm::vec3 getMax() const { return modelMax; }
 	glm::vec3 getDimensions() const { return modelDims; }
+	/**
+	 * @return The transform applied when rendering, from model to world space
+	 */
+	glm::mat4 getModelMat() const;
+	/**
+	 * Builds a BVH of the entity's triangles, in model space, for CPU ray queries
+	 * @return nullptr if the entity has no triangles
+	 * @note This only reads the entity's CPU copy of its geometry, so may be called from a job
+	 * @see RayCaster::add()
+	 */
+	std::shared_ptr<MeshBVH> buildBVH() const;
 protected:
 	glm::mat4 const * viewMatPtr;
 	glm::mat4 const * projectionMatPtr;
@@ -149,23 +187,37 @@ protected:
 
     //Optional material (loaded automaically if detected within model file)
 	std::vector<Material> materials;
-	std::shared_ptr<UniformBuffer> materialBuffer;
-    glm::vec3 location;
-    glm::vec4 rotation;
+    Interpolated<glm::vec3> location;
+    Interpolated<glm::vec4, LerpAxisAngle> rotation;
+	std::unique_ptr<InstanceBuffer> instances;
+	/**
+	 * Binds the instance buffer to the entity's shaders and materials
+	 */
+	void bindInstances();
 
-    static void createVertexBufferObject(GLuint *vbo, GLenum target, GLuint size, void *data);
-    static void deleteVertexBufferObject(GLuint *vbo);
+    /**
+     * The entity's vertices and faces, within the shared arena of its vertex layout
+     */
+    std::shared_ptr<GeometryArena::Allocation> geometry;
+    /**
+     * Positions and faces only, drawn by the shader indices within positionStreams
+     */
+    std::shared_ptr<GeometryArena::Allocation> positionGeometry;
+    std::set<unsigned int> positionStreams;
+    /**
+     * @return The allocation to draw with the shader index
+     */
+    const std::shared_ptr<GeometryArena::Allocation> &getGeometry(unsigned int shaderIndex) const { return positionStreams.count(shaderIndex) ? positionGeometry : geometry; }
     void loadModelFromFile();
     void loadMaterialFromFile(const char *objPath, const char *materialFilename, const char *materialName);
     void generateVertexBufferObjects();
 private:
-	glm::mat4 getModelMat() const;
 	glm::vec3 modelMin, modelMax, modelDims;
 	static std::vector<std::shared_ptr<Shaders>> convertToShader(std::initializer_list<const Stock::Shaders::ShaderSet> ss)
 	{
 		std::vector<std::shared_ptr<Shaders>> rtn;
 		for (auto&& s : ss)
-			rtn.push_back(std::make_shared<Shaders>(s.vertex, s.fragment, s.geometry));
+			rtn.push_back(std::make_shared<Shaders>(s));
 		return rtn;
 	}
     //Set by importModel if the imported model was of an older version.
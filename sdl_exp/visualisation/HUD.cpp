@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.inl>
 #include <glm/gtc/type_ptr.hpp>
 #include "shader/Shaders.h"
+#include "util/Profiler.h"
 
 
 HUD::HUD(const unsigned int &width, const unsigned int &height)
@@ -64,6 +65,7 @@ void HUD::reload()
 }
 void HUD::render()
 {
+	Profiler::Scope scope("HUD::render", true);
     GL_CALL(glDisable(GL_DEPTH_TEST));
     GL_CALL(glEnable(GL_BLEND));
 	//Iterate stack from lowest z-index to highest
@@ -0,0 +1,104 @@
+#include "InstanceBuffer.h"
+#include "util/GLcheck.h"
+#include <cstring>
+
+namespace
+{
+	const char *CULL_SHADER_PATH = "instance_cull.comp";
+	/**
+	 * Must match WORKGROUP_SIZE in instance_cull.comp
+	 */
+	const unsigned int CULL_WORKGROUP_SIZE = 256;
+	/**
+	 * Returns the plane normalised, so that its distances are in model space units
+	 */
+	glm::vec4 normalizePlane(const glm::vec4 &plane)
+	{
+		const float length = glm::length(glm::vec3(plane));
+		return length > 0 ? plane / length : plane;
+	}
+}
+
+InstanceBuffer::InstanceBuffer(unsigned int capacity)
+	: count(0)
+	, capacity(glm::max(capacity, 1u))
+	, instances(std::make_unique<ShaderStorageBuffer>(this->capacity * sizeof(Instance), nullptr, BufferCore::STREAM))
+	, visible(std::make_shared<ShaderStorageBuffer>(this->capacity * sizeof(Instance)))
+	, visibleIndices(std::make_shared<ShaderStorageBuffer>(this->capacity * sizeof(GLuint)))
+	, command(std::make_unique<ShaderStorageBuffer>(sizeof(GeometryArena::DrawCommand)))
+	, cullShader(nullptr)
+	, frustumSides(0.0f)
+	, frustumDepth(0.0f)
+	, cullRadius(0.0f)
+	, cullCount(0)
+	, culling(1)
+{ }
+InstanceBuffer::Instance *InstanceBuffer::map(unsigned int count)
+{
+	if (count > capacity)
+	{//Grow geometrically, so that slowly growing populations rarely reallocate
+		while (capacity < count)
+			capacity *= 2;
+		instances->setData(nullptr, capacity * sizeof(Instance));
+		visible->setData(nullptr, capacity * sizeof(Instance));
+		visibleIndices->setData(nullptr, capacity * sizeof(GLuint));
+	}
+	this->count = count;
+	return (Instance*)instances->mapNextRegion();
+}
+void InstanceBuffer::setInstances(const Instance *instances, unsigned int count)
+{
+	if (Instance *dest = map(count))
+		memcpy(dest, instances, count * sizeof(Instance));
+}
+void InstanceBuffer::cull(const glm::mat4 &modelViewProjection, float radius, const GeometryArena::DrawCommand &mesh)
+{
+	//The GPU counts survivors into instanceCount
+	GeometryArena::DrawCommand cmd = mesh;
+	cmd.instanceCount = 0;
+	cmd.baseInstance = 0;
+	command->setData(&cmd, sizeof(GeometryArena::DrawCommand), 0);
+	if (!count)
+		return;
+	if (!cullShader)
+	{
+		cullShader = std::make_unique<ComputeShader>(CULL_SHADER_PATH);
+		cullShader->addBuffer("_instances", GL_SHADER_STORAGE_BUFFER, instances->getBufferBindPoint());
+		cullShader->addBuffer("_visibleInstances", GL_SHADER_STORAGE_BUFFER, visible->getBufferBindPoint());
+		cullShader->addBuffer("_visibleIndices", GL_SHADER_STORAGE_BUFFER, visibleIndices->getBufferBindPoint());
+		cullShader->addBuffer("_drawCommand", GL_SHADER_STORAGE_BUFFER, command->getBufferBindPoint());
+		cullShader->addDynamicUniform("_frustumSides", &frustumSides);
+		cullShader->addDynamicUniform("_frustumDepth", &frustumDepth);
+		cullShader->addDynamicUniform("_radius", &cullRadius);
+		cullShader->addDynamicUniform("_instanceCount", &cullCount);
+		cullShader->addDynamicUniform("_cull", &culling);
+	}
+	//Gribb-Hartmann, the rows of the transform combine to form the clip planes
+	const glm::mat4 t = glm::transpose(modelViewProjection);
+	frustumSides = glm::mat4(normalizePlane(t[3] + t[0]), normalizePlane(t[3] - t[0]), normalizePlane(t[3] + t[1]), normalizePlane(t[3] - t[1]));
+	frustumDepth = glm::mat4(normalizePlane(t[3] + t[2]), normalizePlane(t[3] - t[2]), glm::vec4(0, 0, 0, 1), glm::vec4(0, 0, 0, 1));
+	cullRadius = radius;
+	cullCount = count;
+	cullShader->launch((count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE);
+	//Survivors are read by vertex shaders, their count by the draw command
+	GL_CALL(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT));
+}
+void InstanceBuffer::draw()
+{
+	if (!count)
+		return;
+	GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command->getName()));
+	GL_CALL(glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr));
+	GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
+unsigned int InstanceBuffer::getVisibleCount()
+{
+	GeometryArena::DrawCommand cmd;
+	command->getData(&cmd, sizeof(GeometryArena::DrawCommand), 0);
+	return cmd.instanceCount;
+}
+void InstanceBuffer::reload()
+{
+	if (cullShader)
+		cullShader->reload();
+}
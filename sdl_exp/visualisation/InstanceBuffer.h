@@ -0,0 +1,124 @@
+#ifndef __InstanceBuffer_h__
+#define __InstanceBuffer_h__
+
+#include <memory>
+#include <glm/glm.hpp>
+#include "shader/buffer/ShaderStorageBuffer.h"
+#include "shader/ComputeShader.h"
+#include "model/GeometryArena.h"
+
+/**
+ * Per instance data of an Entity, written by the CPU each frame and culled on the GPU before it is drawn
+ * Instances are written directly into a persistently mapped ring (BufferCore::STREAM), so the CPU never waits on the frames in flight
+ * cull() frustum culls them with instance_cull.comp, compacting the survivors into getVisible() and counting them into an indirect draw command
+ * Shaders read the survivors from the Shaders::INSTANCE_DATA_BLOCK_NAME storage block at gl_InstanceID (e.g. Stock::Shaders::INSTANCED)
+ * Usage:
+ *   InstanceBuffer::Instance *instances = entity->Instances().map(count);
+ *   ...write count instances, e.g. via JobSystem::parallelFor()...
+ *   entity->renderInstanceData();
+ * @note Owned by an Entity, see Entity::Instances()
+ */
+class InstanceBuffer
+{
+public:
+	/**
+	 * Layout of each instance, matches the Instance struct of instanced.vert and instance_cull.comp (std430)
+	 */
+	struct Instance
+	{
+		/**
+		 * xyz: Location, within the entity's model space
+		 * w: Uniform scale
+		 */
+		glm::vec4 location;
+		/**
+		 * Orientation, as a unit quaternion (x, y, z, w)
+		 */
+		glm::vec4 rotation;
+		/**
+		 * Multiplies the material's ambient and diffuse colours (and opacity)
+		 */
+		glm::vec4 color;
+		/**
+		 * Application defined state, not read by the stock shaders
+		 */
+		glm::uvec4 state;
+	};
+	/**
+	 * @param capacity The number of instances to allocate space for, map() grows the buffers if exceeded
+	 */
+	explicit InstanceBuffer(unsigned int capacity = 1024);
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer &operator=(const InstanceBuffer&) = delete;
+	/**
+	 * Begins a frame's instances, returning persistently mapped memory to write them to
+	 * @param count The number of instances which will be drawn
+	 * @return Pointer to count instances, all of which must be written before the next draw
+	 * @note Must be called from the thread owning the GL context, the returned memory may be written by any thread
+	 */
+	Instance *map(unsigned int count);
+	/**
+	 * Copies count instances, as an alternative to map()
+	 */
+	void setInstances(const Instance *instances, unsigned int count);
+	/**
+	 * Frustum culls the instances, compacting the survivors and writing the indirect draw command
+	 * @param modelViewProjection Transform from the entity's model space to clip space
+	 * @param radius Radius of a sphere about the origin of the entity's model space which bounds its mesh, before instance scale
+	 * @param mesh The range of the geometry arena drawn per instance, its instance count is ignored
+	 */
+	void cull(const glm::mat4 &modelViewProjection, float radius, const GeometryArena::DrawCommand &mesh);
+	/**
+	 * Issues the indirect draw command written by cull(), with the current program and VAO (which must be bound to the mesh's arena)
+	 */
+	void draw();
+	/**
+	 * Disabling culling still compacts instances, so that shaders are unaffected
+	 */
+	void setCulling(bool state) { culling = state ? 1 : 0; }
+	bool getCulling() const { return culling != 0; }
+	unsigned int getCount() const { return count; }
+	unsigned int getCapacity() const { return capacity; }
+	/**
+	 * Returns the number of instances which survived the most recent cull()
+	 * @note This reads back the draw command, stalling until the GPU has executed the cull
+	 */
+	unsigned int getVisibleCount();
+	/**
+	 * The compacted instances, which should be bound to Shaders::INSTANCE_DATA_BLOCK_NAME of the drawing shaders
+	 */
+	std::shared_ptr<ShaderStorageBuffer> getVisible() const { return visible; }
+	/**
+	 * The index each compacted instance had within those written by the CPU, bound to Shaders::INSTANCE_INDEX_BLOCK_NAME
+	 * @note Read by the PICK permutation of instanced.vert, so that picks report the written instance
+	 */
+	std::shared_ptr<ShaderStorageBuffer> getVisibleIndices() const { return visibleIndices; }
+	/**
+	 * Rebuilds the cull shader
+	 */
+	void reload();
+private:
+	unsigned int count;
+	unsigned int capacity;
+	/**
+	 * Written by the CPU
+	 */
+	std::unique_ptr<ShaderStorageBuffer> instances;
+	/**
+	 * Written by cull()
+	 */
+	std::shared_ptr<ShaderStorageBuffer> visible;
+	std::shared_ptr<ShaderStorageBuffer> visibleIndices;
+	std::unique_ptr<ShaderStorageBuffer> command;
+	std::unique_ptr<ComputeShader> cullShader;
+	//Cull shader uniforms
+	/**
+	 * Frustum planes in model space, as columns (left, right, bottom, top), (near, far, 2x always pass)
+	 */
+	glm::mat4 frustumSides, frustumDepth;
+	float cullRadius;
+	GLuint cullCount;
+	GLuint culling;
+};
+
+#endif //__InstanceBuffer_h__
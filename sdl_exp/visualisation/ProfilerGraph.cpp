@@ -0,0 +1,168 @@
+#include "ProfilerGraph.h"
+#include "shader/Shaders.h"
+#include "util/Profiler.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+
+namespace
+{
+	const glm::u8vec4 PALETTE[] = {
+		{ 230, 85, 13, 255 }, { 49, 130, 189, 255 }, { 49, 163, 84, 255 }, { 222, 45, 38, 255 },
+		{ 117, 107, 177, 255 }, { 253, 174, 107, 255 }, { 158, 202, 225, 255 }, { 161, 217, 155, 255 },
+		{ 255, 237, 111, 255 }, { 188, 128, 189, 255 }, { 204, 235, 197, 255 }, { 140, 86, 75, 255 }
+	};
+	const glm::u8vec4 BACKGROUND(0, 0, 0, 160);
+	const glm::u8vec4 GUIDE(255, 255, 255, 64);
+	const glm::u8vec4 UNTRACKED(96, 96, 96, 255);
+	const glm::u8vec4 GPU_MARKER(255, 255, 255, 255);
+	const unsigned int FLAME_ROW_HEIGHT = 8;
+	const unsigned int LEGEND_FONT_HEIGHT = 12;
+	/**
+	 * The legend is rebuilt at this interval, as Text is expensive to update
+	 */
+	const unsigned int LEGEND_INTERVAL = 30;
+}
+
+ProfilerGraph::ProfilerGraph(glm::uvec2 dimensions, float scale)
+	: Overlay(std::make_shared<Shaders>(Stock::Shaders::SPRITE2D), dimensions)
+	, tex(Texture2D::make(dimensions, Texture::Format(GL_RGBA, GL_RGBA8, 4, GL_UNSIGNED_BYTE), Texture::FILTER_MIN_NEAREST | Texture::FILTER_MAG_NEAREST | Texture::DISABLE_MIPMAP))
+	, pixels(dimensions.x * dimensions.y, BACKGROUND)
+	, scale(scale)
+	, framesSinceLegend(LEGEND_INTERVAL)
+{
+	getShaders()->addTexture("_texture", tex);
+	tex->setTexture(pixels.data());
+	for (unsigned int i = 0; i < MAX_LEGEND_ENTRIES; ++i)
+	{
+		legend.push_back(std::make_shared<Text>(" ", LEGEND_FONT_HEIGHT, glm::vec3(1.0f), Stock::Font::LUCIDIA_CONSOLE));
+		legend.back()->setUseAA(false);
+		legend.back()->setBackgroundColor(glm::vec4(0.0f, 0.0f, 0.0f, BACKGROUND.a / 255.0f));
+	}
+}
+glm::u8vec4 ProfilerGraph::colorOf(const char *name)
+{
+	return PALETTE[std::hash<std::string>()(name) % (sizeof(PALETTE) / sizeof(glm::u8vec4))];
+}
+void ProfilerGraph::fill(glm::ivec2 min, glm::ivec2 max, glm::u8vec4 color)
+{
+	const glm::ivec2 dims(getWidth(), getHeight());
+	min = glm::clamp(min, glm::ivec2(0), dims);
+	max = glm::clamp(max, glm::ivec2(0), dims);
+	for (int y = min.y; y < max.y; ++y)
+		std::fill_n(pixels.begin() + (dims.y - 1 - y) * dims.x + min.x, glm::max(max.x - min.x, 0), color);
+}
+void ProfilerGraph::update()
+{
+	const std::deque<Profiler::Frame> &history = Profiler::getHistory();
+	const int width = (int)getWidth();
+	const int height = (int)getHeight();
+	const int flameHeight = height / 3;
+	const int timelineHeight = height - flameHeight;
+	std::fill(pixels.begin(), pixels.end(), BACKGROUND);
+	//Guide lines at 60 and 30 fps
+	for (float ms : { 1000.0f / 60.0f, 1000.0f / 30.0f })
+	{
+		if (ms < scale)
+		{
+			const int y = flameHeight + (int)(ms / scale * timelineHeight);
+			fill({ 0, y }, { width, y + 1 }, GUIDE);
+		}
+	}
+	//Timeline, most recent frame on the right
+	const int first = glm::max((int)history.size() - width, 0);
+	for (int i = first; i < (int)history.size(); ++i)
+	{
+		const Profiler::Frame &frame = history[i];
+		const int x = width - ((int)history.size() - i);
+		const float pxPerMs = timelineHeight / scale;
+		float top = 0.0f;
+		for (auto &&e : frame.events)
+		{
+			if (e.depth)
+				continue;
+			const float bottom = top;
+			top += (float)(e.cpuEnd - e.cpuBegin) * pxPerMs;
+			fill({ x, flameHeight + (int)bottom }, { x + 1, flameHeight + (int)top }, colorOf(e.name));
+		}
+		//Time not covered by any scope
+		fill({ x, flameHeight + (int)top }, { x + 1, flameHeight + (int)(frame.cpuTime * pxPerMs) }, UNTRACKED);
+		if (frame.gpuTime >= 0)
+		{
+			const int y = flameHeight + (int)(frame.gpuTime * pxPerMs);
+			if (y < height)
+				fill({ x, y }, { x + 1, y + 1 }, GPU_MARKER);
+		}
+	}
+	//Flame graph of the most recent frame
+	if (!history.empty() && history.back().cpuTime > 0)
+	{
+		const Profiler::Frame &frame = history.back();
+		const double pxPerMs = width / frame.cpuTime;
+		for (auto &&e : frame.events)
+		{
+			const int y = (int)(e.depth * FLAME_ROW_HEIGHT);
+			if (y + (int)FLAME_ROW_HEIGHT > flameHeight)
+				continue;
+			const int begin = (int)(e.cpuBegin * pxPerMs);
+			const int end = glm::max((int)(e.cpuEnd * pxPerMs), begin + 1);
+			const glm::u8vec4 color = colorOf(e.name);
+			fill({ begin, y }, { end, y + (int)FLAME_ROW_HEIGHT - 1 }, color);
+			//Darken the left edge, so that consecutive scopes of the same name can be distinguished
+			fill({ begin, y }, { begin + 1, y + (int)FLAME_ROW_HEIGHT - 1 }, glm::u8vec4(glm::uvec4(color) / 2u));
+		}
+	}
+	tex->setTexture(pixels.data());
+	if (++framesSinceLegend >= LEGEND_INTERVAL)
+	{
+		framesSinceLegend = 0;
+		updateLegend();
+	}
+}
+void ProfilerGraph::updateLegend()
+{
+	struct Totals
+	{
+		double cpu = 0, gpu = 0;
+		bool gpuTimed = false;
+		unsigned int depth = 0;
+	};
+	const std::deque<Profiler::Frame> &history = Profiler::getHistory();
+	std::map<const char *, Totals> totals;
+	unsigned int gpuFrames = 0;
+	for (auto &&frame : history)
+	{
+		if (frame.gpuTime >= 0)
+			++gpuFrames;
+		for (auto &&e : frame.events)
+		{
+			Totals &t = totals[e.name];
+			t.cpu += e.cpuEnd - e.cpuBegin;
+			t.depth = e.depth;
+			if (e.gpuBegin >= 0)
+			{
+				t.gpu += e.gpuEnd - e.gpuBegin;
+				t.gpuTimed = true;
+			}
+		}
+	}
+	std::vector<std::pair<const char *, Totals>> sorted(totals.begin(), totals.end());
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<const char *, Totals> &a, const std::pair<const char *, Totals> &b){ return a.second.cpu > b.second.cpu; });
+	const double frames = (double)glm::max<size_t>(history.size(), 1);
+	for (unsigned int i = 0; i < MAX_LEGEND_ENTRIES; ++i)
+	{
+		if (i >= sorted.size())
+		{
+			legend[i]->setString(" ");
+			continue;
+		}
+		const Totals &t = sorted[i].second;
+		const glm::u8vec4 color = colorOf(sorted[i].first);
+		legend[i]->setColor(glm::vec3(color) / 255.0f);
+		//Means are per frame, rather than per execution of the scope
+		if (t.gpuTimed && gpuFrames)
+			legend[i]->setString("%*s%-28s %6.2fms cpu %6.2fms gpu", t.depth * 2, "", sorted[i].first, t.cpu / frames, t.gpu / gpuFrames);
+		else
+			legend[i]->setString("%*s%-28s %6.2fms cpu            ", t.depth * 2, "", sorted[i].first, t.cpu / frames);
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef __ProfilerGraph_h__
+#define __ProfilerGraph_h__
+#include "Overlay.h"
+#include "Text.h"
+#include <vector>
+#include <glm/gtc/type_precision.hpp>
+
+/**
+ * HUD overlay which displays the results of Profiler
+ * The upper section is a rolling timeline, each column is a frame with its top level scopes stacked by CPU time
+ * The GPU time of each frame is marked in white, and guide lines mark 60 and 30 fps
+ * The lower section is a flame graph of the most recent frame, with nested scopes stacked upwards
+ * The legend is a set of Text overlays, coloured to match the graph, listing the mean CPU and GPU time of each scope
+ */
+class ProfilerGraph : public Overlay
+{
+public:
+	static const unsigned int MAX_LEGEND_ENTRIES = 10;
+	/**
+	 * @param dimensions Dimensions of the graph, in pixels
+	 * @param scale The frame time represented by the full height of the timeline, in milliseconds
+	 */
+	ProfilerGraph(glm::uvec2 dimensions = glm::uvec2(400, 160), float scale = 40.0f);
+	/**
+	 * Redraws the graph from Profiler::getHistory(), the legend is refreshed less frequently
+	 * @note This should be called once per frame while the graph is visible
+	 */
+	void update();
+	void setScale(float scale) { this->scale = scale; }
+	/**
+	 * Returns the legend's Text overlays, these should be added to the HUD alongside the graph
+	 * Index 0 is the most expensive scope
+	 */
+	const std::vector<std::shared_ptr<Text>> &getLegend() const { return legend; }
+	void reload() override { }
+private:
+	/**
+	 * Returns a colour, unique to the scope's name (up to the size of the palette)
+	 */
+	static glm::u8vec4 colorOf(const char *name);
+	/**
+	 * Fills the rectangle [min, max) of pixels, y increases upwards
+	 */
+	void fill(glm::ivec2 min, glm::ivec2 max, glm::u8vec4 color);
+	void updateLegend();
+	std::shared_ptr<Texture2D> tex;
+	/**
+	 * The graph's pixels, row major with the top row first
+	 */
+	std::vector<glm::u8vec4> pixels;
+	float scale;
+	std::vector<std::shared_ptr<Text>> legend;
+	unsigned int framesSinceLegend;
+};
+
+#endif //__ProfilerGraph_h__
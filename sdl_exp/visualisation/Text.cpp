@@ -366,18 +366,21 @@ void Text::setString(const char*fmt, ...) {
     if (this->string)
         delete this->string;
     int bufSize = 0;
-    int ct = 0;
+    int ct = -1;
     va_list argp;
     va_start(argp, fmt);
     char *buffer=0;
     do
-    {//Repeat until buffer is large enough
+    {//Repeat until buffer is large enough (vsnprintf returns the required length, or -1 on older CRTs)
         if (buffer)
             free(buffer);
-        bufSize += 128;
+        bufSize = ct < 0 ? bufSize + 128 : ct + 1;
         buffer = (char*)malloc(bufSize*sizeof(char));
-        ct = vsnprintf(buffer, bufSize, fmt, argp);
-    } while (ct == -1);
+        va_list argpCopy;
+        va_copy(argpCopy, argp);
+        ct = vsnprintf(buffer, bufSize, fmt, argpCopy);
+        va_end(argpCopy);
+    } while (ct < 0 || ct >= bufSize);
     va_end(argp);
     this->string = buffer;
     recomputeTex();
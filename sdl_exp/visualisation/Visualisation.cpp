@@ -1,4 +1,5 @@
 #include "Visualisation.h"
+#include "util/Interpolated.h"
 
 #include <sstream>
 #include <glm/gtc/type_ptr.hpp>
@@ -8,6 +9,16 @@
 #include "interface/Scene.h"
 
 #include "Text.h"
+#include "ProfilerGraph.h"
+#include "shader/ShaderCore.h"
+#include "util/Profiler.h"
+#include "shader/buffer/UniformBlockAllocator.h"
+#include "multipass/FrameBuffer.h"
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 #define FOVY 60.0f
 #define NEAR_CLIP 0.005f
@@ -15,6 +26,7 @@
 #define DELTA_THETA_PHI 0.01f
 #define MOUSE_SPEED 0.001f
 #define SHIFT_MULTIPLIER 5.0f
+#define MAX_TICKS_PER_FRAME 10
 
 #define MOUSE_SPEED_FPS 0.05f
 #define DELTA_MOVE 0.05f
@@ -27,10 +39,25 @@
 #define DEFAULT_WINDOW_WIDTH 1280
 #define DEFAULT_WINDOW_HEIGHT 720
 
-Visualisation::Visualisation(char *windowTitle, int windowWidth = DEFAULT_WINDOW_WIDTH, int windowHeight = DEFAULT_WINDOW_HEIGHT)
+Visualisation::Visualisation(char *windowTitle, int windowWidth = DEFAULT_WINDOW_WIDTH, int windowHeight = DEFAULT_WINDOW_HEIGHT, bool headless)
     : t(nullptr)
+    , window(nullptr)
+    , headless(headless)
+    , eglDisplay(nullptr)
+    , eglContext(nullptr)
+    , headlessTarget(nullptr)
+    , fixedFrameTime(0)
+    , tickTime(0)
+    , tickAccumulator(0)
+    , ticksPrimed(false)
+    , continueSimulation(false)
+    , pipelinedUpdate(false)
+    , pendingUpdate(nullptr)
     , hud(std::make_shared<HUD>(windowWidth, windowHeight))
     , camera(std::make_shared<NoClipCamera>(glm::vec3(50, 50, 50)))
+    , cameraPath(nullptr)
+    , cameraPathTime(0)
+    , recordStartTime(0)
     , scene(nullptr)
     , isInitialised(false)
 	, continueRender(false)
@@ -39,15 +66,30 @@ Visualisation::Visualisation(char *windowTitle, int windowWidth = DEFAULT_WINDOW
     , windowDims(windowWidth, windowHeight)
 	, fpsDisplay(nullptr)
 {
-    this->isInitialised = this->init();
+    this->isInitialised = headless ? this->initHeadless() : this->init();
 
     fpsDisplay = std::make_shared<Text>("", 10, glm::vec3(1.0f), Stock::Font::ARIAL);
     fpsDisplay->setUseAA(false);
     hud->add(fpsDisplay, HUD::AnchorV::South, HUD::AnchorH::West, glm::ivec2(0), INT_MAX);
-    helpText = std::make_shared<Text>("Controls\nW,S: Move Forwards/Backwards\nA,D: Strafe\nQ,E: Roll\nF1:  Toggle Show Controls\nF5:  Reload Resources/Shaders\nF8:  Toggle Show FPS\nF9:  Toggle Show Skybox\nF10: Toggle MSAA\nF11: Toggle Fullscreen\nESC: Quit", 20, glm::vec3(1.0f), Stock::Font::LUCIDIA_CONSOLE);
+    helpText = std::make_shared<Text>("Controls\nW,S: Move Forwards/Backwards\nA,D: Strafe\nQ,E: Roll\nF1:  Toggle Show Controls\nF3:  Record Camera Path Keyframe\nF4:  Toggle Video Capture\nF5:  Reload Resources/Shaders\nF6:  Export Profiler Trace\nF7:  Toggle Show Profiler\nF8:  Toggle Show FPS\nF9:  Toggle Show Skybox\nF10: Toggle MSAA\nF11: Toggle Fullscreen\nESC: Quit", 20, glm::vec3(1.0f), Stock::Font::LUCIDIA_CONSOLE);
     helpText->setBackgroundColor(glm::vec4(0.0f, 0.0f, 0.0f, 0.65f));
     helpText->setVisible(false);
     hud->add(helpText, HUD::AnchorV::Center, HUD::AnchorH::Center, glm::ivec2(0), INT_MAX);
+    shaderErrorDisplay = std::make_shared<Text>("", 14, glm::vec3(1.0f, 0.3f, 0.3f), Stock::Font::LUCIDIA_CONSOLE);
+    shaderErrorDisplay->setBackgroundColor(glm::vec4(0.0f, 0.0f, 0.0f, 0.75f));
+    shaderErrorDisplay->setVisible(false);
+    hud->add(shaderErrorDisplay, HUD::AnchorV::North, HUD::AnchorH::West, glm::ivec2(0), INT_MAX);
+    profilerGraph = std::make_shared<ProfilerGraph>();
+    profilerGraph->setVisible(false);
+    hud->add(profilerGraph, HUD::AnchorV::South, HUD::AnchorH::East, glm::ivec2(0), INT_MAX);
+    //Legend is stacked above the graph, most expensive scope at the top
+    int legendOffset = profilerGraph->getHeight();
+    for (auto it = profilerGraph->getLegend().rbegin(); it != profilerGraph->getLegend().rend(); ++it)
+    {
+        (*it)->setVisible(false);
+        hud->add(*it, HUD::AnchorV::South, HUD::AnchorH::East, glm::ivec2(0, legendOffset), INT_MAX);
+        legendOffset += (*it)->getHeight();
+    }
 }
 Visualisation::~Visualisation()
 {
@@ -99,16 +141,7 @@ bool Visualisation::init(){
         
         GLEW_INIT();
         
-        // Setup gl stuff
-		GL_CALL(glEnable(GL_DEPTH_TEST));
-        GL_CALL(glCullFace(GL_BACK));
-        GL_CALL(glEnable(GL_CULL_FACE));
-        GL_CALL(glShadeModel(GL_SMOOTH));
-        GL_CALL(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL));
-        GL_CALL(glBlendEquation(GL_FUNC_ADD));
-        GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-        BackBuffer::setClear(true, glm::vec3(0));//Clear to black
-        setMSAA(this->msaaState);
+        initGL();
 
         // Setup the projection matrix
         this->resizeWindow();
@@ -117,10 +150,93 @@ bool Visualisation::init(){
     }
     return false;
 }
+bool Visualisation::initHeadless()
+{
+#ifdef __linux__
+    //Prefer Mesa's surfaceless platform, this requires neither a display server nor a GPU (e.g. llvmpipe)
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (getPlatformDisplay && clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        fprintf(stderr, "Headless visualisation failed to initialise EGL (0x%x).\n", eglGetError());
+        return false;
+    }
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context"))
+    {
+        fprintf(stderr, "Headless visualisation requires EGL_KHR_surfaceless_context.\n");
+        eglTerminate(display);
+        return false;
+    }
+    const EGLint configAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = EGL_NO_CONTEXT;
+    if (eglBindAPI(EGL_OPENGL_API) && eglChooseConfig(display, configAttribs, &config, 1, &configCount) && configCount)
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        fprintf(stderr, "Headless visualisation failed to create an OpenGL 4.3 context (0x%x).\n", eglGetError());
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+    this->eglDisplay = display;
+    this->eglContext = context;
+
+    GLEW_INIT_HEADLESS();
+
+    initGL();
+
+    //There is no default framebuffer, so the back buffer is replaced
+    //BackBuffer clears the target according to its own settings, so the target doesn't clear itself
+    this->headlessTarget = std::make_shared<FrameBuffer>(this->windowDims, FBAFactory::ManagedColorTextureRGBA(), FBAFactory::ManagedDepthRenderBuffer(GL_DEPTH_COMPONENT24), FBAFactory::Disabled(), 0, false);
+    overrideBackBuffer(this->headlessTarget);
+    this->resizeWindow();
+    GL_CHECK();
+    return true;
+#else
+    fprintf(stderr, "Headless visualisations are only supported on Linux.\n");
+    return false;
+#endif
+}
+void Visualisation::initGL()
+{
+    // Setup gl stuff
+    GL_CALL(glEnable(GL_DEPTH_TEST));
+    GL_CALL(glCullFace(GL_BACK));
+    GL_CALL(glEnable(GL_CULL_FACE));
+    GL_CALL(glShadeModel(GL_SMOOTH));
+    GL_CALL(glPolygonMode(GL_FRONT_AND_BACK, GL_FILL));
+    GL_CALL(glBlendEquation(GL_FUNC_ADD));
+    GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    BackBuffer::setClear(true, glm::vec3(0));//Clear to black
+    setMSAA(this->msaaState);
+}
 std::shared_ptr<Scene> Visualisation::setScene(std::unique_ptr<Scene> scene)
 {
 	std::shared_ptr<Scene> oldScene = this->scene;
+	//The pending update belongs to the old scene
+	this->finishUpdate();
+	this->pendingUpdate.reset();
 	this->scene = std::shared_ptr<Scene>(scene.release());
+	this->ticksPrimed = false;
     return oldScene;
 }
 void Visualisation::handleMouseMove(int x, int y){
@@ -148,6 +264,22 @@ void Visualisation::handleKeypress(SDL_Keycode keycode, int x, int y){
     case SDLK_F8:
         this->fpsDisplay->setVisible(!this->fpsDisplay->getVisible());
         break;
+    case SDLK_F7:
+        this->toggleProfilerGraph();
+        break;
+    case SDLK_F4:
+        if (this->isCapturing())
+            this->stopCapture();
+        else
+            this->startCapture("capture.y4m");
+        break;
+    case SDLK_F3:
+        this->recordCameraKeyframe();
+        break;
+    case SDLK_F6:
+        if (Profiler::exportTrace("trace.json"))
+            printf("Profiler trace exported to trace.json\n");
+        break;
     case SDLK_F5:
         if (this->scene)
 			this->scene->_reload();
@@ -160,16 +292,47 @@ void Visualisation::handleKeypress(SDL_Keycode keycode, int x, int y){
 }
 void Visualisation::close(){
 	killThread();
-	assert(this->window);//There should always be a window, it might just be hidden
-	SDL_GL_MakeCurrent(this->window, this->context);
+	stopSimulation();
+	finishUpdate();
+	if (!this->headless)
+	{
+		assert(this->window);//There should always be a window, it might just be hidden
+		SDL_GL_MakeCurrent(this->window, this->context);
+	}
+#ifdef __linux__
+	else if (this->eglContext)
+	{
+		eglMakeCurrent((EGLDisplay)this->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)this->eglContext);
+	}
+#endif
     //Delete objects before we delete the GL context!
     fpsDisplay.reset();
 	helpText.reset();
+	profilerGraph.reset();
+	frameCapture.reset();
+	Profiler::clear();
+	shaderErrorDisplay.reset();
     this->hud->clear();
     if (this->scene)
     {
         this->scene.reset();
 	}
+	resetBackBuffer();
+	headlessTarget.reset();
+	if (this->headless)
+	{
+#ifdef __linux__
+		if (this->eglContext)
+		{
+			eglMakeCurrent((EGLDisplay)this->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext((EGLDisplay)this->eglDisplay, (EGLContext)this->eglContext);
+			eglTerminate((EGLDisplay)this->eglDisplay);
+			this->eglContext = nullptr;
+			this->eglDisplay = nullptr;
+		}
+#endif
+		return;
+	}
 	SDL_DestroyWindow(this->window);
 	this->window = nullptr;
     SDL_GL_DeleteContext(this->context);
@@ -177,13 +340,133 @@ void Visualisation::close(){
 }
 void Visualisation::render()
 {
-    //Static fn var for tracking the time to send to scene->update()
-    static unsigned int updateTime = 0;
-	unsigned int t_updateTime = SDL_GetTicks();
-	//If the program runs for over ~49 days, the return value of SDL_GetTicks() will wrap
-	unsigned int frameTime = t_updateTime < updateTime ? (t_updateTime + (UINT_MAX - updateTime)) : t_updateTime - updateTime;
-	updateTime = t_updateTime;
+    //Static fn vars for tracking the time to send to scene->update()
+    static Uint64 updateTime = SDL_GetPerformanceCounter();
+    static double remainder = 0.0;
+    const Uint64 t_updateTime = SDL_GetPerformanceCounter();
+    //Sub-millisecond remainders are carried to the next frame, so that frame times don't drift from the clock
+    const double elapsed = (t_updateTime - updateTime) * 1000.0 / SDL_GetPerformanceFrequency() + remainder;
+    updateTime = t_updateTime;
+    unsigned int frameTime = (unsigned int)elapsed;
+    remainder = elapsed - frameTime;
+    if (this->fixedFrameTime)
+        frameTime = this->fixedFrameTime;
+    if (!this->headless)
+        this->handleInput(frameTime);
+    this->renderFrame(frameTime);
+}
+void Visualisation::step(unsigned int frameTime, unsigned int frames)
+{
+    if (!this->isInitialised || !this->scene)
+    {
+        printf("Visualisation cannot step, %s.\n", this->isInitialised ? "scene not yet set" : "not initialised");
+        return;
+    }
+    for (unsigned int i = 0; i < frames; ++i)
+        this->renderFrame(frameTime);
+    //The caller may modify the scene between steps
+    this->finishUpdate();
+}
+void Visualisation::setSimulationTimestep(unsigned int tickTime)
+{
+    //The simulation thread reads tickTime, so must be stopped whilst it changes
+    const bool running = this->simulationThread.joinable();
+    this->stopSimulation();
+    this->tickTime = tickTime;
+    this->tickAccumulator = 0;
+    if (!tickTime)
+    {
+        //Transforms are again rendered as updated, the initial state is re-committed if a timestep is later set
+        if (this->scene)
+            this->scene->_resetTicks();
+        this->ticksPrimed = false;
+    }
+    if (running)
+        this->startSimulation();
+}
+void Visualisation::tickScene(unsigned int frameTime)
+{
+    if (!this->ticksPrimed)
+    {
+        this->scene->_commitTick();
+        this->ticksPrimed = true;
+    }
+    if (this->simulationThread.joinable())
+    {
+        Profiler::Scope scope("Scene::_interpolateTick");
+        std::lock_guard<std::mutex> lock(InterpolatedBase::tickMutex);
+        //The latest tick is current at tickEnd, the previous tick one tickTime earlier
+        const float remaining = std::chrono::duration<float, std::milli>(this->tickEnd - std::chrono::steady_clock::now()).count();
+        this->scene->_interpolateTick(glm::clamp(1.0f - remaining / this->tickTime, 0.0f, 1.0f));
+        return;
+    }
+    this->tickAccumulator += frameTime;
+    //Drop time which can't be caught up, rather than spending ever longer simulating
+    this->tickAccumulator = glm::min(this->tickAccumulator, this->tickTime * MAX_TICKS_PER_FRAME);
+    while (this->tickAccumulator >= this->tickTime)
+    {
+        Profiler::Scope scope("Scene::_update");
+        this->scene->_update(this->tickTime);
+        this->scene->_commitTick();
+        this->tickAccumulator -= this->tickTime;
+    }
+    Profiler::Scope scope("Scene::_interpolateTick");
+    this->scene->_interpolateTick(this->tickAccumulator / (float)this->tickTime);
+}
+void Visualisation::setPipelinedUpdate(bool state)
+{
+    this->pipelinedUpdate = state;
+}
+void Visualisation::finishUpdate()
+{
+    if (this->pendingUpdate)
+        JobSystem::global().wait(this->pendingUpdate);
+}
+void Visualisation::startSimulation()
+{
+    if (!this->tickTime || this->simulationThread.joinable())
+        return;
+    if (!this->ticksPrimed)
+    {
+        this->scene->_commitTick();
+        this->ticksPrimed = true;
+    }
+    this->tickEnd = std::chrono::steady_clock::now();
+    this->continueSimulation = true;
+    this->simulationThread = std::thread(&Visualisation::simulationLoop, this);
+}
+void Visualisation::stopSimulation()
+{
+    this->continueSimulation = false;
+    if (this->simulationThread.joinable())
+        this->simulationThread.join();
+    this->tickAccumulator = 0;
+}
+void Visualisation::simulationLoop()
+{
+    const std::chrono::milliseconds tick(this->tickTime);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while (this->continueSimulation)
+    {
+        next += tick;
+        this->scene->_update(this->tickTime);
+        {
+            std::lock_guard<std::mutex> lock(InterpolatedBase::tickMutex);
+            this->scene->_commitTick();
+            this->tickEnd = next;
+        }
+        //Drop time which can't be caught up, rather than spending ever longer simulating
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - next > tick * MAX_TICKS_PER_FRAME)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
+void Visualisation::handleInput(unsigned int frameTime)
+{
     SDL_Event e;
+    //Keypresses may modify the scene
+    this->finishUpdate();
     // Handle continuous key presses (movement)
     const Uint8 *state = SDL_GetKeyboardState(NULL);
     float turboMultiplier = state[SDL_SCANCODE_LSHIFT] ? SHIFT_MULTIPLIER : 1.0f;
@@ -237,28 +520,123 @@ void Visualisation::render()
             this->handleMouseMove(e.motion.xrel, e.motion.yrel);
             break;
         case SDL_MOUSEBUTTONDOWN:
-            this->toggleMouseMode();
+            if (!this->scene || this->scene->_mousePress(e.button.button, e.button.x, e.button.y))
+                this->toggleMouseMode();
             break;
 
         }
     }
+}
+void Visualisation::renderFrame(unsigned int frameTime)
+{
+    Profiler::beginFrame();
+    // hot reload shaders
+    {
+        Profiler::Scope scope("Visualisation::updateShaders");
+        this->updateShaders();
+    }
+    if (this->cameraPath)
+    {
+        glm::vec3 eye = this->camera->getEye(), target = eye + this->camera->getLook();
+        this->cameraPath->sample(this->cameraPathTime / 1000.0f, eye, target);
+        this->camera->setPose(eye, target);
+        this->cameraPathTime += frameTime;
+    }
     // update
-	this->scene->_update(frameTime);
+    if (this->tickTime)
+    {
+        this->tickScene(frameTime);
+    }
+    else if (this->pendingUpdate)
+    {//Submitted by the previous frame
+        Profiler::Scope scope("Scene::_update (wait)");
+        this->finishUpdate();
+        this->pendingUpdate.reset();
+    }
+    else
+    {
+        Profiler::Scope scope("Scene::_update");
+        this->scene->_update(frameTime);
+    }
     // render
-    BackBuffer::useStatic();
-    this->scene->_render();
+    {
+        Profiler::Scope scope("Scene::_render", true);
+        BackBuffer::useStatic();
+        this->scene->_render();
+    }
     GL_CALL(glViewport(0, 0, windowDims.x, windowDims.y));
-	GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, this->headlessTarget ? this->headlessTarget->getFrameBufferName() : 0));
+    if (this->profilerGraph->getVisible())
+    {
+        Profiler::Scope scope("ProfilerGraph::update");
+        this->profilerGraph->update();
+    }
 	this->hud->render();
+    if (this->frameCapture)
+    {
+        Profiler::Scope scope("FrameCapture::capture");
+        this->frameCapture->capture(this->headlessTarget ? this->headlessTarget->getFrameBufferName() : 0, this->windowDims);
+    }
 
     GL_CHECK();
 
+    // update the next frame whilst the GPU executes this one
+    if (this->pipelinedUpdate && !this->tickTime)
+    {
+        std::shared_ptr<Scene> scene = this->scene;
+        this->pendingUpdate = JobSystem::global().submit([scene, frameTime]{ scene->_update(frameTime); });
+    }
     // update the screen
-    SDL_GL_SwapWindow(window);
+    if (!this->headless)
+    {
+        Profiler::Scope scope("SDL_GL_SwapWindow");
+        SDL_GL_SwapWindow(window);
+    }
+    Profiler::endFrame();
+    UniformBlockAllocator::endFrame();
+}
+void Visualisation::startCapture(const std::string &path, FrameCapture::Format format, unsigned int fps)
+{
+    this->frameCapture = std::make_unique<FrameCapture>(path, format, fps);
+    if (!this->frameCapture->isGood())
+        this->frameCapture.reset();
+}
+void Visualisation::stopCapture()
+{
+    if (this->frameCapture)
+    {
+        this->frameCapture->finish();
+        printf("Captured %llu frames.\n", this->frameCapture->getFramesWritten());
+        this->frameCapture.reset();
+    }
+}
+void Visualisation::toggleProfilerGraph()
+{
+    const bool visible = !this->profilerGraph->getVisible();
+    this->profilerGraph->setVisible(visible);
+    for (auto &&entry : this->profilerGraph->getLegend())
+        entry->setVisible(visible);
+}
+void Visualisation::updateShaders()
+{
+    ShaderCore::pollReloads();
+    if (shaderErrorVersion != ShaderCore::getErrorLogVersion())
+    {
+        shaderErrorVersion = ShaderCore::getErrorLogVersion();
+        std::string errors = ShaderCore::getErrorLog();
+        shaderErrorDisplay->setVisible(!errors.empty());
+        if (!errors.empty())
+            shaderErrorDisplay->setString("%s", errors.c_str());
+    }
 }
 void Visualisation::runAsync()
 {
-	if (!continueRender)
+	if (this->headless)
+	{
+		//The EGL context is current to the calling thread
+		printf("runAsync() is not supported by headless visualisations, use run() or step()!\n");
+	}
+	else if (!continueRender)
 	{
 		if (t)
 		{//Async window was closed via cross, so thread still exists
@@ -300,6 +678,16 @@ void Visualisation::_run()
     else if (!this->scene){
         printf("Scene not yet set.\n");
     }
+	else if (this->headless){
+		//Renders until quit() is called, e.g. by the scene
+		this->continueRender = true;
+		this->startSimulation();
+		while (this->continueRender){
+			this->updateFPS();
+			this->render();
+		}
+		this->stopSimulation();
+	}
 	else {
 		//Recreate window in current thread (else IO fails)
 		if (this->window)
@@ -325,12 +713,14 @@ void Visualisation::_run()
 			GL_CHECK();
 			SDL_StartTextInput();
 			this->continueRender = true;
+			this->startSimulation();
 			while (this->continueRender){
 				// Update the fps in the window title
 				this->updateFPS();
 
 				this->render();
 			}
+			this->stopSimulation();
 			SDL_StopTextInput();
 			//Release mouse lock
 			if (SDL_GetRelativeMouseMode()){
@@ -353,7 +743,8 @@ const char *Visualisation::getWindowTitle() const{
 }
 void Visualisation::setWindowTitle(const char *windowTitle){
     this->windowTitle = windowTitle; 
-    SDL_SetWindowTitle(this->window, this->windowTitle);
+    if (this->window)
+        SDL_SetWindowTitle(this->window, this->windowTitle);
 }
 void Visualisation::quit(){
 	this->continueRender = false;
@@ -387,6 +778,8 @@ void Visualisation::killThread()
 	}
 }
 void Visualisation::toggleFullScreen(){
+    if (this->headless)
+        return;
     if (this->isFullscreen()){
         // Update the window using the stored windowBounds
         SDL_SetWindowBordered(this->window, SDL_TRUE);
@@ -409,6 +802,8 @@ void Visualisation::toggleFullScreen(){
     this->resizeWindow();
 }
 void Visualisation::toggleMouseMode(){
+    if (this->headless)
+        return;
     if (SDL_GetRelativeMouseMode()){
         SDL_SetRelativeMouseMode(SDL_FALSE);
     }
@@ -417,7 +812,8 @@ void Visualisation::toggleMouseMode(){
     }
 }
 void Visualisation::resizeWindow(){
-    // Use the sdl drawable size
+    // Use the sdl drawable size, headless visualisations keep their initial dimensions
+    if (this->window)
     {
         glm::ivec2 tDims;
         SDL_GL_GetDrawableSize(this->window, &tDims.x, &tDims.y);
@@ -432,6 +828,8 @@ void Visualisation::resizeWindow(){
     resizeBackBuffer(this->windowDims);
 }
 bool Visualisation::isFullscreen() const{
+    if (!this->window)
+        return false;
     // Use window borders as a toggle to detect fullscreen.
     return (SDL_GetWindowFlags(this->window) & SDL_WINDOW_BORDERLESS) == SDL_WINDOW_BORDERLESS;
 }
@@ -460,6 +858,20 @@ std::shared_ptr<const Camera> Visualisation::getCamera() const
 {
     return this->camera;
 }
+void Visualisation::setCameraPath(std::shared_ptr<const CameraPath> path)
+{
+    this->cameraPath = path;
+    this->cameraPathTime = 0;
+}
+void Visualisation::recordCameraKeyframe()
+{
+    if (this->recordedPath.isEmpty())
+        this->recordStartTime = SDL_GetTicks();
+    const float time = (SDL_GetTicks() - this->recordStartTime) / 1000.0f;
+    this->recordedPath.addKeyframe(time, this->camera->getEye(), this->camera->getEye() + this->camera->getLook());
+    if (this->recordedPath.save("camera_path.txt"))
+        printf("Camera keyframe %u recorded at %.2fs, path saved to camera_path.txt\n", (unsigned int)this->recordedPath.getKeyframes().size(), time);
+}
 std::weak_ptr<Scene> Visualisation::getScene() const{
     return this->scene;
 }
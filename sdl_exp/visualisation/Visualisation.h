@@ -7,17 +7,25 @@
 #include "interface/Viewport.h"
 #include <memory>
 #include "camera/NoClipCamera.h"
+#include "camera/CameraPath.h"
 #include "HUD.h"
+#include "util/FrameCapture.h"
+#include "util/JobSystem.h"
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <mutex>
 
 #undef main //SDL breaks the regular main entry point, this fixes
 
 class Scene;
 class Text;
+class ProfilerGraph;
+class FrameBuffer;
 
 /**
  * This class provides an OpenGL window
+ * Alternatively, headless visualisations render offscreen without a display (e.g. on render farm nodes)
  * @todo Add a keypress handler interface
  * @todo Make a runAsync() variation
  */
@@ -30,8 +38,10 @@ public:
 	 * @param windowTitle The title of the window
 	 * @param windowWidth The width of the contained graphics panel
 	 * @param windowHeight The height of the contained graphics panel
+	 * @param headless If true, no window is created, instead a surfaceless EGL context renders into an offscreen FrameBuffer
+	 * @note Headless visualisations are only available on Linux, they can be driven with step() for deterministic output
 	 */
-	Visualisation(char *windowTitle, int windowWidth, int windowHeight);
+	Visualisation(char *windowTitle, int windowWidth, int windowHeight, bool headless = false);
 	/**
 	 * Default destructor, destruction happens in close() to ensure objects are killed before the GL context
 	 * @see close()
@@ -43,6 +53,62 @@ public:
 	 * @note This only need be called if manually triggering frame updates, run() should otherwise be used
 	 */
     void render();
+	/**
+	 * Renders frames without handling user input, each frame advances the scene by exactly frameTime
+	 * This is intended for headless visualisations, where output must be reproducible
+	 * @param frameTime The simulated number of milliseconds between frames
+	 * @param frames The number of frames to render
+	 */
+	void step(unsigned int frameTime, unsigned int frames = 1);
+	/**
+	 * Replaces the measured frame time passed to the scene by render() and run() with a constant
+	 * @param frameTime The simulated number of milliseconds between frames, 0 restores measured frame times
+	 */
+	void setFixedFrameTime(unsigned int frameTime) { fixedFrameTime = frameTime; }
+	/**
+	 * Decouples the scene's update() from rendering, it is instead called once per fixed length simulation tick
+	 * Whilst run() executes, ticks are scheduled by a high resolution clock on a separate simulation thread, so slow updates don't delay rendering
+	 * Otherwise (render(), step()) as many ticks as the frame time covers execute on the calling thread, which is deterministic
+	 * Each frame renders entity and model transforms interpolated between the two most recent ticks (see Interpolated)
+	 * @param tickTime Milliseconds simulated per tick, 0 restores a single update() per rendered frame
+	 * @note The scene's update() must then only modify interpolated state, see BasicScene::update()
+	 * @note If run() is executing, the simulation thread is stopped and restarted with the new timestep (not at all if 0), so this must not be called from the scene's update()
+	 */
+	void setSimulationTimestep(unsigned int tickTime);
+	unsigned int getSimulationTimestep() const { return tickTime; }
+	/**
+	 * Overlaps the scene's update() for the next frame with the GPU executing the current frame
+	 * Once a frame's rendering has been issued, the next update is submitted to JobSystem::global() and the buffers are swapped (which blocks on vsync and the GPU)
+	 * The update completes before input is handled and before the next frame renders, it is passed the current frame's frame time
+	 * @param state Whether updates should be pipelined, this has no effect whilst a simulation timestep is set
+	 * @note The scene's update() must then not use the GL context
+	 */
+	void setPipelinedUpdate(bool state);
+	bool getPipelinedUpdate() const { return pipelinedUpdate; }
+	/**
+	 * @return True if the visualisation renders offscreen, without a window
+	 */
+	bool isHeadless() const { return headless; }
+	/**
+	 * Returns the FrameBuffer which replaces the back buffer of headless visualisations
+	 * Color attachment 0 holds the most recently rendered frame
+	 * @return The offscreen FrameBuffer, nullptr if the visualisation is not headless
+	 */
+	std::shared_ptr<FrameBuffer> getHeadlessFrameBuffer() const { return headlessTarget; }
+	/**
+	 * Begins recording each rendered frame (including the HUD), replacing any capture in progress
+	 * @param path Output file, or file prefix for FrameCapture::PNG
+	 * @param format The output format
+	 * @param fps Frame rate stored in the output, where supported
+	 * @see FrameCapture
+	 * @note Unless blocked by the active Scene the F4 key toggles capture to capture.y4m at runtime
+	 */
+	void startCapture(const std::string &path, FrameCapture::Format format = FrameCapture::Y4M, unsigned int fps = 60);
+	/**
+	 * Completes the capture in progress, waiting for the remaining frames to be written
+	 */
+	void stopCapture();
+	bool isCapturing() const { return frameCapture != nullptr; }
 	/**
 	 * Executes the render loop, this is a blocking call
      * @see quit() to externally kill the loop
@@ -95,6 +161,13 @@ public:
 	 * @return The camera
 	 */
     std::shared_ptr<const Camera> getCamera() const;
+	/**
+	 * The camera follows path, which is sampled once per frame (before the scene updates) using the accumulated frame time
+	 * Combine with step() or setFixedFrameTime() for camera motion which is identical between runs
+	 * @param path The path to follow, nullptr returns control of the camera to the user
+	 * @note The path's clock restarts each time this is called
+	 */
+	void setCameraPath(std::shared_ptr<const CameraPath> path);
 	/**
 	 * Sets the Scene object to be rendered within the viewport
 	 * @return The previously bound Scene
@@ -140,6 +213,11 @@ private:
 	 * @note Unsure whether the mouse position is relative to the window
 	 */
 	void handleKeypress(SDL_Keycode keycode, int x, int y);
+	/**
+	 * Moves the camera according to held keys, and handles queued SDL events
+	 * @param frameTime The number of milliseconds since the previous frame, this scales camera movement
+	 */
+	void handleInput(unsigned int frameTime);
 	/**
 	 * Moves the camera according to the motion of the mouse (whilst the mouse is attatched to the window via toggleMouseMode())
 	 * @param x The horizontal distance moved
@@ -152,6 +230,19 @@ private:
 	 * @note This is called within the render loop
 	 */
 	void updateFPS();
+	/**
+	 * Toggles the profiler graph and it's legend
+	 */
+	void toggleProfilerGraph();
+	/**
+	 * Appends the camera's current pose to recordedPath, timed from the first recorded keyframe, and saves it to camera_path.txt
+	 */
+	void recordCameraKeyframe();
+	/**
+	 * Hot reloads modified shaders, and updates the shader error overlay
+	 * @note This is called within the render loop
+	 */
+	void updateShaders();
 	/**
 	 * Updates the viewport and projection matrix
 	 * This should be called after window resize events, or simply if the viewport needs generating
@@ -163,6 +254,37 @@ private:
 	 * @note This method doesn't begin the render loop, use run() for that
 	 */
 	bool init();
+	/**
+	 * Creates a surfaceless EGL context and the offscreen FrameBuffer, in place of init()
+	 * @return Returns true on success
+	 */
+	bool initHeadless();
+	/**
+	 * Configures the GL state shared by windowed and headless contexts
+	 */
+	void initGL();
+	/**
+	 * Updates, renders and presents a single frame
+	 * @param frameTime The number of milliseconds to advance the scene by
+	 */
+	void renderFrame(unsigned int frameTime);
+	/**
+	 * Executes the simulation ticks covered by frameTime (unless the simulation thread is running), then interpolates the scene
+	 */
+	void tickScene(unsigned int frameTime);
+	/**
+	 * Starts the simulation thread, if a simulation timestep has been set
+	 */
+	void startSimulation();
+	void stopSimulation();
+	/**
+	 * Simulation thread body, updates the scene once per tick until stopSimulation() is called
+	 */
+	void simulationLoop();
+	/**
+	 * Waits for a pipelined update to complete, it remains pending so that the next frame doesn't update again
+	 */
+	void finishUpdate();
 	/**
 	 * Provides destruction of the object, deletes child objects, removes the GL context, closes the window and calls SDL_quit()
 	 */
@@ -180,8 +302,46 @@ private:
     SDL_Rect windowedBounds;
     SDL_GLContext context;
 
+    //Headless stuff
+    const bool headless;
+    /**
+     * EGLDisplay and EGLContext of headless visualisations, stored as void* so that EGL headers are not required here
+     */
+    void *eglDisplay;
+    void *eglContext;
+    std::shared_ptr<FrameBuffer> headlessTarget;
+    unsigned int fixedFrameTime;
+
+    //Fixed timestep stuff
+    unsigned int tickTime;
+    /**
+     * Milliseconds not yet simulated, when ticks execute on the render thread
+     */
+    unsigned int tickAccumulator;
+    /**
+     * Whether the scene has committed its initial state, which the first tick interpolates from
+     */
+    bool ticksPrimed;
+    std::thread simulationThread;
+    std::atomic<bool> continueSimulation;
+    /**
+     * The time at which the most recently committed tick's state is current, guarded by InterpolatedBase::tickMutex
+     */
+    std::chrono::steady_clock::time_point tickEnd;
+    //Pipelined update stuff
+    bool pipelinedUpdate;
+    /**
+     * The update for the next frame, submitted before the previous frame's swap
+     */
+    JobSystem::TaskHandle pendingUpdate;
+
     std::shared_ptr<HUD> hud;
     std::shared_ptr<NoClipCamera> camera;
+    //Scripted camera stuff
+    std::shared_ptr<const CameraPath> cameraPath;
+    unsigned long long cameraPathTime;
+    CameraPath recordedPath;
+    unsigned int recordStartTime;
 	std::shared_ptr<Scene> scene;
     glm::mat4 projMat;
 
@@ -199,6 +359,15 @@ private:
     unsigned int frameCount = 0;
     std::shared_ptr<Text> fpsDisplay;
     std::shared_ptr<Text> helpText;
+
+    //Profiler display
+    std::shared_ptr<ProfilerGraph> profilerGraph;
+
+    std::unique_ptr<FrameCapture> frameCapture;
+
+    //Shader error tracking stuff
+    unsigned int shaderErrorVersion = 0;
+    std::shared_ptr<Text> shaderErrorDisplay;
 };
 
 #endif //ifndef __Visualisation_h__
@@ -0,0 +1,127 @@
+#include "CameraPath.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	/**
+	 * Uniform Catmull-Rom interpolation between p1 and p2
+	 */
+	glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, float u)
+	{
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+		return 0.5f * ((2.0f * p1)
+			+ (p2 - p0) * u
+			+ (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2
+			+ (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+	}
+}
+
+CameraPath::CameraPath()
+	: looped(false)
+{ }
+CameraPath::CameraPath(const std::string &path)
+	: looped(false)
+{
+	FILE *f = fopen(path.c_str(), "r");
+	if (!f)
+		throw std::runtime_error("CameraPath: Unable to open '" + path + "' for reading.");
+	char line[512];
+	unsigned int lineNumber = 0;
+	while (fgets(line, sizeof(line), f))
+	{
+		++lineNumber;
+		const char *c = line + strspn(line, " \t");
+		if (*c == '#' || *c == '\n' || *c == '\r' || *c == '\0')
+			continue;
+		if (!strncmp(c, "loop", 4))
+		{
+			looped = true;
+			continue;
+		}
+		Keyframe k;
+		if (sscanf(c, "%f %f %f %f %f %f %f", &k.time, &k.eye.x, &k.eye.y, &k.eye.z, &k.target.x, &k.target.y, &k.target.z) != 7)
+		{
+			fclose(f);
+			throw std::runtime_error("CameraPath: Malformed keyframe on line " + std::to_string(lineNumber) + " of '" + path + "'.");
+		}
+		addKeyframe(k.time, k.eye, k.target);
+	}
+	fclose(f);
+}
+CameraPath CameraPath::orbit(const glm::vec3 &center, float radius, float height, float duration, unsigned int keyframes)
+{
+	CameraPath rtn;
+	keyframes = glm::max(keyframes, 3u);
+	for (unsigned int i = 0; i <= keyframes; ++i)
+	{
+		const float a = glm::two_pi<float>() * (i % keyframes) / keyframes;
+		rtn.addKeyframe(duration * i / keyframes, center + glm::vec3(radius * sin(a), height, radius * cos(a)), center);
+	}
+	rtn.setLooped(true);
+	return rtn;
+}
+void CameraPath::addKeyframe(float time, const glm::vec3 &eye, const glm::vec3 &target)
+{
+	const Keyframe k = { time, eye, target };
+	keyframes.insert(std::upper_bound(keyframes.begin(), keyframes.end(), k, [](const Keyframe &a, const Keyframe &b){ return a.time < b.time; }), k);
+}
+bool CameraPath::save(const std::string &path) const
+{
+	FILE *f = fopen(path.c_str(), "w");
+	if (!f)
+	{
+		fprintf(stderr, "CameraPath::save(): Unable to open '%s' for writing.\n", path.c_str());
+		return false;
+	}
+	fprintf(f, "#time eye.x eye.y eye.z target.x target.y target.z\n");
+	if (looped)
+		fprintf(f, "loop\n");
+	for (auto &&k : keyframes)
+		fprintf(f, "%g %g %g %g %g %g %g\n", k.time, k.eye.x, k.eye.y, k.eye.z, k.target.x, k.target.y, k.target.z);
+	const bool success = !ferror(f);
+	fclose(f);
+	return success;
+}
+void CameraPath::sample(float time, glm::vec3 &eye, glm::vec3 &target) const
+{
+	if (keyframes.empty())
+		return;
+	const int n = (int)keyframes.size();
+	const float start = keyframes.front().time;
+	const float duration = keyframes.back().time - start;
+	if (looped && duration > 0.0f)
+	{
+		time = fmod(time - start, duration);
+		time = (time < 0.0f ? time + duration : time) + start;
+	}
+	if (n == 1 || time <= keyframes.front().time)
+	{
+		eye = keyframes.front().eye;
+		target = keyframes.front().target;
+		return;
+	}
+	if (time >= keyframes.back().time)
+	{
+		eye = keyframes.back().eye;
+		target = keyframes.back().target;
+		return;
+	}
+	//Index of the keyframe which begins the segment containing time
+	const int i = (int)(std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe &k){ return t < k.time; }) - keyframes.begin()) - 1;
+	//Neighbouring keyframes, looped paths skip the duplicate which closes the loop
+	auto at = [&](int j) -> const Keyframe&
+	{
+		if (looped && n > 2)
+			return keyframes[j < 0 ? j + n - 1 : (j >= n ? j - n + 1 : j)];
+		return keyframes[glm::clamp(j, 0, n - 1)];
+	};
+	const Keyframe &k0 = at(i - 1), &k1 = at(i), &k2 = at(i + 1), &k3 = at(i + 2);
+	const float u = (time - k1.time) / glm::max(k2.time - k1.time, 1e-6f);
+	eye = catmullRom(k0.eye, k1.eye, k2.eye, k3.eye, u);
+	target = catmullRom(k0.target, k1.target, k2.target, k3.target, u);
+}
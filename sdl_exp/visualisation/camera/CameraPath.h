@@ -0,0 +1,77 @@
+#ifndef __CameraPath_h__
+#define __CameraPath_h__
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * A timed sequence of camera poses, interpolated with Catmull-Rom splines
+ * Used to replay identical camera motion between runs, e.g. for benchmarking (see Visualisation::setCameraPath())
+ * Paths are stored as plain text, one keyframe per line: "time eye.x eye.y eye.z target.x target.y target.z"
+ * Times are in seconds, blank lines and lines beginning '#' are ignored, a line reading "loop" marks the path as looped
+ */
+class CameraPath
+{
+public:
+	struct Keyframe
+	{
+		float time;
+		glm::vec3 eye;
+		glm::vec3 target;
+	};
+	/**
+	 * Creates an empty path
+	 */
+	CameraPath();
+	/**
+	 * Loads a path from file
+	 * @param path Path to the file to load
+	 * @throws std::runtime_error If the file cannot be read, or contains a malformed keyframe
+	 */
+	explicit CameraPath(const std::string &path);
+	/**
+	 * Creates a looped path, which circles center once, whilst looking at it
+	 * @param center The point which is orbited
+	 * @param radius Horizontal distance of the camera from center
+	 * @param height Height of the camera above center
+	 * @param duration The time taken to complete an orbit, in seconds
+	 * @param keyframes The number of keyframes to generate (excluding the one which closes the loop)
+	 */
+	static CameraPath orbit(const glm::vec3 &center, float radius, float height, float duration, unsigned int keyframes = 8);
+	/**
+	 * Adds a keyframe, keyframes are kept sorted by time
+	 */
+	void addKeyframe(float time, const glm::vec3 &eye, const glm::vec3 &target);
+	/**
+	 * Writes the path to file, in the format read by CameraPath(const std::string &)
+	 * @return False if the file could not be written
+	 */
+	bool save(const std::string &path) const;
+	/**
+	 * Interpolates the camera pose at the given time
+	 * Times outside of the path are clamped, unless the path is looped
+	 * @param time Time in seconds since the start of the path
+	 * @param eye Returns the interpolated camera location
+	 * @param target Returns the interpolated point which the camera is directed towards
+	 * @note An empty path leaves eye and target unchanged
+	 */
+	void sample(float time, glm::vec3 &eye, glm::vec3 &target) const;
+	/**
+	 * Looped paths wrap time about getDuration(), their final keyframe should match their first
+	 * The spline's tangents at the join are computed across the loop, so motion remains smooth
+	 */
+	void setLooped(bool looped) { this->looped = looped; }
+	bool isLooped() const { return looped; }
+	/**
+	 * @return The time of the final keyframe, in seconds
+	 */
+	float getDuration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+	bool isEmpty() const { return keyframes.empty(); }
+	const std::vector<Keyframe> &getKeyframes() const { return keyframes; }
+private:
+	std::vector<Keyframe> keyframes;
+	bool looped;
+};
+
+#endif //__CameraPath_h__
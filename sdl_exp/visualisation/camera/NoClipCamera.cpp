@@ -73,6 +73,18 @@ void NoClipCamera::roll(const float &roll){
 void NoClipCamera::setStabilise(const bool &stabilise){
 	this->stabilise = stabilise;
 }
+void NoClipCamera::setPose(const glm::vec3 &eye, const glm::vec3 &target){
+	const glm::vec3 look = target - eye;
+	if (length(look) == 0.0f)
+		return;
+	this->eye = eye;
+	this->look = normalize(look);
+	//Don't let right degenerate when looking straight up/down
+	if (abs(dot(this->look, this->pureUp)) < 0.999f)
+		this->right = normalize(cross(this->look, this->pureUp));
+	this->up = normalize(cross(this->right, this->look));
+	this->updateViews();
+}
 void NoClipCamera::gluLookAt(){
     GL_CALL(::gluLookAt(
         eye.x, eye.y, eye.z,
@@ -60,6 +60,14 @@ public:
 	 * @param stabilise Whether the camera should be stabilised
 	 */
 	void setStabilise(const bool &stabilise);
+	/**
+	 * Relocates the camera to eye, directed at target, with up perpendicular to look within the plane of pureUp
+	 * Used to play back scripted camera motion, e.g. a CameraPath
+	 * @param eye The coordinates the camera is located
+	 * @param target The coordinates the camera is directed towards
+	 * @note If the camera would look (almost) parallel to pureUp, the previous right vector is retained
+	 */
+	void setPose(const glm::vec3 &eye, const glm::vec3 &target);
 	/**
 	 * Calls gluLookAt()
 	 * For people using fixed function pipeline
@@ -52,7 +52,27 @@ public:
 	}
 	virtual void setLightsBuffer(const GLuint &bufferBindingPoint) = 0;
 	virtual void setLightsBuffer(std::shared_ptr<const LightsBuffer> buffer);
-	
+	/**
+	 * Completes CPU work deferred since the entity was last updated (e.g. posing a Model's bones), without using the GL context
+	 * @note Called by BasicScene and MultiPassScene after each update(), in parallel across their registered entities
+	 */
+	virtual void prepare() { }
+	/**
+	 * Latches transforms written during the simulation tick which just completed
+	 * @note Called by BasicScene, on the simulation thread, when the visualisation runs a fixed timestep
+	 */
+	virtual void commitTick() { }
+	/**
+	 * Blends the transforms of the two most recent simulation ticks, ready for rendering
+	 * @param alpha Progress from the previous tick to the current tick [0, 1]
+	 * @note Called by BasicScene, on the render thread, when the visualisation runs a fixed timestep
+	 */
+	virtual void interpolateTick(float alpha) { }
+	/**
+	 * Discards latched ticks, so that transforms are again rendered as set
+	 * @note Called by BasicScene when the visualisation stops running a fixed timestep
+	 */
+	virtual void resetTicks() { }
 };
 
 #endif //__Renderable_h__
\ No newline at end of file
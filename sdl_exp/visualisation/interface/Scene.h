@@ -22,6 +22,14 @@ public:
 	 * @return Returning true permits the visualisation to also handle the keypress
 	 */
 	virtual bool _keypress(SDL_Keycode keycode, int x, int y) { return true; };
+	/**
+	 * Called when the user presses a mouse button
+	 * @param button The SDL button index (SDL_BUTTON_LEFT, SDL_BUTTON_MIDDLE, SDL_BUTTON_RIGHT etc)
+	 * @param x The mouse's x coordinate relative to the window
+	 * @param y The mouse's y coordinate relative to the window
+	 * @return Returning true permits the visualisation to also handle the press (toggling mouse capture)
+	 */
+	virtual bool _mousePress(Uint8 button, int x, int y) { return true; };
 	/**
 	 * Called by the viewport when the windows dimensions change
 	 */
@@ -36,6 +44,22 @@ public:
 	 * @param frameTime The number of milliseconds since update was last called
 	 */
 	virtual void _update(const unsigned int &frameTime) {};
+	/**
+	 * Called at the end of each simulation tick, when the viewport runs a fixed timestep simulation
+	 * The state written by the tick should be latched, so that it can be interpolated by _interpolateTick()
+	 * @note The render thread is blocked whilst this executes
+	 */
+	virtual void _commitTick() {};
+	/**
+	 * Called before _render(), when the viewport runs a fixed timestep simulation
+	 * @param alpha Progress from the previous tick to the current tick [0, 1]
+	 */
+	virtual void _interpolateTick(float alpha) {};
+	/**
+	 * Called when the viewport stops running a fixed timestep simulation
+	 * Latched tick state should be discarded, so that state is rendered as updated
+	 */
+	virtual void _resetTicks() {};
 
 	virtual ~Scene(){};
 protected:
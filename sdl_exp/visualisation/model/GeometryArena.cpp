@@ -0,0 +1,308 @@
+#include "GeometryArena.h"
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+
+std::map<GeometryArena::Layout, std::weak_ptr<GeometryArena>> GeometryArena::arenas;
+
+unsigned int GeometryArena::Layout::getSize(Attribute a) const
+{
+	switch (a)
+	{
+	case POSITION:
+		return positions * sizeof(float);
+	case NORMAL:
+		return normals * sizeof(float);
+	case COLOR:
+		return colors * sizeof(float);
+	case TEXCOORD:
+		return texcoords * sizeof(float);
+	case BONE_ID:
+		return bones ? 4 * sizeof(unsigned int) : 0;
+	case BONE_WEIGHT:
+		return bones ? 4 * sizeof(float) : 0;
+	default:
+		return 0;
+	}
+}
+unsigned int GeometryArena::Layout::getOffset(Attribute a) const
+{
+	unsigned int rtn = 0;
+	for (int i = 0; i < a; ++i)
+		rtn += getSize((Attribute)i);
+	return rtn;
+}
+bool GeometryArena::Layout::operator<(const Layout &other) const
+{
+	if (positions != other.positions) return positions < other.positions;
+	if (normals != other.normals) return normals < other.normals;
+	if (colors != other.colors) return colors < other.colors;
+	if (texcoords != other.texcoords) return texcoords < other.texcoords;
+	return bones < other.bones;
+}
+
+GeometryArena::Allocation::Allocation(std::shared_ptr<GeometryArena> arena, TLSF::Allocation vertices, unsigned int vertexCount, TLSF::Allocation indices, unsigned int indexCount)
+	: arena(arena)
+	, vertices(vertices)
+	, indices(indices)
+	, vertexCount(vertexCount)
+	, indexCount(indexCount)
+{ }
+GeometryArena::Allocation::~Allocation()
+{
+	arena->vertexAllocator.free(vertices.node);
+	arena->indexAllocator.free(indices.node);
+	arena->allocations.erase(this);
+}
+void GeometryArena::Allocation::setVertices(const void *positions, const void *normals, const void *colors, const void *texcoords, const void *boneIDs, const void *boneWeights)
+{
+	const Layout &layout = arena->layout;
+	const unsigned int stride = layout.getStride();
+	const void *attributes[ATTRIBUTE_COUNT] = { positions, normals, colors, texcoords, boneIDs, boneWeights };
+	std::vector<char> interleaved(vertexCount * stride, 0);
+	for (unsigned int a = 0; a < ATTRIBUTE_COUNT; ++a)
+	{
+		const unsigned int size = layout.getSize((Attribute)a);
+		if (!size || !attributes[a])
+			continue;
+		const char *src = static_cast<const char *>(attributes[a]);
+		char *dest = interleaved.data() + layout.getOffset((Attribute)a);
+		for (unsigned int v = 0; v < vertexCount; ++v)
+			memcpy(dest + v * stride, src + v * size, size);
+	}
+	//Copy targets don't affect the bound VAO
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, arena->vbo));
+	GL_CALL(glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)vertices.offset * stride, interleaved.size(), interleaved.data()));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+void GeometryArena::Allocation::setIndices(const GLuint *indices, unsigned int first, unsigned int count)
+{
+	assert(first <= indexCount);
+	count = count ? count : indexCount - first;
+	assert(first + count <= indexCount);
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, arena->ibo));
+	GL_CALL(glBufferSubData(GL_COPY_WRITE_BUFFER, ((size_t)this->indices.offset + first) * sizeof(GLuint), count * sizeof(GLuint), indices));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+void GeometryArena::Allocation::draw(GLenum mode, unsigned int first, unsigned int count, GLsizei instances) const
+{
+	count = count ? count : indexCount - first;
+	const void *offset = reinterpret_cast<const void *>(((size_t)indices.offset + first) * sizeof(GLuint));
+	if (instances == 1)
+	{
+		GL_CALL(glDrawElementsBaseVertex(mode, count, GL_UNSIGNED_INT, offset, getBaseVertex()));
+	}
+	else
+	{
+		GL_CALL(glDrawElementsInstancedBaseVertex(mode, count, GL_UNSIGNED_INT, offset, instances, getBaseVertex()));
+	}
+}
+GeometryArena::DrawCommand GeometryArena::Allocation::command(GLuint instanceCount, GLuint baseInstance, unsigned int first, unsigned int count) const
+{
+	DrawCommand rtn;
+	rtn.count = count ? count : indexCount - first;
+	rtn.instanceCount = instanceCount;
+	rtn.firstIndex = indices.offset + first;
+	rtn.baseVertex = getBaseVertex();
+	rtn.baseInstance = baseInstance;
+	return rtn;
+}
+
+std::shared_ptr<GeometryArena> GeometryArena::get(const Layout &layout)
+{
+	std::shared_ptr<GeometryArena> rtn = arenas[layout].lock();
+	if (!rtn)
+	{//Constructor is private, so make_shared() can't be used
+		rtn = std::shared_ptr<GeometryArena>(new GeometryArena(layout));
+		arenas[layout] = rtn;
+	}
+	return rtn;
+}
+void GeometryArena::report(FILE *out)
+{
+	fprintf(out, "stride,allocations,vertices_used,vertex_capacity,indices_used,index_capacity,largest_free_vertices,largest_free_indices\n");
+	for (auto &&a : arenas)
+	{
+		if (auto arena = a.second.lock())
+		{
+			const Utilisation u = arena->getUtilisation();
+			fprintf(out, "%u,%u,%u,%u,%u,%u,%u,%u\n", a.first.getStride(), u.allocations, u.verticesUsed, u.vertexCapacity, u.indicesUsed, u.indexCapacity, u.largestFreeVertices, u.largestFreeIndices);
+		}
+	}
+}
+GeometryArena::GeometryArena(const Layout &layout)
+	: layout(layout)
+	, vbo(0)
+	, ibo(0)
+	, commandBuffer(0)
+	, commandBufferSize(0)
+	, vertexAllocator(DEFAULT_VERTICES)
+	, indexAllocator(DEFAULT_INDICES)
+{
+	GL_CALL(glGenBuffers(1, &vbo));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, vbo));
+	GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, (size_t)DEFAULT_VERTICES * layout.getStride(), nullptr, GL_STATIC_DRAW));
+	GL_CALL(glGenBuffers(1, &ibo));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, ibo));
+	GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, (size_t)DEFAULT_INDICES * sizeof(GLuint), nullptr, GL_STATIC_DRAW));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+GeometryArena::~GeometryArena()
+{
+	auto it = arenas.find(layout);
+	if (it != arenas.end() && it->second.expired())
+		arenas.erase(it);
+	GL_CALL(glDeleteBuffers(1, &vbo));
+	GL_CALL(glDeleteBuffers(1, &ibo));
+	if (commandBuffer)
+	{
+		GL_CALL(glDeleteBuffers(1, &commandBuffer));
+	}
+}
+void GeometryArena::growBuffer(GLuint buffer, size_t oldBytes, size_t newBytes)
+{
+	//Stage the contents in a temporary buffer, so that buffer keeps its name
+	GLuint temp;
+	GL_CALL(glGenBuffers(1, &temp));
+	GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, buffer));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, temp));
+	GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, oldBytes, nullptr, GL_STREAM_COPY));
+	GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes));
+	GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, temp));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+	GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW));
+	GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes));
+	GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	GL_CALL(glDeleteBuffers(1, &temp));
+}
+std::shared_ptr<GeometryArena::Allocation> GeometryArena::allocate(unsigned int vertexCount, unsigned int indexCount)
+{
+	TLSF::Allocation v = vertexAllocator.allocate(vertexCount);
+	TLSF::Allocation i = indexAllocator.allocate(indexCount);
+	if (v.node == TLSF::NONE || i.node == TLSF::NONE)
+	{
+		vertexAllocator.free(v.node);
+		indexAllocator.free(i.node);
+		//Fragmented, compacting is cheaper than growing
+		const bool verticesFit = vertexAllocator.getSize() - vertexAllocator.getUsed() >= vertexCount * 2;
+		const bool indicesFit = indexAllocator.getSize() - indexAllocator.getUsed() >= indexCount * 2;
+		if (verticesFit && indicesFit)
+			defragment();
+		//Grow geometrically, with slack for the rounding of TLSF's size classes
+		if (vertexAllocator.getLargestFree() < vertexCount * 2)
+		{
+			const unsigned int size = std::max(vertexAllocator.getSize() * 2, vertexAllocator.getSize() + vertexCount * 2);
+			growBuffer(vbo, (size_t)vertexAllocator.getSize() * layout.getStride(), (size_t)size * layout.getStride());
+			vertexAllocator.grow(size);
+		}
+		if (indexAllocator.getLargestFree() < indexCount * 2)
+		{
+			const unsigned int size = std::max(indexAllocator.getSize() * 2, indexAllocator.getSize() + indexCount * 2);
+			growBuffer(ibo, (size_t)indexAllocator.getSize() * sizeof(GLuint), (size_t)size * sizeof(GLuint));
+			indexAllocator.grow(size);
+		}
+		v = vertexAllocator.allocate(vertexCount);
+		i = indexAllocator.allocate(indexCount);
+		if (v.node == TLSF::NONE || i.node == TLSF::NONE)
+		{
+			fprintf(stderr, "GeometryArena::allocate(): Unable to allocate %u vertices and %u indices.\n", vertexCount, indexCount);
+			vertexAllocator.free(v.node);
+			indexAllocator.free(i.node);
+			return nullptr;
+		}
+	}
+	std::shared_ptr<Allocation> rtn(new Allocation(shared_from_this(), v, vertexCount, i, indexCount));
+	allocations.insert(rtn.get());
+	return rtn;
+}
+bool GeometryArena::attach(Attribute a, Shaders::VertexAttributeDetail &vad) const
+{
+	if (!layout.getSize(a))
+		return false;
+	vad.vbo = vbo;
+	vad.offset = layout.getOffset(a);
+	vad.stride = layout.getStride();
+	return true;
+}
+void GeometryArena::multiDraw(GLenum mode, const std::vector<DrawCommand> &commands)
+{
+	if (commands.empty())
+		return;
+	const size_t bytes = commands.size() * sizeof(DrawCommand);
+	if (!commandBuffer)
+	{
+		GL_CALL(glGenBuffers(1, &commandBuffer));
+	}
+	GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer));
+	if (bytes > commandBufferSize)
+	{
+		commandBufferSize = std::max(bytes, commandBufferSize * 2);
+		GL_CALL(glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBufferSize, nullptr, GL_STREAM_DRAW));
+	}
+	else
+	{//Orphan the previous frame's commands
+		GL_CALL(glInvalidateBufferData(commandBuffer));
+	}
+	GL_CALL(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, commands.data()));
+	GL_CALL(glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, (GLsizei)commands.size(), 0));
+	GL_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
+void GeometryArena::defragment()
+{
+	//Repack in order of vertex offset, so most allocations move a short distance (or not at all)
+	std::vector<Allocation *> sorted(allocations.begin(), allocations.end());
+	std::sort(sorted.begin(), sorted.end(), [](const Allocation *a, const Allocation *b){ return a->vertices.offset < b->vertices.offset; });
+	const unsigned int stride = layout.getStride();
+	const size_t vertexBytes = (size_t)vertexAllocator.getSize() * stride;
+	const size_t indexBytes = (size_t)indexAllocator.getSize() * sizeof(GLuint);
+	//Stage the current contents, so that moves can't overwrite data which has yet to move
+	GLuint temp[2];
+	GL_CALL(glGenBuffers(2, temp));
+	GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, vbo));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, temp[0]));
+	GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, nullptr, GL_STREAM_COPY));
+	GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vertexBytes));
+	GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, ibo));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, temp[1]));
+	GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STREAM_COPY));
+	GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, indexBytes));
+	//Allocating from empty allocators packs allocations contiguously, in order
+	vertexAllocator.reset(vertexAllocator.getSize());
+	indexAllocator.reset(indexAllocator.getSize());
+	for (Allocation *a : sorted)
+	{
+		const TLSF::Allocation v = vertexAllocator.allocate(a->vertexCount);
+		const TLSF::Allocation i = indexAllocator.allocate(a->indexCount);
+		assert(v.node != TLSF::NONE && i.node != TLSF::NONE);
+		if (v.offset != a->vertices.offset)
+		{
+			GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, temp[0]));
+			GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, vbo));
+			GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (size_t)a->vertices.offset * stride, (size_t)v.offset * stride, (size_t)a->vertexCount * stride));
+		}
+		if (i.offset != a->indices.offset)
+		{
+			GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, temp[1]));
+			GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, ibo));
+			GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (size_t)a->indices.offset * sizeof(GLuint), (size_t)i.offset * sizeof(GLuint), (size_t)a->indexCount * sizeof(GLuint)));
+		}
+		a->vertices = v;
+		a->indices = i;
+	}
+	GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	GL_CALL(glDeleteBuffers(2, temp));
+}
+GeometryArena::Utilisation GeometryArena::getUtilisation() const
+{
+	Utilisation rtn;
+	rtn.allocations = (unsigned int)allocations.size();
+	rtn.verticesUsed = vertexAllocator.getUsed();
+	rtn.vertexCapacity = vertexAllocator.getSize();
+	rtn.indicesUsed = indexAllocator.getUsed();
+	rtn.indexCapacity = indexAllocator.getSize();
+	rtn.largestFreeVertices = vertexAllocator.getLargestFree();
+	rtn.largestFreeIndices = indexAllocator.getLargestFree();
+	return rtn;
+}
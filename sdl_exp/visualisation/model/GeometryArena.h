@@ -0,0 +1,198 @@
+#ifndef __GeometryArena_h__
+#define __GeometryArena_h__
+
+#include "../shader/Shaders.h"
+#include "../util/TLSF.h"
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Shared vertex and index buffers, which meshes of the same vertex layout are sub allocated from
+ * Vertices are interleaved, so every mesh in an arena shares the same attribute offsets and stride
+ * Meshes are drawn with a base vertex and first index (see Allocation::draw()), or many at once with multiDraw()
+ * As the buffers are shared, so are the bindings of every Shaders which draws from the arena
+ * Usage:
+ *   auto arena = GeometryArena::get({ 3, 3 });//Positions and normals
+ *   auto mesh = arena->allocate(vertexCount, indexCount);
+ *   mesh->setVertices(positions, normals);
+ *   mesh->setIndices(indices);
+ *   arena->attach(GeometryArena::POSITION, shaderPositions);//Sets vbo, offset and stride
+ *   shaders->setFaceVBO(arena->getIndexBuffer());
+ *   mesh->draw(GL_TRIANGLES);
+ * @note Buffers grow in place, their names never change, so VAOs built against an arena remain valid
+ */
+class GeometryArena : public std::enable_shared_from_this<GeometryArena>
+{
+public:
+	enum Attribute
+	{
+		POSITION,
+		NORMAL,
+		COLOR,
+		TEXCOORD,
+		/**
+		 * uvec4
+		 */
+		BONE_ID,
+		/**
+		 * vec4
+		 */
+		BONE_WEIGHT,
+		ATTRIBUTE_COUNT
+	};
+	/**
+	 * The number of float components of each attribute, 0 if absent
+	 */
+	struct Layout
+	{
+		unsigned int positions;
+		unsigned int normals;
+		unsigned int colors;
+		unsigned int texcoords;
+		/**
+		 * Adds the BONE_ID and BONE_WEIGHT attributes
+		 */
+		bool bones;
+		/**
+		 * @return The byte offset of the attribute within each vertex
+		 */
+		unsigned int getOffset(Attribute a) const;
+		/**
+		 * @return The size of the attribute in bytes, 0 if absent
+		 */
+		unsigned int getSize(Attribute a) const;
+		unsigned int getStride() const { return getOffset(ATTRIBUTE_COUNT); }
+		bool operator<(const Layout &other) const;
+	};
+	/**
+	 * Matches DrawElementsIndirectCommand
+	 */
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+	struct Utilisation
+	{
+		unsigned int allocations;
+		unsigned int verticesUsed, vertexCapacity;
+		unsigned int indicesUsed, indexCapacity;
+		/**
+		 * The largest allocation possible without growing or defragmenting
+		 */
+		unsigned int largestFreeVertices, largestFreeIndices;
+	};
+	/**
+	 * A mesh's vertices and indices within an arena, these are released when destroyed
+	 * Its base vertex and first index may change if the arena is defragmented, so should be read when drawing
+	 */
+	class Allocation
+	{
+		friend class GeometryArena;
+	public:
+		~Allocation();
+		Allocation(const Allocation&) = delete;
+		Allocation &operator=(const Allocation&) = delete;
+		/**
+		 * Interleaves and uploads the mesh's vertices
+		 * Each attribute is a tightly packed array of getVertexCount() elements, with the arena layout's component count
+		 * Attributes absent from the layout are ignored, those present but passed as nullptr are left undefined
+		 */
+		void setVertices(const void *positions, const void *normals = nullptr, const void *colors = nullptr, const void *texcoords = nullptr, const void *boneIDs = nullptr, const void *boneWeights = nullptr);
+		/**
+		 * Uploads count indices, starting from index first of the mesh
+		 * Indices are relative to the mesh's first vertex, the base vertex is applied when drawing
+		 * @param count The number of indices, 0 uploads until the end of the mesh
+		 */
+		void setIndices(const GLuint *indices, unsigned int first = 0, unsigned int count = 0);
+		/**
+		 * Draws the mesh (or a range of its indices) with the currently bound program and VAO
+		 * @param count The number of indices, 0 draws until the end of the mesh
+		 */
+		void draw(GLenum mode, unsigned int first = 0, unsigned int count = 0, GLsizei instances = 1) const;
+		/**
+		 * Returns an indirect command drawing the mesh (or a range of its indices), for multiDraw()
+		 * @param count The number of indices, 0 draws until the end of the mesh
+		 */
+		DrawCommand command(GLuint instanceCount = 1, GLuint baseInstance = 0, unsigned int first = 0, unsigned int count = 0) const;
+		GLint getBaseVertex() const { return (GLint)vertices.offset; }
+		GLuint getFirstIndex() const { return indices.offset; }
+		unsigned int getVertexCount() const { return vertexCount; }
+		unsigned int getIndexCount() const { return indexCount; }
+		GeometryArena &getArena() const { return *arena; }
+	private:
+		Allocation(std::shared_ptr<GeometryArena> arena, TLSF::Allocation vertices, unsigned int vertexCount, TLSF::Allocation indices, unsigned int indexCount);
+		/**
+		 * Held so that the arena outlives its allocations
+		 */
+		std::shared_ptr<GeometryArena> arena;
+		TLSF::Allocation vertices, indices;
+		unsigned int vertexCount, indexCount;
+	};
+	/**
+	 * The default capacity of new arenas
+	 */
+	static const unsigned int DEFAULT_VERTICES = 1 << 16;
+	static const unsigned int DEFAULT_INDICES = 1 << 18;
+	/**
+	 * Returns the shared arena of the layout, creating it if necessary
+	 * Arenas are destroyed when their final allocation is released
+	 */
+	static std::shared_ptr<GeometryArena> get(const Layout &layout);
+	/**
+	 * Prints the utilisation of every live arena, as CSV
+	 */
+	static void report(FILE *out = stdout);
+	~GeometryArena();
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena &operator=(const GeometryArena&) = delete;
+	/**
+	 * Sub allocates a mesh, if no free ranges are large enough the arena is defragmented, or grown
+	 */
+	std::shared_ptr<Allocation> allocate(unsigned int vertexCount, unsigned int indexCount);
+	/**
+	 * Points vad at the attribute within the vertex buffer, other members (e.g. data, count) are unchanged
+	 * @return False if the attribute is absent from the layout
+	 */
+	bool attach(Attribute a, Shaders::VertexAttributeDetail &vad) const;
+	/**
+	 * Issues every command with a single glMultiDrawElementsIndirect(), with the currently bound program and VAO
+	 * @note Per draw data can be fetched via a vertex attribute with divisor 1, which begins at each command's baseInstance
+	 */
+	void multiDraw(GLenum mode, const std::vector<DrawCommand> &commands);
+	/**
+	 * Moves every allocation to the front of the buffers, merging the free space into a single range
+	 */
+	void defragment();
+	Utilisation getUtilisation() const;
+	const Layout &getLayout() const { return layout; }
+	GLuint getVertexBuffer() const { return vbo; }
+	GLuint getIndexBuffer() const { return ibo; }
+private:
+	explicit GeometryArena(const Layout &layout);
+	/**
+	 * Reallocates the buffer's storage, preserving its contents and name
+	 */
+	static void growBuffer(GLuint buffer, size_t oldBytes, size_t newBytes);
+	/**
+	 * Live arenas, by layout
+	 */
+	static std::map<Layout, std::weak_ptr<GeometryArena>> arenas;
+	const Layout layout;
+	GLuint vbo, ibo;
+	/**
+	 * Indirect commands submitted by multiDraw()
+	 */
+	GLuint commandBuffer;
+	size_t commandBufferSize;
+	TLSF vertexAllocator, indexAllocator;
+	std::unordered_set<Allocation *> allocations;
+};
+
+#endif //__GeometryArena_h__
@@ -1,14 +1,15 @@
 #include "Material.h"
 #include "../Texture/Texture2D.h"
 Material *Material::active = nullptr;
+Material::RenderFilter Material::filter = Material::AllMaterials;
 const char * Material::TEX_NAME[13] = { "t_none", "t_ambient", "t_diffuse", "t_specular", "t_emissive", "t_height", "t_normal", "t_shininess", "t_opacity", "t_displacement", "t_light", "t_reflection", "t_unknown" };
-Material::Material(std::shared_ptr<UniformBuffer> &buffer, const unsigned int &bufferIndex, const char* name, const bool &shaderRequiresBones)
+Material::Material(const char* name, const bool &shaderRequiresBones)
     : name(name==nullptr?"":name)
     , properties()
-    , buffer(buffer)
-    , bufferIndex(bufferIndex)
+    , slot(MaterialBuffer::get()->allocate())
 	, hasBaked(false)
 	, hasAlpha(false)
+	, textureAlpha(false)
 	, isWireframe(false)
 	, faceCull(true)
 	, shaderMode(Phong)
@@ -19,8 +20,8 @@ Material::Material(std::shared_ptr<UniformBuffer> &buffer, const unsigned int &b
 	alphaBlendMode[1] = GL_ONE_MINUS_SRC_ALPHA;
 }
 
-Material::Material(std::shared_ptr<UniformBuffer> &buffer, const unsigned int &bufferIndex, const Stock::Materials::Material &set, const bool &shaderRequiresBones)
-	: Material(buffer, bufferIndex, set.name, shaderRequiresBones)
+Material::Material(const Stock::Materials::Material &set, const bool &shaderRequiresBones)
+	: Material(set.name, shaderRequiresBones)
 {
 	properties.ambient = set.ambient;
 	properties.diffuse = set.diffuse;
@@ -32,10 +33,10 @@ Material::Material(std::shared_ptr<UniformBuffer> &buffer, const unsigned int &b
 Material::Material(const Material&other)
 	: name(other.name)
 	, properties(other.properties)
-	, buffer(other.buffer)
-	, bufferIndex(other.bufferIndex)
+	, slot(other.slot)
 	, hasBaked(false)
 	, hasAlpha(other.hasAlpha)
+	, textureAlpha(other.textureAlpha)
 	, isWireframe(other.isWireframe)
 	, faceCull(other.faceCull)
 	, shaderMode(other.shaderMode)
@@ -59,7 +60,7 @@ void Material::updatePropertiesUniform(bool force)
 	if (!force&&!hasBaked)
 		return;
 	hasBaked = true;
-	buffer->setData(&properties, sizeof(MaterialProperties), bufferIndex*sizeof(MaterialProperties));
+	slot->set(properties);
 }
 /**
  * Todo: compare textures
@@ -85,27 +86,50 @@ bool  Material::operator==(Material& other) const
     return false;
 }
 /**
- * Temporary texture solution before proper materials
+ * Ambient, diffuse and specular textures are packed into the MaterialBuffer's texture arrays, or bound directly if they are full
+ * Other types are recorded in the bitmask, but not currently sampled
  */
 void Material::addTexture(TextureFrame texFrame, TextureType type)
 {
 	textures[type].push_back(texFrame);
-	this->properties.bitmask |= (1 << type);
-	updatePropertiesUniform();
-	if (hasBaked)
+	if (textures[type].size() > 1)
 	{
-		if (textures[type].size() == 1)
+		fprintf(stderr, "Warning: Material '%s' contains multiple textures of type %s\n Texture stacks are currently unsupported.\n", name.c_str(), TEX_NAME[type]);
+		return;
+	}
+	if (type == Ambient || type == Diffuse || type == Specular)
+	{
+		const GLuint handle = slot->addTexture(texFrame.texture);
+		if (handle == MaterialBuffer::INVALID_TEXTURE)
+			return;//Fallback to the material's colour
+		this->properties.textures[type - Ambient] = handle;
+		if (type == Diffuse && texFrame.useAlpha)
 		{
-			defaultShader->addTexture(TEX_NAME[type], texFrame.texture);
-			for (const auto &i : this->shaders)
-				i->addTexture(TEX_NAME[type], texFrame.texture);
+			const GLenum format = texFrame.texture->getFormat().format;
+			textureAlpha = format == GL_RGBA || format == GL_BGRA;
 		}
+		//Packed textures have been copied, so the source can be freed
+		if (handle >> 16 != MaterialBuffer::STANDALONE_ARRAY)
+			textures[type].back().texture = nullptr;
 	}
-	if (textures[type].size() > 1)
-	{
-		fprintf(stderr, "Warning: Material '%s' contains multiple textures of type %s\n Texture stacks are currently unsupported.\n", name.c_str(), TEX_NAME[type]);
+	this->properties.bitmask |= (1 << type);
+	updatePropertiesUniform();
+	updateAlpha();
+	if (hasBaked)
+	{//Packing may have created a texture array
+		attach(defaultShader);
+		for (const auto &i : this->shaders)
+			attach(i);
 	}
 }
+void Material::attach(const std::shared_ptr<Shaders> &shader) const
+{
+	shader->setMaterialBuffer(slot->getBuffer());
+	shader->setMaterialID(slot->getIndex());
+	const auto &standalone = slot->getStandaloneTextures();
+	for (unsigned int i = 0; i < standalone.size(); ++i)
+		shader->addTexture(MaterialBuffer::TEXTURE_UNIFORM_NAMES[i], standalone[i]);
+}
 //HasMatrices overrides
 void Material::setViewMatPtr(const glm::mat4 *viewMat)
 {
@@ -132,17 +156,9 @@ void Material::setCustomShaders(const std::vector<std::shared_ptr<Shaders>> &sha
 	//Clone all shaders
 	for (const auto &i:shaders)
 		this->shaders.push_back(std::make_shared<Shaders>(*i));
-	//Setup material in all Shaders
+	//Setup material in all Shaders, textures are bound as part of the material buffer
 	for (const auto &i : this->shaders)
-	{
-		//Setup material buffer
-		i->setMaterialBuffer(buffer);
-		i->setMaterialID(bufferIndex);
-		//Setup default shader, e.g. textures
-		for (auto &typeVec : textures)
-			if (typeVec.second.size())
-				i->addTexture(TEX_NAME[typeVec.first], typeVec.second[0].texture);
-	}
+		attach(i);
 }
 void Material::prepare(unsigned int index)
 {
@@ -183,18 +199,20 @@ void Material::use(glm::mat4 &transform, unsigned int index, bool requiresPrepar
 		{
 			GL_CALL(glDisable(GL_CULL_FACE));
         }
-		//Treat all materials as having alpha until we can add a suitable check/switch
-		//if (hasAlpha || this->properties.opacity>1.0f)
-		//{
-		if ((index<shaders.size() && shaders[index]->supportsGL_BLEND())
-			|| (index >= shaders.size() && defaultShader->supportsGL_BLEND()))
-		{
-			GL_CALL(glEnable(GL_BLEND));
-			GL_CALL(glBlendFunc(alphaBlendMode[0], alphaBlendMode[1]));
-		}
-		else
+		//Only materials with alpha are blended, so opaque surfaces write depth without ordering artifacts
+		//Whilst drawing transparent materials only, blend state belongs to the caller (e.g. OITPass)
+		if (filter != TransparentMaterials)
 		{
-			GL_CALL(glDisable(GL_BLEND));
+			if (hasAlpha && ((index<shaders.size() && shaders[index]->supportsGL_BLEND())
+				|| (index >= shaders.size() && defaultShader->supportsGL_BLEND())))
+			{
+				GL_CALL(glEnable(GL_BLEND));
+				GL_CALL(glBlendFunc(alphaBlendMode[0], alphaBlendMode[1]));
+			}
+			else
+			{
+				GL_CALL(glDisable(GL_BLEND));
+			}
 		}
         
     	active = this;
@@ -215,14 +233,17 @@ void Material::use(glm::mat4 &transform, unsigned int index, bool requiresPrepar
         if ((polygonMode[0] != GL_LINE&&isWireframe) || (polygonMode[0] != GL_FILL&&!isWireframe))
            fprintf(stderr, "Warning: Material::use() detected GL_POLYGON_MODE has been changed.\nUse Material::clearActive() before to prevent this warning.\n");
         //Blend mode
-        GLint alphaSrc, alphaDst, rgbSrc, rgbDst;
-        GL_CALL(glGetIntegerv(GL_BLEND_SRC_ALPHA, &alphaSrc));
-        GL_CALL(glGetIntegerv(GL_BLEND_DST_ALPHA, &alphaDst));
-        GL_CALL(glGetIntegerv(GL_BLEND_SRC_RGB, &rgbSrc));
-        GL_CALL(glGetIntegerv(GL_BLEND_DST_RGB, &rgbDst));
-        if (alphaSrc != alphaBlendMode[0] || rgbSrc != alphaBlendMode[0] || alphaDst != alphaBlendMode[1] || rgbDst != alphaBlendMode[1])
+        if (hasAlpha && filter != TransparentMaterials)
         {
-            fprintf(stderr, "Warning: Material::use() detected glBlendFunc() has been called.\nUse Material::clearActive() before to prevent this warning.\n");
+            GLint alphaSrc, alphaDst, rgbSrc, rgbDst;
+            GL_CALL(glGetIntegerv(GL_BLEND_SRC_ALPHA, &alphaSrc));
+            GL_CALL(glGetIntegerv(GL_BLEND_DST_ALPHA, &alphaDst));
+            GL_CALL(glGetIntegerv(GL_BLEND_SRC_RGB, &rgbSrc));
+            GL_CALL(glGetIntegerv(GL_BLEND_DST_RGB, &rgbDst));
+            if (alphaSrc != alphaBlendMode[0] || rgbSrc != alphaBlendMode[0] || alphaDst != alphaBlendMode[1] || rgbDst != alphaBlendMode[1])
+            {
+                fprintf(stderr, "Warning: Material::use() detected glBlendFunc() has been called.\nUse Material::clearActive() before to prevent this warning.\n");
+            }
         }
     }
 #endif
@@ -245,27 +266,21 @@ void Material::bake()
 {
 	//Update material properties buffer
 	updatePropertiesUniform(true);
+	updateAlpha();
 	//Create default shader
 	if (shaderRequiresBones)
 		defaultShader = std::make_shared<Shaders>(Stock::Shaders::BONE);//Temp
 	else
 		defaultShader = std::make_shared<Shaders>(Stock::Shaders::PHONG);//Temp
-	//Setup material buffer
-	defaultShader->setMaterialBuffer(buffer);
-	defaultShader->setMaterialID(bufferIndex);
-	//Setup default shader, e.g. textures
-	for (auto &typeVec:textures)
-		if (typeVec.second.size())
-			defaultShader->addTexture(TEX_NAME[typeVec.first], typeVec.second[0].texture);
+	//Setup material buffer and textures
+	attach(defaultShader);
 	//Setup material in all custom shaders
 	for (const auto &i : this->shaders)
-	{
-		//Setup material buffer
-		i->setMaterialBuffer(buffer);
-		i->setMaterialID(bufferIndex);
-		//Setup default shader, e.g. textures
-		for (auto &typeVec : textures)
-			if (typeVec.second.size())
-				i->addTexture(TEX_NAME[typeVec.first], typeVec.second[0].texture);
-	}
-}
\ No newline at end of file
+		attach(i);
+}
+
+void Material::updateAlpha()
+{
+	//Diffuse alpha is multiplied into the fragment's alpha
+	hasAlpha = properties.opacity < 1.0f || (properties.bitmask & (1 << Opacity)) != 0 || textureAlpha;
+}
@@ -4,7 +4,7 @@
 #include "../interface/Renderable.h"
 #include "../shader/Shaders.h"
 #include "../shader/ShaderHeader.h"
-#include "../shader/buffer/UniformBuffer.h"
+#include "MaterialBuffer.h"
 
 namespace Stock
 {
@@ -69,6 +69,16 @@ class Material : protected Renderable
      */
     static Material *active;
 public:
+	/**
+	 * Which materials render calls draw, meshes whose material is filtered out are skipped
+	 * @see setRenderFilter()
+	 */
+	enum RenderFilter
+	{
+		AllMaterials,           //Every material is drawn, transparent materials are blended in draw order
+		OpaqueMaterials,        //Only materials without alpha are drawn, e.g. the opaque pass before an OITPass
+		TransparentMaterials    //Only materials with alpha are drawn, GL_BLEND is left as configured by the caller (e.g. OITPass)
+	};
     enum ShadingMode
     {
         Constant,           //No shading, Constant light=1
@@ -126,12 +136,16 @@ public:
     };
     /**
      * Creates a named material with the default configuration
+     * The material's properties are allocated from the shared MaterialBuffer
      */
-	Material(std::shared_ptr<UniformBuffer> &buffer, const unsigned int &bufferIndex, const char* name = "", const bool &shaderRequiresBones = false);
+	Material(const char* name = "", const bool &shaderRequiresBones = false);
 	/**
 	* Creates a named material with the default configuration
 	*/
-	Material(std::shared_ptr<UniformBuffer> &buffer, const unsigned int &bufferIndex, const Stock::Materials::Material &set, const bool &shaderRequiresBones = false);
+	Material(const Stock::Materials::Material &set, const bool &shaderRequiresBones = false);
+	/**
+	 * Copies share the original's slot within the MaterialBuffer, so changes to their properties affect both
+	 */
 	Material(const Material&other);
     /**
      *
@@ -160,6 +174,16 @@ public:
 	 */
 	void clear(unsigned int index = UINT_MAX);
     static void clearActive() { Material::active = nullptr; }
+	/**
+	 * Selects which materials are drawn by subsequent render calls, this persists until changed
+	 * This allows a model with both opaque and transparent meshes to be split between passes
+	 */
+	static void setRenderFilter(RenderFilter filter) { Material::filter = filter; clearActive(); }
+	static RenderFilter getRenderFilter() { return Material::filter; }
+	/**
+	 * @return True if the material passes the current render filter
+	 */
+	bool isRenderable() const { return filter == AllMaterials || (filter == TransparentMaterials) == hasAlpha; }
     //Setters
     void setName(const std::string name) { this->name = name; };
 
@@ -174,7 +198,7 @@ public:
 	 * Currently unused
 	 */
     void setTransparent(const glm::vec3 transparent) { this->properties.transparent = transparent; updatePropertiesUniform(); }
-    void setOpacity(const float opacity) { this->properties.opacity = opacity; updatePropertiesUniform(); }
+    void setOpacity(const float opacity) { this->properties.opacity = opacity; updatePropertiesUniform(); updateAlpha(); }
     void setShininess(const float shininess) { this->properties.shininess = shininess; updatePropertiesUniform(); }
 	/**
 	 * This is currently unused, unclear how it differs from shininess
@@ -190,6 +214,11 @@ public:
     void setShadingMode(const ShadingMode shaderMode) { this->shaderMode = shaderMode; }
 	void addTexture(TextureFrame, TextureType type = Diffuse);
 	void setCustomShaders(const std::vector<std::shared_ptr<Shaders>> &shaders);
+	/**
+	 * Binds the MaterialBuffer and this material's ID to the shader
+	 * This allows a single shader to draw many materials, by updating _materialID between draws
+	 */
+	void attach(const std::shared_ptr<Shaders> &shader) const;
     /**
      * @see glBlendFunc()
      */
@@ -209,6 +238,15 @@ public:
     bool getWireframe() const { return isWireframe; }
     bool getTwoSided() const { return !faceCull; }
     ShadingMode getShadingMode() const { return shaderMode; }
+	/**
+	 * @return True if the material has opacity below 1, an opacity texture or a diffuse texture with an alpha channel
+	 * Only these materials are rendered with GL_BLEND
+	 */
+	bool getAlpha() const { return hasAlpha; }
+	/**
+	 * @return The material's index within the MaterialBuffer, this is the value of _materialID within shaders
+	 */
+	unsigned int getMaterialID() const { return slot->getIndex(); }
 	std::shared_ptr<Shaders> getShaders(unsigned int index = UINT_MAX) const { return index<shaders.size() ? shaders[index] : defaultShader; }
     std::pair<GLenum, GLenum> getAlphaBlendMode() const { return std::make_pair(alphaBlendMode[0], alphaBlendMode[1]); }
 	/**
@@ -221,11 +259,19 @@ private:
     std::string name;
 
     MaterialProperties properties;
-	std::shared_ptr<UniformBuffer> buffer;
-	const unsigned int bufferIndex;
+	std::shared_ptr<MaterialBuffer::Slot> slot;
 	bool hasBaked;
 	bool hasAlpha;
+	/**
+	 * Whether the diffuse texture contributes alpha, recorded when it's added as packed textures are not retained
+	 */
+	bool textureAlpha;
     void updatePropertiesUniform(bool force=false);
+	/**
+	 * Classifies whether the material requires blending, called when the properties it depends on change
+	 */
+	void updateAlpha();
+	static RenderFilter filter;
     //Textures
     std::map<TextureType, std::vector<TextureFrame>> textures;
     //Modifiers
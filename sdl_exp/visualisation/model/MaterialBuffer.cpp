@@ -0,0 +1,226 @@
+#include "MaterialBuffer.h"
+#include "../texture/Texture2D.h"
+#include <cassert>
+#include <algorithm>
+
+std::weak_ptr<MaterialBuffer> MaterialBuffer::instance;
+const char *MaterialBuffer::ARRAY_UNIFORM_NAMES[MAX_MATERIAL_ARRAYS] = {
+	"t_materialArrays[0]", "t_materialArrays[1]", "t_materialArrays[2]", "t_materialArrays[3]",
+	"t_materialArrays[4]", "t_materialArrays[5]", "t_materialArrays[6]", "t_materialArrays[7]"
+};
+const char *MaterialBuffer::TEXTURE_UNIFORM_NAMES[MAX_MATERIAL_TEXTURES] = {
+	"t_materialTextures[0]", "t_materialTextures[1]", "t_materialTextures[2]"
+};
+
+MaterialBuffer::Slot::Slot(std::shared_ptr<MaterialBuffer> buffer, unsigned int index)
+	: buffer(buffer)
+	, index(index)
+{ }
+MaterialBuffer::Slot::~Slot()
+{
+	for (auto &&t : textures)
+		buffer->release(t);
+	buffer->properties[index] = MaterialProperties();
+	buffer->freeSlots.push_back(index);
+}
+void MaterialBuffer::Slot::set(const MaterialProperties &properties)
+{
+	buffer->properties[index] = properties;
+	buffer->storage->setData(&buffer->properties[index], sizeof(MaterialProperties), index * sizeof(MaterialProperties));
+}
+GLuint MaterialBuffer::Slot::addTexture(const std::shared_ptr<const Texture> &texture)
+{
+	const GLuint rtn = buffer->pack(texture);
+	if (rtn != INVALID_TEXTURE)
+	{
+		textures.push_back(texture);
+		return rtn;
+	}
+	if (!texture || texture->getType() != GL_TEXTURE_2D)
+		return INVALID_TEXTURE;
+	if (standalone.size() >= MAX_MATERIAL_TEXTURES)
+	{
+		fprintf(stderr, "MaterialBuffer::Slot::addTexture(): All %u texture arrays and %u standalone textures are in use, texture '%s' can't be bound.\n", MAX_MATERIAL_ARRAYS, MAX_MATERIAL_TEXTURES, texture->getReference().c_str());
+		return INVALID_TEXTURE;
+	}
+	//The arrays are full, so the material's shaders sample the texture directly
+	standalone.push_back(texture);
+	return (STANDALONE_ARRAY << 16) | (GLuint)(standalone.size() - 1);
+}
+
+std::shared_ptr<MaterialBuffer> MaterialBuffer::get()
+{
+	std::shared_ptr<MaterialBuffer> rtn = instance.lock();
+	if (!rtn)
+	{//Constructor is private, so make_shared() can't be used
+		rtn = std::shared_ptr<MaterialBuffer>(new MaterialBuffer());
+		instance = rtn;
+	}
+	return rtn;
+}
+void MaterialBuffer::report(FILE *out)
+{
+	fprintf(out, "materials,material_capacity,texture_arrays,layers_used,layer_capacity\n");
+	if (auto buffer = instance.lock())
+	{
+		const Utilisation u = buffer->getUtilisation();
+		fprintf(out, "%u,%u,%u,%u,%u\n", u.materials, u.materialCapacity, u.arrays, u.layersUsed, u.layerCapacity);
+	}
+}
+MaterialBuffer::MaterialBuffer()
+	: storage(std::make_shared<ShaderStorageBuffer>(DEFAULT_CAPACITY * sizeof(MaterialProperties)))
+{
+	properties.reserve(DEFAULT_CAPACITY);
+}
+MaterialBuffer::~MaterialBuffer()
+{
+	for (auto &&a : arrays)
+	{
+		GL_CALL(glDeleteTextures(1, &a.name));
+	}
+}
+std::shared_ptr<MaterialBuffer::Slot> MaterialBuffer::allocate()
+{
+	unsigned int index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		index = (unsigned int)properties.size();
+		properties.push_back(MaterialProperties());
+		const size_t capacity = storage->getSize() / sizeof(MaterialProperties);
+		if (properties.size() > capacity)
+		{//Grow geometrically, BufferCore keeps the buffer's name and binding point so shaders are unaffected
+			storage->setData(nullptr, std::max(capacity * 2, properties.size()) * sizeof(MaterialProperties));
+			storage->setData(properties.data(), properties.size() * sizeof(MaterialProperties), 0);
+		}
+	}
+	storage->setData(&properties[index], sizeof(MaterialProperties), index * sizeof(MaterialProperties));
+	return std::shared_ptr<Slot>(new Slot(shared_from_this(), index));
+}
+MaterialBuffer::Utilisation MaterialBuffer::getUtilisation() const
+{
+	Utilisation rtn;
+	rtn.materials = (unsigned int)(properties.size() - freeSlots.size());
+	rtn.materialCapacity = (unsigned int)(storage->getSize() / sizeof(MaterialProperties));
+	rtn.arrays = (unsigned int)arrays.size();
+	rtn.layersUsed = 0;
+	rtn.layerCapacity = 0;
+	for (auto &&a : arrays)
+	{
+		rtn.layersUsed += a.nextLayer - (unsigned int)a.freeLayers.size();
+		rtn.layerCapacity += a.layers;
+	}
+	return rtn;
+}
+unsigned int MaterialBuffer::createArray(const glm::uvec2 &dimensions, const Texture::Format &format)
+{
+	if (arrays.size() >= MAX_MATERIAL_ARRAYS)
+		return (unsigned int)arrays.size();
+	//Reserve units from the top of the range, Texture subclasses allocate theirs upwards from 1
+	GLint maxUnits, maxLayers;
+	GL_CALL(glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxUnits));
+	GL_CALL(glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers));
+	const size_t layerBytes = std::max<size_t>((size_t)dimensions.x * dimensions.y * format.pixelSize, 1);
+	TextureArray a;
+	a.unit = (GLuint)maxUnits - 1 - (GLuint)arrays.size();
+	a.dimensions = dimensions;
+	a.internalFormat = format.internalFormat;
+	a.layers = (unsigned int)std::max<size_t>(std::min<size_t>(ARRAY_BUDGET / layerBytes, std::min<size_t>((size_t)MAX_ARRAY_LAYERS, (size_t)maxLayers)), 1);
+	a.nextLayer = 0;
+	GLsizei levels = 1;
+	for (unsigned int d = std::max(dimensions.x, dimensions.y); d > 1; d >>= 1)
+		++levels;
+	GL_CALL(glGenTextures(1, &a.name));
+	GL_CALL(glActiveTexture(GL_TEXTURE0 + a.unit));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D_ARRAY, a.name));
+	GL_CALL(glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, a.internalFormat, dimensions.x, dimensions.y, a.layers));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT));
+	if (GLEW_EXT_texture_filter_anisotropic)
+	{
+		GLfloat fLargest;
+		GL_CALL(glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &fLargest));
+		GL_CALL(glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, fLargest));
+	}
+	//The array remains bound to its unit
+	GL_CALL(glActiveTexture(GL_TEXTURE0));
+	arrays.push_back(a);
+	return (unsigned int)arrays.size() - 1;
+}
+GLuint MaterialBuffer::pack(const std::shared_ptr<const Texture> &texture)
+{
+	if (!texture)
+		return INVALID_TEXTURE;
+	auto p = packed.find(texture);
+	if (p != packed.end())
+	{
+		++p->second.references;
+		return p->second.handle;
+	}
+	const std::shared_ptr<const Texture2D> tex2D = std::dynamic_pointer_cast<const Texture2D>(texture);
+	if (!tex2D || texture->getType() != GL_TEXTURE_2D)
+	{
+		fprintf(stderr, "MaterialBuffer::pack(): Texture '%s' is not a GL_TEXTURE_2D, so can't be packed.\n", texture->getReference().c_str());
+		return INVALID_TEXTURE;
+	}
+	const glm::uvec2 dims = tex2D->getDimensions();
+	//Find an array of the same size class with a free layer
+	unsigned int array = 0;
+	for (; array < arrays.size(); ++array)
+	{
+		const TextureArray &a = arrays[array];
+		if (a.dimensions == dims && a.internalFormat == texture->getFormat().internalFormat && (!a.freeLayers.empty() || a.nextLayer < a.layers))
+			break;
+	}
+	if (array == arrays.size())
+		array = createArray(dims, texture->getFormat());
+	if (array == arrays.size())
+		return INVALID_TEXTURE;//All MAX_MATERIAL_ARRAYS arrays are in use
+	TextureArray &a = arrays[array];
+	unsigned int layer;
+	if (!a.freeLayers.empty())
+	{
+		layer = a.freeLayers.back();
+		a.freeLayers.pop_back();
+	}
+	else
+	{
+		layer = a.nextLayer++;
+	}
+	//Copy the base level, then rebuild the array's mipmaps
+	GL_CALL(glCopyImageSubData(texture->getName(), GL_TEXTURE_2D, 0, 0, 0, 0, a.name, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, dims.x, dims.y, 1));
+	GL_CALL(glActiveTexture(GL_TEXTURE0 + a.unit));
+	GL_CALL(glGenerateMipmap(GL_TEXTURE_2D_ARRAY));
+	GL_CALL(glActiveTexture(GL_TEXTURE0));
+	const GLuint handle = (array << 16) | layer;
+	packed.emplace(texture, PackedTexture{ handle, 1 });
+	return handle;
+}
+void MaterialBuffer::release(const std::weak_ptr<const Texture> &texture)
+{
+	auto p = packed.find(texture);
+	assert(p != packed.end());
+	if (--p->second.references == 0)
+	{
+		arrays[p->second.handle >> 16].freeLayers.push_back(p->second.handle & 0xFFFF);
+		packed.erase(p);
+	}
+}
+
+//Comment out this include if not making use of Shaders/ShaderCore
+#include "../shader/Shaders.h"
+#ifdef __Shaders_h__
+bool Shaders::setMaterialBuffer(const std::shared_ptr<MaterialBuffer> &buffer)
+{
+	//Arrays are only ever created, so any array holding a texture of this shader's material is already present
+	for (unsigned int i = 0; i < buffer->getArrayCount(); ++i)
+		addTexture(MaterialBuffer::ARRAY_UNIFORM_NAMES[i], GL_TEXTURE_2D_ARRAY, buffer->getArrayName(i), buffer->getArrayUnit(i));
+	return addBuffer(MATERIAL_UNIFORM_BLOCK_NAME, buffer->getStorage());
+};
+#endif //__Shaders_h__
@@ -0,0 +1,171 @@
+#ifndef __MaterialBuffer_h__
+#define __MaterialBuffer_h__
+
+#include "../shader/ShaderHeader.h"
+#include "../shader/buffer/ShaderStorageBuffer.h"
+#include "../texture/Texture.h"
+#include <glm/glm.hpp>
+#include <climits>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * Shared storage of every Material's properties and textures
+ * Properties live in a single shader storage buffer, indexed by _materialID, which grows as materials are created
+ * Textures are copied into GL_TEXTURE_2D_ARRAYs, one per size class (width, height and internal format)
+ * Each array is bound to a reserved texture unit for the buffer's lifetime, so draws with different materials never change texture bindings
+ * Once all MAX_MATERIAL_ARRAYS arrays are in use, textures of new size classes are instead bound directly to the material's shaders
+ * Usage:
+ *   auto slot = MaterialBuffer::get()->allocate();
+ *   properties.textures.y = slot->addTexture(diffuseTex);
+ *   slot->set(properties);
+ *   shaders->setMaterialBuffer(slot->getBuffer());
+ *   shaders->setMaterialID(slot->getIndex());
+ * @note Within shaders, textures are sampled with materialTexture() (see material.glsl)
+ */
+class MaterialBuffer : public std::enable_shared_from_this<MaterialBuffer>
+{
+public:
+	/**
+	 * Returned by Slot::addTexture() if the texture could neither be packed nor bound directly
+	 */
+	static const GLuint INVALID_TEXTURE = UINT_MAX;
+	/**
+	 * The array index (handle>>16) of textures bound directly, the layer (handle&0xFFFF) indexes TEXTURE_UNIFORM_NAMES
+	 */
+	static const GLuint STANDALONE_ARRAY = MAX_MATERIAL_ARRAYS;
+	/**
+	 * The initial number of materials the storage buffer can hold
+	 */
+	static const unsigned int DEFAULT_CAPACITY = 64;
+	/**
+	 * Texture arrays can't grow without changing their name, so are allocated with a fixed number of layers
+	 * This is the byte budget (of the base level) used to choose that number, arrays of large textures therefore hold fewer layers
+	 */
+	static const size_t ARRAY_BUDGET = 64 << 20;
+	static const unsigned int MAX_ARRAY_LAYERS = 256;
+	/**
+	 * Names of the elements of the sampler array within shaders, of length MAX_MATERIAL_ARRAYS
+	 */
+	static const char *ARRAY_UNIFORM_NAMES[];
+	/**
+	 * Names of the elements of the standalone sampler array within shaders, of length MAX_MATERIAL_TEXTURES
+	 */
+	static const char *TEXTURE_UNIFORM_NAMES[];
+	/**
+	 * A material's index within the buffer, and the packed textures it references
+	 * These are released when destroyed
+	 */
+	class Slot
+	{
+		friend class MaterialBuffer;
+	public:
+		~Slot();
+		Slot(const Slot&) = delete;
+		Slot &operator=(const Slot&) = delete;
+		/**
+		 * Updates the material's properties within the storage buffer
+		 */
+		void set(const MaterialProperties &properties);
+		/**
+		 * Packs the texture into the array of its size class, textures shared by materials are only packed once
+		 * If the arrays are full, the texture is instead held by the slot, to be bound directly (see getStandaloneTextures())
+		 * @return The handle to be stored in MaterialProperties::textures, INVALID_TEXTURE if it could not be packed or bound directly
+		 * @note Packed textures' contents are copied, later changes to the texture are not reflected
+		 * @note Packed textures are not retained, so the source texture can be released once this returns
+		 */
+		GLuint addTexture(const std::shared_ptr<const Texture> &texture);
+		unsigned int getIndex() const { return index; }
+		const std::shared_ptr<MaterialBuffer> &getBuffer() const { return buffer; }
+		/**
+		 * Textures which could not be packed, these must be bound to TEXTURE_UNIFORM_NAMES of the material's shaders
+		 */
+		const std::vector<std::shared_ptr<const Texture>> &getStandaloneTextures() const { return standalone; }
+	private:
+		Slot(std::shared_ptr<MaterialBuffer> buffer, unsigned int index);
+		/**
+		 * Held so that the buffer outlives its slots
+		 */
+		std::shared_ptr<MaterialBuffer> buffer;
+		const unsigned int index;
+		/**
+		 * Packed textures, used to release their layers
+		 */
+		std::vector<std::weak_ptr<const Texture>> textures;
+		std::vector<std::shared_ptr<const Texture>> standalone;
+	};
+	struct Utilisation
+	{
+		unsigned int materials, materialCapacity;
+		unsigned int arrays;
+		unsigned int layersUsed, layerCapacity;
+	};
+	/**
+	 * Returns the shared buffer, creating it if necessary
+	 * The buffer is destroyed when the final slot is released
+	 */
+	static std::shared_ptr<MaterialBuffer> get();
+	/**
+	 * Prints the utilisation of the live buffer, as CSV
+	 */
+	static void report(FILE *out = stdout);
+	~MaterialBuffer();
+	MaterialBuffer(const MaterialBuffer&) = delete;
+	MaterialBuffer &operator=(const MaterialBuffer&) = delete;
+	/**
+	 * Allocates a material, its properties are initially the defaults of MaterialProperties
+	 */
+	std::shared_ptr<Slot> allocate();
+	Utilisation getUtilisation() const;
+	const std::shared_ptr<ShaderStorageBuffer> &getStorage() const { return storage; }
+	/**
+	 * @return The number of texture arrays which have been created, their indices are contiguous from 0
+	 */
+	unsigned int getArrayCount() const { return (unsigned int)arrays.size(); }
+	GLuint getArrayName(unsigned int array) const { return arrays[array].name; }
+	GLuint getArrayUnit(unsigned int array) const { return arrays[array].unit; }
+private:
+	MaterialBuffer();
+	struct TextureArray
+	{
+		GLuint name;
+		GLuint unit;
+		glm::uvec2 dimensions;
+		GLenum internalFormat;
+		unsigned int layers;
+		/**
+		 * Layers beyond this have never been used
+		 */
+		unsigned int nextLayer;
+		std::vector<unsigned int> freeLayers;
+	};
+	struct PackedTexture
+	{
+		GLuint handle;
+		unsigned int references;
+	};
+	/**
+	 * Creates an array for the size class, bound to its reserved texture unit
+	 * @return The index of the new array, or arrays.size() if MAX_MATERIAL_ARRAYS has been reached
+	 */
+	unsigned int createArray(const glm::uvec2 &dimensions, const Texture::Format &format);
+	GLuint pack(const std::shared_ptr<const Texture> &texture);
+	void release(const std::weak_ptr<const Texture> &texture);
+	static std::weak_ptr<MaterialBuffer> instance;
+	std::shared_ptr<ShaderStorageBuffer> storage;
+	/**
+	 * Host copy of the storage buffer, used to repopulate it when it grows
+	 */
+	std::vector<MaterialProperties> properties;
+	std::vector<unsigned int> freeSlots;
+	std::vector<TextureArray> arrays;
+	/**
+	 * Packed textures, by source texture
+	 * Keys are weak, so sources are freed once packed, their control blocks outlive them so a key can't be reused by a new texture
+	 */
+	std::map<std::weak_ptr<const Texture>, PackedTexture, std::owner_less<std::weak_ptr<const Texture>>> packed;
+};
+
+#endif //__MaterialBuffer_h__
@@ -4,11 +4,14 @@
 
 void Mesh::render(glm::mat4 &transform, const unsigned int &shaderIndex) const
 {
-	if (!visible)
+	if (!visible || !data->materials[materialIndex]->isRenderable())
 		return;
 	data->materials[materialIndex]->use(transform, shaderIndex, false);
+	data->materials[materialIndex]->getShaders(shaderIndex)->overrideMeshID(index);
 	//Render
-	GL_CALL(glDrawElements(faceType, faceSize, GL_UNSIGNED_INT, (void *)(byteOffset)));
+	const auto &geometry = data->getGeometry(shaderIndex);
+	if (geometry && faceSize)
+		geometry->draw(faceType, byteOffset / sizeof(unsigned int), faceSize);
 }
 BoundingBox3D Mesh::calculateBoundingBox(glm::mat4 transform) const
 {
@@ -14,15 +14,28 @@ class Mesh
 {
 	friend class ModelNode;
 public:
-	static std::shared_ptr<Mesh> make_shared(const char *name, std::shared_ptr<ModelData> data, unsigned int fo, unsigned int fc, unsigned int mi, GLenum ft, unsigned int boneOffset = 0, unsigned int boneCount = 0)
+	static std::shared_ptr<Mesh> make_shared(const char *name, std::shared_ptr<ModelData> data, unsigned int index, unsigned int fo, unsigned int fc, unsigned int mi, GLenum ft, unsigned int boneOffset = 0, unsigned int boneCount = 0)
 	{
-		std::shared_ptr<Mesh> rtn = std::shared_ptr<Mesh>(new Mesh(name, data, fo, fc, mi, ft, boneOffset, boneCount));
+		std::shared_ptr<Mesh> rtn = std::shared_ptr<Mesh>(new Mesh(name, data, index, fo, fc, mi, ft, boneOffset, boneCount));
 		rtn->me = rtn;
 		return rtn;
 	}
 	void render(glm::mat4 &transform, const unsigned int &shaderIndex = UINT_MAX) const;
 	BoundingBox3D calculateBoundingBox(glm::mat4 transform) const;
 	std::string getName() const { return name; }
+	/**
+	 * @return The mesh's index within its Model, unique for meshes of the same model
+	 */
+	unsigned int getIndex() const { return index; }
+	/**
+	 * @return Offset of the mesh's first index within ModelData::faces
+	 */
+	unsigned int getFirstFace() const { return byteOffset / sizeof(unsigned int); }
+	/**
+	 * @return The number of indices within ModelData::faces belonging to the mesh
+	 */
+	unsigned int getFaceCount() const { return faceSize; }
+	GLenum getFaceType() const { return faceType; }
 	void setVisible(bool isVisible) { this->visible = isVisible; }
 	bool getVisible() const { return this->visible; }
 private:
@@ -31,8 +44,9 @@ private:
 	{
 		return me.lock();
 	}
-	Mesh(const char *name, std::shared_ptr<ModelData> data, unsigned int bo, unsigned int fs, unsigned int mi, GLenum ft, unsigned int boneOffset = 0, unsigned int boneCount = 0)
+	Mesh(const char *name, std::shared_ptr<ModelData> data, unsigned int index, unsigned int bo, unsigned int fs, unsigned int mi, GLenum ft, unsigned int boneOffset = 0, unsigned int boneCount = 0)
 		: name(name)
+		, index(index)
 		, byteOffset(bo)
 		, faceSize(fs)
 		, materialIndex(mi)
@@ -45,6 +59,7 @@ private:
 		this->parent = parent;
 	}
 	std::string name;
+	unsigned int index;
 	unsigned int byteOffset;
 	unsigned int faceSize;
 	unsigned int materialIndex;
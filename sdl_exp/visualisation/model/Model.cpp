@@ -9,6 +9,7 @@
 #include <glm/gtx/hash.hpp>
 #include <filesystem>
 #include "../texture/Texture2D.h"
+#include "../util/Profiler.h"
 
 
 const float Model::DEFAULT_KEYFRAME_TRANSITION_DURATION = 0.4f;//seconds
@@ -67,9 +68,6 @@ void Model::freeModel()
     root.reset();
     //Clear data
     data.reset();
-    //Release VBOs
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &fbo);
 }
 void Model::reload()
 {
@@ -111,6 +109,7 @@ VFCcount countVertices(const struct aiScene* scene, const struct aiNode* nd)
 		const struct aiMesh* mesh = scene->mMeshes[nd->mMeshes[n]];
 		vfc.v += mesh->mNumVertices;
 		vfc.b += mesh->mNumBones;
+		++vfc.m;
         for (unsigned int t = 0; t < mesh->mNumFaces; ++t) {
             vfc.f += mesh->mFaces[t].mNumIndices;
 #ifdef _DEBUG
@@ -287,6 +286,7 @@ std::shared_ptr<ModelNode> Model::buildHierarchy(const struct aiScene* scene, co
 		std::shared_ptr<Mesh> mesh = Mesh::make_shared(
 			_aiMesh->mName.C_Str(),
 			this->data,
+			vfc.m++,
 			vfc.f*sizeof(unsigned int),
 			_aiMesh->mNumFaces*mNumFaceIndices,
 			_aiMesh->mMaterialIndex,
@@ -416,11 +416,10 @@ void Model::loadModel()
     if (scene->HasTextures()){ fprintf(stderr, "Model '%s' has embedded textures, these are currently unsupported.\n", modelPath.c_str()); }
 	std::string modelFolder = su::getFolderFromPath(modelPath);
     //Copy materials
-	materialBuffer = std::make_shared<UniformBuffer>(sizeof(MaterialProperties)*data->materialsSize);
     for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
     {
 		//Create new blank material
-		data->materials[i] = std::make_shared<Material>(materialBuffer, i, "", boneWeights.count!=0);
+		data->materials[i] = std::make_shared<Material>("", boneWeights.count!=0);
 		//Setup basic material properties
 		au::getMaterialProps(data->materials[i], scene->mMaterials[i]);
 		//Textures
@@ -458,86 +457,44 @@ void Model::loadModel()
 	}
 
 	printf("\rLoading Model: %s [Parsing Assimp Filling Buffers]       ", su::getFilenameFromPath(modelPath).c_str());
-    //Calc VBO size
-    size_t vboSize = 0;
-    vboSize += this->vfc.v*sizeof(glm::vec3);
-    if (data->normals)
-        vboSize += this->vfc.v*sizeof(glm::vec3);
-    if (data->colors)
-        vboSize += this->vfc.v*sizeof(glm::vec4);
-    if (data->texcoords)
-        vboSize += this->vfc.v*sizeof(glm::vec3);
-	if (data->bonesSize)
-	{
-		vboSize += this->vfc.v*sizeof(glm::uvec4);
-		vboSize += this->vfc.v*sizeof(glm::vec4);
-	}
-
-    //Build VBO from data
-    GL_CALL(glGenBuffers(1, &vbo));
-    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
-    GL_CALL(glBufferData(GL_ARRAY_BUFFER, vboSize, nullptr, GL_STATIC_DRAW));
-    //Copy each vertex attrib to subBuffer location
-    vboSize = 0;
-    GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, vboSize, this->vfc.v*sizeof(glm::vec3), data->vertices));
-    vboSize += this->vfc.v*sizeof(glm::vec3);
-    if (data->normals)
-    {
-        GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, vboSize, this->vfc.v*sizeof(glm::vec3), data->normals));
-        normals.offset = (unsigned int)vboSize;
-        vboSize += this->vfc.v*sizeof(glm::vec3);
-    }
-    if (data->colors)
-    {
-        GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, vboSize, this->vfc.v*sizeof(glm::vec4), data->colors));
-		colors.offset = (unsigned int)vboSize;
-        vboSize += this->vfc.v*sizeof(glm::vec4);
-    }
-    if (data->texcoords)
-    {
-        GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, vboSize, this->vfc.v*sizeof(glm::vec3), data->texcoords));
-		texcoords.offset = (unsigned int)vboSize;
-        vboSize += this->vfc.v*sizeof(glm::vec3);
-	}
+	//Models with the same attributes share an arena, and hence their buffers
+	const GeometryArena::Layout layout = {
+		3,
+		data->normals ? 3u : 0u,
+		data->colors ? 4u : 0u,
+		data->texcoords ? 3u : 0u,
+		data->bonesSize > 0
+	};
+	data->geometry = GeometryArena::get(layout)->allocate(this->vfc.v, this->vfc.f);
+	if (!data->geometry)
+		return;
+	std::vector<glm::uvec4> u_buff;
+	std::vector<glm::vec4> v_buff;
 	if (data->bonesSize)
 	{
 		assert(VertexBoneData::COUNT == 4);//Required for this shader config
-		glm::uvec4 *u_buff = (glm::uvec4 *)malloc(this->vfc.v*sizeof(glm::uvec4));
-		glm::vec4 *v_buff = (glm::vec4 *)malloc(this->vfc.v*sizeof(glm::vec4));
+		u_buff.resize(this->vfc.v);
+		v_buff.resize(this->vfc.v);
 		for (unsigned int i = 0; i < this->vfc.v;++i)
 		{
 			u_buff[i] = *reinterpret_cast<const glm::uvec4*>(data->boneData[i].BoneIds());
 			v_buff[i] = *reinterpret_cast<const glm::vec4*>(data->boneData[i].Weights());
 		}
-		GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, vboSize, this->vfc.v*sizeof(glm::uvec4), u_buff));
-		boneIDs.offset = (unsigned int)vboSize;
-		vboSize += this->vfc.v*sizeof(glm::uvec4);
-		GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, vboSize, this->vfc.v*sizeof(glm::vec4), v_buff));
-		boneWeights.offset = (unsigned int)vboSize;
-		vboSize += this->vfc.v*sizeof(glm::vec4);
-		free(u_buff);
-		free(v_buff);
-		boneBuffer = std::make_shared<UniformBuffer>(sizeof(glm::mat4)*this->vfc.b, data->computedTransforms);
-	}
-    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
-    //Store VBO is VADs
-    positions.vbo = vbo;
-    if (data->normals)
-        normals.vbo = vbo;
-    if (data->colors)
-        colors.vbo = vbo;
-    if (data->texcoords)
-        texcoords.vbo = vbo;
-	if (data->bonesSize)
-	{
-		boneIDs.vbo = vbo;
-		boneWeights.vbo = vbo;
+		boneBuffer = UniformBlockAllocator::get()->allocate(sizeof(glm::mat4)*this->vfc.b);
+		if (boneBuffer)
+			boneBuffer->setData(data->computedTransforms);
 	}
-    //Build FBO
-    GL_CALL(glGenBuffers(1, &fbo));
-    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fbo));
-    GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->vfc.f*sizeof(unsigned int), data->faces, GL_STATIC_DRAW));
-    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+	data->geometry->setVertices(data->vertices, data->normals, data->colors, data->texcoords, u_buff.data(), v_buff.data());
+	data->geometry->setIndices(data->faces);
+	//Store arena in VADs
+	const GeometryArena &arena = data->geometry->getArena();
+	arena.attach(GeometryArena::POSITION, positions);
+	arena.attach(GeometryArena::NORMAL, normals);
+	arena.attach(GeometryArena::COLOR, colors);
+	arena.attach(GeometryArena::TEXCOORD, texcoords);
+	arena.attach(GeometryArena::BONE_ID, boneIDs);
+	arena.attach(GeometryArena::BONE_WEIGHT, boneWeights);
+	const GLuint fbo = arena.getIndexBuffer();
 
 	//Check vertex weights make sense
 	for (unsigned int i = 0; i < data->verticesSize;++i)
@@ -575,7 +532,6 @@ void Model::loadModel()
 			s->addGenericAttributeDetail("_boneWeights", boneWeights);
 			s->addBuffer("_bones", boneBuffer);
 		}
-		s->setMaterialBuffer(materialBuffer);//Redundant (Material re-sets this when we set custom shaders).
 	}
 	for (unsigned int i = 0; i < data->materialsSize; ++i)
 	{
@@ -633,15 +589,46 @@ unsigned int Model::loadExternalAnimations(const std::string &directory, const s
 //Rendering
 void Model::update(float time)
 {
-#if _DEBUG
-	if (!this->root)
-	{
+	this->animationTime.set(time);
+	//Bones are posed by interpolateTick() at the interpolated time, which the renderer owns
+	if (!this->animationTime.isTicked())
+		this->posePending = true;
+}
+void Model::prepare()
+{
+	if (!this->posePending)
 		return;
+	this->posePending = false;
+	if (this->root && !this->data->animations.empty())
+	{
+		Profiler::Scope scope("Model::update");
+		updateBoneTransforms(this->animationTime.get());
 	}
-#endif
-	updateBoneTransforms(time);
 }
-void Model::render(unsigned int shaderIndex) const
+void Model::commitTick()
+{
+	this->location.commit();
+	this->rotation.commit();
+	this->animationTime.commit();
+}
+void Model::interpolateTick(float alpha)
+{
+	this->location.interpolate(alpha);
+	this->rotation.interpolate(alpha);
+	this->animationTime.interpolate(alpha);
+	if (this->animationTime.isTicked() && this->root && !this->data->animations.empty())
+	{
+		Profiler::Scope scope("Model::update");
+		updateBoneTransforms(this->animationTime.get());
+	}
+}
+void Model::resetTicks()
+{
+	this->location.reset();
+	this->rotation.reset();
+	this->animationTime.reset();
+}
+void Model::render(unsigned int shaderIndex)
 {
 #if _DEBUG
     static bool aborted = false;
@@ -653,7 +640,13 @@ void Model::render(unsigned int shaderIndex) const
         return;
     }
 #endif
-
+	//Models which aren't registered with a scene are posed here
+	prepare();
+	if (bonesDirty && boneBuffer)
+	{
+		boneBuffer->setData(data->computedTransforms, sizeof(glm::mat4)*data->bonesSize);
+		bonesDirty = false;
+	}
 	for (unsigned int i = 0; i < data->materialsSize; ++i)
 		data->materials[i]->prepare(shaderIndex);
 
@@ -666,6 +659,47 @@ void Model::render(unsigned int shaderIndex) const
 	for (unsigned int i = 0; i < data->materialsSize && i < 1; ++i)
 		data->materials[i]->clear(shaderIndex);
 }
+void Model::usePositionStream(unsigned int shaderIndex)
+{
+	if (!data || !data->geometry)
+		return;
+	Shaders::VertexAttributeDetail compactPositions = positions, compactBoneIDs = boneIDs, compactBoneWeights = boneWeights;
+	if (!data->positionGeometry)
+	{
+		const GeometryArena::Layout layout = { 3, 0, 0, 0, data->bonesSize > 0 };
+		data->positionGeometry = GeometryArena::get(layout)->allocate(this->vfc.v, this->vfc.f);
+		if (!data->positionGeometry)
+			return;
+		std::vector<glm::uvec4> u_buff;
+		std::vector<glm::vec4> v_buff;
+		if (data->bonesSize)
+		{
+			u_buff.resize(this->vfc.v);
+			v_buff.resize(this->vfc.v);
+			for (unsigned int i = 0; i < this->vfc.v; ++i)
+			{
+				u_buff[i] = *reinterpret_cast<const glm::uvec4*>(data->boneData[i].BoneIds());
+				v_buff[i] = *reinterpret_cast<const glm::vec4*>(data->boneData[i].Weights());
+			}
+		}
+		data->positionGeometry->setVertices(data->vertices, nullptr, nullptr, nullptr, u_buff.data(), v_buff.data());
+		data->positionGeometry->setIndices(data->faces);
+	}
+	const GeometryArena &arena = data->positionGeometry->getArena();
+	arena.attach(GeometryArena::POSITION, compactPositions);
+	//Materials draw with their own clones of the model's shaders, so update those too
+	auto s = getShaders(shaderIndex);
+	s->setPositionsAttributeDetail(compactPositions);
+	s->setFaceVBO(arena.getIndexBuffer());
+	if (data->bonesSize)
+	{
+		arena.attach(GeometryArena::BONE_ID, compactBoneIDs);
+		arena.attach(GeometryArena::BONE_WEIGHT, compactBoneWeights);
+		s->addGenericAttributeDetail("_boneIDs", compactBoneIDs);
+		s->addGenericAttributeDetail("_boneWeights", compactBoneWeights);
+	}
+	data->positionStreams.insert(shaderIndex);
+}
 void Model::renderSkeleton()
 {
 #if _DEBUG
@@ -870,8 +904,8 @@ void Model::updateBoneTransforms(float seconds)
 			mTransitioningKeyframes = false;
 		}
 	}
-	//Update bones on GPU
-	boneBuffer->setData(data->computedTransforms, sizeof(glm::mat4)*data->bonesSize);
+	//Bones are uploaded by the next render(), so that posing doesn't require the GL context (e.g. within a job)
+	bonesDirty = true;
 	{
 		glm::mat4 rootTransform = glm::mat4(1);
 		for (auto a = data->rootChain.begin(); a != data->rootChain.end(); ++a)
@@ -987,11 +1021,13 @@ void Model::computeInverseRootTransform()
 glm::mat4 Model::getModelMat() const
 {
 	//Apply world transforms (in reverse order that we wish for them to be applied)
-	glm::mat4 modelMat = glm::translate(glm::mat4(1), this->location + this->mAnimationLocationOffset);
+	const glm::vec3 &location = this->location.get();
+	const glm::vec4 &rotation = this->rotation.get();
+	glm::mat4 modelMat = glm::translate(glm::mat4(1), location + this->mAnimationLocationOffset);
 
 	//Check we actually have a rotation (providing no axis == error)
-	if ((this->rotation.x != 0 || this->rotation.y != 0 || this->rotation.z != 0) && this->rotation.w != 0)
-		modelMat = glm::rotate(modelMat, glm::radians(this->rotation.w), glm::vec3(this->rotation));
+	if ((rotation.x != 0 || rotation.y != 0 || rotation.z != 0) && rotation.w != 0)
+		modelMat = glm::rotate(modelMat, glm::radians(rotation.w), glm::vec3(rotation));
 
 	//Only bother scaling if we were asked to
 	if (this->scaleFactor != 1.0f)
@@ -2,29 +2,36 @@
 #define __Model_h__
 #include "glm/glm.hpp"
 #include <memory>
+#include <set>
 #include "ModelNode.h"
 #include "../shader/Shaders.h"
 #include "Material.h"
 #include "BoundingBox.h"
 #include "Animation.h"
-#include "../shader/buffer/UniformBuffer.h"
+#include "../shader/buffer/UniformBlockAllocator.h"
 #include <assimp/config.h>
 #include "../shader/ShadersVec.h"
 #include "../Draw.h"
+#include "../util/Interpolated.h"
+#include "GeometryArena.h"
+
+class MeshBVH;
 
 struct VFCcount
 {
-	VFCcount(int i = 1) :v(0), f(0), c(i), b(0){}
+	VFCcount(int i = 1) :v(0), f(0), c(i), b(0), m(0){}
 	unsigned int v;//vertices
 	unsigned int f;//faces
 	unsigned int c;//components??
 	unsigned int b;//bones
+	unsigned int m;//meshes
 	VFCcount &operator +=(const VFCcount &rhs)
 	{
 		v += rhs.v;
 		f += rhs.f;
 		c += rhs.c;
 		b += rhs.b;
+		m += rhs.m;
 		return *this;
 	}
 };
@@ -166,6 +173,19 @@ struct ModelData
 
 	//Component attributes
 	unsigned int *faces;
+	/**
+	 * The model's vertices and faces, within the shared arena of its vertex layout
+	 */
+	std::shared_ptr<GeometryArena::Allocation> geometry;
+	/**
+	 * Positions (and bones) and faces only, drawn by the shader indices within positionStreams
+	 */
+	std::shared_ptr<GeometryArena::Allocation> positionGeometry;
+	std::set<unsigned int> positionStreams;
+	/**
+	 * @return The allocation to draw with the shader index
+	 */
+	const std::shared_ptr<GeometryArena::Allocation> &getGeometry(unsigned int shaderIndex) const { return positionStreams.count(shaderIndex) ? positionGeometry : geometry; }
 	glm::mat4 *transforms;//bind pose transform
 	glm::mat4 *_transforms;//last animation pose transform
 	std::vector<unsigned int> rootChain;
@@ -202,16 +222,48 @@ public:
 	*/
 	void reload() override;
 	//Rendering methods
+	/**
+	 * Sets the animation time the model's bones are posed at
+	 * @param time Animation time in seconds
+	 * @note The bones are posed by prepare(), which scenes call in parallel for their registered entities once update() returns, else by the next render()
+	 * @note When the visualisation runs a fixed timestep, the bones are instead posed at the interpolated time by interpolateTick()
+	 */
 	void update(float time);
-	void render(unsigned int shaderIndex = UINT_MAX) const;
+	/**
+	 * Poses the model's bones, if the animation time has been updated since they were last posed
+	 * @note This doesn't use the GL context, so may be called from a job, the posed bones are uploaded by the next render()
+	 */
+	void prepare() override;
+	void render(unsigned int shaderIndex = UINT_MAX);
+	/**
+	 * Draws the shaders at shaderIndex from a compact copy of the model's positions (and bone IDs and weights), allocated from a position only GeometryArena
+	 * Depth only shaders (built with DEPTH_ONLY, e.g. Stock::Shaders::BONE_DEPTH) then fetch only the attributes they read
+	 * @see DepthPrePass
+	 */
+	void usePositionStream(unsigned int shaderIndex);
 	void renderSkeleton();
-    void setLocation(glm::vec3 location){ this->location = location; }
-    void setRotation(glm::vec4 rotation){ this->rotation = rotation; }
-    glm::vec3 getLocation() const{ return location; }
-    glm::vec4 getRotation() const{ return rotation; }
+    void setLocation(glm::vec3 location){ this->location.set(location); }
+    void setRotation(glm::vec4 rotation){ this->rotation.set(rotation); }
+    glm::vec3 getLocation() const{ return location.getSimulated(); }
+    glm::vec4 getRotation() const{ return rotation.getSimulated(); }
+	void commitTick() override;
+	void interpolateTick(float alpha) override;
+	void resetTicks() override;
 	BoundingBox3D getBoundingBox() const { return boundingBox; }
 	std::unique_ptr<ShadersVec> getShaders(unsigned int shaderIndex = 0) const;
 	std::shared_ptr<Material> getMaterial(unsigned int materialIndex = 0) const;
+	/**
+	 * @return The number of meshes within the model's hierarchy, Mesh::getIndex() is less than this
+	 */
+	unsigned int getMeshCount() const { return vfc.m; }
+	/**
+	 * Builds a BVH of the model's triangles, in bind pose and model space, for CPU ray queries
+	 * Hits report the index of the mesh hit as their element
+	 * @return nullptr if the model failed to load
+	 * @note This only reads the model's CPU copy of its geometry, so may be called from a job
+	 * @see RayCaster::add()
+	 */
+	std::shared_ptr<MeshBVH> buildBVH() const;
 	unsigned int loadExternalAnimation(const std::string &path);
 	/**
 	 * Attempts to load animations from all files in the named directory
@@ -305,11 +357,9 @@ private:
 	VFCcount vfc;
 	const std::string modelPath;
     const float loadScale;//Scale that vertices are scaled to at model load
-	//VBOs
-	GLuint vbo;
-	GLuint fbo;
-	glm::vec3 location = glm::vec3(0);
-	glm::vec4 rotation = glm::vec4(0);
+	Interpolated<glm::vec3> location = glm::vec3(0);
+	Interpolated<glm::vec4, LerpAxisAngle> rotation = glm::vec4(0);
+	Interpolated<float> animationTime = 0.0f;
 	float scaleFactor = 1.0f;
 
 	/**
@@ -336,8 +386,18 @@ private:
 	* Holds information for binding the bone weights attribute
 	*/
 	Shaders::VertexAttributeDetail boneWeights;
-	std::shared_ptr<UniformBuffer> boneBuffer;
-	std::shared_ptr<UniformBuffer> materialBuffer;
+	/**
+	 * Sub allocated from the shared UniformBlockAllocator, so that many animated models don't exhaust uniform binding points
+	 */
+	std::shared_ptr<UniformBlock> boneBuffer;
+	/**
+	 * Set by update(), until prepare() has posed the bones at the new animation time
+	 */
+	bool posePending = false;
+	/**
+	 * Set when bones have been posed, but not yet uploaded to boneBuffer
+	 */
+	bool bonesDirty = false;
 	/**
 	 * Custom shaders, shared by all materials
 	 * e.g. for shadow etc
@@ -348,6 +408,9 @@ private:
 	const glm::mat4 *projMatPtr;
 	GLuint lightsBufferBindPt;
 public:
+	/**
+	 * @return The transform applied when rendering, from model to world space
+	 */
 	glm::mat4 getModelMat() const;
 	/**
 	* Sets the pointer from which the View matrix should be loaded from
@@ -39,7 +39,15 @@ bool BackBuffer::_useStatic(const bool &doClear, const glm::vec3 &clearColor)
     if (auto o = overrideBuffer.lock())
     {
         if (o->use())
+        {
+            //Clear as the native back buffer would, so that passes sharing the back buffer (e.g. after a DepthPrePass) aren't cleared
+            if (doClear)
+            {
+                GL_CALL(glClearColor(clearColor.x, clearColor.y, clearColor.z, 1));
+                GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+            }
             return true;
+        }
         fprintf(stderr, "BackBuffer override failed, reverting to FrameBuffer 0.\n");
     }
     GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, NAME));
@@ -0,0 +1,96 @@
+#include "DeferredLightingPass.h"
+#include <vector>
+#include "../model/MaterialBuffer.h"
+
+namespace
+{
+	const char *BIN_SHADER_PATH = "tile_lights.comp";
+	const char *TILE_LIGHTS_BLOCK_NAME = "_tileLights";
+	const char *INVERSE_PROJECTION_UNIFORM_NAME = "_inverseProjection";
+}
+
+DeferredLightingPass::DeferredLightingPass(std::shared_ptr<GBufferPass> gBuffer, std::shared_ptr<LightsBuffer> lights, const glm::mat4 *projMatPtr, std::shared_ptr<FBuffer> target, bool shadowMaps)
+	: RenderPass(target)
+	, gBuffer(gBuffer)
+	, lights(lights)
+	, projMatPtr(projMatPtr)
+	, tiles(0)
+	, tileLights(std::make_shared<ShaderStorageBuffer>(sizeof(GLuint)))
+	, materials(MaterialBuffer::get())
+{
+	//Lights are read from whichever layout the lights buffer uploads all of them to
+	Shaders::Defines defines;
+	if (lights->isClustered())
+		defines["CLUSTERED"] = "";
+	binShader = std::make_unique<ComputeShader>(BIN_SHADER_PATH, defines);
+	if (shadowMaps)
+		defines["SHADOW_MAPS"] = "";
+	lighting = std::make_shared<Shaders>(Stock::Shaders::DEFERRED_LIGHTING, defines);
+	auto fb = gBuffer->getGBuffer();
+	binShader->addTexture("_gDepth", fb->getDepthTexture());
+	binShader->addDynamicUniform(INVERSE_PROJECTION_UNIFORM_NAME, &inverseProjection);
+	binShader->addBuffer(TILE_LIGHTS_BLOCK_NAME, tileLights);
+	if (lights->isClustered())
+	{
+		const LightClusters &clusters = lights->getClusters();
+		binShader->addBuffer(Shaders::LIGHT_STORAGE_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, clusters.getLightsBindPoint());
+		binShader->addBuffer(Shaders::LIGHT_CLUSTERS_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, clusters.getClustersBindPoint());
+	}
+	else
+		binShader->addBuffer(Shaders::LIGHT_UNIFORM_BLOCK_NAME, GL_UNIFORM_BUFFER, lights->getBufferBindPoint());
+	lighting->addTexture("_gAlbedo", fb->getColorTexture(0));
+	lighting->addTexture("_gSurface", fb->getColorTexture(1));
+	lighting->addTexture("_gDepth", fb->getDepthTexture());
+	lighting->addDynamicUniform(INVERSE_PROJECTION_UNIFORM_NAME, &inverseProjection);
+	lighting->addBuffer(TILE_LIGHTS_BLOCK_NAME, tileLights);
+	lighting->setLightsBuffer(lights->getBufferBindPoint());
+	lighting->setMaterialBuffer(materials);
+}
+void DeferredLightingPass::render()
+{
+	auto fb = gBuffer->getGBuffer();
+	const glm::uvec2 dims = fb->getDimensions();
+	const glm::uvec2 t = (dims + glm::uvec2(TILE_SIZE - 1)) / TILE_SIZE;
+	if (t != tiles)
+	{
+		tiles = t;
+		tileLights->setData(nullptr, tiles.x * tiles.y * (MAX_LIGHTS_PER_TILE + 1) * sizeof(GLuint));
+	}
+	if (!tiles.x || !tiles.y)
+		return;
+	if (projMatPtr)
+		inverseProjection = glm::inverse(*projMatPtr);
+	binShader->launch(tiles);
+	//Tile lists must be written before the lighting pass reads them
+	GL_CALL(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+	//Write the G-buffer's depth to the target
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GL_CALL(glEnable(GL_DEPTH_TEST));
+	GL_CALL(glDepthFunc(GL_ALWAYS));
+	GL_CALL(glDepthMask(GL_TRUE));
+	lighting->useProgram();
+	GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 3));
+	lighting->clearProgram();
+	GL_CALL(glDepthFunc(GL_LESS));
+	if (!depthTest)
+	{
+		GL_CALL(glDisable(GL_DEPTH_TEST));
+	}
+}
+float DeferredLightingPass::getMeanLightsPerTile()
+{
+	const unsigned int tileCount = tiles.x * tiles.y;
+	if (!tileCount)
+		return 0;
+	std::vector<GLuint> data(tileCount * (MAX_LIGHTS_PER_TILE + 1));
+	tileLights->getData(data.data(), data.size() * sizeof(GLuint), 0);
+	unsigned long long lightsCount = 0;
+	unsigned int litTiles = 0;
+	for (unsigned int i = 0; i < tileCount; ++i)
+	{
+		const GLuint count = data[i * (MAX_LIGHTS_PER_TILE + 1)];
+		lightsCount += count;
+		litTiles += count ? 1 : 0;
+	}
+	return litTiles ? lightsCount / (float)litTiles : 0;
+}
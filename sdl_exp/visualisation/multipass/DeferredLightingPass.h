@@ -0,0 +1,74 @@
+#ifndef __DeferredLightingPass_h__
+#define __DeferredLightingPass_h__
+#include <memory>
+#include "RenderPass.h"
+#include "GBufferPass.h"
+#include "BackBuffer.h"
+#include "../shader/Shaders.h"
+#include "../shader/ComputeShader.h"
+#include "../shader/buffer/ShaderStorageBuffer.h"
+#include "../shader/lights/LightsBuffer.h"
+
+class MaterialBuffer;
+
+/**
+ * Lighting pass of deferred shading, lights the G-buffer of a GBufferPass into the target
+ * tile_lights.comp first bins the lights into 16x16 pixel tiles, bounded by the depth range of each tile
+ * A single full screen draw (deferred_lighting.frag) then lights each pixel by its tile's lights, with the same phong model as material.frag
+ * The G-buffer's depth is written to the target, so forward passes (e.g. light markers, OITPass) may follow
+ * @note The G-buffer must have the same dimensions as the target
+ */
+class DeferredLightingPass : public RenderPass
+{
+public:
+	/**
+	 * Must match TILE_SIZE in include/deferred.glsl
+	 */
+	static const unsigned int TILE_SIZE = 16;
+	/**
+	 * Lights beyond this many within a single tile are dropped
+	 * @note Must match TILE_MAX_LIGHTS in include/deferred.glsl
+	 */
+	static const unsigned int MAX_LIGHTS_PER_TILE = 255;
+	/**
+	 * @param gBuffer The pass which renders the G-buffer, it must be rendered before this pass
+	 * @param lights The lights, if clustered lighting is to be used it must be enabled before construction
+	 * @param projMatPtr The camera's projection matrix, which the G-buffer was rendered with
+	 * @param target The FrameBuffer to receive the lit image
+	 * @param shadowMaps If true, shadows are applied from a ShadowPass, pass this to ShadowPass::addReceiver() with shader index 0
+	 */
+	DeferredLightingPass(std::shared_ptr<GBufferPass> gBuffer, std::shared_ptr<LightsBuffer> lights, const glm::mat4 *projMatPtr, std::shared_ptr<FBuffer> target = std::make_shared<BackBuffer>(), bool shadowMaps = false);
+	/**
+	 * Returns the lighting shader, permitting ShadowPass::addReceiver()
+	 */
+	std::shared_ptr<Shaders> getShaders(unsigned int index = 0) const { return lighting; }
+	/**
+	 * Reads back the tiles' light lists of the most recent render()
+	 * @return The mean number of lights per tile, over tiles which received lights
+	 * @note This stalls the pipeline, it is intended for reporting
+	 */
+	float getMeanLightsPerTile();
+protected:
+	/**
+	 * Bins the lights into tiles, then lights the G-buffer
+	 */
+	void render() override;
+private:
+	std::shared_ptr<GBufferPass> gBuffer;
+	std::shared_ptr<LightsBuffer> lights;
+	const glm::mat4 *projMatPtr;
+	glm::mat4 inverseProjection;
+	/**
+	 * The number of tiles along each axis, the tile buffer is reallocated when this changes
+	 */
+	glm::uvec2 tiles;
+	std::shared_ptr<ShaderStorageBuffer> tileLights;
+	/**
+	 * Held so that the material IDs within the G-buffer remain valid
+	 */
+	std::shared_ptr<MaterialBuffer> materials;
+	std::unique_ptr<ComputeShader> binShader;
+	std::shared_ptr<Shaders> lighting;
+};
+
+#endif //__DeferredLightingPass_h__
@@ -0,0 +1,61 @@
+#include "DepthPrePass.h"
+#include "FrameBuffer.h"
+#include "../model/Material.h"
+
+DepthPrePass::DepthPrePass(std::shared_ptr<FBuffer> target)
+	: RenderPass(target)
+	, nextID(0)
+	, clearTarget(false)
+{
+	//The colour passes share the FrameBuffer, so must not clear the depth written by the pre-pass
+	if (auto fb = std::dynamic_pointer_cast<FrameBuffer>(target))
+	{
+		clearTarget = fb->getDoClear();
+		fb->setDoClear(false);
+	}
+}
+unsigned int DepthPrePass::addOccluder(std::function<void()> render)
+{
+	occluders.emplace(nextID, render);
+	return nextID++;
+}
+void DepthPrePass::removeOccluder(unsigned int id)
+{
+	occluders.erase(id);
+}
+void DepthPrePass::executeRender()
+{
+	if (!clearTarget)
+	{
+		RenderPass::executeRender();
+		return;
+	}
+	auto fb = std::static_pointer_cast<FrameBuffer>(getFrameBuffer());
+	fb->setDoClear(true);
+	RenderPass::executeRender();
+	fb->setDoClear(false);
+}
+void DepthPrePass::render()
+{
+	GL_CALL(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+	GL_CALL(glEnable(GL_DEPTH_TEST));
+	GL_CALL(glDepthMask(GL_TRUE));
+	GL_CALL(glDepthFunc(GL_LESS));
+	//Transparent surfaces must not occlude those behind them
+	const Material::RenderFilter previousFilter = Material::getRenderFilter();
+	Material::setRenderFilter(Material::OpaqueMaterials);
+	for (auto &&o : occluders)
+		o.second();
+	Material::setRenderFilter(previousFilter);
+	GL_CALL(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+}
+void DepthPrePass::beginColourPasses()
+{
+	GL_CALL(glDepthFunc(GL_EQUAL));
+	GL_CALL(glDepthMask(GL_FALSE));
+}
+void DepthPrePass::endColourPasses()
+{
+	GL_CALL(glDepthFunc(GL_LESS));
+	GL_CALL(glDepthMask(GL_TRUE));
+}
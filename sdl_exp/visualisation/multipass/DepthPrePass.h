@@ -0,0 +1,76 @@
+#ifndef __DepthPrePass_h__
+#define __DepthPrePass_h__
+#include <functional>
+#include <map>
+#include <memory>
+#include "RenderPass.h"
+
+/**
+ * Renders the depth of opaque occluders, with colour writes disabled, before the colour passes which share its FrameBuffer
+ * The colour passes are then drawn with glDepthFunc(GL_EQUAL) and depth writes disabled, so early depth testing shades each visible pixel once
+ * Occluders should be drawn with a depth only shader (built with DEPTH_ONLY, e.g. Stock::Shaders::DEPTH, BONE_DEPTH or INSTANCED_DEPTH)
+ * Entity::usePositionStream() and Model::usePositionStream() further reduce the cost, by drawing from compact position only vertex buffers
+ * Vertex shaders declare gl_Position invariant, so depth matches exactly between the pre-pass and the colour passes
+ * Usage:
+ *   auto prePass = std::make_shared<DepthPrePass>(colourPass->getFrameBuffer());
+ *   prePass->addOccluder(model, 2);
+ *   model->usePositionStream(2);
+ *   setDepthPrePass(1, prePass, 2);//Within a MultiPassScene, colourPass has index 2
+ * @note Anything drawn by the colour passes must also be drawn by the pre-pass, otherwise it fails the depth test
+ * @note Only opaque materials (see Material::setRenderFilter()) are drawn, transparent surfaces should be drawn after the colour passes (e.g. OITPass)
+ */
+class DepthPrePass : public RenderPass
+{
+public:
+	/**
+	 * @param target The FrameBuffer shared with the colour passes
+	 * @note If target is a FrameBuffer which clears, the pre-pass takes over its clear, so that the colour passes don't clear the depth
+	 *       The colour passes of a BackBuffer target must be constructed without clear, e.g. BackBuffer(false)
+	 */
+	DepthPrePass(std::shared_ptr<FBuffer> target);
+	/**
+	 * Registers an Entity or Model, whose depth is rendered with render(shaderIndex)
+	 * @param occluder The Entity or Model
+	 * @param shaderIndex Index of the occluder's depth only shader
+	 * @return ID to pass to removeOccluder()
+	 */
+	template<class T>
+	unsigned int addOccluder(const std::shared_ptr<T> &occluder, unsigned int shaderIndex);
+	/**
+	 * As above, however the occluder is drawn by the provided function
+	 * e.g. [entity](){ entity->renderInstanceData(2); }
+	 * This may draw with any shader, as only depth is written, although depth only shaders are cheaper
+	 */
+	unsigned int addOccluder(std::function<void()> render);
+	void removeOccluder(unsigned int id);
+	/**
+	 * Clears the target (if it was set to clear), then renders the occluders' depth
+	 */
+	void executeRender() override;
+	/**
+	 * Configures depth testing for the colour passes which follow the pre-pass
+	 * glDepthFunc(GL_EQUAL), with depth writes disabled
+	 */
+	static void beginColourPasses();
+	/**
+	 * Restores the default depth testing, glDepthFunc(GL_LESS) with depth writes enabled
+	 */
+	static void endColourPasses();
+protected:
+	void render() override;
+private:
+	std::map<unsigned int, std::function<void()>> occluders;
+	unsigned int nextID;
+	/**
+	 * True if the target is a FrameBuffer whose clear has been taken over
+	 */
+	bool clearTarget;
+};
+
+template<class T>
+unsigned int DepthPrePass::addOccluder(const std::shared_ptr<T> &occluder, unsigned int shaderIndex)
+{
+	return addOccluder([occluder, shaderIndex](){ occluder->render(shaderIndex); });
+}
+
+#endif //__DepthPrePass_h__
@@ -0,0 +1,28 @@
+#include "GBufferPass.h"
+#include "../model/Material.h"
+
+GBufferPass::GBufferPass()
+	: RenderPass(std::make_shared<FrameBuffer>(
+		std::initializer_list<FrameBufferAttachment>{ FBAFactory::ManagedColorTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE), FBAFactory::ManagedColorTexture(GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT) },
+		FBAFactory::ManagedDepthTexture(GL_DEPTH_COMPONENT32F), FBAFactory::Disabled(), 0, 1.0f, true))
+	, nextID(0)
+{ }
+unsigned int GBufferPass::addOpaque(std::function<void()> render)
+{
+	opaques.emplace(nextID, render);
+	return nextID++;
+}
+void GBufferPass::removeOpaque(unsigned int id)
+{
+	opaques.erase(id);
+}
+void GBufferPass::render()
+{
+	GL_CALL(glEnable(GL_DEPTH_TEST));
+	//Transparent surfaces can't be represented by the G-buffer
+	const Material::RenderFilter previousFilter = Material::getRenderFilter();
+	Material::setRenderFilter(Material::OpaqueMaterials);
+	for (auto &&o : opaques)
+		o.second();
+	Material::setRenderFilter(previousFilter);
+}
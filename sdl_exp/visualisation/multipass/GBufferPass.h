@@ -0,0 +1,59 @@
+#ifndef __GBufferPass_h__
+#define __GBufferPass_h__
+#include <functional>
+#include <map>
+#include <memory>
+#include "RenderPass.h"
+#include "FrameBuffer.h"
+
+/**
+ * Geometry pass of deferred shading, renders opaque surfaces into a compact G-buffer which DeferredLightingPass lights
+ * 0: GL_RGBA8 albedo (rgb: diffuse colour, a: specular intensity)
+ * 1: GL_RGBA16 surface (xy: octahedral eye space normal, z: material ID, w: roughness)
+ * Depth: GL_DEPTH_COMPONENT32F, eye space positions are reconstructed from it
+ * Objects opt in by drawing with a GBUFFER shader (Stock::Shaders::PHONG_GBUFFER, FLAT_GBUFFER, INSTANCED_GBUFFER or BONE_GBUFFER), with any material
+ * Usage:
+ *   auto gBuffer = std::make_shared<GBufferPass>();
+ *   gBuffer->addOpaque(model, 1);
+ *   addPass(1, gBuffer);
+ *   addPass(2, std::make_shared<DeferredLightingPass>(gBuffer, Lights(), visualisation.getProjectionMatPtr()));
+ * @note Only opaque materials are drawn (see Material::setRenderFilter()), transparent surfaces should be drawn forward after lighting (e.g. OITPass)
+ * @note Material IDs beyond 65535 can't be packed
+ */
+class GBufferPass : public RenderPass
+{
+public:
+	/**
+	 * Size of a G-buffer pixel, including depth
+	 */
+	static const unsigned int BYTES_PER_PIXEL = 16;
+	GBufferPass();
+	/**
+	 * Registers an Entity or Model, which is drawn into the G-buffer with render(shaderIndex)
+	 * @param opaque The Entity or Model
+	 * @param shaderIndex Index of the object's GBUFFER shader
+	 * @return ID to pass to removeOpaque()
+	 */
+	template<class T>
+	unsigned int addOpaque(const std::shared_ptr<T> &opaque, unsigned int shaderIndex);
+	/**
+	 * As above, however the object is drawn by the provided function
+	 * e.g. [entity](){ entity->renderInstanceData(1); }
+	 */
+	unsigned int addOpaque(std::function<void()> render);
+	void removeOpaque(unsigned int id);
+	std::shared_ptr<FrameBuffer> getGBuffer() { return std::static_pointer_cast<FrameBuffer>(getFrameBuffer()); }
+protected:
+	void render() override;
+private:
+	std::map<unsigned int, std::function<void()>> opaques;
+	unsigned int nextID;
+};
+
+template<class T>
+unsigned int GBufferPass::addOpaque(const std::shared_ptr<T> &opaque, unsigned int shaderIndex)
+{
+	return addOpaque([opaque, shaderIndex](){ opaque->render(shaderIndex); });
+}
+
+#endif //__GBufferPass_h__
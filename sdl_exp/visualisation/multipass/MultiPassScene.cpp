@@ -3,6 +3,8 @@
 MultiPassScene::MultiPassScene(ViewportExt &visualisation)
 	: Scene(visualisation)
 	, lighting(std::make_shared<LightsBuffer>(visualisation.getCamera()->getViewMatPtr()))
+	, prePassIndex(0)
+	, lastColourIndex(0)
 {
     lighting->setProjectionMatPtr(this->visualisation.getProjectionMatPtr());
 }
@@ -27,6 +29,31 @@ void MultiPassScene::_reload()
         it->reload();
     reload();
 }
+void MultiPassScene::_update(const unsigned int &frameTime)
+{
+	update(frameTime);
+	Jobs().parallelFor(0, (unsigned int)entities.size(), 0, [this](unsigned int begin, unsigned int end){
+		for (unsigned int i = begin; i < end; ++i)
+			entities[i]->prepare();
+	});
+}
+void MultiPassScene::_commitTick()
+{
+	for (auto &&e : entities)
+		e->commitTick();
+}
+void MultiPassScene::_interpolateTick(float alpha)
+{
+	Jobs().parallelFor(0, (unsigned int)entities.size(), 0, [this, alpha](unsigned int begin, unsigned int end){
+		for (unsigned int i = begin; i < end; ++i)
+			entities[i]->interpolateTick(alpha);
+	});
+}
+void MultiPassScene::_resetTicks()
+{
+	for (auto &&e : entities)
+		e->resetTicks();
+}
 
 std::shared_ptr<RenderPass> MultiPassScene::addPass(int index, std::shared_ptr<RenderPass> rp)
 {
@@ -40,12 +67,49 @@ std::shared_ptr<RenderPass> MultiPassScene::addPass(int index, std::shared_ptr<R
 	rp->resize(visualisation.getWindowWidth(), visualisation.getWindowHeight());
     return rtn;
 }
+void MultiPassScene::setDepthPrePass(int index, std::shared_ptr<DepthPrePass> prePass, int lastColourIndex)
+{
+	if (!prePass || lastColourIndex <= index)
+	{
+		fprintf(stderr, "MultiPassScene::setDepthPrePass(): The colour passes must follow the pre-pass.\n");
+		return;
+	}
+	clearDepthPrePass();
+	addPass(index, prePass);
+	this->prePass = prePass;
+	this->prePassIndex = index;
+	this->lastColourIndex = lastColourIndex;
+}
+void MultiPassScene::clearDepthPrePass()
+{
+	if (!prePass)
+		return;
+	auto &&it = rpMap.find(prePassIndex);
+	if (it != rpMap.end() && it->second == prePass)
+		rpMap.erase(it);
+	prePass.reset();
+}
 
 void MultiPassScene::_render()
 {
 	lighting->update();
+	bool equalDepth = false;
     for (auto&& it : rpMap)//byRef
+	{
+		if (equalDepth && it.first > lastColourIndex)
+		{
+			DepthPrePass::endColourPasses();
+			equalDepth = false;
+		}
         it.second->executeRender();
+		if (prePass && it.second == prePass)
+		{
+			DepthPrePass::beginColourPasses();
+			equalDepth = true;
+		}
+	}
+	if (equalDepth)
+		DepthPrePass::endColourPasses();
 }
 void MultiPassScene::_resize(const glm::uvec2 &dims)
 {
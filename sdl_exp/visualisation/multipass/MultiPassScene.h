@@ -8,7 +8,9 @@
 #include "../shader/Shaders.h"
 #include "../Visualisation.h"
 #include "RenderPass.h"
+#include "DepthPrePass.h"
 #include "../shader/lights/LightsBuffer.h"
+#include "../util/JobSystem.h"
 
 /**
  * This Scene implementation allows each render to occur over multiple passes
@@ -33,6 +35,20 @@ public:
 	 * @param rp A shared pointer to the RenderPass
 	 */
     std::shared_ptr<RenderPass> addPass(int index, std::shared_ptr<RenderPass> rp);
+	/**
+	 * Enables the depth pre-pass pipeline mode, adds prePass to the render loop
+	 * Passes after the pre-pass, up to and including lastColourIndex, are rendered with glDepthFunc(GL_EQUAL) and depth writes disabled
+	 * Passes after lastColourIndex (e.g. an OITPass, or objects not drawn by the pre-pass) are rendered with the default depth state
+	 * @param index The position which the pre-pass should be rendered at
+	 * @param prePass The depth pre-pass, sharing the colour passes' FrameBuffer
+	 * @param lastColourIndex The position of the final colour pass which uses the pre-pass's depth
+	 * @see DepthPrePass
+	 */
+	void setDepthPrePass(int index, std::shared_ptr<DepthPrePass> prePass, int lastColourIndex);
+	/**
+	 * Disables the depth pre-pass pipeline mode, removing the pre-pass from the render loop
+	 */
+	void clearDepthPrePass();
     /**
      * Called when the user requests a reload
      * @note You should call functions such as shaders->reload() here
@@ -46,7 +62,19 @@ public:
 	 * @return Returning true permits the visualisation to also handle the keypress
 	 */
 	virtual bool keypress(SDL_Keycode keycode, int x, int y) = 0;
+	/**
+	 * Called when the user presses a mouse button, e.g. to request a PickPass::pick()
+	 * @param button The SDL button index (SDL_BUTTON_LEFT, SDL_BUTTON_MIDDLE, SDL_BUTTON_RIGHT etc)
+	 * @param x The mouse's x coordinate relative to the window
+	 * @param y The mouse's y coordinate relative to the window
+	 * @return Returning true permits the visualisation to also handle the press
+	 */
+	virtual bool mousePress(Uint8 button, int x, int y) { return true; };
 	std::shared_ptr<LightsBuffer> Lights(){ return lighting; }
+	/**
+	 * The job system used for the scene's built in per frame work, update() may also submit work to it
+	 */
+	JobSystem &Jobs(){ return JobSystem::global(); }
 protected:
 	/**
 	 * Registers an entity, so the scene can manage it's modelview and projection matrices and reloads
@@ -67,6 +95,11 @@ private:
 	 * @note Calls keypress()
 	 */
 	virtual bool _keypress(SDL_Keycode keycode, int x, int y) override final { return keypress(keycode, x, y); };
+	/**
+	 * Called when the user presses a mouse button
+	 * @note Calls mousePress()
+	 */
+	virtual bool _mousePress(Uint8 button, int x, int y) override final { return mousePress(button, x, y); };
 	/**
 	 * Resizes the textures attatched the Framebuffers within RenderPass's
 	 */
@@ -76,9 +109,21 @@ private:
 	 */
 	virtual void _reload() override final;
 	/**
-	 * Internal update functionality, calls update()
+	 * Internal update functionality, calls update() then prepares registered entities in parallel
+	 */
+	void _update(const unsigned int &frameTime) override final;
+	/**
+	 * Latches the transforms of registered entities
+	 */
+	void _commitTick() override final;
+	/**
+	 * Interpolates the transforms of registered entities, in parallel
 	 */
-	inline virtual void _update(const unsigned int &frameTime) override final { update(frameTime); };
+	void _interpolateTick(float alpha) override final;
+	/**
+	 * Discards the latched transforms of registered entities
+	 */
+	void _resetTicks() override final;
 	/**
 	* Holds registered entities so the Scene can automatically reload them
 	*/
@@ -87,6 +132,11 @@ private:
 	* Holds registered render passes so they can be triggered during render
 	*/
 	std::map<int, std::shared_ptr<RenderPass>> rpMap;
+	/**
+	 * The optional depth pre-pass, and the range of render pass indices which depth test against it
+	 */
+	std::shared_ptr<DepthPrePass> prePass;
+	int prePassIndex, lastColourIndex;
 	/**
 	* Provides a simple default lighting configuration located at the camera using the old fixed function pipeline methods
 	*/
@@ -0,0 +1,81 @@
+#include "OITPass.h"
+#include "../model/Material.h"
+
+OITPass::OITPass(std::shared_ptr<FrameBuffer> target)
+	: RenderPass(std::make_shared<FrameBuffer>(
+		std::initializer_list<FrameBufferAttachment>{ FBAFactory::ManagedColorTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT), FBAFactory::ManagedColorTexture(GL_R16F, GL_RED, GL_FLOAT) },
+		FBAFactory::Disabled(), FBAFactory::Disabled(), 0, 1.0f, false))
+	, target(target)
+	, nextID(0)
+	, composite(std::make_shared<Shaders>(Stock::Shaders::OIT_COMPOSITE))
+{
+	auto fb = std::static_pointer_cast<FrameBuffer>(getFrameBuffer());
+	composite->addTexture("_accum", fb->getColorTexture(0));
+	composite->addTexture("_revealage", fb->getColorTexture(1));
+}
+unsigned int OITPass::addTransparent(std::function<void()> render)
+{
+	transparents.emplace(nextID, render);
+	return nextID++;
+}
+void OITPass::removeTransparent(unsigned int id)
+{
+	transparents.erase(id);
+}
+void OITPass::render()
+{
+	if (transparents.empty() || !target)
+		return;
+	if (std::static_pointer_cast<FrameBuffer>(getFrameBuffer())->getDimensions() != target->getDimensions())
+	{
+		fprintf(stderr, "OITPass::render(): Target FrameBuffer dimensions differ from the viewport, transparency skipped.\n");
+		return;
+	}
+	//Depth test against the opaque surfaces, without writing depth so transparent surfaces never occlude each other
+	attachTargetDepth(true);
+	const GLfloat clearAccum[4] = { 0, 0, 0, 0 };
+	const GLfloat clearRevealage[4] = { 1, 1, 1, 1 };
+	GL_CALL(glClearBufferfv(GL_COLOR, 0, clearAccum));
+	GL_CALL(glClearBufferfv(GL_COLOR, 1, clearRevealage));
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GL_CALL(glEnable(GL_DEPTH_TEST));
+	GL_CALL(glDepthMask(GL_FALSE));
+	//Accumulation sums weighted premultiplied colour, revealage is the product of (1-alpha)
+	GL_CALL(glEnable(GL_BLEND));
+	GL_CALL(glBlendFunci(0, GL_ONE, GL_ONE));
+	GL_CALL(glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR));
+	const Material::RenderFilter previousFilter = Material::getRenderFilter();
+	Material::setRenderFilter(Material::TransparentMaterials);
+	for (auto &&t : transparents)
+		t.second();
+	Material::setRenderFilter(previousFilter);
+	attachTargetDepth(false);
+	//Composite over the target's colour
+	GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, target->getFrameBufferName()));
+	GL_CALL(glDisable(GL_DEPTH_TEST));
+	GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+	composite->useProgram();
+	GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 3));
+	composite->clearProgram();
+	GL_CALL(glDisable(GL_BLEND));
+	GL_CALL(glDepthMask(GL_TRUE));
+	if (depthTest)
+	{
+		GL_CALL(glEnable(GL_DEPTH_TEST));
+	}
+	//Materials must reapply their blend state
+	Material::clearActive();
+}
+void OITPass::attachTargetDepth(bool attach)
+{
+	const GLenum attachPoint = target->getDepthStencilTextureName() || target->getDepthStencilRenderBufferName() ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+	const GLuint depthTexture = attach ? target->getDepthTextureName() : 0;
+	if (depthTexture)
+	{
+		GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, attachPoint, GL_TEXTURE_2D, depthTexture, 0));
+	}
+	else
+	{//Attaching renderbuffer 0 also detaches a texture
+		GL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachPoint, GL_RENDERBUFFER, attach ? target->getDepthRenderBufferName() : 0));
+	}
+}
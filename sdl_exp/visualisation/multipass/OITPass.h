@@ -0,0 +1,68 @@
+#ifndef __OITPass_h__
+#define __OITPass_h__
+#include <functional>
+#include <map>
+#include <memory>
+#include "RenderPass.h"
+#include "FrameBuffer.h"
+#include "../shader/Shaders.h"
+
+/**
+ * Weighted blended order independent transparency (McGuire & Bavoil 2013)
+ * Transparent materials (see Material::getAlpha()) are drawn in any order into an RGBA16F accumulation and an R16F revealage attachment
+ * These are depth tested against the target's depth buffer, then composited over the target's colour in a single fullscreen draw
+ * Objects are rendered with a shader built with the OIT define, e.g. Stock::Shaders::PHONG_OIT, INSTANCED_OIT or BONE_OIT
+ * Only meshes with transparent materials are drawn by this pass, opaque meshes of the same model should be drawn by the target's pass
+ * Usage:
+ *   auto oit = std::make_shared<OITPass>(opaqueFrameBuffer);
+ *   addPass(1, oit);
+ *   oit->addTransparent(model, 1);
+ *   ...within the opaque pass's render()...
+ *   Material::setRenderFilter(Material::OpaqueMaterials);
+ *   model->render();
+ * @note The target must be a FrameBuffer without multisampling, with a depth (or depthstencil) attachment, of the same dimensions as the viewport
+ */
+class OITPass : public RenderPass
+{
+public:
+	/**
+	 * @param target The FrameBuffer holding the opaque image and its depth, which the transparent surfaces are composited into
+	 */
+	OITPass(std::shared_ptr<FrameBuffer> target);
+	/**
+	 * Registers an Entity or Model whose transparent materials are drawn with render(shaderIndex)
+	 * @param transparent The Entity or Model
+	 * @param shaderIndex Index of the object's OIT shader
+	 * @return ID to pass to removeTransparent()
+	 */
+	template<class T>
+	unsigned int addTransparent(const std::shared_ptr<T> &transparent, unsigned int shaderIndex);
+	/**
+	 * As above, however the object is drawn by the provided function
+	 * e.g. [entity](){ entity->renderInstanceData(1); }
+	 */
+	unsigned int addTransparent(std::function<void()> render);
+	void removeTransparent(unsigned int id);
+protected:
+	/**
+	 * Accumulates the transparent surfaces, then composites them into the target
+	 */
+	void render() override;
+private:
+	/**
+	 * Attaches (or detaches, when false) the target's depth buffer to the pass's FrameBuffer
+	 */
+	void attachTargetDepth(bool attach);
+	std::shared_ptr<FrameBuffer> target;
+	std::map<unsigned int, std::function<void()>> transparents;
+	unsigned int nextID;
+	std::shared_ptr<Shaders> composite;
+};
+
+template<class T>
+unsigned int OITPass::addTransparent(const std::shared_ptr<T> &transparent, unsigned int shaderIndex)
+{
+	return addTransparent([transparent, shaderIndex](){ transparent->render(shaderIndex); });
+}
+
+#endif //__OITPass_h__
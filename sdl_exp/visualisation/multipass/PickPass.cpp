@@ -0,0 +1,167 @@
+#include "PickPass.h"
+#include "FrameBuffer.h"
+#include <algorithm>
+
+const char *PickPass::PICK_ID_UNIFORM_NAME = "_pickID";
+
+PickPass::PickPass(float scale)
+	: RenderPass(std::make_shared<FrameBuffer>(FBAFactory::ManagedColorRenderBuffer(GL_R32UI), FBAFactory::ManagedDepthRenderBuffer(), FBAFactory::Disabled(), 0, scale, false))
+	, nextID(1)
+	, windowDims(0)
+{ }
+PickPass::~PickPass()
+{
+	for (auto &&r : inFlight)
+	{
+		GL_CALL(glDeleteSync(r.fence));
+		sparePBOs.push_back(r.pbo);
+	}
+	if (!sparePBOs.empty())
+	{
+		GL_CALL(glDeleteBuffers((GLsizei)sparePBOs.size(), sparePBOs.data()));
+	}
+}
+unsigned int PickPass::reserve(unsigned int elements, std::function<void()> render)
+{
+	const unsigned int rtn = nextID;
+	nextID += std::max(elements, 1u);
+	pickables.emplace(rtn, Pickable{ std::max(elements, 1u), render });
+	return rtn;
+}
+void PickPass::removePickable(unsigned int object)
+{
+	pickables.erase(object);
+}
+void PickPass::pick(const glm::ivec2 &windowPos, const glm::uvec2 &size, Callback callback)
+{
+	//Convert to framebuffer coordinates, which have their origin at the bottom left and may be scaled
+	const glm::uvec2 fbDims = std::static_pointer_cast<FrameBuffer>(getFrameBuffer())->getDimensions();
+	const glm::vec2 scale = windowDims.x && windowDims.y ? glm::vec2(fbDims) / glm::vec2(windowDims) : glm::vec2(1);
+	const glm::ivec2 windowMin(windowPos.x, (int)windowDims.y - windowPos.y - (int)size.y);
+	glm::ivec2 fbMin = glm::ivec2(glm::floor(glm::vec2(windowMin) * scale));
+	glm::ivec2 fbMax = glm::max(glm::ivec2(glm::ceil(glm::vec2(windowMin + glm::ivec2(size)) * scale)), fbMin + 1);
+	fbMin = glm::clamp(fbMin, glm::ivec2(0), glm::ivec2(fbDims) - 1);
+	fbMax = glm::clamp(fbMax, fbMin + 1, glm::ivec2(fbDims));
+	pending.push_back(Request{ fbMin, glm::uvec2(fbMax - fbMin), callback });
+}
+void PickPass::resize(const glm::uvec2 &dims)
+{
+	windowDims = dims;
+	RenderPass::resize(dims);
+}
+void PickPass::executeRender()
+{
+	retire();
+	//Nothing is rendered unless a pick has been requested
+	if (pending.empty())
+		return;
+	GLint previousDraw = 0, previousRead = 0, viewport[4];
+	GL_CALL(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw));
+	GL_CALL(glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead));
+	GL_CALL(glGetIntegerv(GL_VIEWPORT, viewport));
+	RenderPass::executeRender();
+	GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw));
+	GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead));
+	GL_CALL(glViewport(viewport[0], viewport[1], viewport[2], viewport[3]));
+}
+void PickPass::render()
+{
+	//The FrameBuffer's own clear is floating point, integer attachments must be cleared with glClearBuffer*()
+	const GLuint clearID[4] = { 0, 0, 0, 0 };
+	const GLfloat clearDepth = 1.0f;
+	GL_CALL(glClearBufferuiv(GL_COLOR, 0, clearID));
+	GL_CALL(glClearBufferfv(GL_DEPTH, 0, &clearDepth));
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GL_CALL(glEnable(GL_DEPTH_TEST));
+	for (auto &&p : pickables)
+		p.second.render();
+	if (!depthTest)
+	{
+		GL_CALL(glDisable(GL_DEPTH_TEST));
+	}
+	//Begin reading back each request, with a pack buffer bound glReadPixels() returns immediately
+	GLint previousPack = 0;
+	GL_CALL(glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previousPack));
+	GL_CALL(glReadBuffer(GL_COLOR_ATTACHMENT0));
+	GL_CALL(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+	for (auto &&request : pending)
+	{
+		Readback r;
+		r.request = std::move(request);
+		if (!sparePBOs.empty())
+		{
+			r.pbo = sparePBOs.back();
+			sparePBOs.pop_back();
+		}
+		else
+		{
+			GL_CALL(glGenBuffers(1, &r.pbo));
+		}
+		GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo));
+		GL_CALL(glBufferData(GL_PIXEL_PACK_BUFFER, r.request.size.x * r.request.size.y * sizeof(GLuint), nullptr, GL_STREAM_READ));
+		GL_CALL(glReadPixels(r.request.origin.x, r.request.origin.y, r.request.size.x, r.request.size.y, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr));
+		r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		inFlight.push_back(std::move(r));
+	}
+	pending.clear();
+	GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, previousPack));
+}
+void PickPass::retire()
+{
+	if (inFlight.empty())
+		return;
+	GLint previousPack = 0;
+	GL_CALL(glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previousPack));
+	while (!inFlight.empty())
+	{
+		Readback &r = inFlight.front();
+		//Never wait, the readback is checked again next frame
+		const GLenum status = glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+			break;
+		GL_CALL(glDeleteSync(r.fence));
+		std::vector<Hit> hits;
+		const size_t count = r.request.size.x * r.request.size.y;
+		GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo));
+		const GLuint *ids = static_cast<const GLuint *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(GLuint), GL_MAP_READ_BIT));
+		if (ids)
+		{
+			hits = resolve(ids, count);
+			GL_CALL(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+		}
+		else
+		{
+			fprintf(stderr, "PickPass::retire(): Failed to map readback, pick reported as a miss.\n");
+		}
+		//Pop before the callback, in case it requests another pick
+		Callback callback = std::move(r.request.callback);
+		sparePBOs.push_back(r.pbo);
+		inFlight.pop_front();
+		if (callback)
+			callback(hits);
+	}
+	GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, previousPack));
+}
+std::vector<PickPass::Hit> PickPass::resolve(const GLuint *ids, size_t count) const
+{
+	std::map<GLuint, unsigned int> pixels;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (ids[i])
+			++pixels[ids[i]];
+	}
+	std::vector<Hit> rtn;
+	for (auto &&p : pixels)
+	{
+		//Find the pickable whose range contains the ID, ranges of removed pickables are ignored
+		auto it = pickables.upper_bound(p.first);
+		if (it == pickables.begin())
+			continue;
+		--it;
+		if (p.first - it->first >= it->second.elements)
+			continue;
+		rtn.push_back(Hit{ it->first, p.first - it->first, p.second });
+	}
+	std::stable_sort(rtn.begin(), rtn.end(), [](const Hit &a, const Hit &b){ return a.pixels > b.pixels; });
+	return rtn;
+}
@@ -0,0 +1,177 @@
+#ifndef __PickPass_h__
+#define __PickPass_h__
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+#include "RenderPass.h"
+#include "../util/GLcheck.h"
+
+/**
+ * Identifies the Entity, Model mesh or instance under the mouse, without stalling the frame
+ * Only when a pick has been requested, registered objects are rendered into an R32UI attachment (optionally at reduced resolution)
+ * Each pick's pixels are then read back into a pixel pack buffer, the result is delivered to its callback once its fence has signalled (typically a frame or two later)
+ * Objects are rendered with a shader which outputs their ID, e.g. Stock::Shaders::PICK, INSTANCED_PICK or BONE_PICK
+ * Each object reserves a contiguous range of IDs, the offset within the range is the index of the mesh (Model) or instance (Entity, gl_InstanceID) drawn
+ * Usage:
+ *   auto pick = std::make_shared<PickPass>(0.5f);
+ *   addPass(10, pick);
+ *   const unsigned int id = pick->addPickable(model, 1, model->getMeshCount());
+ *   ...within mousePress() or keypress()...
+ *   pick->pick(glm::ivec2(x, y), [](const std::vector<PickPass::Hit> &hits){ ... });
+ * @note Within a BasicScene, which has no passes, call executeRender() once per frame from render()
+ */
+class PickPass : public RenderPass
+{
+public:
+	/**
+	 * An object found within a picked region
+	 */
+	struct Hit
+	{
+		/**
+		 * The ID returned by addPickable()
+		 */
+		unsigned int object;
+		/**
+		 * Index of the mesh (Model) or instance (Entity) within the object
+		 */
+		unsigned int element;
+		/**
+		 * The number of pixels of the region the element covered
+		 */
+		unsigned int pixels;
+	};
+	/**
+	 * Receives the elements found by a pick, most pixels first, this is empty if nothing was hit
+	 */
+	typedef std::function<void(const std::vector<Hit> &hits)> Callback;
+	static const char *PICK_ID_UNIFORM_NAME;//="_pickID"
+	/**
+	 * @param scale Resolution of the ID buffer relative to the viewport, reducing this reduces the cost of each pick at the expense of accuracy
+	 */
+	PickPass(float scale = 1.0f);
+	~PickPass();
+	/**
+	 * Registers an Entity or Model to be picked, it is rendered with render(shaderIndex)
+	 * @param pickable The Entity or Model
+	 * @param shaderIndex Index of the pickable's pick shader
+	 * @param elements The number of IDs to reserve, Model::getMeshCount() for models, the instance count for Entity::renderInstances()
+	 * @return The object ID reported by hits
+	 */
+	template<class T>
+	unsigned int addPickable(const std::shared_ptr<T> &pickable, unsigned int shaderIndex, unsigned int elements = 1);
+	/**
+	 * As above, however the pickable is drawn by the provided function
+	 * e.g. [entity](){ entity->renderInstanceData(1); }, with the instance buffer's capacity as elements
+	 */
+	template<class T>
+	unsigned int addPickable(const std::shared_ptr<T> &pickable, unsigned int shaderIndex, unsigned int elements, std::function<void()> render);
+	/**
+	 * Stops rendering the object, its IDs are not reused
+	 */
+	void removePickable(unsigned int object);
+	/**
+	 * Requests the element under a point, the pick occurs during the next executeRender()
+	 * @param windowPos Window coordinates, with the origin at the top left (as passed to Scene::_keypress())
+	 * @param callback Receives the result, from within a later executeRender()
+	 */
+	void pick(const glm::ivec2 &windowPos, Callback callback) { pick(windowPos, glm::uvec2(1), callback); }
+	/**
+	 * Requests the elements within a region
+	 * @param windowPos Window coordinates of the region's top left corner
+	 * @param size Width and height of the region, in window pixels
+	 */
+	void pick(const glm::ivec2 &windowPos, const glm::uvec2 &size, Callback callback);
+	/**
+	 * Delivers completed picks, then renders IDs and begins reading back any which are pending
+	 * The previously bound framebuffer and viewport are restored
+	 */
+	void executeRender() override;
+	void resize(const glm::uvec2 &dims) override;
+	/**
+	 * @return The number of picks which have been requested, but not yet delivered
+	 */
+	unsigned int getOutstanding() const { return (unsigned int)(pending.size() + inFlight.size()); }
+protected:
+	/**
+	 * Renders every pickable's IDs, then reads back the region of each pending pick
+	 */
+	void render() override;
+private:
+	struct Pickable
+	{
+		unsigned int elements;
+		std::function<void()> render;
+	};
+	struct Request
+	{
+		/**
+		 * Region within the ID buffer
+		 */
+		glm::ivec2 origin;
+		glm::uvec2 size;
+		Callback callback;
+	};
+	struct Readback
+	{
+		Request request;
+		GLuint pbo;
+		GLsync fence;
+	};
+	/**
+	 * Reserves IDs for a pickable
+	 * @return The first ID
+	 */
+	unsigned int reserve(unsigned int elements, std::function<void()> render);
+	/**
+	 * Passes the ID to the pickable's pick shaders
+	 */
+	template<class T>
+	static void setPickID(const std::shared_ptr<T> &pickable, unsigned int shaderIndex, unsigned int id);
+	/**
+	 * Delivers readbacks whose fence has signalled, in the order they were requested
+	 */
+	void retire();
+	/**
+	 * Counts the pixels of each element within a readback
+	 */
+	std::vector<Hit> resolve(const GLuint *ids, size_t count) const;
+	/**
+	 * Key: First ID of the pickable
+	 */
+	std::map<unsigned int, Pickable> pickables;
+	/**
+	 * ID 0 is cleared to, so represents no object
+	 */
+	unsigned int nextID;
+	glm::uvec2 windowDims;
+	std::vector<Request> pending;
+	std::deque<Readback> inFlight;
+	/**
+	 * Pixel pack buffers of delivered readbacks, saves regenerating them each pick
+	 */
+	std::vector<GLuint> sparePBOs;
+};
+
+template<class T>
+unsigned int PickPass::addPickable(const std::shared_ptr<T> &pickable, unsigned int shaderIndex, unsigned int elements)
+{
+	return addPickable(pickable, shaderIndex, elements, [pickable, shaderIndex](){ pickable->render(shaderIndex); });
+}
+template<class T>
+unsigned int PickPass::addPickable(const std::shared_ptr<T> &pickable, unsigned int shaderIndex, unsigned int elements, std::function<void()> render)
+{
+	const unsigned int id = reserve(elements, render);
+	setPickID(pickable, shaderIndex, id);
+	return id;
+}
+template<class T>
+void PickPass::setPickID(const std::shared_ptr<T> &pickable, unsigned int shaderIndex, unsigned int id)
+{
+	//Static uniforms are copied as 4 components
+	const GLuint value[4] = { id, 0, 0, 0 };
+	pickable->getShaders(shaderIndex)->addStaticUniform(PICK_ID_UNIFORM_NAME, value);
+}
+
+#endif //__PickPass_h__
@@ -1,18 +1,44 @@
 #include "RenderPass.h"
 #include "BackBuffer.h"
+#include "../util/Profiler.h"
+#include <cctype>
+#include <cstring>
+#include <typeinfo>
+
+namespace
+{
+	/**
+	 * Strips the decoration compilers add to type names, e.g. "class ShadowPass" (MSVC), "10ShadowPass" (GCC)
+	 */
+	std::string readableTypeName(const char *name)
+	{
+		if (!strncmp(name, "class ", 6))
+			name += 6;
+		else if (!strncmp(name, "struct ", 7))
+			name += 7;
+		while (isdigit((unsigned char)*name))
+			++name;
+		return name;
+	}
+}
 
 RenderPass::RenderPass(glm::vec3 clearColor, bool doClear)
 	: fb(std::make_shared<BackBuffer>(doClear, clearColor))
+	, profilerName(nullptr)
 { }
 
 RenderPass::RenderPass(std::shared_ptr<FBuffer> fb)
 	: fb(fb)
+	, profilerName(nullptr)
 { }
 void RenderPass::executeRender()
 {
 	//Skip render if Framebuffer is incomplete
 	if (!fb->use())
 		return;
+	if (!profilerName)
+		profilerName = Profiler::intern(readableTypeName(typeid(*this).name()));
+	Profiler::Scope scope(profilerName, true);
 	render();
 }
 void RenderPass::resize(const glm::uvec2 &dims)
@@ -30,6 +30,7 @@ public:
     /**
      * Binds the contained FrameBuffer and then triggers render()
      * If the FrameBuffer is incomplete (invalid), the render will be skipped and the previous framebuffer bound
+     * The CPU and GPU time of each pass is recorded by Profiler, named after the subclass
 	 * @note This method is called by the scene in order of RenderPass priority
 	 */
 	virtual void executeRender();
@@ -40,6 +41,10 @@ public:
     virtual void resize(const glm::uvec2 &dims);
 private:
 	const std::shared_ptr<FBuffer> fb;
+	/**
+	 * Name under which executeRender() is profiled, derived from the subclass's type on first use
+	 */
+	const char *profilerName;
 protected:
     /**
      * Called by executeRender() after framebuffer has been bound
@@ -0,0 +1,408 @@
+#include "ShadowPass.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include "FrameBuffer.h"
+#include "../util/GLcheck.h"
+
+namespace
+{
+	/**
+	 * Slope scaled and constant depth offset applied whilst rendering casters, to prevent shadow acne
+	 */
+	const float POLYGON_OFFSET_FACTOR = 2.0f;
+	const float POLYGON_OFFSET_UNITS = 4.0f;
+	/**
+	 * Ratio of a perspective shadow map's near plane to its far plane
+	 */
+	const float NEAR_RATIO = 0.002f;
+	/**
+	 * Spot light maps are widened slightly beyond the cone, and capped below 180 degrees
+	 */
+	const float SPOT_FOV_MARGIN = glm::radians(2.0f);
+	const float SPOT_FOV_MAX = glm::radians(170.0f);
+	/**
+	 * Direction and up vector of each cube face, in the order +x, -x, +y, -y, +z, -z
+	 */
+	const glm::vec3 CUBE_FACES[6][2] = {
+		{ glm::vec3(1, 0, 0), glm::vec3(0, -1, 0) },
+		{ glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0) },
+		{ glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) },
+		{ glm::vec3(0, -1, 0), glm::vec3(0, 0, -1) },
+		{ glm::vec3(0, 0, 1), glm::vec3(0, -1, 0) },
+		{ glm::vec3(0, 0, -1), glm::vec3(0, -1, 0) }
+	};
+	glm::vec3 upVector(const glm::vec3 &direction)
+	{
+		return std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	}
+	unsigned int floorPow2(unsigned int v)
+	{
+		unsigned int rtn = 1;
+		while (rtn * 2 <= v)
+			rtn *= 2;
+		return rtn;
+	}
+}
+
+const char *ShadowPass::ATLAS_UNIFORM_NAME = "_shadowAtlas";
+const char *ShadowPass::MAPS_BLOCK_NAME = "_shadowMaps";
+
+ShadowPass::ShadowPass(std::shared_ptr<LightsBuffer> lights, const glm::mat4 *viewMatPtr, const glm::mat4 *projMatPtr, unsigned int atlasSize)
+	: RenderPass(std::make_shared<FrameBuffer>(glm::uvec2(atlasSize), FBAFactory::Disabled(), FBAFactory::ManagedDepthTexture(GL_DEPTH_COMPONENT32F), FBAFactory::Disabled(), 0, false))
+	, lights(lights)
+	, viewMatPtr(viewMatPtr)
+	, projMatPtr(projMatPtr)
+	, atlasSize(atlasSize)
+	, atlas(std::dynamic_pointer_cast<FrameBuffer>(getFrameBuffer())->getDepthTexture())
+	, maps(std::make_shared<ShaderStorageBuffer>(sizeof(ShadowMap)))
+	, mapsCapacity(1)
+	, allocator(atlasSize)
+	, atlasReleases(0)
+	, casterView(1.0f)
+	, casterProjection(1.0f)
+	, cascadeCount(DEFAULT_CASCADE_COUNT)
+	, cascadeSize(glm::min(DEFAULT_CASCADE_SIZE, atlasSize / 2))
+	, maxTileSize(glm::min(DEFAULT_MAX_TILE_SIZE, atlasSize / 2))
+	, shadowDistance(200.0f)
+	, splitLambda(0.75f)
+	, frame(0)
+	, tilesRendered(0)
+{
+	//Sample the atlas with hardware depth comparison (sampler2DShadow)
+	GL_CALL(glActiveTexture(GL_TEXTURE0 + atlas->getTextureUnit()));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, atlas->getName()));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL));
+	GL_CALL(glActiveTexture(GL_TEXTURE0));
+}
+void ShadowPass::setCascades(unsigned int count, unsigned int size)
+{
+	cascadeCount = count;
+	cascadeSize = floorPow2(glm::clamp(size, MIN_TILE_SIZE, atlasSize));
+	releaseAll();
+}
+void ShadowPass::setMaxTileSize(unsigned int size)
+{
+	maxTileSize = floorPow2(glm::clamp(size, MIN_TILE_SIZE, atlasSize));
+	releaseAll();
+}
+void ShadowPass::release(unsigned int lightIndex)
+{
+	auto it = allocations.find(lightIndex);
+	if (it == allocations.end())
+		return;
+	for (auto &&tile : it->second.tiles)
+		allocator.release(tile, it->second.tileSize);
+	allocations.erase(it);
+	++atlasReleases;
+	lights->setShadow(lightIndex, -1, 0);
+}
+void ShadowPass::releaseAll()
+{
+	while (!allocations.empty())
+		release(allocations.begin()->first);
+}
+float ShadowPass::calculateImportance(const LightProperties &eyeLight) const
+{
+	if (eyeLight.range < 0)
+		return 1.0f;//Unbounded
+	//Test the light's sphere of influence against the view frustum planes
+	const glm::mat4 &p = *projMatPtr;
+	const glm::vec4 row0(p[0][0], p[1][0], p[2][0], p[3][0]);
+	const glm::vec4 row1(p[0][1], p[1][1], p[2][1], p[3][1]);
+	const glm::vec4 row2(p[0][2], p[1][2], p[2][2], p[3][2]);
+	const glm::vec4 row3(p[0][3], p[1][3], p[2][3], p[3][3]);
+	const glm::vec4 planes[6] = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+	for (auto &&plane : planes)
+	{
+		if (glm::dot(glm::vec3(plane), eyeLight.position) + plane.w < -eyeLight.range * glm::length(glm::vec3(plane)))
+			return 0.0f;
+	}
+	//Projected radius, relative to the height of the screen
+	const float distance = glm::length(eyeLight.position);
+	if (distance <= eyeLight.range)
+		return 1.0f;
+	return glm::min(1.0f, p[1][1] * eyeLight.range / distance);
+}
+void ShadowPass::render()
+{
+	++frame;
+	tilesRendered = 0;
+	//Find the visible shadow casting lights, most important first
+	std::vector<std::pair<float, unsigned int>> visible;
+	for (unsigned int i = 0; i < lights->getCount(); ++i)
+	{
+		if (!lights->getWorldProperties(i).castShadows)
+		{
+			release(i);
+			continue;
+		}
+		const LightProperties eyeLight = lights->getEyeProperties(i);
+		const float importance = eyeLight.spotCosCutoff > 1.0f ? FLT_MAX : calculateImportance(eyeLight);
+		if (importance > 0)
+			visible.push_back({ importance, i });
+		else
+			release(i);
+	}
+	std::sort(visible.begin(), visible.end(), [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b){ return a.first > b.first; });
+	//Release tiles which no longer suit their light, before allocating, so that important lights are served first
+	std::vector<unsigned int> desiredSize(visible.size());
+	for (unsigned int v = 0; v < visible.size(); ++v)
+	{
+		const unsigned int i = visible[v].second;
+		const LightProperties eyeLight = lights->getEyeProperties(i);
+		const LightType type = eyeLight.spotCosCutoff > 1.0f ? Directional : eyeLight.spotCosCutoff < 0.0f ? Point : Spot;
+		desiredSize[v] = type == Directional ? cascadeSize
+			: floorPow2(glm::clamp((unsigned int)(visible[v].first * maxTileSize), MIN_TILE_SIZE, maxTileSize));
+		if (type == Point)
+			desiredSize[v] = glm::max(desiredSize[v] / 2, MIN_TILE_SIZE);
+		auto it = allocations.find(i);
+		if (it == allocations.end())
+			continue;
+		const Allocation &a = it->second;
+		//Compare growth against the requested size, lights which fell back to smaller tiles only retry once space has been released
+		const bool grown = desiredSize[v] > a.requestedSize || (desiredSize[v] > a.tileSize && a.atlasReleases != atlasReleases);
+		//Only shrink once the light needs less than a quarter of its tile, to avoid thrashing
+		if (a.type != type || grown || desiredSize[v] * 4 <= a.tileSize)
+			release(i);
+	}
+	//Allocate tiles to lights without, halving their size until they fit
+	for (unsigned int v = 0; v < visible.size(); ++v)
+	{
+		const unsigned int i = visible[v].second;
+		if (allocations.find(i) != allocations.end())
+			continue;
+		const LightProperties eyeLight = lights->getEyeProperties(i);
+		Allocation a;
+		a.type = eyeLight.spotCosCutoff > 1.0f ? Directional : eyeLight.spotCosCutoff < 0.0f ? Point : Spot;
+		a.requestedSize = desiredSize[v];
+		a.atlasReleases = atlasReleases;
+		a.lastRendered = 0;
+		a.cutoff = -1.0f;
+		a.range = -1.0f;
+		const unsigned int count = a.type == Directional ? cascadeCount : a.type == Point ? 6 : 1;
+		for (a.tileSize = desiredSize[v]; a.tileSize >= MIN_TILE_SIZE && a.tiles.size() < count; a.tileSize /= 2)
+		{
+			glm::uvec2 offset;
+			while (a.tiles.size() < count && allocator.allocate(a.tileSize, offset))
+				a.tiles.push_back(offset);
+			if (a.tiles.size() == count)
+				break;
+			for (auto &&tile : a.tiles)
+				allocator.release(tile, a.tileSize);
+			a.tiles.clear();
+		}
+		if (a.tiles.size() == count)
+			allocations.emplace(i, a);
+	}
+	//Render the tiles which are due
+	const glm::mat4 inverseView = glm::inverse(*viewMatPtr);
+	GL_CALL(glEnable(GL_SCISSOR_TEST));
+	GL_CALL(glEnable(GL_POLYGON_OFFSET_FILL));
+	GL_CALL(glPolygonOffset(POLYGON_OFFSET_FACTOR, POLYGON_OFFSET_UNITS));
+	mapsData.clear();
+	for (auto &&v : visible)
+	{
+		auto it = allocations.find(v.second);
+		if (it == allocations.end())
+			continue;
+		Allocation &a = it->second;
+		const LightsBuffer::TLightProperties &light = lights->getWorldProperties(v.second);
+		const float range = lights->getEyeProperties(v.second).range;
+		bool due = true;
+		if (a.type != Directional)
+		{
+			//Smaller (less important) tiles are re-rendered less frequently, offset by light so that updates are spread across frames
+			const unsigned int interval = maxTileSize / a.tileSize;
+			const bool moved = light.position != a.position || light.spotDirection != a.direction || light.spotCutoff != a.cutoff || range != a.range;
+			due = moved || !a.lastRendered || (frame + v.second) % interval == 0;
+		}
+		if (due)
+		{
+			calculateMatrices(light, range, a);
+			if (a.type == Directional)
+			{//Casters beyond the near plane are clamped to it, so that the cascades can be fitted tightly to the receivers
+				GL_CALL(glEnable(GL_DEPTH_CLAMP));
+			}
+			for (unsigned int t = 0; t < a.tiles.size(); ++t)
+				renderTile(a.tiles[t], a.tileSize, a.viewProjection[t]);
+			if (a.type == Directional)
+			{
+				GL_CALL(glDisable(GL_DEPTH_CLAMP));
+			}
+			a.lastRendered = frame;
+			a.position = light.position;
+			a.direction = light.spotDirection;
+			a.cutoff = light.spotCutoff;
+			a.range = range;
+		}
+		lights->setShadow(v.second, (int)mapsData.size(), (unsigned int)a.tiles.size());
+		for (unsigned int t = 0; t < a.tiles.size(); ++t)
+		{
+			ShadowMap m;
+			m.eyeToLight = a.viewProjection[t] * inverseView;
+			m.tile = glm::vec4(glm::vec2(a.tiles[t]), glm::vec2((float)a.tileSize)) / (float)atlasSize;
+			mapsData.push_back(m);
+		}
+	}
+	GL_CALL(glDisable(GL_POLYGON_OFFSET_FILL));
+	GL_CALL(glDisable(GL_SCISSOR_TEST));
+	//Upload the maps, and any lights whose shadow indices have changed
+	if (mapsData.size() > mapsCapacity)
+	{
+		while (mapsCapacity < mapsData.size())
+			mapsCapacity *= 2;
+		maps->setData(nullptr, mapsCapacity * sizeof(ShadowMap));
+	}
+	if (!mapsData.empty())
+		maps->setData(mapsData.data(), mapsData.size() * sizeof(ShadowMap), 0);
+	lights->update();
+}
+void ShadowPass::calculateMatrices(const LightsBuffer::TLightProperties &light, float range, Allocation &allocation) const
+{
+	const glm::vec3 position(light.position);
+	const glm::vec3 direction = glm::normalize(glm::vec3(light.spotDirection));
+	const float zFar = range > 0 ? range : shadowDistance;
+	const float zNear = zFar * NEAR_RATIO;
+	allocation.viewProjection.resize(allocation.tiles.size());
+	if (allocation.type == Spot)
+	{
+		const float fov = glm::min(2.0f * light.spotCutoff + SPOT_FOV_MARGIN, SPOT_FOV_MAX);
+		allocation.viewProjection[0] = glm::perspective(fov, 1.0f, zNear, zFar) * glm::lookAt(position, position + direction, upVector(direction));
+	}
+	else if (allocation.type == Point)
+	{
+		const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, zNear, zFar);
+		for (unsigned int f = 0; f < 6; ++f)
+			allocation.viewProjection[f] = projection * glm::lookAt(position, position + CUBE_FACES[f][0], CUBE_FACES[f][1]);
+	}
+	else
+	{
+		fitCascades(direction, allocation);
+	}
+}
+void ShadowPass::fitCascades(const glm::vec3 &direction, Allocation &allocation) const
+{
+	const glm::mat4 &projection = *projMatPtr;
+	//Recover the clip planes from the perspective projection
+	const float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+	float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+	if (!std::isfinite(zFar) || zFar <= zNear)
+		zFar = shadowDistance;//Infinite far plane
+	zFar = glm::min(zFar, shadowDistance);
+	//Eye space rays through the corners of the screen, scaled to unit depth
+	const glm::mat4 inverseProjection = glm::inverse(projection);
+	glm::vec3 rays[4];
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		const glm::vec4 corner = inverseProjection * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, -1.0f, 1.0f);
+		rays[i] = glm::vec3(corner) / corner.w;
+		rays[i] /= -rays[i].z;
+	}
+	//Rotation only light view, the camera's eye space is transformed straight into it
+	const glm::mat4 lightView = glm::lookAt(glm::vec3(0), direction, upVector(direction));
+	const glm::mat4 eyeToLightView = lightView * glm::inverse(*viewMatPtr);
+	float splitNear = zNear;
+	for (unsigned int c = 0; c < allocation.tiles.size(); ++c)
+	{
+		//Practical split scheme, blends logarithmic and uniform splits
+		const float ratio = (c + 1) / (float)allocation.tiles.size();
+		const float splitFar = splitLambda * zNear * std::pow(zFar / zNear, ratio) + (1.0f - splitLambda) * (zNear + (zFar - zNear) * ratio);
+		//Bound the slice's corners in light space
+		glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			const glm::vec3 corner = glm::vec3(eyeToLightView * glm::vec4(rays[i & 3] * (i & 4 ? splitFar : splitNear), 1.0f));
+			min = glm::min(min, corner);
+			max = glm::max(max, corner);
+		}
+		//Snap to whole texels, so that the cascade does not shimmer as the camera translates
+		const glm::vec2 texel = (glm::vec2(max) - glm::vec2(min)) / (float)allocation.tileSize;
+		if (texel.x > 0 && texel.y > 0)
+		{
+			const glm::vec2 snapped = glm::floor(glm::vec2(min) / texel) * texel;
+			max = glm::vec3(glm::vec2(max) + glm::vec2(min) - snapped, max.z);
+			min = glm::vec3(snapped, min.z);
+		}
+		//The light looks down -z
+		allocation.viewProjection[c] = glm::ortho(min.x, max.x, min.y, max.y, -max.z, -min.z) * lightView;
+		splitNear = splitFar;
+	}
+}
+void ShadowPass::renderTile(const glm::uvec2 &offset, unsigned int tileSize, const glm::mat4 &viewProjection)
+{
+	GL_CALL(glViewport(offset.x, offset.y, tileSize, tileSize));
+	GL_CALL(glScissor(offset.x, offset.y, tileSize, tileSize));
+	GL_CALL(glClear(GL_DEPTH_BUFFER_BIT));
+	//The light's view is folded into the projection, the caster's shaders only require the combined matrix
+	casterProjection = viewProjection;
+	for (auto &&caster : casters)
+		caster();
+	++tilesRendered;
+}
+
+ShadowPass::TileAllocator::TileAllocator(unsigned int size)
+	: size(size)
+	, freeTiles(levelOf(MIN_TILE_SIZE) + 1)
+{
+	freeTiles[0].insert({ 0, 0 });
+}
+unsigned int ShadowPass::TileAllocator::levelOf(unsigned int tileSize) const
+{
+	unsigned int level = 0;
+	while ((size >> level) > tileSize)
+		++level;
+	return level;
+}
+bool ShadowPass::TileAllocator::allocate(unsigned int tileSize, glm::uvec2 &offset)
+{
+	const unsigned int level = levelOf(tileSize);
+	if (level >= freeTiles.size())
+		return false;
+	//Find the smallest free tile which is large enough
+	int l = (int)level;
+	while (l >= 0 && freeTiles[l].empty())
+		--l;
+	if (l < 0)
+		return false;
+	std::pair<unsigned int, unsigned int> tile = *freeTiles[l].begin();
+	freeTiles[l].erase(freeTiles[l].begin());
+	//Split it down to the requested size, keeping the first quadrant
+	for (; l < (int)level; ++l)
+	{
+		const unsigned int half = size >> (l + 1);
+		freeTiles[l + 1].insert({ tile.first + half, tile.second });
+		freeTiles[l + 1].insert({ tile.first, tile.second + half });
+		freeTiles[l + 1].insert({ tile.first + half, tile.second + half });
+	}
+	offset = glm::uvec2(tile.first, tile.second);
+	return true;
+}
+void ShadowPass::TileAllocator::release(glm::uvec2 offset, unsigned int tileSize)
+{
+	unsigned int level = levelOf(tileSize);
+	//Merge with the siblings whilst they are all free
+	for (; level > 0; --level)
+	{
+		const unsigned int parentSize = size >> (level - 1);
+		const glm::uvec2 parent = (offset / parentSize) * parentSize;
+		const unsigned int half = parentSize / 2;
+		std::pair<unsigned int, unsigned int> siblings[3];
+		unsigned int s = 0;
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			const std::pair<unsigned int, unsigned int> child(parent.x + (i & 1 ? half : 0), parent.y + (i & 2 ? half : 0));
+			if (child != std::make_pair(offset.x, offset.y))
+				siblings[s++] = child;
+		}
+		auto &tiles = freeTiles[level];
+		if (!tiles.count(siblings[0]) || !tiles.count(siblings[1]) || !tiles.count(siblings[2]))
+			break;
+		for (auto &&sibling : siblings)
+			tiles.erase(sibling);
+		offset = parent;
+	}
+	freeTiles[level].insert({ offset.x, offset.y });
+}
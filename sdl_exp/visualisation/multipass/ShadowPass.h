@@ -0,0 +1,233 @@
+#ifndef __ShadowPass_h__
+#define __ShadowPass_h__
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+#include "RenderPass.h"
+#include "../shader/buffer/ShaderStorageBuffer.h"
+#include "../shader/lights/LightsBuffer.h"
+#include "../texture/Texture.h"
+
+/**
+ * Renders shadow maps for every light with CastShadows() enabled into a single depth atlas
+ * Directional lights receive cascades fitted to slices of the camera's view frustum, these are re-rendered every frame
+ * Spot lights receive a single perspective map, point lights a map per cube face
+ * Spot/point light tiles are allocated on demand, sized by the light's projected size on screen
+ * Lights outside of the view frustum release their tiles, smaller tiles are re-rendered less frequently
+ * Each light's range of maps is passed to shaders via LightsBuffer (LightProperties::shadowIndex/shadowCount)
+ * Shaders built with the SHADOW_MAPS define (see include/shadow_maps.glsl) apply the shadows
+ * @note This pass must be rendered after LightsBuffer::update() and before any receivers
+ */
+class ShadowPass : public RenderPass
+{
+public:
+	/**
+	 * Matches an element of the _shadowMaps storage block (std430)
+	 */
+	struct ShadowMap
+	{
+		/**
+		 * Transforms from the camera's eye space to the light's clip space
+		 */
+		glm::mat4 eyeToLight;
+		/**
+		 * xy: offset, zw: scale of the map's tile within the atlas, in texture coordinates
+		 */
+		glm::vec4 tile;
+	};
+	static const char *ATLAS_UNIFORM_NAME;//="_shadowAtlas"
+	static const char *MAPS_BLOCK_NAME;//="_shadowMaps"
+	static const unsigned int DEFAULT_ATLAS_SIZE = 4096;
+	/**
+	 * The largest tile a single spot light can receive, point lights receive 6 tiles of half this size
+	 */
+	static const unsigned int DEFAULT_MAX_TILE_SIZE = 1024;
+	static const unsigned int MIN_TILE_SIZE = 64;
+	static const unsigned int DEFAULT_CASCADE_COUNT = 4;
+	static const unsigned int DEFAULT_CASCADE_SIZE = 1024;
+	/**
+	 * @param lights The lights to be shadowed
+	 * @param viewMatPtr The camera's view matrix
+	 * @param projMatPtr The camera's projection matrix
+	 * @param atlasSize Width and height of the depth atlas, must be a power of two
+	 */
+	ShadowPass(std::shared_ptr<LightsBuffer> lights, const glm::mat4 *viewMatPtr, const glm::mat4 *projMatPtr, unsigned int atlasSize = DEFAULT_ATLAS_SIZE);
+	/**
+	 * Registers an Entity or Model to be rendered into shadow maps
+	 * The shaders at shaderIndex are pointed at the pass's light matrices, a depth only shader such as Stock::Shaders::DEPTH should be used
+	 * @param caster The Entity or Model
+	 * @param shaderIndex Index of the caster's depth shader
+	 * @note Must be called after the caster has been registered with the scene, otherwise its matrices will be overwritten
+	 */
+	template<class T>
+	void addCaster(const std::shared_ptr<T> &caster, unsigned int shaderIndex);
+	/**
+	 * Passes the atlas and shadow maps to an Entity or Model's shaders
+	 * @param receiver The Entity or Model
+	 * @param shaderIndex Index of the receiver's shader, which should be built with the SHADOW_MAPS define
+	 */
+	template<class T>
+	void addReceiver(const std::shared_ptr<T> &receiver, unsigned int shaderIndex);
+	/**
+	 * Configures directional light cascades, existing allocations are released
+	 * @param count The number of cascades per directional light
+	 * @param size Width and height of each cascade's tile, must be a power of two
+	 */
+	void setCascades(unsigned int count, unsigned int size = DEFAULT_CASCADE_SIZE);
+	/**
+	 * @param distance Cascades do not extend beyond this distance from the camera, this is also the range of unbounded spot/point lights
+	 * @note Default value 200
+	 */
+	void setShadowDistance(float distance) { shadowDistance = distance; }
+	/**
+	 * @param lambda Blend between logarithmic (1) and uniform (0) cascade splits
+	 * @note Default value 0.75
+	 */
+	void setSplitLambda(float lambda) { splitLambda = lambda; }
+	/**
+	 * @param size The largest tile a single spot light can receive, must be a power of two
+	 */
+	void setMaxTileSize(unsigned int size);
+	std::shared_ptr<Texture> getAtlas() const { return atlas; }
+	/**
+	 * Returns the number of tiles rendered by the most recent render()
+	 */
+	unsigned int getTilesRendered() const { return tilesRendered; }
+protected:
+	/**
+	 * Assigns atlas tiles to visible lights, re-renders those which are due and updates the lights' shadow indices
+	 */
+	void render() override;
+private:
+	/**
+	 * Quadtree (buddy) allocator of square, power of two tiles within the atlas
+	 */
+	class TileAllocator
+	{
+	public:
+		TileAllocator(unsigned int size);
+		/**
+		 * @param tileSize Width and height of the requested tile, must be a power of two
+		 * @param offset Returns the tile's offset within the atlas
+		 * @return false if there is no space
+		 */
+		bool allocate(unsigned int tileSize, glm::uvec2 &offset);
+		/**
+		 * Returns a tile, merging it with its siblings where possible
+		 */
+		void release(glm::uvec2 offset, unsigned int tileSize);
+	private:
+		unsigned int levelOf(unsigned int tileSize) const;
+		const unsigned int size;
+		/**
+		 * Free tiles at each level of the quadtree, level 0 is the whole atlas
+		 */
+		std::vector<std::set<std::pair<unsigned int, unsigned int>>> freeTiles;
+	};
+	enum LightType { Point, Spot, Directional };
+	/**
+	 * The tiles held by a single light
+	 */
+	struct Allocation
+	{
+		LightType type;
+		unsigned int tileSize;
+		/**
+		 * The tile size the light wanted, tileSize is smaller if the atlas couldn't fit it
+		 */
+		unsigned int requestedSize;
+		/**
+		 * Value of ShadowPass::atlasReleases once the tiles were allocated
+		 * A light which received smaller tiles than requested only retries once other tiles have since been released
+		 */
+		unsigned long long atlasReleases;
+		std::vector<glm::uvec2> tiles;
+		/**
+		 * World to light clip space matrix, that each tile was last rendered with
+		 */
+		std::vector<glm::mat4> viewProjection;
+		/**
+		 * Frame the tiles were last rendered, such that updates can be staggered
+		 */
+		unsigned long long lastRendered;
+		/**
+		 * Light state the tiles were last rendered with, tiles are re-rendered immediately if it changes
+		 */
+		glm::vec4 position, direction;
+		float cutoff, range;
+	};
+	/**
+	 * Releases the light's tiles and clears its shadow indices
+	 */
+	void release(unsigned int lightIndex);
+	void releaseAll();
+	/**
+	 * Calculates the fraction of the screen covered by the light's range, 0 if it is outside the view frustum
+	 */
+	float calculateImportance(const LightProperties &eyeLight) const;
+	/**
+	 * Calculates the light's world to light clip space matrices, one per tile
+	 */
+	void calculateMatrices(const LightsBuffer::TLightProperties &light, float range, Allocation &allocation) const;
+	/**
+	 * Fits each of a directional light's cascades to its slice of the camera frustum
+	 */
+	void fitCascades(const glm::vec3 &direction, Allocation &allocation) const;
+	/**
+	 * Renders every caster into the tile
+	 */
+	void renderTile(const glm::uvec2 &offset, unsigned int tileSize, const glm::mat4 &viewProjection);
+	std::shared_ptr<LightsBuffer> lights;
+	const glm::mat4 *viewMatPtr;
+	const glm::mat4 *projMatPtr;
+	const unsigned int atlasSize;
+	std::shared_ptr<Texture> atlas;
+	std::shared_ptr<ShaderStorageBuffer> maps;
+	/**
+	 * The number of ShadowMaps the storage buffer currently has space for
+	 */
+	unsigned int mapsCapacity;
+	std::vector<ShadowMap> mapsData;
+	TileAllocator allocator;
+	/**
+	 * Key: Light index
+	 * Val: The light's tiles
+	 */
+	std::map<unsigned int, Allocation> allocations;
+	/**
+	 * Incremented each time release() returns tiles to the atlas
+	 */
+	unsigned long long atlasReleases;
+	std::vector<std::function<void()>> casters;
+	/**
+	 * Matrices the casters' shaders track, updated before each tile is rendered
+	 */
+	glm::mat4 casterView;
+	glm::mat4 casterProjection;
+	unsigned int cascadeCount;
+	unsigned int cascadeSize;
+	unsigned int maxTileSize;
+	float shadowDistance;
+	float splitLambda;
+	unsigned long long frame;
+	unsigned int tilesRendered;
+};
+
+template<class T>
+void ShadowPass::addCaster(const std::shared_ptr<T> &caster, unsigned int shaderIndex)
+{
+	auto shaders = caster->getShaders(shaderIndex);
+	shaders->setViewMatPtr(&casterView);
+	shaders->setProjectionMatPtr(&casterProjection);
+	casters.push_back([caster, shaderIndex](){ caster->render(shaderIndex); });
+}
+template<class T>
+void ShadowPass::addReceiver(const std::shared_ptr<T> &receiver, unsigned int shaderIndex)
+{
+	auto shaders = receiver->getShaders(shaderIndex);
+	shaders->addTexture(ATLAS_UNIFORM_NAME, atlas);
+	shaders->addBuffer(MAPS_BLOCK_NAME, maps);
+}
+
+#endif //__ShadowPass_h__
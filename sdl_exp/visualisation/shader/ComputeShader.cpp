@@ -3,13 +3,17 @@
 ComputeShader::ComputeShader(const char *path, glm::uvec3 defaultLaunchConfig)
 	: ComputeShader(std::initializer_list<const char *>{ path }, defaultLaunchConfig)
 { }
-ComputeShader::ComputeShader(std::initializer_list<const char *> paths, glm::uvec3 defaultLaunchConfig)
+ComputeShader::ComputeShader(std::initializer_list<const char *> paths, glm::uvec3 defaultLaunchConfig, const Defines &defines)
 	: ShaderCore()
 	, lastLaunchConfig(defaultLaunchConfig)
 	, shaderFilePaths(buildFileVector(paths))
 {
+	this->defines = defines;
 	reload();
 }
+ComputeShader::ComputeShader(const char *path, const Defines &defines)
+	: ComputeShader(std::initializer_list<const char *>{ path }, glm::uvec3(0), defines)
+{ }
 ComputeShader::ComputeShader(const ComputeShader&other)
 	: ShaderCore(other)
 	, lastLaunchConfig(other.lastLaunchConfig)
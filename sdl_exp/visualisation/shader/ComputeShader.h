@@ -25,9 +25,16 @@ public:
 	 * Use this constructor if you wish to constructor a shader from multiple files (e.g. a common functions file)
 	 * @param paths Init list of file paths to be included in the shader
 	 * @param defaultLaunchConfig Default launch config (useful if you will be using the same config each launch)
+	 * @param defines Preprocessor definitions injected into the source
 	 * @note The file containing main() should be the final item (this is just an assumption)
 	 */
-	ComputeShader(std::initializer_list<const char *> paths, glm::uvec3 defaultLaunchConfig = glm::uvec3(0));
+	ComputeShader(std::initializer_list<const char *> paths, glm::uvec3 defaultLaunchConfig = glm::uvec3(0), const Defines &defines = Defines());
+	/**
+	 * Creates a permutation of a compute shader from a single source file
+	 * @param path File path to be included in the shader
+	 * @param defines Preprocessor definitions injected into the source
+	 */
+	ComputeShader(const char *path, const Defines &defines);
 	/**
 	 * Copy constructor
 	 */
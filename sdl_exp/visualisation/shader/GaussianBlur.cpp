@@ -1,74 +1,270 @@
 #include "GaussianBlur.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <glm/gtc/type_ptr.hpp>
 
+namespace
+{
+	/**
+	 * Must match WORKGROUP_SIZE in gaussian_blur.comp
+	 */
+	const unsigned int SEPARABLE_WORKGROUP_SIZE = 128;
+	/**
+	 * Must match local_size_x/y in image_resample.comp
+	 */
+	const unsigned int RESAMPLE_WORKGROUP_SIZE = 16;
+}
+const char *GaussianBlur::formatQualifier(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R32F:
+		return "r32f";
+	case GL_RGBA16F:
+		return "rgba16f";
+	case GL_RGBA8:
+		return "rgba8";
+	default:
+		return nullptr;
+	}
+}
 
 GaussianBlur::GaussianBlur(unsigned int filterRadius, float sigma)
 	: sigma(sigma)
-	, filterRadius(glm::clamp<unsigned int>(filterRadius, 0, 16))
-	, filterWidth(2 * glm::clamp<unsigned int>(filterRadius, 0, 16) + 1)
-	, blurShader(std::make_shared<ComputeShader>(GAUSSIAN_BLUR_SHADER_PATH))
-	, filter(nullptr)
+	, filterRadius(filterRadius)
+	, passRadius(UINT_MAX)
+	, passSigma(0.0f)
+	, filterBuffer(std::make_shared<UniformBuffer>(sizeof(passWeights)))
+	, direction(1, 0)
+	, tapOffset(1.0f)
 {
-	if (filterRadius != this->filterRadius)
-		fprintf(stderr, "Gaussian filter radius was clamped from %d to %d.\n", filterRadius, this->filterRadius);
 	//For the time being we will allocate ourselves the final 2 image units
 	this->inBufferBind = 0;
 	this->outBufferBind = 1;
-	//Generate the Gaussian filter (manually at current)
-	this->filter = (float*)malloc(filterWidth*sizeof(float));
-	generateFilter();
-	//Copy that to a uniform buffer
-	filterBuffer = std::make_shared<UniformBuffer>(filterWidth*sizeof(float), this->filter);
-	//Configure uniforms
-	blurShader->addBuffer("_filterWeights", this->filterBuffer);
-	blurShader->addStaticUniform("_filterRadius", &this->filterRadius);
-	blurShader->addStaticUniform("_filterWidth", &this->filterWidth);
-	blurShader->addStaticUniform("_imageIn", &this->inBufferBind);
-	blurShader->addStaticUniform("_imageOut", &this->outBufferBind);
-	blurShader->addDynamicUniform("_imageDimensions", glm::value_ptr(this->imageDimensions), 2);
 }
 GaussianBlur::~GaussianBlur()
 {
+	for (auto &&image : images)
+	{
+		GL_CALL(glDeleteTextures(1, &image.second));
+	}
+	shaders.clear();
 	this->filterBuffer.reset();
-	free(filter);
 }
-void GaussianBlur::generateFilter()
+void GaussianBlur::setFilter(unsigned int filterRadius, float sigma)
+{
+	this->filterRadius = filterRadius;
+	this->sigma = sigma;
+}
+std::vector<float> GaussianBlur::makeWeights(unsigned int filterRadius, float sigma)
 {//http://www.stat.wisc.edu/~mchung/teaching/MIA/reading/diffusion.gaussian.kernel.pdf.pdf
-	//Count filter, so it can be normalised
+	std::vector<float> rtn(filterRadius + 1, 0.0f);
+	if (sigma <= 0.0f)
+	{
+		rtn[0] = 1.0f;
+		return rtn;
+	}
+	//Count filter, so it can be normalised (outer taps appear on both sides)
 	float c = 0.0f;
-	//Fill filter without sigma
-	//unsigned int i = 0;
-	//for (unsigned int x = 0; x < filterWidth; ++x)
-	//{
-	//    filter[x] = (float)(x <= filterRadius ? ++i : --i);
-	//    c += filter[x];
-	//}
-	//Fill filter with sigma
-	int i = filterRadius;
-	for (unsigned int x = 0; x < filterWidth; ++x)
+	for (unsigned int x = 0; x <= filterRadius; ++x)
 	{
-		float _j = (float)(x < filterRadius ? i-- : i++);
-		filter[x] = (1.0f / (sqrt(2.0f*glm::pi<float>())*this->sigma))*glm::exp(-(_j*_j) / (2 * this->sigma*this->sigma));
-		c += filter[x];
+		rtn[x] = (1.0f / (sqrt(2.0f*glm::pi<float>())*sigma))*glm::exp(-(float)(x*x) / (2 * sigma*sigma));
+		c += x ? 2 * rtn[x] : rtn[x];
 	}
 	//Normalise filter
-	for (unsigned int x = 0; x < filterWidth; ++x)
+	for (auto &&w : rtn)
+		w /= c;
+	return rtn;
+}
+void GaussianBlur::setPassFilter(unsigned int radius, float sigma)
+{
+	if (radius == passRadius && sigma == passSigma)
+		return;
+	passRadius = radius;
+	passSigma = sigma;
+	const std::vector<float> weights = makeWeights(radius, sigma);
+	float *packed = glm::value_ptr(passWeights[0]);
+	std::fill(packed, packed + 4 * (sizeof(passWeights) / sizeof(glm::vec4)), 0.0f);
+	std::copy(weights.begin(), weights.end(), packed);
+	filterBuffer->setData(passWeights, sizeof(passWeights), 0);
+}
+ComputeShader &GaussianBlur::getShader(Shader kind, GLenum internalFormat)
+{
+	std::unique_ptr<ComputeShader> &shader = shaders[{ kind, internalFormat }];
+	if (!shader)
 	{
-		filter[x] /= c;
+		ComputeShader::Defines defines = { { "IMAGE_FORMAT", formatQualifier(internalFormat) } };
+		if (kind == BoxDownsample)
+			defines["BOX_DOWNSAMPLE"] = "";
+		else if (kind == BilinearUpsample)
+			defines["BILINEAR_UPSAMPLE"] = "";
+		else if (kind == DualDownsample)
+			defines["DUAL_DOWNSAMPLE"] = "";
+		else if (kind == DualUpsample)
+			defines["DUAL_UPSAMPLE"] = "";
+		shader = std::make_unique<ComputeShader>(kind == SeparablePass ? GAUSSIAN_BLUR_SHADER_PATH : RESAMPLE_SHADER_PATH, defines);
+		shader->addStaticUniform("_imageIn", &this->inBufferBind);
+		shader->addStaticUniform("_imageOut", &this->outBufferBind);
+		shader->addDynamicUniform("_inDimensions", glm::value_ptr(this->inDimensions), 2);
+		if (kind == SeparablePass)
+		{
+			shader->addBuffer("_filterWeights", this->filterBuffer);
+			shader->addDynamicUniform("_filterRadius", &this->passRadius);
+			shader->addDynamicUniform("_direction", glm::value_ptr(this->direction), 2);
+		}
+		else
+		{
+			shader->addDynamicUniform("_outDimensions", glm::value_ptr(this->outDimensions), 2);
+			if (kind == DualDownsample || kind == DualUpsample)
+				shader->addDynamicUniform("_offset", &this->tapOffset);
+		}
 	}
+	return *shader;
 }
-void GaussianBlur::blurR32F(GLuint inTex, GLuint outTex, glm::uvec2 texDims)
+GLuint GaussianBlur::getImage(glm::uvec2 dims, GLenum internalFormat, unsigned int slot)
 {
+	const auto key = std::make_tuple(dims.x, dims.y, internalFormat, slot);
+	auto it = images.find(key);
+	if (it != images.end())
+		return it->second;
+	GLint previous = 0;
+	GLuint name = 0;
+	GL_CALL(glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous));
+	GL_CALL(glGenTextures(1, &name));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, name));
+	GL_CALL(glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, dims.x, dims.y));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, previous));
+	images.emplace(key, name);
+	return name;
+}
+void GaussianBlur::pass(Shader kind, GLuint inTex, glm::uvec2 inDims, GLuint outTex, glm::uvec2 outDims, GLenum internalFormat)
+{
+	ComputeShader &shader = getShader(kind, internalFormat);
 	//Update shader config
-	this->imageDimensions = texDims;
-	blurShader->useProgram();
-	GL_CALL(glBindImageTexture(this->inBufferBind, inTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F));
-	GL_CALL(glBindImageTexture(this->outBufferBind, outTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F));
-	blurShader->launch((texDims / glm::uvec2(16)) + glm::uvec2(1));
-	//Synchronise written memory
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	this->inDimensions = inDims;
+	this->outDimensions = outDims;
+	shader.useProgram();
+	GL_CALL(glBindImageTexture(this->inBufferBind, inTex, 0, GL_FALSE, 0, GL_READ_ONLY, internalFormat));
+	GL_CALL(glBindImageTexture(this->outBufferBind, outTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, internalFormat));
+	if (kind == SeparablePass)
+	{//One workgroup per run of pixels along the pass direction
+		const unsigned int length = direction.x ? outDims.x : outDims.y;
+		const unsigned int rows = direction.x ? outDims.y : outDims.x;
+		shader.launch((length + SEPARABLE_WORKGROUP_SIZE - 1) / SEPARABLE_WORKGROUP_SIZE, rows);
+	}
+	else
+	{
+		shader.launch((outDims + glm::uvec2(RESAMPLE_WORKGROUP_SIZE - 1)) / glm::uvec2(RESAMPLE_WORKGROUP_SIZE));
+	}
+	//The next pass reads this pass's output
+	GL_CALL(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+}
+void GaussianBlur::blur(GLuint inTex, GLuint outTex, glm::uvec2 texDims, GLenum internalFormat)
+{
+	if (!formatQualifier(internalFormat))
+	{
+		fprintf(stderr, "GaussianBlur::blur(): Unsupported internal format 0x%x.\n", internalFormat);
+		return;
+	}
+	//Halve the resolution until the radius can be covered by a single pass
+	unsigned int radius = filterRadius;
+	float s = sigma;
+	unsigned int levels = 0;
+	while (radius > MAX_PASS_RADIUS)
+	{
+		radius = (radius + 1) / 2;
+		s *= 0.5f;
+		++levels;
+	}
+	setPassFilter(radius, s);
+	std::vector<glm::uvec2> dims = { texDims };
+	std::vector<GLuint> level = { inTex };
+	for (unsigned int l = 1; l <= levels; ++l)
+	{
+		dims.push_back(glm::max((dims.back() + 1u) / 2u, glm::uvec2(1)));
+		level.push_back(getImage(dims.back(), internalFormat, 0));
+		pass(BoxDownsample, level[l - 1], dims[l - 1], level[l], dims[l], internalFormat);
+	}
+	//Horizontal then vertical, via an intermediate image
+	const GLuint temp = getImage(dims.back(), internalFormat, 1);
+	direction = glm::uvec2(1, 0);
+	pass(SeparablePass, level.back(), dims.back(), temp, dims.back(), internalFormat);
+	direction = glm::uvec2(0, 1);
+	pass(SeparablePass, temp, dims.back(), levels ? level.back() : outTex, dims.back(), internalFormat);
+	//Upsample back to full resolution, an octave at a time
+	for (unsigned int l = levels; l > 0; --l)
+		pass(BilinearUpsample, level[l], dims[l], l > 1 ? level[l - 1] : outTex, dims[l - 1], internalFormat);
+	//Synchronise written memory, for both image and sampler access
+	GL_CALL(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT));
+}
+void GaussianBlur::dualFilter(GLuint inTex, GLuint outTex, glm::uvec2 texDims, GLenum internalFormat, unsigned int iterations, float offset)
+{
+	if (!formatQualifier(internalFormat))
+	{
+		fprintf(stderr, "GaussianBlur::dualFilter(): Unsupported internal format 0x%x.\n", internalFormat);
+		return;
+	}
+	iterations = glm::max(iterations, 1u);
+	tapOffset = offset;
+	std::vector<glm::uvec2> dims = { texDims };
+	std::vector<GLuint> level = { inTex };
+	for (unsigned int l = 1; l <= iterations; ++l)
+	{
+		dims.push_back(glm::max((dims.back() + 1u) / 2u, glm::uvec2(1)));
+		level.push_back(getImage(dims.back(), internalFormat, 0));
+		pass(DualDownsample, level[l - 1], dims[l - 1], level[l], dims[l], internalFormat);
+	}
+	//Each level's downsampled result is no longer required once the level below has been produced, so it is overwritten
+	for (unsigned int l = iterations; l > 0; --l)
+		pass(DualUpsample, level[l], dims[l], l > 1 ? level[l - 1] : outTex, dims[l - 1], internalFormat);
+	//Synchronise written memory, for both image and sampler access
+	GL_CALL(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT));
 }
 void GaussianBlur::reload()
 {
-	blurShader->reload();
-}
\ No newline at end of file
+	for (auto &&shader : shaders)
+		shader.second->reload();
+}
+void GaussianBlur::reference(const float *in, float *out, glm::uvec2 dims, unsigned int channels, unsigned int filterRadius, float sigma)
+{
+	const std::vector<float> weights = makeWeights(filterRadius, sigma);
+	std::vector<float> temp(dims.x * dims.y * channels);
+	const int r = (int)filterRadius;
+	//Horizontal pass
+	for (int y = 0; y < (int)dims.y; ++y)
+	{
+		for (int x = 0; x < (int)dims.x; ++x)
+		{
+			for (unsigned int c = 0; c < channels; ++c)
+			{
+				float sum = 0.0f;
+				for (int i = -r; i <= r; ++i)
+				{
+					const int sx = glm::clamp(x + i, 0, (int)dims.x - 1);
+					sum += weights[std::abs(i)] * in[(y * dims.x + sx) * channels + c];
+				}
+				temp[(y * dims.x + x) * channels + c] = sum;
+			}
+		}
+	}
+	//Vertical pass
+	for (int y = 0; y < (int)dims.y; ++y)
+	{
+		for (int x = 0; x < (int)dims.x; ++x)
+		{
+			for (unsigned int c = 0; c < channels; ++c)
+			{
+				float sum = 0.0f;
+				for (int i = -r; i <= r; ++i)
+				{
+					const int sy = glm::clamp(y + i, 0, (int)dims.y - 1);
+					sum += weights[std::abs(i)] * temp[(sy * dims.x + x) * channels + c];
+				}
+				out[(y * dims.x + x) * channels + c] = sum;
+			}
+		}
+	}
+}
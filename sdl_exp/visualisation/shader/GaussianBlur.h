@@ -2,33 +2,63 @@
 #define __GaussianBlur_h__
 #include "ComputeShader.h"
 #include "buffer/UniformBuffer.h"
+#include <map>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 class Texture2D;
 
 /**
- * Provides convenient compute shader Gaussian blur functionality
- * Currently only supports 2D textures of format R32F (single channel textures)
- * Following the existing code it would be trivial to add multi-channel versions
- * The max filter width is limited by the max permitted shader shared memory, work group size and channels.
- * The minimum required shared memory is 32kb, aka 8k single precision floating point values
+ * Provides convenient compute shader image filters
+ * Gaussian blur is performed as separate horizontal and vertical passes via an intermediate image
+ * Radii beyond MAX_PASS_RADIUS are blurred at a reduced resolution (downsample, blur, upsample)
+ * dualFilter() provides a cheaper, approximately Gaussian, blur suited to bloom
+ * Supported formats: GL_R32F, GL_RGBA16F, GL_RGBA8
+ * @note reference() provides a CPU implementation of the Gaussian blur, for correctness tests
  */
 class GaussianBlur : public Reloadable
 {
 	const char *GAUSSIAN_BLUR_SHADER_PATH = "gaussian_blur.comp";
+	const char *RESAMPLE_SHADER_PATH = "image_resample.comp";
 public:
 	/**
-	 * Builds the compute shader and preconfigures the weights
+	 * The largest radius blurred at full resolution
+	 * @note Must match MAX_RADIUS in gaussian_blur.comp
+	 */
+	static const unsigned int MAX_PASS_RADIUS = 32;
+	/**
+	 * Preconfigures the weights, shaders are built on first use of each format
 	 */
 	GaussianBlur(unsigned int filterRadius, float sigma = 1.0f);
 	~GaussianBlur();
+	/**
+	 * Changes the filter, without rebuilding the shaders
+	 */
+	void setFilter(unsigned int filterRadius, float sigma);
+	unsigned int getFilterRadius() const { return filterRadius; }
+	float getSigma() const { return sigma; }
+	/**
+	 * Blurs inTex into outTex according to the filter
+	 * @param inTex Source texture to be blurred
+	 * @param outTex Destination texture to store result, may be the same as inTex
+	 * @param texDims Dimensions of the textures
+	 * @param internalFormat Internal format of both textures
+	 */
+	void blur(GLuint inTex, GLuint outTex, glm::uvec2 texDims, GLenum internalFormat);
+	/**
+	 * Blurs inTex into outTex according to the filter
+	 * @note This is a convenience function, implemented in Texture2D.cpp
+	 * @note Textures must have equal dimensions and format
+	 */
+	void blur(std::shared_ptr<Texture2D> inTex, std::shared_ptr<Texture2D> outTex);
 	/**
 	 * Blurs a GL_R32F format texture from inTex to outTex according to the constructed args
 	 * @param inTex Source texture to be blurred
 	 * @param outTex Destination texture to store result
 	 * @param texDims Dimensions of the texture to be blurred
 	 */
-	void blurR32F(GLuint inTex, GLuint outTex, glm::uvec2 texDims);
+	void blurR32F(GLuint inTex, GLuint outTex, glm::uvec2 texDims) { blur(inTex, outTex, texDims, GL_R32F); }
 	/**
 	 * Blurs a GL_R32F format texture from inTex to outTex according to the constructed args
 	 * @param inTex Source texture to be blurred
@@ -37,23 +67,89 @@ public:
 	 * @note Textures must have equal dimensions
 	 */
 	void blurR32F(std::shared_ptr<Texture2D> inTex, std::shared_ptr<Texture2D> outTex);
+	/**
+	 * Dual filter (Kawase style) blur, each iteration halves the resolution and the results are then upsampled back
+	 * Cost is roughly independent of the blur's width, which doubles with each iteration
+	 * @param inTex Source texture to be blurred
+	 * @param outTex Destination texture to store result, may be the same as inTex
+	 * @param texDims Dimensions of the textures
+	 * @param internalFormat Internal format of both textures
+	 * @param iterations The number of downsample steps
+	 * @param offset Distance of the filter taps, in source pixels
+	 */
+	void dualFilter(GLuint inTex, GLuint outTex, glm::uvec2 texDims, GLenum internalFormat, unsigned int iterations, float offset = 1.0f);
+	/**
+	 * @note This is a convenience function, implemented in Texture2D.cpp
+	 */
+	void dualFilter(std::shared_ptr<Texture2D> inTex, std::shared_ptr<Texture2D> outTex, unsigned int iterations, float offset = 1.0f);
 	/**
 	 * Slightly redundant reload
-	 * Reloads the internal shader
+	 * Reloads the internal shaders
 	 */
 	virtual void reload() override;
+	/**
+	 * Returns the normalised weights of the centre tap, followed by each tap outward
+	 */
+	static std::vector<float> makeWeights(unsigned int filterRadius, float sigma);
+	/**
+	 * CPU reference implementation of the full resolution separable blur, edges are clamped
+	 * @param in Source pixels, row major with interleaved channels
+	 * @param out Destination pixels, must not alias in
+	 * @param dims Dimensions of the image
+	 * @param channels Number of channels per pixel
+	 */
+	static void reference(const float *in, float *out, glm::uvec2 dims, unsigned int channels, unsigned int filterRadius, float sigma);
+	/**
+	 * @return The image format layout qualifier matching the internal format (e.g. "rgba16f"), nullptr if unsupported
+	 */
+	static const char *formatQualifier(GLenum internalFormat);
 private:
-	void generateFilter();
+	enum Shader { SeparablePass, BoxDownsample, BilinearUpsample, DualDownsample, DualUpsample };
+	/**
+	 * Returns the shader of the given kind for the format, building it if necessary
+	 */
+	ComputeShader &getShader(Shader kind, GLenum internalFormat);
+	/**
+	 * Returns an intermediate image, these persist between calls
+	 * @param slot Distinguishes multiple images of the same dimensions
+	 */
+	GLuint getImage(glm::uvec2 dims, GLenum internalFormat, unsigned int slot);
+	/**
+	 * Launches a single pass from inTex to outTex
+	 */
+	void pass(Shader kind, GLuint inTex, glm::uvec2 inDims, GLuint outTex, glm::uvec2 outDims, GLenum internalFormat);
+	/**
+	 * Uploads the weights of a pass with the given radius to filterBuffer, if they differ from the current pass
+	 */
+	void setPassFilter(unsigned int radius, float sigma);
+	float sigma;
+	unsigned int filterRadius;
 	//These are mapped to the shader uniforms
-	const float sigma;
-	const unsigned int filterRadius;
-	const unsigned int filterWidth;
-	glm::uvec2 imageDimensions;
+	/**
+	 * Radius and sigma of the current pass, reduced when blurring at a lower resolution
+	 */
+	GLuint passRadius;
+	float passSigma;
+	/**
+	 * Weights packed into vec4s, as std140 arrays of floats are padded to 16 bytes per element
+	 */
+	glm::vec4 passWeights[(MAX_PASS_RADIUS + 4) / 4];
 	std::shared_ptr<UniformBuffer> filterBuffer;
+	glm::uvec2 direction;
+	glm::uvec2 inDimensions;
+	glm::uvec2 outDimensions;
+	float tapOffset;
 	GLint inBufferBind;
 	GLint outBufferBind;
-	std::shared_ptr<ComputeShader> blurShader;
-	float *filter;
+	/**
+	 * Key: Shader kind, internal format
+	 */
+	std::map<std::pair<Shader, GLenum>, std::unique_ptr<ComputeShader>> shaders;
+	/**
+	 * Key: Width, height, internal format, slot
+	 * Val: GL name of an image allocated by glTexStorage2D()
+	 */
+	std::map<std::tuple<unsigned int, unsigned int, GLenum, unsigned int>, GLuint> images;
 };
 
-#endif //__GaussianBlur_h__
\ No newline at end of file
+#endif //__GaussianBlur_h__
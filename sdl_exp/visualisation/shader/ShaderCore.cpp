@@ -1,18 +1,30 @@
 #define  _CRT_SECURE_NO_WARNINGS
 #include "ShaderCore.h"
+#include "buffer/UniformBlockAllocator.h"
 #include <cstdlib> //<_splitpath() Windows only, need to rewrite linux ver
 #include <regex>
+#include <sstream>
+#include <algorithm>
 #include <glm/gtc/type_ptr.hpp>
 #include "../util/StringUtils.h"
 #include "Shaders.h"
+#include "../util/FileWatcher.h"
 
 bool ShaderCore::exitOnError = false;//Tempted to use pre-processor macros to swap this default to true on release mode
+std::unordered_map<std::string, ShaderCore::ProgramBinary> ShaderCore::programBinaries;
+std::string ShaderCore::programCacheDirectory = "./shader_cache/";
+std::set<ShaderCore*> ShaderCore::instances;
+unsigned int ShaderCore::errorLogVersion = 0;
 
 //Constructors/Destructors
 ShaderCore::ShaderCore()
 	: programId(-1)
 	, shaderTag("")
-{ }
+	, buildFromBinary(false)
+	, pendingProgram(0)
+{
+	instances.insert(this);
+}
 ShaderCore::ShaderCore(const ShaderCore &other)
 	: ShaderCore()
 {
@@ -34,57 +46,144 @@ ShaderCore::ShaderCore(const ShaderCore &other)
 		this->lostBuffers.push_back(BufferDetail(i.second));
 	for (const auto &i : other.lostBuffers)
 		this->lostBuffers.push_back(BufferDetail(i));
+	this->uniformBlocks = other.uniformBlocks;
+	//defines
+	this->defines = other.defines;
 }
 ShaderCore::~ShaderCore()
 {
+	cancelReload();
+	instances.erase(this);
+	if (!errorLog.empty())
+		++errorLogVersion;
 	if (this->shaderTag[0]!='\0') delete[] this->shaderTag;
 }
 //Core
 void ShaderCore::reload()
 {
 	GL_CHECK();
+	cancelReload();
+	GLuint t_programId = beginReload();
+	finishReload(t_programId, t_programId && finishBuild(t_programId));
+}
+void ShaderCore::reloadAsync()
+{
+	GL_CHECK();
+	cancelReload();
+	GLuint t_programId = beginReload();
+	if (t_programId)
+		pendingProgram = t_programId;
+	else
+		finishReload(0, false);
+}
+GLuint ShaderCore::beginReload()
+{
 	//Clear shadertag
 	if (this->shaderTag[0] != '\0') delete[] this->shaderTag;
 	this->shaderTag = "";
-	while (true)
-	{//Iterate until shader compilation has been corrected
-		//Create temporary shader program
-		GLuint t_programId = GL_CALL(glCreateProgram());
-		//Pass it to subclass to compile shaders
-		if (this->_compileShaders(t_programId))
-		{
-			// Link the program and ensure the program compiled correctly;
-			GL_CALL(glLinkProgram(t_programId));
-
-			// If the program linked ok, then we update the instance variable (for live reloading)
-			if (this->checkProgramLinkError(t_programId)){
-				// Destroy the old program
-				this->destroyProgram();
-				// Update the class var for the next usage.
-				this->programId = t_programId;
-			}
-			else
+	pendingStages.clear();
+	programKey.clear();
+	sourcePaths.clear();
+	if (!errorLog.empty())
+	{
+		errorLog.clear();
+		++errorLogVersion;
+	}
+	//Create temporary shader program
+	GLuint t_programId = GL_CALL(glCreateProgram());
+	//Pass it to subclass to load shaders, then begin compiling them (or restore them from the binary cache)
+	if (this->_compileShaders(t_programId) && this->beginBuild(t_programId))
+		return t_programId;
+	GL_CALL(glDeleteProgram(t_programId));
+	return 0;
+}
+void ShaderCore::finishReload(const GLuint t_programId, const bool success)
+{
+	if (success)
+	{
+		// Destroy the old program
+		this->destroyProgram();
+		// Update the class var for the next usage.
+		this->programId = t_programId;
+		this->setupBindings();
+	}
+	else
+	{
+		//Compilation failed, cleanup temp program, the previous program remains in use
+		if (t_programId)
+		{
+			GL_CALL(glDeleteProgram(t_programId));
+		}
+		deleteShaders();
+		fprintf(stderr, "Shader '%s' will be rebuilt when it's sources are modified.\n", this->shaderTag);
+	}
+}
+void ShaderCore::cancelReload()
+{
+	if (pendingProgram)
+	{
+		GL_CALL(glDeleteProgram(pendingProgram));
+		pendingProgram = 0;
+		deleteShaders();
+	}
+}
+void ShaderCore::pollReloads()
+{
+	static std::unique_ptr<FileWatcher> watcher;
+	if (!watcher)
+		watcher = std::unique_ptr<FileWatcher>(new FileWatcher(getShadersDirectory()));
+	//Reload shaders which depend on modified files
+	std::vector<std::string> modified = watcher->poll();
+	if (!modified.empty())
+	{
+		std::set<std::string> modifiedSet(modified.begin(), modified.end());
+		for (auto &shader : instances)
+		{
+			for (auto &path : shader->sourcePaths)
 			{
-				//Compilation failed, cleanup temp program
-				GL_CALL(glDeleteProgram(t_programId));
-				deleteShaders();
-				fprintf(stderr, "Press any key to recompile.\n", this->shaderTag);
-				getchar();
-				continue;
+				if (modifiedSet.find(path) != modifiedSet.end())
+				{
+					shader->reloadAsync();
+					break;
+				}
 			}
 		}
-		else
+	}
+	//Complete pending reloads
+	for (auto &shader : instances)
+	{
+		if (shader->pendingProgram && shader->isBuildComplete(shader->pendingProgram))
 		{
-			//Compilation failed, cleanup temp program
-			GL_CALL(glDeleteProgram(t_programId));
-			deleteShaders();
-			fprintf(stderr, "Press any key to recompile.\n", this->shaderTag);
-			getchar();
-			continue;
+			GLuint t_programId = shader->pendingProgram;
+			shader->pendingProgram = 0;
+			shader->finishReload(t_programId, shader->finishBuild(t_programId));
 		}
-		break;
 	}
-	this->setupBindings();
+}
+std::string ShaderCore::getErrorLog()
+{
+	//Shaders which share sources often share errors, so skip duplicates
+	std::vector<const std::string*> logs;
+	for (auto &shader : instances)
+	{
+		if (shader->errorLog.empty())
+			continue;
+		bool duplicate = false;
+		for (auto &log : logs)
+			duplicate |= *log == shader->errorLog;
+		if (!duplicate)
+			logs.push_back(&shader->errorLog);
+	}
+	std::string rtn;
+	for (auto &log : logs)
+		rtn.append(*log);
+	return rtn;
+}
+void ShaderCore::reportError(const std::string &error)
+{
+	fprintf(stderr, "%s", error.c_str());
+	errorLog.append(error);
+	++errorLogVersion;
 }
 void ShaderCore::setupBindings()
 {
@@ -191,9 +290,9 @@ void ShaderCore::setupBindings()
 		{			
 			auto rtn = buffers.emplace(uniformBlockIndex, d);
 			if (!rtn.second)fprintf(stderr, "Somehow a buffer was bound twice.");
-			GL_CALL(glUniformBlockBinding(this->programId, uniformBlockIndex, d.bindingPoint));
+			bindBlock(uniformBlockIndex, d.type, d.bindingPoint);
 		}
-		else if (strcmp(d.nameInShader, Shaders::LIGHT_UNIFORM_BLOCK_NAME) && strcmp(d.nameInShader, Shaders::MATERIAL_UNIFORM_BLOCK_NAME))
+		else if (!isSystemBuffer(d.nameInShader))
 		{//If the buffer isn't found, remind the user, Don't warn for known system bufferS
 			lostBuffers.push_front(d);
 			printf("%s: Buffer '%s' could not be located on shader reload.\n", this->shaderTag, d.nameInShader);
@@ -234,6 +333,10 @@ void ShaderCore::prepare(bool autoClear)
 			{
 				GL_CALL(glGetIntegerv(GL_TEXTURE_BINDING_2D_MULTISAMPLE, &whichID));
 			}
+			else if (utd.second.type == GL_TEXTURE_2D_ARRAY)
+			{
+				GL_CALL(glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &whichID));
+			}
 			else
 			{
 				fprintf(stderr,"Unexpected texture type when verifying texture unit bindings, please add to ShaderCore::useProgram()\n");
@@ -322,6 +425,9 @@ void ShaderCore::useProgram(bool autoPrepare)
         this->prepare(false);
 	else
 		GL_CALL(glUseProgram(this->programId));
+	//Sub allocated uniform blocks share binding points, so must be bound before each use
+	for (auto &&b : uniformBlocks)
+		b.second.second->bind(b.second.first);
 
     //Is this required with new tex?
 	////Set any Texture buffers
@@ -523,6 +629,27 @@ GLenum ShaderCore::getResourceBlock(GLenum bufferType)
         return GL_INVALID_ENUM;
     }
 }
+void ShaderCore::bindBlock(GLuint blockIndex, GLenum bufferType, GLuint bufferBindingPoint)
+{
+	if (bufferType == GL_SHADER_STORAGE_BUFFER)
+	{
+		GL_CALL(glShaderStorageBlockBinding(this->programId, blockIndex, bufferBindingPoint));
+	}
+	else
+	{
+		GL_CALL(glUniformBlockBinding(this->programId, blockIndex, bufferBindingPoint));
+	}
+}
+bool ShaderCore::isSystemBuffer(const char *bufferName)
+{
+	return !strcmp(bufferName, Shaders::LIGHT_UNIFORM_BLOCK_NAME)
+		|| !strcmp(bufferName, Shaders::MATERIAL_UNIFORM_BLOCK_NAME)
+		|| !strcmp(bufferName, Shaders::LIGHT_STORAGE_BLOCK_NAME)
+		|| !strcmp(bufferName, Shaders::LIGHT_CLUSTERS_BLOCK_NAME)
+		|| !strcmp(bufferName, Shaders::LIGHT_INDICES_BLOCK_NAME)
+		|| !strcmp(bufferName, Shaders::INSTANCE_DATA_BLOCK_NAME)
+		|| !strcmp(bufferName, Shaders::INSTANCE_INDEX_BLOCK_NAME);
+}
 bool ShaderCore::addBuffer(const char *bufferNameInShader, const GLenum bufferType, const GLuint bufferBindingPoint)
 {//Each buffer must have a unique binding point
 	//Purge any existing buffer which matches
@@ -542,10 +669,10 @@ bool ShaderCore::addBuffer(const char *bufferNameInShader, const GLenum bufferTy
 			//dynamicUniforms.erase(blockIndex);//Why?
 			auto rtn = buffers.emplace(uniformBlockIndex, bd);
 			if (!rtn.second)fprintf(stderr, "%s: Buffer named: %s is already bound.\n", shaderTag, bufferNameInShader);
-			GL_CALL(glUniformBlockBinding(this->programId, uniformBlockIndex, bufferBindingPoint));
+			bindBlock(uniformBlockIndex, bufferType, bufferBindingPoint);
 			return true;
 		}
-		else if (strcmp(bufferNameInShader, Shaders::LIGHT_UNIFORM_BLOCK_NAME) && strcmp(bufferNameInShader, Shaders::MATERIAL_UNIFORM_BLOCK_NAME))
+		else if (!isSystemBuffer(bufferNameInShader))
 		{//Don't warn for known system buffers
 			fprintf(stderr, "%s: Buffer named: %s was not found.\n", shaderTag, bufferNameInShader);
 		}
@@ -653,6 +780,7 @@ bool ShaderCore::removeBuffer(const char *nameInShader)
 		else
 			++a;
 	}
+	uniformBlocks.erase(nameInShader);
 	return rtn;
 }
 std::pair<int, GLenum> ShaderCore::findUniform(const char *uniformName, const int shaderProgram)
@@ -695,10 +823,16 @@ int ShaderCore::compileShader(const GLuint t_shaderProgram, GLenum type, std::ve
 		shaderSources.push_back(loadShaderSource(i.c_str()));
 	}
 	//Check for shaders that didn't load correctly
-	for (auto i : shaderSources)
+	for (unsigned int i = 0; i < shaderSources.size(); ++i)
 	{
-		if (!i)
+		if (!shaderSources[i])
 		{
+			reportError(su::format("Shader source not found: %s\n", (*shaderSourceFiles)[i].c_str()));
+			if (exitOnError)
+			{
+				getchar();
+				exit(1);
+			}
 			//Cleanup
 			for (auto j : shaderSources)
 			{
@@ -707,22 +841,52 @@ int ShaderCore::compileShader(const GLuint t_shaderProgram, GLenum type, std::ve
 			return -1;
 		}
 	}
-	GLuint shaderId = createShader(type);
-	GL_CALL(glShaderSource(shaderId,(GLsizei)shaderSources.size(), &shaderSources[0], nullptr));
-	GL_CALL(glCompileShader(shaderId));
 	std::string shaderName = su::getFilenameFromPath(*(shaderSourceFiles->end() - 1));
-	//Check for compile errors
-	if (!this->checkShaderCompileError(shaderId, shaderName.c_str()))
+	//Preprocess the sources
+	ShaderStage stage;
+	stage.type = type;
+	stage.name = shaderName;
+	//Each file's #line source string number is its index within files, includes follow the sources
+	std::vector<std::string> files;
+	for (unsigned int j = 0; j < shaderSources.size(); ++j)
 	{
-		//Cleanup
-		for (auto j : shaderSources)
+		files.push_back(findShaderFile((*shaderSourceFiles)[j]));
+		sourcePaths.push_back(FileWatcher::canonicalPath(files.back()));
+	}
+	for (unsigned int j = 0; j < shaderSources.size(); ++j)
+	{
+		std::string source(shaderSources[j]);
+		if (!resolveIncludes(source, j, files))
 		{
-			free(j);
+			//Cleanup
+			for (auto k : shaderSources)
+			{
+				free(k);
+			}
+			return -1;
 		}
-		return -1;
+		stage.sources.push_back(source);
+	}
+	if (files.size() > shaderSources.size())
+	{
+		//Identify the source string numbers which compile errors refer to
+		stage.name.append(", source strings:");
+		for (unsigned int j = 0; j < files.size(); ++j)
+			stage.name.append(su::format(" %u=%s", j, su::getFilenameFromPath(files[j]).c_str()));
+	}
+	if (!defines.empty())
+	{
+		//Defines must follow the version directive, so find the source which holds it
+		auto versionSource = std::find_if(stage.sources.begin(), stage.sources.end(), [](const std::string &src){ return src.find("#version") != std::string::npos; });
+		injectDefines(versionSource != stage.sources.end() ? *versionSource : stage.sources[0]);
+	}
+	//Queue the stage for buildProgram(), the preprocessed sources also form the program's cache key
+	programKey.append(std::to_string(type)).append(":");
+	for (auto &src : stage.sources)
+	{
+		programKey.append(src).append("\n");
 	}
-	//Attach shader to program
-	GL_CALL(glAttachShader(t_shaderProgram, shaderId));
+	pendingStages.push_back(std::move(stage));
 	//Append to shaderTag
 	if (shaderTag[0] == '\0')
 	{
@@ -735,13 +899,133 @@ int ShaderCore::compileShader(const GLuint t_shaderProgram, GLenum type, std::ve
 	}
 	this->shaderTag = new char[shaderName.length() + 1];
 	strcpy(this->shaderTag, shaderName.c_str());
-	return static_cast<int>(findShaderVersion(*reinterpret_cast<std::vector<const char*>*>(&shaderSources)));
+	int version = static_cast<int>(findShaderVersion(*reinterpret_cast<std::vector<const char*>*>(&shaderSources)));
+	//Cleanup
+	for (auto j : shaderSources)
+	{
+		free(j);
+	}
+	return version;
+}
+bool ShaderCore::beginBuild(const GLuint t_programId)
+{
+	const std::string key = driverKey() + programKey;
+	buildFromBinary = loadProgramBinary(t_programId, key);
+	if (buildFromBinary)
+	{
+		pendingStages.clear();
+		return true;
+	}
+	//Allow the driver to compile using it's own threads, so we needn't wait for compilation (where supported)
+	static bool parallelCompileInit = false;
+	if (!parallelCompileInit)
+	{
+		parallelCompileInit = true;
+		if (GLEW_ARB_parallel_shader_compile)
+		{
+			GL_CALL(glMaxShaderCompilerThreadsARB(0xFFFFFFFF));
+		}
+	}
+	//Compile and attach each stage, errors are checked by finishBuild()
+	for (auto &stage : pendingStages)
+	{
+		std::vector<const char*> sources;
+		for (auto &src : stage.sources)
+			sources.push_back(src.c_str());
+		GLuint shaderId = createShader(stage.type);
+		floatingShaderNames.push_back(stage.name);
+		GL_CALL(glShaderSource(shaderId, (GLsizei)sources.size(), sources.data(), nullptr));
+		GL_CALL(glCompileShader(shaderId));
+		GL_CALL(glAttachShader(t_programId, shaderId));
+	}
+	pendingStages.clear();
+	// Link the program, without checking the result
+	GL_CALL(glProgramParameteri(t_programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	GL_CALL(glLinkProgram(t_programId));
+	return true;
+}
+bool ShaderCore::finishBuild(const GLuint t_programId)
+{
+	if (buildFromBinary)
+		return true;
+	//Check for compile errors
+	for (unsigned int i = 0; i < floatingShaders.size(); ++i)
+	{
+		if (!this->checkShaderCompileError(floatingShaders[i], floatingShaderNames[i].c_str()))
+			return false;
+	}
+	// Ensure the program linked correctly
+	if (!this->checkProgramLinkError(t_programId))
+		return false;
+	//Shaders are nolonger required once the program is linked
+	for (auto i : floatingShaders)
+	{
+		GL_CALL(glDetachShader(t_programId, i));
+	}
+	deleteShaders();
+	storeProgramBinary(t_programId, driverKey() + programKey);
+	return true;
+}
+bool ShaderCore::isBuildComplete(const GLuint t_programId) const
+{
+	if (buildFromBinary || !GLEW_ARB_parallel_shader_compile)
+		return true;
+	GLint complete = GL_TRUE;
+	GL_CALL(glGetProgramiv(t_programId, GL_COMPLETION_STATUS_ARB, &complete));
+	return complete == GL_TRUE;
 }
 #include <filesystem>
 #ifdef _MSC_VER
 #define filesystem tr2::sys
 #endif
-char* ShaderCore::loadShaderSource(const char* file){
+namespace
+{
+	typedef decltype(std::filesystem::last_write_time(std::filesystem::path())) IncludeTime;
+	/**
+	 * Cache of included files, so that common includes are only read once
+	 * Key: Path of the included file
+	 * Val: Last write time of the file when it was read, contents of the file
+	 */
+	std::unordered_map<std::string, std::pair<IncludeTime, std::string>> includeCache;
+	/**
+	 * Returns source with the contents of comments replaced by spaces, line breaks are preserved so lines still correspond
+	 */
+	std::string stripComments(const std::string &source)
+	{
+		std::string rtn(source);
+		bool lineComment = false, blockComment = false;
+		for (size_t i = 0; i < rtn.size(); ++i)
+		{
+			if (lineComment)
+			{
+				if (rtn[i] == '\n')
+					lineComment = false;
+				else
+					rtn[i] = ' ';
+			}
+			else if (blockComment)
+			{
+				if (rtn[i] == '*' && i + 1 < rtn.size() && rtn[i + 1] == '/')
+				{
+					blockComment = false;
+					rtn[i] = rtn[i + 1] = ' ';
+					++i;
+				}
+				else if (rtn[i] != '\n')
+					rtn[i] = ' ';
+			}
+			else if (rtn[i] == '/' && i + 1 < rtn.size() && (rtn[i + 1] == '/' || rtn[i + 1] == '*'))
+			{
+				(rtn[i + 1] == '/' ? lineComment : blockComment) = true;
+				rtn[i] = rtn[i + 1] = ' ';
+				++i;
+			}
+		}
+		return rtn;
+	}
+}
+const std::string &ShaderCore::getShadersDirectory()
+{
 	static std::string shadersRoot;
 	if (shadersRoot.empty())
 	{
@@ -757,22 +1041,24 @@ char* ShaderCore::loadShaderSource(const char* file){
 		if (!std::filesystem::exists(std::filesystem::path(shadersRoot)))
 			shadersRoot = "./";
 	}
+	return shadersRoot;
+}
+std::string ShaderCore::findShaderFile(const std::string &file)
+{
+	const std::string &shadersRoot = getShadersDirectory();
+	if (std::filesystem::exists(std::filesystem::path(shadersRoot + file)))
+		return shadersRoot + file;//Attempt with shader root
+	if (std::filesystem::exists(std::filesystem::path(file)))
+		return file;//Attempt without shader root
+	return "";
+}
+char* ShaderCore::loadShaderSource(const char* file){
 	// If file path is 0 it is being omitted. kinda gross
 	if (file != nullptr){
-		std::string shaderPath = shadersRoot + file;
-		FILE* fptr = fopen(shaderPath.c_str(), "rb");//Attempt with shader root
-		if (!fptr)
-		{
-			fptr = fopen(file, "rb");//Attempt without shader root
-			if (!fptr){
-				fprintf(stderr, "Shader source not found: %s\n", file);
-				if (exitOnError)
-				{
-					getchar();
-					exit(1);
-				}
-				return nullptr;
-			}
+		std::string shaderPath = findShaderFile(file);
+		FILE* fptr = shaderPath.empty() ? nullptr : fopen(shaderPath.c_str(), "rb");
+		if (!fptr){
+			return nullptr;
 		}
 		fseek(fptr, 0, SEEK_END);
 		long length = ftell(fptr);
@@ -787,6 +1073,113 @@ char* ShaderCore::loadShaderSource(const char* file){
 		return nullptr;
 	}
 }
+bool ShaderCore::resolveIncludes(std::string &source, unsigned int fileIndex, std::vector<std::string> &files)
+{
+	static std::regex includeRegex("^[ \\t]*#[ \\t]*include[ \\t]*[\"<]([^\">]+)[\">]");
+	if (source.find("include") == std::string::npos)
+		return true;
+	const std::string file = files[fileIndex];
+	std::string rtn;
+	std::istringstream stream(source);
+	//Directives are matched against the source with comments removed, so commented out includes are ignored
+	std::istringstream codeStream(stripComments(source));
+	std::string line, code;
+	unsigned int lineNumber = 0;
+	while (std::getline(stream, line) && std::getline(codeStream, code))
+	{
+		++lineNumber;
+		std::smatch match;
+		if (!std::regex_search(code, match, includeRegex))
+		{
+			rtn.append(line).append("\n");
+			continue;
+		}
+		//Resolve relative to the including file, then as a regular shader source
+		std::string includePath = su::getFolderFromPath(file) + match[1].str();
+		if (file.empty() || !std::filesystem::exists(std::filesystem::path(includePath)))
+			includePath = findShaderFile(match[1].str());
+		if (includePath.empty())
+		{
+			reportError(su::format("Shader include not found: %s (%s:%u)\n", match[1].str().c_str(), file.c_str(), lineNumber));
+			if (exitOnError)
+			{
+				getchar();
+				exit(1);
+			}
+			return false;
+		}
+		if (std::find(files.begin(), files.end(), includePath) == files.end())
+		{
+			const unsigned int includeIndex = static_cast<unsigned int>(files.size());
+			files.push_back(includePath);
+			sourcePaths.push_back(FileWatcher::canonicalPath(includePath));
+			//Reuse the cached contents, unless the file has since been modified
+			IncludeTime modified = std::filesystem::last_write_time(std::filesystem::path(includePath));
+			auto cached = includeCache.find(includePath);
+			if (cached == includeCache.end() || cached->second.first != modified)
+			{
+				char *includeSource = loadShaderSource(includePath.c_str());
+				if (!includeSource)
+					return false;
+				auto &entry = includeCache[includePath];
+				entry.first = modified;
+				entry.second = includeSource;
+				free(includeSource);
+				cached = includeCache.find(includePath);
+			}
+			std::string includeSource = cached->second.second;
+			if (!resolveIncludes(includeSource, includeIndex, files))
+				return false;
+			rtn.append(su::format("#line 1 %u\n", includeIndex)).append(includeSource).append("\n");
+		}
+		//Restore line numbering of the including file
+		rtn.append(su::format("#line %u %u\n", lineNumber + 1, fileIndex));
+	}
+	source = rtn;
+	return true;
+}
+void ShaderCore::injectDefines(std::string &source) const
+{
+	static std::regex versionRegex("#[ \\t]*version[^\\n]*\\n?");
+	std::string definesSource;
+	for (auto &d : defines)
+	{
+		definesSource.append("#define ").append(d.first);
+		if (!d.second.empty())
+			definesSource.append(" ").append(d.second);
+		definesSource.append("\n");
+	}
+	std::smatch match;
+	size_t offset = 0;
+	unsigned int nextLine = 1;
+	if (std::regex_search(source, match, versionRegex))
+	{
+		offset = match.position(0) + match.length(0);
+		nextLine = static_cast<unsigned int>(std::count(source.begin(), source.begin() + offset, '\n')) + 1;
+		if (offset > 0 && source[offset - 1] != '\n')
+			definesSource.insert(0, "\n");
+	}
+	//Restore line numbering of the source
+	definesSource.append(su::format("#line %u\n", nextLine));
+	source.insert(offset, definesSource);
+}
+ShaderCore::Defines ShaderCore::parseDefines(const char *defines)
+{
+	Defines rtn;
+	if (!defines)
+		return rtn;
+	std::istringstream stream(defines);
+	std::string define;
+	while (stream >> define)
+	{
+		size_t eq = define.find('=');
+		if (eq == std::string::npos)
+			rtn[define] = "";
+		else
+			rtn[define.substr(0, eq)] = define.substr(eq + 1);
+	}
+	return rtn;
+}
 bool ShaderCore::checkShaderCompileError(GLuint shaderId, const char* shaderPath){
 	GL_CHECK();
 	GLint status;
@@ -798,9 +1191,8 @@ bool ShaderCore::checkShaderCompileError(GLuint shaderId, const char* shaderPath
 		// Get the contents of the log message
 		char* log = new char[len + 1];
 		GL_CALL(glGetShaderInfoLog(shaderId, len, &len, log));
-		// Print the message
-		fprintf(stderr, "Shader compilation error (%s) :\n", shaderPath);
-		fprintf(stderr, "%s\n", log);
+		// Report the message
+		reportError(su::format("Shader compilation error (%s) :\n%s\n", shaderPath, log));
 		delete[] log;
 		if(exitOnError)
 		{
@@ -811,7 +1203,7 @@ bool ShaderCore::checkShaderCompileError(GLuint shaderId, const char* shaderPath
 	}
 	return true;
 }
-bool ShaderCore::checkProgramLinkError(const GLuint programId) const{
+bool ShaderCore::checkProgramLinkError(const GLuint programId){
 	GL_CHECK();
 	GLint status;
 	GL_CALL(glGetProgramiv(programId, GL_LINK_STATUS, &status));
@@ -822,9 +1214,8 @@ bool ShaderCore::checkProgramLinkError(const GLuint programId) const{
 		// Get the contents of the log message
 		char* log = new char[len + 1];
 		GL_CALL(glGetProgramInfoLog(programId, len, nullptr, log));
-		// Print the message
-		fprintf(stderr, "Program compilation error (%s):\n", shaderTag);
-		fprintf(stderr, "%s\n", log);
+		// Report the message
+		reportError(su::format("Program compilation error (%s):\n%s\n", shaderTag, log));
 		delete[] log;
 		if(exitOnError)
 		{
@@ -853,4 +1244,131 @@ std::vector<const std::string> *ShaderCore::buildFileVector(std::initializer_lis
 		rtn->push_back(std::string(i));
 	}
 	return rtn;
-}
\ No newline at end of file
+}
+
+namespace
+{
+	/**
+	 * 64-bit FNV-1a hash, used to name (and verify) program binaries within the on disk cache
+	 */
+	unsigned long long fnv1a(const std::string &str, unsigned long long hash = 14695981039346656037ull)
+	{
+		for (auto c : str)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+	/**
+	 * Header of program binaries stored within the on disk cache
+	 */
+	struct ProgramBinaryHeader
+	{
+		char magic[4];
+		GLenum format;
+		unsigned long long keyHash;//Hash of the key with an alternate basis, to detect collisions
+		unsigned long long length;
+	};
+	const char PROGRAM_BINARY_MAGIC[4] = { 'S', 'D', 'L', 'B' };
+	const unsigned long long PROGRAM_BINARY_KEY_BASIS = 0x84222325cbf29ce4ull;
+}
+const std::string &ShaderCore::driverKey()
+{
+	static std::string key;
+	if (key.empty())
+	{
+		const GLubyte *vendor = GL_CALL(glGetString(GL_VENDOR));
+		const GLubyte *renderer = GL_CALL(glGetString(GL_RENDERER));
+		const GLubyte *version = GL_CALL(glGetString(GL_VERSION));
+		key = std::string(vendor ? reinterpret_cast<const char *>(vendor) : "") + "\n"
+			+ std::string(renderer ? reinterpret_cast<const char *>(renderer) : "") + "\n"
+			+ std::string(version ? reinterpret_cast<const char *>(version) : "") + "\n";
+	}
+	return key;
+}
+std::string ShaderCore::programBinaryPath(const std::string &key)
+{
+	std::string path = programCacheDirectory;
+	if (!path.empty() && path.back() != '/' && path.back() != '\\')
+		path += "/";
+	return path + su::format("%016llx.bin", fnv1a(key));
+}
+bool ShaderCore::loadProgramBinary(const GLuint t_programId, const std::string &key)
+{
+	GLint formatCount = 0;
+	GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+	if (formatCount <= 0)
+		return false;
+	auto f = programBinaries.find(key);
+	if (f == programBinaries.end())
+	{//Not in memory, attempt the on disk cache
+		if (programCacheDirectory.empty())
+			return false;
+		FILE *file = fopen(programBinaryPath(key).c_str(), "rb");
+		if (!file)
+			return false;
+		ProgramBinaryHeader header;
+		ProgramBinary binary;
+		bool valid = fread(&header, sizeof(ProgramBinaryHeader), 1, file) == 1
+			&& memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC)) == 0
+			&& header.keyHash == fnv1a(key, PROGRAM_BINARY_KEY_BASIS)
+			&& header.length > 0;
+		if (valid)
+		{
+			binary.format = header.format;
+			binary.data.resize(static_cast<size_t>(header.length));
+			valid = fread(binary.data.data(), binary.data.size(), 1, file) == 1;
+		}
+		fclose(file);
+		if (!valid)
+			return false;
+		f = programBinaries.emplace(key, std::move(binary)).first;
+	}
+	GL_CALL(glProgramBinary(t_programId, f->second.format, f->second.data.data(), (GLsizei)f->second.data.size()));
+	GLint status = GL_FALSE;
+	GL_CALL(glGetProgramiv(t_programId, GL_LINK_STATUS, &status));
+	if (status == GL_TRUE)
+		return true;
+	//Binary was rejected (e.g. the driver changed), purge it so that it is rebuilt from source
+	programBinaries.erase(f);
+	if (!programCacheDirectory.empty())
+		remove(programBinaryPath(key).c_str());
+	return false;
+}
+void ShaderCore::storeProgramBinary(const GLuint t_programId, const std::string &key)
+{
+	GLint formatCount = 0;
+	GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+	if (formatCount <= 0)
+		return;
+	GLint length = 0;
+	GL_CALL(glGetProgramiv(t_programId, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+		return;
+	ProgramBinary binary;
+	binary.data.resize(length);
+	GL_CALL(glGetProgramBinary(t_programId, length, nullptr, &binary.format, binary.data.data()));
+	if (!programCacheDirectory.empty())
+	{
+		if (!std::filesystem::exists(std::filesystem::path(programCacheDirectory)))
+			std::filesystem::create_directories(std::filesystem::path(programCacheDirectory));
+		FILE *file = fopen(programBinaryPath(key).c_str(), "wb");
+		if (file)
+		{
+			ProgramBinaryHeader header;
+			memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC));
+			header.format = binary.format;
+			header.keyHash = fnv1a(key, PROGRAM_BINARY_KEY_BASIS);
+			header.length = binary.data.size();
+			fwrite(&header, sizeof(ProgramBinaryHeader), 1, file);
+			fwrite(binary.data.data(), binary.data.size(), 1, file);
+			fclose(file);
+		}
+		else
+		{
+			fprintf(stderr, "Unable to write program binary cache '%s'.\n", programBinaryPath(key).c_str());
+		}
+	}
+	programBinaries[key] = std::move(binary);
+}
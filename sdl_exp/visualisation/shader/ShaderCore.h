@@ -6,12 +6,16 @@
 #include <vector>
 #include <map>
 #include <list>
+#include <string>
+#include <unordered_map>
+#include <set>
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 #include <memory>
 
 class BufferCore;//Implementation of addBuffer(const char *, std::shared_ptr<BufferCore>) found in BufferCore.cpp
 class Texture;//Impementation of addTexture(const char *textureNameInShader, std::shared_ptr<Texture> texture) found in Texture.cpp
+class UniformBlock;//Implementation of addBuffer(const char *, std::shared_ptr<const UniformBlock>) found in UniformBlockAllocator.cpp
 /**
  * This class is is a wrapper for the core OpenGL shader operations
  * Uniforms, textures and buffers can be automatically bound using the addXXX() methods, so they are provided to the shader
@@ -21,6 +25,16 @@ class Texture;//Impementation of addTexture(const char *textureNameInShader, std
  *
  * This class is great for quickly using shaders, if you start double binding/unbinding stuff you might find bugs though
  *
+ * Linked programs are cached as program binaries, both in memory and on disk, keyed by their source and the GL driver
+ * Therefore constructing many shader objects from the same sources only compiles them once
+ *
+ * Shader sources are preprocessed before compilation:
+ * '#include "file"' directives are resolved (relative to the including file, then the shaders directory), each file is included at most once per shader
+ * Definitions held in defines are injected after the '#version' directive, allowing permutations of a shader to be built from the same sources
+ *
+ * Shaders are hot reloaded when their sources (or included files) are modified, see pollReloads()
+ * A shader which fails to build continues to use it's previous program, errors are available via getErrorLog()
+ *
  * @see Shaders
  * @see ComputeShader
  * @todo Replace uniform bindings pointers with weak ptrs
@@ -57,6 +71,22 @@ protected:
 	 */
 	virtual ~ShaderCore();
 public:
+	/**
+	 * Preprocessor definitions injected into each shader source
+	 * Key: Macro name
+	 * Val: Macro value (may be empty)
+	 */
+	typedef std::map<std::string, std::string> Defines;
+	/**
+	 * Parses a whitespace separated list of preprocessor definitions
+	 * @param defines The list of definitions, e.g. "FLAT SHADOWED MAX_LIGHTS=8"
+	 * @return The parsed definitions, empty if defines is nullptr
+	 */
+	static Defines parseDefines(const char *defines);
+	/**
+	 * @return The preprocessor definitions the shader is built with
+	 */
+	inline const Defines &getDefines() const { return this->defines; }
 	/**
 	 * Returns the shader tag, this is a rough identifier of the shader
 	 * This value is produced by concatenating the file name (sans extension) of the final file provided for each shader attatched to the object
@@ -64,9 +94,30 @@ public:
 	inline const char* getShaderTag() const { return this->shaderTag; }
 	/**
      * Reloads the shader source from file, recompiles it and rebinds all bound items
+	 * If the build fails, the previous program remains in use and the errors are reported to stderr and getErrorLog()
 	 * @note It is expected that subclass constructors call this method after configuring their sources
 	 */
 	void reload() final;
+	/**
+	 * Reloads the shader without blocking, the previous program remains in use until the new program has linked
+	 * Where GL_ARB_parallel_shader_compile is available, compilation occurs on the driver's threads
+	 * @note The reload is completed by pollReloads()
+	 */
+	void reloadAsync();
+	/**
+	 * Calls reloadAsync() on any shaders whose sources (or included files) within the shaders directory have been modified
+	 * Completes any asynchronous reloads whose programs have finished linking
+	 * @note Visualisation calls this once per frame, it must be called from the thread which owns the GL context
+	 */
+	static void pollReloads();
+	/**
+	 * @return The errors of all shaders whose most recent build failed, empty if there are none
+	 */
+	static std::string getErrorLog();
+	/**
+	 * @return A value which changes each time the contents of getErrorLog() changes
+	 */
+	static unsigned int getErrorLogVersion(){ return errorLogVersion; }
 	/**
 	 * Returns OpenGLs reference to the shader
 	 * @return The OpenGL program id of the shader
@@ -224,6 +275,16 @@ public:
 	 * @note Convenience method, implemented in BufferCore.cpp
 	 */
 	bool addBuffer(const char *bufferNameInShader, const std::shared_ptr<BufferCore> &buffer);
+	/**
+	 * Attaches the specified uniform block to the shader if bufferNameInShader can be found
+	 * If a buffer with the same bufferNameInShader is already bound, it will be replaced
+	 * The block's range is bound (with glBindBufferRange()) each time the shader is used, so the shared_ptr is retained
+	 * @param bufferNameInShader The indentifier of the uniform block within the shader source
+	 * @param block The block to be used
+	 * @return True if buffer name is found in the current shader to be bound
+	 * @note Convenience method, implemented in UniformBlockAllocator.cpp
+	 */
+	bool addBuffer(const char *bufferNameInShader, const std::shared_ptr<const UniformBlock> &block);
 	/**
 	 * Unbinds the named dynamic uniform
 	 * @note This will not replace the value cached in the shader, reload() is necessary to achieve that
@@ -254,6 +315,17 @@ public:
 	 * @return True if the program should exit on shader compilation failure
 	 */
 	static bool getExitOnError(){ return ShaderCore::exitOnError; }
+	/**
+	 * Sets the directory which program binaries are cached to on disk
+	 * @param directory Path to the directory, it will be created if it does not exist. An empty string disables the on disk cache
+	 * @note The in memory cache of program binaries is unaffected
+	 */
+	static void setProgramCacheDirectory(const std::string &directory){ ShaderCore::programCacheDirectory = directory; }
+	/**
+	 * Returns the directory which program binaries are cached to on disk
+	 * @return The directory path, empty if the on disk cache is disabled
+	 */
+	static const std::string &getProgramCacheDirectory(){ return ShaderCore::programCacheDirectory; }
 	/**
 	 * Attempts to locate the specified uniform's location and type within the provided shader
 	 * @param uniformName The name of the uniform
@@ -272,6 +344,15 @@ public:
 	static std::pair<int, GLenum> findAttribute(const char *attributeName, const int shaderProgram);
 private:
     static GLenum getResourceBlock(GLenum bufferType);
+	/**
+	 * Binds the block at blockIndex to the provided binding point
+	 * Storage blocks and uniform blocks have separate binding functions
+	 */
+	void bindBlock(GLuint blockIndex, GLenum bufferType, GLuint bufferBindingPoint);
+	/**
+	 * @return True if bufferName is a buffer bound to all shaders by the system (e.g. lights), which shaders need not declare
+	 */
+	static bool isSystemBuffer(const char *bufferName);
 	/**
 	 * Holds shaders thats have been compiled, so that they can be deleted
 	 * @see deleteShaders()
@@ -297,7 +378,12 @@ private:
 			GL_CALL(glDeleteShader(i));
 		}
 		floatingShaders.clear();
+		floatingShaderNames.clear();
 	}
+	/**
+	 * Names of the shaders held in floatingShaders, so that they can be identified in error logs
+	 */
+	std::vector<std::string> floatingShaderNames;
 	/**
 	 * Holds all the necessary information for binding dynamic uniform int and float vectors
 	 */
@@ -413,6 +499,11 @@ private:
 	 * or went missing after a shader reload
 	 */
 	std::list<BufferDetail> lostBuffers;
+	/**
+	 * Sub allocated uniform blocks, and their binding points, by name within the shader
+	 * These are bound by useProgram()
+	 */
+	std::map<std::string, std::pair<GLuint, std::shared_ptr<const UniformBlock>>> uniformBlocks;
 	/**
 	 * Subclasses should use this to clear any enabled client states or attribute arrays
 	 * If not overriden, does nothing
@@ -448,19 +539,42 @@ protected:
 	 */
 	void setupBindings();
 	/**
-	 * Compiles the specified shader source and attatches it to the provided program
+	 * Loads the specified shader source, so that it can be compiled and attatched to the provided program
 	 * @param t_shaderProgram The shader program to attach the compiled shader to
 	 * @param type GL_VERTEX_SHADER/GL_FRAGMENT_SHADER/GL_GEOMETRY_SHADER/GL_COMPUTE_SHADER
 	 * @param shaderSourceFiles An initialiser list ({a,b,c}) of paths to shader sources
-	 * @return The shader version detected, -1 on compilation failure
+	 * @return The shader version detected, -1 on failure to load the source
+	 * @note Compilation is deferred until all shaders have been loaded, so that a cached program binary can be used instead
 	 */
 	int compileShader(const GLuint t_shaderProgram, GLenum type, std::vector<const std::string> *shaderSourceFiles);
+	/**
+	 * Appends to the key which identifies the program in the program binary cache
+	 * Subclasses must call this during _compileShaders() for any state which is set prior to linking (e.g. glBindFragDataLocation())
+	 * @param key Text identifying the state
+	 */
+	void addProgramKey(const std::string &key){ programKey.append(key); }
+	/**
+	 * Preprocessor definitions injected into every shader source by compileShader()
+	 * @note Subclasses should set this prior to calling reload()
+	 */
+	Defines defines;
 	/**
 	 * Loads the text from the provided filepath
-	 * @return A pointer to the loaded shader source
+	 * @return A pointer to the loaded shader source, nullptr if the file was not found
 	 * @note the returned pointer is allocated via malloc, and should be free'd when nolonger required
 	 */
 	static char *loadShaderSource(const char *file);
+	/**
+	 * Locates the provided file, first within the shaders directory, then relative to the working directory
+	 * @param file Path to the shader source
+	 * @return The path of the located file, empty if the file was not found
+	 */
+	static std::string findShaderFile(const std::string &file);
+	/**
+	 * Locates the shaders directory, by searching a few levels up from the working directory
+	 * @return Path to the shaders directory, "./" if it was not found
+	 */
+	static const std::string &getShadersDirectory();
 	/**
 	 * Looks for the '#version xx' tag in the provided shader source and returns the numeric value
 	 * @param shaderSources The shader code to detect the version from
@@ -479,8 +593,143 @@ protected:
 	 * @return True if no errors were detected
 	 * @note For some reason program compilation failure logs don't seem to work (the same as shader compilation)
 	 */
-	bool checkProgramLinkError(const GLuint programId) const;
+	bool checkProgramLinkError(const GLuint programId);
 private:
+	/**
+	 * Shader source loaded by compileShader(), waiting to be compiled by buildProgram()
+	 */
+	struct ShaderStage
+	{
+		GLenum type;
+		/**
+		 * Filename of the final source, used to identify the shader in error logs
+		 */
+		std::string name;
+		std::vector<std::string> sources;
+	};
+	std::vector<ShaderStage> pendingStages;
+	/**
+	 * Identifies the program in the program binary cache
+	 * This is formed of the sources of all stages, and any state added via addProgramKey()
+	 */
+	std::string programKey;
+	/**
+	 * Begins linking pendingStages into the provided program
+	 * If a binary of the program is cached this is used, otherwise stages are compiled and linked, without waiting for the result
+	 * @param t_programId The shader program to be linked
+	 * @return False if the program could not be built
+	 * @see finishBuild(const GLuint)
+	 */
+	bool beginBuild(const GLuint t_programId);
+	/**
+	 * Checks the result of beginBuild(), on success the program binary is cached
+	 * @param t_programId The shader program passed to beginBuild()
+	 * @return True if the program linked succesfully
+	 * @note This blocks until the driver has finished compilation, see isBuildComplete()
+	 */
+	bool finishBuild(const GLuint t_programId);
+	/**
+	 * @param t_programId The shader program passed to beginBuild()
+	 * @return True if the driver has finished compiling and linking the program (always true without GL_ARB_parallel_shader_compile)
+	 */
+	bool isBuildComplete(const GLuint t_programId) const;
+	/**
+	 * Whether the program passed to beginBuild() was restored from a cached binary (and hence is already linked)
+	 */
+	bool buildFromBinary;
+	/**
+	 * Creates a program and begins building the shader's sources into it
+	 * @return The new program, 0 if the sources could not be loaded
+	 */
+	GLuint beginReload();
+	/**
+	 * Replaces the shader's program with t_programId if it built succesfully, otherwise t_programId is discarded
+	 * @param t_programId The program returned by beginReload()
+	 * @param success Whether the program built successfully
+	 */
+	void finishReload(const GLuint t_programId, const bool success);
+	/**
+	 * Discards the program being built by reloadAsync(), if one exists
+	 */
+	void cancelReload();
+	/**
+	 * Program being built by reloadAsync(), 0 if a reload is not pending
+	 */
+	GLuint pendingProgram;
+	/**
+	 * Canonical paths of all files (including included files) used by the most recent build
+	 * These are compared against modified files by pollReloads()
+	 */
+	std::vector<std::string> sourcePaths;
+	/**
+	 * All shader objects, so that pollReloads() can locate those which depend upon modified files
+	 */
+	static std::set<ShaderCore*> instances;
+	/**
+	 * Errors produced by the most recent build of the shader
+	 */
+	std::string errorLog;
+	/**
+	 * Appends to errorLog, and prints the error to stderr
+	 */
+	void reportError(const std::string &error);
+	/**
+	 * Incremented each time the errorLog of any shader changes
+	 */
+	static unsigned int errorLogVersion;
+	/**
+	 * A program binary as returned by glGetProgramBinary()
+	 */
+	struct ProgramBinary
+	{
+		GLenum format;
+		std::vector<char> data;
+	};
+	/**
+	 * In memory cache of program binaries
+	 * Key: Program key prefixed with the driver identifier
+	 * Val: The program binary
+	 */
+	static std::unordered_map<std::string, ProgramBinary> programBinaries;
+	static std::string programCacheDirectory;
+	/**
+	 * @return Text identifying the GL driver (vendor, renderer, version), as binaries are only valid for a matching driver
+	 */
+	static const std::string &driverKey();
+	/**
+	 * Attempts to restore the program from a cached binary, first from memory, then from disk
+	 * @param t_programId The shader program to load the binary into
+	 * @param key Key of the program (including the driver identifier)
+	 * @return True if a cached binary was accepted by the driver
+	 * @note Rejected binaries are purged from the cache
+	 */
+	static bool loadProgramBinary(const GLuint t_programId, const std::string &key);
+	/**
+	 * Stores the binary of a succesfully linked program to the in memory and on disk caches
+	 * @param t_programId The shader program to retrieve the binary from
+	 * @param key Key of the program (including the driver identifier)
+	 */
+	static void storeProgramBinary(const GLuint t_programId, const std::string &key);
+	/**
+	 * @return The path of the on disk cache file for the given key
+	 */
+	static std::string programBinaryPath(const std::string &key);
+	/**
+	 * Replaces any '#include "file"' directives within the source with the contents of the included file
+	 * Included files are resolved recursively, each file is only included once (regardless of include guards)
+	 * Directives within comments are ignored, '#line' directives name the source string number of each file, so compile errors identify the file
+	 * @param source The shader source to be processed
+	 * @param fileIndex Index within files of the file the source was loaded from, includes are first resolved relative to this file
+	 * @param files Paths of the stage's files, indexed by source string number, included files are appended and those already present are skipped
+	 * @return False if an included file could not be found
+	 */
+	bool resolveIncludes(std::string &source, unsigned int fileIndex, std::vector<std::string> &files);
+	/**
+	 * Inserts '#define' directives for each member of defines after the '#version' directive of the source
+	 * If the source has no '#version' directive, they are inserted at the start of the source
+	 * @param source The shader source to be processed
+	 */
+	void injectDefines(std::string &source) const;
 	/**
 	 * Checks whether the specified shader compiled succesfully.
 	 * Compilation errors are printed to stderr and compileSuccessflag is set to false on failure.
@@ -488,7 +737,7 @@ private:
 	 * @param shaderPath Path to the shader being checked (so that it can be easily identified in the error log)
 	 * @return True if no errors were detected
 	 */
-	static bool checkShaderCompileError(const GLuint shaderId, const char *shaderPath);
+	bool checkShaderCompileError(const GLuint shaderId, const char *shaderPath);
 };
 
 #endif //ifndef __ShaderCore_h__
\ No newline at end of file
@@ -10,6 +10,7 @@
 #ifdef __cplusplus
 #include <glm/glm.hpp>
 #define vec3 glm::vec3
+#define uvec4 glm::uvec4
 #define uint glm::uint
 #endif //#ifdef __cplusplus
     
@@ -27,6 +28,7 @@
             , refractionIndex(1.0f)
             , transparent(0)
 			, bitmask(0)
+			, textures(0)
         { }
 #endif //#ifdef __cplusplus
 		vec3 ambient;           //Ambient color
@@ -39,6 +41,7 @@
         float refractionIndex;	//Unused
 		vec3 transparent;       //Unused, Transparent color, multiplied with translucent light to construct final color
         uint bitmask;           //bitmask to calculate which textures are available
+		uvec4 textures;         //Ambient, diffuse and specular texture handles (array<<16|layer, see MaterialBuffer), w is unused
     };
 
 	struct LightProperties
@@ -52,12 +55,14 @@
 			: ambient(0)
 			, spotExponent(0)
 			, diffuse(1)
-			, PADDING1(0)
+			, range(-1)
 			, specular(1)
 			, spotCosCutoff(cos(180.0f))
 			, position(0,0,1)
 			, constantAttenuation(1)
-			, halfVector(0)
+			, shadowIndex(-1)
+			, shadowCount(0)
+			, PADDING2(0)
 			, linearAttenuation(0)
 			, spotDirection(0,0,-1)
 			, quadraticAttenuation(0)
@@ -66,28 +71,31 @@
 		vec3 ambient;              // Aclarri   
 		float spotExponent;        // Srli   
 		vec3 diffuse;              // Dcli   
-		float PADDING1;            // Crli   (ex spot cutoff, this value is nolonger set internally)
+		float range;               // Derived: Distance at which attenuation makes the light negligible, negative == unbounded (used by clustered lighting)
 		vec3 specular;             // Scli   
 		float spotCosCutoff;       // Derived: cos(Crli) // (Valid spotlight range: [1.0,0.0]), negative == pointlight, greater than 1.0 == directional light
 		vec3 position;             // Ppli   
 		float constantAttenuation; // K0   
-		vec3 halfVector;           // Derived: Hi  (This is calculated as the vector half way between vector-light and vector-viewer) 
+		int shadowIndex;           // Derived: Index of the light's first shadow map within _shadowMaps, negative == no shadows (used by ShadowPass)
+		uint shadowCount;          // Derived: Number of consecutive shadow maps (cascades/cube faces) belonging to the light
+		float PADDING2;
 		float linearAttenuation;   // K1   
 		vec3 spotDirection;        // Sdli   
 		float quadraticAttenuation;// K2  
 	};
 	
 
-	const uint MAX_MATERIALS = 50;//Abitrary limit, haven't done maths to solve max in min uniform buffer requirement
+	const uint MAX_MATERIAL_ARRAYS = 8;//Texture arrays which hold material textures, each occupies a texture unit of every material shader
+	const uint MAX_MATERIAL_TEXTURES = 3;//Textures bound directly to a material's shaders, once the texture arrays are full
 	const uint MAX_LIGHTS = 50;//Abitrary limit, haven't done maths to solve max in min uniform buffer requirement
 
 #ifndef __cplusplus
 //Include in shader
 	uniform uint _materialID;
-	uniform _materials
+	layout(std430) readonly buffer _materials
 	{
-		MaterialProperties material[MAX_MATERIALS];
-	};	
+		MaterialProperties material[];
+	};
 
 	uniform _lights
 	{
@@ -96,9 +104,8 @@
 		LightProperties light[MAX_LIGHTS];
 	};
 
-	uniform sampler2D t_ambient;
-	uniform sampler2D t_diffuse;
-	uniform sampler2D t_specular;
+	uniform sampler2DArray t_materialArrays[MAX_MATERIAL_ARRAYS];
+	uniform sampler2D t_materialTextures[MAX_MATERIAL_TEXTURES];
 #else
 	struct LightUniformBlock
 	{
@@ -112,6 +119,7 @@
 	
 #ifdef __cplusplus
 #undef uint
+#undef uvec4
 #undef vec3
 #endif //#ifdef __cplusplus
 
@@ -5,6 +5,8 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp> 
+#include "../util/StringUtils.h"
+#include "lights/LightClusters.h"
 
 const char *Shaders::MODELVIEW_MATRIX_UNIFORM_NAME = "_modelViewMat";
 const char *Shaders::PROJECTION_MATRIX_UNIFORM_NAME = "_projectionMat";
@@ -13,24 +15,31 @@ const char *Shaders::NORMAL_MATRIX_UNIFORM_NAME = "_normalMat";
 const char *Shaders::MODEL_MATRIX_UNIFORM_NAME = "_modelMat";
 const char *Shaders::VIEW_MATRIX_UNIFORM_NAME = "_viewMat";
 const char *Shaders::LIGHT_UNIFORM_BLOCK_NAME = "_lights";
+const char *Shaders::LIGHT_STORAGE_BLOCK_NAME = "_lightStorage";
+const char *Shaders::LIGHT_CLUSTERS_BLOCK_NAME = "_lightClusters";
+const char *Shaders::LIGHT_INDICES_BLOCK_NAME = "_lightIndices";
 const char *Shaders::MATERIAL_UNIFORM_BLOCK_NAME = "_materials";
+const char *Shaders::INSTANCE_DATA_BLOCK_NAME = "_instanceData";
+const char *Shaders::INSTANCE_INDEX_BLOCK_NAME = "_instanceIndices";
 const char *Shaders::MATERIAL_ID_UNIFORM_NAME = "_materialID";
+const char *Shaders::MESH_ID_UNIFORM_NAME = "_meshID";
 const char *Shaders::VERTEX_ATTRIBUTE_NAME = "_vertex";
 const char *Shaders::NORMAL_ATTRIBUTE_NAME = "_normal";
 const char *Shaders::COLOR_ATTRIBUTE_NAME = "_color";
 const char *Shaders::TEXCOORD_ATTRIBUTE_NAME = "_texCoords";
 //const char *Shaders::PREV_MODELVIEW_MATRIX_UNIFORM_NAME = "_prevModelViewMat";
 
-Shaders::Shaders(Stock::Shaders::ShaderSet set)
-    :Shaders(set.vertex, set.fragment, set.geometry){}
-Shaders::Shaders(const char *vertexShaderPath, const char *fragmentShaderPath, const char *geometryShaderPath)
+Shaders::Shaders(Stock::Shaders::ShaderSet set, const Defines &defines)
+    :Shaders(set.vertex, set.fragment, set.geometry, mergeDefines(parseDefines(set.defines), defines)){}
+Shaders::Shaders(const char *vertexShaderPath, const char *fragmentShaderPath, const char *geometryShaderPath, const Defines &defines)
 	: Shaders(
 		vertexShaderPath ? std::initializer_list <const char *>{vertexShaderPath } : std::initializer_list <const char *>{}, 
 		fragmentShaderPath ? std::initializer_list <const char *>{fragmentShaderPath } : std::initializer_list <const char *>{}, 
-		geometryShaderPath ? std::initializer_list <const char *>{geometryShaderPath } : std::initializer_list <const char *>{}
+		geometryShaderPath ? std::initializer_list <const char *>{geometryShaderPath } : std::initializer_list <const char *>{},
+		defines
 	)
 { }
-Shaders::Shaders(std::initializer_list <const char *> vertexShaderPath, std::initializer_list <const char *> fragmentShaderPath, std::initializer_list <const char *> geometryShaderPath)
+Shaders::Shaders(std::initializer_list <const char *> vertexShaderPath, std::initializer_list <const char *> fragmentShaderPath, std::initializer_list <const char *> geometryShaderPath, const Defines &defines)
     : ShaderCore()
     , fbo(0)
 	, vao(0)
@@ -39,6 +48,7 @@ Shaders::Shaders(std::initializer_list <const char *> vertexShaderPath, std::ini
     , projectionMat()
     , materialIDLocation(-1)
     , materialIDVal(INT_MAX)
+    , meshIDLocation(-1)
     , modelviewprojectionMatLoc(-1)
     , modelviewMatLoc(-1)
     , normalMatLoc(-1)
@@ -57,10 +67,14 @@ Shaders::Shaders(std::initializer_list <const char *> vertexShaderPath, std::ini
     , fragmentShaderVersion(-1)
 	, geometryShaderVersion(-1)
 {
+	this->defines = defines;
 	GL_CALL(glGenVertexArrays(1, &vao));
 	reload();
 }
 Shaders::Shaders(const Shaders &other)
+	: Shaders(other, other.getDefines())
+{ }
+Shaders::Shaders(const Shaders &other, const Defines &defines)
 	: ShaderCore(other)
 	, fbo(other.fbo)
 	, vao(0)
@@ -69,6 +83,7 @@ Shaders::Shaders(const Shaders &other)
 	, projectionMat(UniformMatrixDetail(-1, other.projectionMat.matrixPtr))
 	, materialIDLocation(-1)
 	, materialIDVal(other.materialIDVal)
+	, meshIDLocation(-1)
 	, modelviewprojectionMatLoc(-1)
 	, modelviewMatLoc(-1)
 	, normalMatLoc(-1)
@@ -116,9 +131,28 @@ Shaders::Shaders(const Shaders &other)
 	geometryShaderFiles = new std::vector<const std::string>();
 	for (const auto &i : *other.geometryShaderFiles)
 		geometryShaderFiles->push_back(std::string(i));
+	//defines
+	this->defines = defines;
 	//Usual shader reload
 	reload();
 }
+std::shared_ptr<Shaders> Shaders::getVariant(const Defines &defines)
+{
+	const Defines variantDefines = mergeDefines(this->defines, defines);
+	auto it = variants.find(variantDefines);
+	if (it != variants.end())
+		return it->second;
+	//Build the variant on first request
+	std::shared_ptr<Shaders> rtn(new Shaders(*this, variantDefines));
+	variants.insert({ variantDefines, rtn });
+	return rtn;
+}
+Shaders::Defines Shaders::mergeDefines(Defines base, const Defines &overrides)
+{
+	for (const auto &i : overrides)
+		base[i.first] = i.second;
+	return base;
+}
 Shaders::~Shaders(){
     this->destroyProgram();
 	GL_CALL(glDeleteVertexArrays(1, &vao));
@@ -168,7 +202,8 @@ bool Shaders::_compileShaders(const GLuint t_programId)
 	//Bind any frag shader outputs prior to shader link
 	for (auto &&it : fragShaderOutputLocations)
 	{
-		GL_CALL(glBindFragDataLocation(this->getProgram(), it.first, it.second.c_str()));
+		GL_CALL(glBindFragDataLocation(t_programId, it.first, it.second.c_str()));
+		addProgramKey(su::format("frag%u=%s\n", it.first, it.second.c_str()));
 	}
 	return true;
 }
@@ -233,6 +268,8 @@ void Shaders::_setupBindings(){
 	//Material ID uniform
 	bindUniform(&this->materialIDLocation, MATERIAL_ID_UNIFORM_NAME, GL_UNSIGNED_INT);
 	if (this->materialIDLocation != -1) overrideMaterialID(this->materialIDVal);
+	//Mesh ID uniform
+	bindUniform(&this->meshIDLocation, MESH_ID_UNIFORM_NAME, GL_UNSIGNED_INT);
     //Locate the color uniform
     std::pair<int, GLenum> u_C = findUniform(COLOR_ATTRIBUTE_NAME, this->getProgram());
     if (u_C.first >= 0 && (u_C.second == GL_FLOAT_VEC3 || u_C.second == GL_FLOAT_VEC4))
@@ -300,6 +337,20 @@ void Shaders::overrideMaterialID(unsigned int materialIndex)
 		GL_CALL(glUniform1ui(this->materialIDLocation, materialIDVal));
 	}
 }
+void Shaders::overrideMeshID(unsigned int meshIndex)
+{
+	if (this->meshIDLocation < 0)
+		return;
+#ifdef _DEBUG
+    int currProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currProgram);
+	if (currProgram != getProgram() || getProgram() == -1)
+	{
+		throw std::runtime_error("Error: Shader::overrideMeshID() should only be called whilst the shader is in use.\n");
+    }
+#endif
+	GL_CALL(glUniform1ui(this->meshIDLocation, meshIndex));
+}
 void Shaders::setMaterialID(unsigned int materialIndex)
 {
 	materialIDVal = materialIndex;
@@ -311,6 +362,17 @@ void Shaders::setMaterialID(unsigned int materialIndex)
 		GL_CALL(glUseProgram(0));
 	}
 }
+void Shaders::setLightsBuffer(GLuint bufferBindingPoint)
+{
+	addBuffer(LIGHT_UNIFORM_BLOCK_NAME, GL_UNIFORM_BUFFER, bufferBindingPoint);
+	//Storage used by the CLUSTERED permutation, if the lights buffer has any
+	if (const LightClusters *clusters = LightClusters::find(bufferBindingPoint))
+	{
+		addBuffer(LIGHT_STORAGE_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, clusters->getLightsBindPoint());
+		addBuffer(LIGHT_CLUSTERS_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, clusters->getClustersBindPoint());
+		addBuffer(LIGHT_INDICES_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, clusters->getIndicesBindPoint());
+	}
+}
 void Shaders::_useProgramModelMatrices(const glm::mat4 *force)
 {
     ////Set the previous modelview matrix (e.g. glFrustum, normally provided by the Visualisation)
@@ -489,6 +551,7 @@ void Shaders::buildVAO()
 			{
 				GL_CALL(glVertexAttribIPointer(a.location, a.components, a.componentType, a.stride, static_cast<char *>(nullptr) + a.offset));
 			}
+			GL_CALL(glVertexAttribDivisor(a.location, a.divisor));
 		}
 	}
 	//Face vbo
@@ -7,7 +7,7 @@
 
 #define NORMALS_SIZE 3
 
-class UniformBuffer;//Implementation of setMaterialBuffer(const std::shared_ptr<UniformBuffer> &buffer) found in UniformBuffer.cpp
+class MaterialBuffer;//Implementation of setMaterialBuffer(const std::shared_ptr<MaterialBuffer> &buffer) found in MaterialBuffer.cpp
 
 namespace Stock
 {
@@ -18,28 +18,49 @@ namespace Stock
             char *vertex;
             char *fragment;
             char *geometry;
+            char *defines;//Whitespace separated preprocessor definitions, e.g. "FLAT SHADOWED"
         };
         const ShaderSet FIXED_FUNCTION{ nullptr, nullptr, nullptr };
 		const ShaderSet FULLBRIGHT{ "default.vert", "fullbright_phong.frag", nullptr };
 		const ShaderSet FULLBRIGHT_FLAT{ "default.vert", "material_fullbright_flat.frag", nullptr };
 		const ShaderSet FULLBRIGHT_PHONG{ "default.vert", "material_fullbright_phong.frag", nullptr };
-        const ShaderSet FLAT{ "default.vert", "material_flat.frag", nullptr };
-        const ShaderSet PHONG{ "default.vert", "material_phong.frag", nullptr };
+        const ShaderSet FLAT{ "default.vert", "material.frag", nullptr, "FLAT" };
+        const ShaderSet PHONG{ "default.vert", "material.frag", nullptr };
 		const ShaderSet COLOR{ "color.vert", "color.frag", nullptr };
 		const ShaderSet COLOR_NOSHADE{ "color.vert", "color_noshade.frag", nullptr };
+		const ShaderSet DRAW_WIDE{ "draw_wide.vert", "color_noshade.frag", nullptr };
         const ShaderSet SKYBOX{ "skybox.vert", "skybox.frag", nullptr };
-		const ShaderSet INSTANCED_FLAT{ "instanced_flat.vert", "material_flat.frag", nullptr };
-		const ShaderSet INSTANCED_PHONG{ "instanced_default.vert", "material_phong.frag", nullptr };
+		const ShaderSet INSTANCED_FLAT{ "instanced_flat.vert", "material.frag", nullptr, "FLAT" };
+		const ShaderSet INSTANCED_PHONG{ "instanced_default.vert", "material.frag", nullptr };
+		const ShaderSet INSTANCED{ "instanced.vert", "material.frag", nullptr, "INSTANCE_COLOR" };
 		const ShaderSet TEXT{ "default.vert", "text.frag", nullptr };
 		const ShaderSet SPRITE2D{ "default.vert", "sprite2d.frag", nullptr };
 		const ShaderSet SPRITE2D_HEAT{ "default.vert", "sprite2dHeat.frag", nullptr };
         const ShaderSet BILLBOARD{ "billboard.vert", "particle.frag", nullptr };
 		const ShaderSet LINEAR_DEPTH{ "default.vert", "linear_depth.frag", nullptr };
-		const ShaderSet FLAT_SHADOW{ "shadow.vert", "material_flat_shadow.frag", nullptr };
-		const ShaderSet PHONG_SHADOW{ "shadow.vert", "material_phong_shadow.frag", nullptr };
-		const ShaderSet BONE{ "bone.vert", "material_phong.frag", nullptr };
+		const ShaderSet FLAT_SHADOW{ "default.vert", "material.frag", nullptr, "FLAT SHADOWED" };
+		const ShaderSet PHONG_SHADOW{ "default.vert", "material.frag", nullptr, "SHADOWED" };
+		const ShaderSet BONE{ "bone.vert", "material.frag", nullptr };
 		const ShaderSet BONE_LINEAR_DEPTH{ "bone.vert", "linear_depth.frag", nullptr };
-		const ShaderSet BONE_SHADOW{ "bone_shadow.vert", "material_phong_shadow.frag", nullptr };
+		const ShaderSet BONE_SHADOW{ "bone.vert", "material.frag", nullptr, "SHADOWED" };
+		const ShaderSet DEPTH{ "default.vert", "depth.frag", nullptr, "DEPTH_ONLY" };
+		const ShaderSet BONE_DEPTH{ "bone.vert", "depth.frag", nullptr, "DEPTH_ONLY" };
+		const ShaderSet INSTANCED_DEPTH{ "instanced.vert", "depth.frag", nullptr, "DEPTH_ONLY" };
+		const ShaderSet FLAT_SHADOW_MAPS{ "default.vert", "material.frag", nullptr, "FLAT SHADOW_MAPS" };
+		const ShaderSet PHONG_SHADOW_MAPS{ "default.vert", "material.frag", nullptr, "SHADOW_MAPS" };
+		const ShaderSet BONE_SHADOW_MAPS{ "bone.vert", "material.frag", nullptr, "SHADOW_MAPS" };
+		const ShaderSet PICK{ "default.vert", "pick.frag", nullptr, "PICK" };
+		const ShaderSet INSTANCED_PICK{ "instanced.vert", "pick.frag", nullptr, "PICK" };
+		const ShaderSet BONE_PICK{ "bone.vert", "pick.frag", nullptr, "PICK" };
+		const ShaderSet PHONG_OIT{ "default.vert", "material.frag", nullptr, "OIT" };
+		const ShaderSet INSTANCED_OIT{ "instanced.vert", "material.frag", nullptr, "INSTANCE_COLOR OIT" };
+		const ShaderSet BONE_OIT{ "bone.vert", "material.frag", nullptr, "OIT" };
+		const ShaderSet OIT_COMPOSITE{ "fullscreen.vert", "oit_composite.frag", nullptr };
+		const ShaderSet PHONG_GBUFFER{ "default.vert", "material.frag", nullptr, "GBUFFER" };
+		const ShaderSet FLAT_GBUFFER{ "default.vert", "material.frag", nullptr, "FLAT GBUFFER" };
+		const ShaderSet INSTANCED_GBUFFER{ "instanced.vert", "material.frag", nullptr, "INSTANCE_COLOR GBUFFER" };
+		const ShaderSet BONE_GBUFFER{ "bone.vert", "material.frag", nullptr, "GBUFFER" };
+		const ShaderSet DEFERRED_LIGHTING{ "fullscreen.vert", "deferred_lighting.frag", nullptr };
     }
 }
 /**
@@ -61,8 +82,14 @@ public:
     static const char *MODEL_MATRIX_UNIFORM_NAME;// = "_modelMat";
     static const char *VIEW_MATRIX_UNIFORM_NAME;// = "_viewMat";
 	static const char *LIGHT_UNIFORM_BLOCK_NAME;// = "_lights";
+	static const char *LIGHT_STORAGE_BLOCK_NAME;// = "_lightStorage";
+	static const char *LIGHT_CLUSTERS_BLOCK_NAME;// = "_lightClusters";
+	static const char *LIGHT_INDICES_BLOCK_NAME;// = "_lightIndices";
 	static const char *MATERIAL_UNIFORM_BLOCK_NAME;// = "_materials";
+	static const char *INSTANCE_DATA_BLOCK_NAME;// = "_instanceData";
+	static const char *INSTANCE_INDEX_BLOCK_NAME;// = "_instanceIndices";
 	static const char *MATERIAL_ID_UNIFORM_NAME;// = "_materialID";
+	static const char *MESH_ID_UNIFORM_NAME;// = "_meshID";
 	static const char *VERTEX_ATTRIBUTE_NAME;// = "_vertex";
 	static const char *NORMAL_ATTRIBUTE_NAME;// = "_normal";
 	static const char *COLOR_ATTRIBUTE_NAME;// = "_color";
@@ -110,6 +137,7 @@ public:
             , location(-1)
             , offset(0)
             , stride(0)
+            , divisor(0)
         {}
 		/**
 		 * Underlying component type expressed as GLenum
@@ -152,29 +180,37 @@ public:
 		 * @note This is value is 0 unless the data is interleaved
 		 */
         unsigned int stride;
+		/**
+		 * Number of instances which share each element of the array (as passed to glVertexAttribDivisor())
+		 * @note This value is 0 unless the attribute is per instance
+		 */
+        unsigned int divisor;
      };
 	/**
 	 * Constructs a shader object from one of the stock shader sets
 	 * @param set The shader set to create
+	 * @param defines Preprocessor definitions to build the shader with, these take precedence over those of the shader set
 	 */
-	Shaders(Stock::Shaders::ShaderSet set);
+	Shaders(Stock::Shaders::ShaderSet set, const Defines &defines = Defines());
 	/*
 	 * Constructs a shader program from the provided shader files
 	 * @param vertexShaderFiles Path to the GLSL vertex shader (nullptr if not required)
 	 * @param fragmentShaderFiles Path to the GLSL fragment shader (nullptr if not required)
 	 * @param geometryShaderFiles Path to the GLSL geometry shader (nullptr if not required)
+	 * @param defines Preprocessor definitions to build the shader with
 	 * @note You must provide atleast 1 shader path, however it can be of any of the 3 types
 	 */
-	Shaders(const char *vertexShaderPath = nullptr, const char *fragmentShaderPath = nullptr, const char *geometryShaderPath = nullptr);
+	Shaders(const char *vertexShaderPath = nullptr, const char *fragmentShaderPath = nullptr, const char *geometryShaderPath = nullptr, const Defines &defines = Defines());
 	/*
 	 * Constructs a shader program from the provided shader files
 	 * Use this constructor if you wish to constructor a shader from multiple files (e.g. a common functions file)
 	 * @param vertexShaderFiles Path to the GLSL vertex shader ({} if not required)
 	 * @param fragmentShaderFiles Path to the GLSL fragment shader ({} if not required)
 	 * @param geometryShaderFiles Path to the GLSL geometry shader ({} if not required)
+	 * @param defines Preprocessor definitions to build the shader with
 	 * @note You must provide atleast 1 shader path, however it can be of any of the 3 types
 	 */
-	Shaders(std::initializer_list <const char *> vertexShaderPath, std::initializer_list <const char *> fragmentShaderPath = {}, std::initializer_list <const char *> geometryShaderPath = {});
+	Shaders(std::initializer_list <const char *> vertexShaderPath, std::initializer_list <const char *> fragmentShaderPath = {}, std::initializer_list <const char *> geometryShaderPath = {}, const Defines &defines = Defines());
 	/**
 	 * Copy constructor
 	 * @note This does not duplicate linked external objects, e.g. buffers, textures.
@@ -182,6 +218,14 @@ public:
 	 * @note Therefore this should be used with caution outside of advanced model classes
 	 */
 	Shaders(const Shaders &other);
+	/**
+	 * Returns a permutation of this shader, built with additional preprocessor definitions (e.g. {{"SHADOWED", ""}, {"MAX_LIGHTS", "8"}})
+	 * Variants are built on first request and reused thereafter, they share this shader's bindings as if copy constructed
+	 * @param defines Definitions to add to (or replace within) those of this shader
+	 * @return The shader variant
+	 * @note The variant is owned by this shader, so will be invalidated if this shader is destroyed
+	 */
+	std::shared_ptr<Shaders> getVariant(const Defines &defines);
 	/**
 	 * Free the shader program
 	 */
@@ -224,22 +268,30 @@ public:
      * @throws runtime_error When called whilst current shader is not active
      */
     void overrideModelMat(const glm::mat4 *modelMat);
-	void setLightsBuffer(GLuint bufferBindingPoint) { addBuffer(LIGHT_UNIFORM_BLOCK_NAME, GL_UNIFORM_BUFFER, bufferBindingPoint); }
+	/**
+	 * Sets the uniform buffer which should be bound to the lights uniform buffer block
+	 * If the buffer belongs to a LightsBuffer, it's clustered lighting storage buffers are also bound
+	 * @param bufferBindingPoint GL binding point where the lights buffer is bound
+	 * @see LightClusters
+	 */
+	void setLightsBuffer(GLuint bufferBindingPoint);
     /**
-     * Sets the uniform buffer which should be bound to the material uniform buffer block
+     * Sets the shader storage buffer which should be bound to the material storage block
      * @param bufferBindingPoint GL binding point where buffer is bound
      * @return Returns true if the current shader has a detected material buffer block
+	 * @note Material textures are not bound, use setMaterialBuffer(const std::shared_ptr<MaterialBuffer> &) where possible
 	 * @see addBuffer(const char *, const GLenum, const GLuint)
      */
-	bool setMaterialBuffer(const GLuint bufferBindingPoint) { return addBuffer(MATERIAL_UNIFORM_BLOCK_NAME, GL_UNIFORM_BUFFER, bufferBindingPoint); }
+	bool setMaterialBuffer(const GLuint bufferBindingPoint) { return addBuffer(MATERIAL_UNIFORM_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, bufferBindingPoint); }
 	/**
-     * Sets the uniform buffer which should be bound to the material uniform buffer block
+     * Binds the material storage block, and each of the buffer's texture arrays
 	 * This will not retain the shared_ptr, it's upto you to keep it alive
 	 * @param buffer The buffer to be used
-	 * @note Convenience method, implemented in BufferCore.cpp
+	 * @note Convenience method, implemented in MaterialBuffer.cpp
+	 * @note Texture arrays created after this call are not bound, so this should be repeated after packing a material's textures
 	 * @see addBuffer(const char *, const std::shared_ptr<BufferCore> &)
 	 */
-	bool setMaterialBuffer(const std::shared_ptr<UniformBuffer> &buffer);
+	bool setMaterialBuffer(const std::shared_ptr<MaterialBuffer> &buffer);
 	/**
 	 * Updates the material index
 	 * This version is only to be called whilst the shader is active
@@ -257,6 +309,14 @@ public:
      * @see setMaterialId(unsigned int)
      */
     void overrideMaterialID(unsigned int materialIndex);
+    /**
+     * Updates the index of the mesh being drawn, this is set by Mesh::render() (e.g. for pick.frag)
+     * This version is only to be called whilst the shader is active
+     * @param meshIndex Index of the mesh within its Model
+     * @note This will only throw exceptions in Debug mode
+     * @throws runtime_error When called whilst current shader is not active
+     */
+    void overrideMeshID(unsigned int meshIndex);
 	/**
      * Sets the pointer which will apply a rotation to the ModelView matrix, rotating items rendered by this shader
      * @param rotationPtr A pointer to the rotation will be tracked
@@ -390,6 +450,23 @@ public:
 	 */
 	bool supportsGL_BLEND() const { return supportsBlend; }
 private:
+	/**
+	 * Copy constructor which replaces the preprocessor definitions, used to build variants
+	 * @see getVariant(const Defines &)
+	 */
+	Shaders(const Shaders &other, const Defines &defines);
+	/**
+	 * Permutations of this shader which have been built by getVariant()
+	 * Key: The definitions of the variant
+	 * Val: The variant
+	 */
+	std::map<Defines, std::shared_ptr<Shaders>> variants;
+	/**
+	 * @param base The initial definitions
+	 * @param overrides Definitions to add to base, replacing any of the same name
+	 * @return The combined definitions
+	 */
+	static Defines mergeDefines(Defines base, const Defines &overrides);
 	/**
 	 * Whether shader allows usage of GL_BLEND
 	 * This is based on whether a fragment output includes an alpha channel
@@ -475,6 +552,10 @@ private:
      */
 	int materialIDLocation;
 	int materialIDVal;
+	/**
+	 * Location of the mesh id, the value is set per draw so isn't stored
+	 */
+	int meshIDLocation;
 	/**
 	 * When positive this variable holds the location of the (combined) modelviewprojection matrix in the shader
 	 */
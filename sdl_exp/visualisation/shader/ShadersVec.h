@@ -5,6 +5,7 @@
 
 /**
 * Basic class allowing common shader operations to be perfomed across a set of shaders
+* Operations are applied to every shader, their return value is true only if they succeeded for all shaders
 */
 class ShadersVec
 {
@@ -30,7 +31,7 @@ public:
 		for (auto s : vec)
 			s->setMaterialBuffer(materialName);
 	}
-	void setMaterialBuffer(const std::shared_ptr<UniformBuffer> &buffer){
+	void setMaterialBuffer(const std::shared_ptr<MaterialBuffer> &buffer){
 		for (auto s : vec)
 			s->setMaterialBuffer(buffer);
 	}
@@ -44,11 +45,21 @@ public:
 		for (auto s : vec)
 			s->setTranslationPtr(translationPtr);
 	}
+	void setPositionsAttributeDetail(Shaders::VertexAttributeDetail vad)
+	{
+		for (auto s : vec)
+			s->setPositionsAttributeDetail(vad);
+	}
+	void setFaceVBO(GLuint fbo)
+	{
+		for (auto s : vec)
+			s->setFaceVBO(fbo);
+	}
 	bool addGenericAttributeDetail(const char* attributeName, Shaders::VertexAttributeDetail vad)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addGenericAttributeDetail(attributeName, vad);
+			a = s->addGenericAttributeDetail(attributeName, vad) && a;
 		return a;
 	}
 	void clearModelMatPtr()
@@ -80,105 +91,112 @@ public:
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addTexture(textureNameInShader, type, textureName, textureUnit);
+			a = s->addTexture(textureNameInShader, type, textureName, textureUnit) && a;
 		return a;
 	}
 	bool addTexture(const char *textureNameInShader, const std::shared_ptr<const Texture> &texture)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addTexture(textureNameInShader, texture);
+			a = s->addTexture(textureNameInShader, texture) && a;
 		return a;
 	}
 	bool addDynamicUniform(const char *uniformName, const GLfloat *arry, unsigned int count = 1)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addDynamicUniform(uniformName, arry, count);
+			a = s->addDynamicUniform(uniformName, arry, count) && a;
 		return a;
 	}
 	bool addDynamicUniform(const char *uniformName, const GLint *arry, unsigned int count = 1)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addDynamicUniform(uniformName, arry, count);
+			a = s->addDynamicUniform(uniformName, arry, count) && a;
 		return a;
 	}
 	bool addDynamicUniform(const char *uniformName, const GLuint *arry, unsigned int count = 1)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addDynamicUniform(uniformName, arry, count);
+			a = s->addDynamicUniform(uniformName, arry, count) && a;
 		return a;
 	}
 	bool addDynamicUniform(const char *uniformName, const glm::mat4 *mat)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addDynamicUniform(uniformName, mat);
+			a = s->addDynamicUniform(uniformName, mat) && a;
 		return a;
 	}
 	bool addStaticUniform(const char *uniformName, const GLfloat *arry, unsigned int count = 1)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addDynamicUniform(uniformName, arry, count);
+			a = s->addDynamicUniform(uniformName, arry, count) && a;
 		return a;
 	}
 	bool addStaticUniform(const char *uniformName, const GLint *arry, unsigned int count = 1)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addStaticUniform(uniformName, arry, count);
+			a = s->addStaticUniform(uniformName, arry, count) && a;
 		return a;
 	}
 	bool addStaticUniform(const char *uniformName, const GLuint *arry, unsigned int count = 1)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addStaticUniform(uniformName, arry, count);
+			a = s->addStaticUniform(uniformName, arry, count) && a;
 		return a;
 	}
 	bool addBuffer(const char *bufferNameInShader, const std::shared_ptr<BufferCore> &buffer)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addBuffer(bufferNameInShader, buffer);
+			a = s->addBuffer(bufferNameInShader, buffer) && a;
 		return a;
 	}
 	bool addBuffer(const char *bufferNameInShader, const GLenum bufferType, const GLuint bufferBindingPoint)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->addBuffer(bufferNameInShader, bufferType, bufferBindingPoint);
+			a = s->addBuffer(bufferNameInShader, bufferType, bufferBindingPoint) && a;
+		return a;
+	}
+	bool addBuffer(const char *bufferNameInShader, const std::shared_ptr<const UniformBlock> &block)
+	{
+		bool a = true;
+		for (auto s : vec)
+			a = s->addBuffer(bufferNameInShader, block) && a;
 		return a;
 	}
 	bool removeDynamicUniform(const char *uniformName)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->removeDynamicUniform(uniformName);
+			a = s->removeDynamicUniform(uniformName) && a;
 		return a;
 	}
 	bool removeStaticUniform(const char *uniformName)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->removeStaticUniform(uniformName);
+			a = s->removeStaticUniform(uniformName) && a;
 		return a;
 	}
 	bool removeTextureUniform(const char *uniformName)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->removeTextureUniform(uniformName);
+			a = s->removeTextureUniform(uniformName) && a;
 		return a;
 	}
 	bool removeBuffer(const char *nameInShader)
 	{
 		bool a = true;
 		for (auto s : vec)
-			a = a && s->removeBuffer(nameInShader);
+			a = s->removeBuffer(nameInShader) && a;
 		return a;
 	}
 };
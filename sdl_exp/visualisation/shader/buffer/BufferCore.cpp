@@ -1,34 +1,103 @@
 #include "BufferCore.h"
 #include "../../util/GLcheck.h"
 #include <cassert>
+#include <cstdio>
 
-BufferCore::BufferCore(GLenum bufferType, GLint bindPoint, size_t size, void* data)
+BufferCore::BufferCore(GLenum bufferType, GLint bindPoint, size_t size, void* data, Usage usage)
 	: size(size)
 	, bufferName(0)
+	, usage(usage)
+	, ring(nullptr)
 	, bufferBindPoint(bindPoint)
 	, bufferType(bufferType)
 {
 	assert(this->size < maxSize(bufferType));
 	GL_CALL(glGenBuffers(1, &bufferName));
-	GL_CALL(glBindBuffer(bufferType, bufferName));
-	GL_CALL(glBindBufferBase(bufferType, bufferBindPoint, bufferName));
-	GL_CALL(glBufferData(bufferType, size, data, GL_STATIC_DRAW));
-	GL_CALL(glBindBuffer(bufferType, 0));
+	allocate(data);
 }
 BufferCore::~BufferCore()
 {
+	//Deleting the buffer unmaps the ring
+	ring.reset();
 	GL_CALL(glDeleteBuffers(1, &bufferName));
 }
+void BufferCore::allocate(const void *data)
+{
+	if (usage == STREAM)
+	{
+		ring = std::make_unique<StreamRing>(bufferType, bufferName, size, offsetAlignment(bufferType), data);
+	}
+	else
+	{
+		GL_CALL(glBindBuffer(bufferType, bufferName));
+		if (usage == IMMUTABLE)
+		{//Read/write mapping is permitted, so that mapBuffer() behaves as with mutable storage
+			GL_CALL(glBufferStorage(bufferType, size, data, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT));
+		}
+		else
+		{
+			GL_CALL(glBufferData(bufferType, size, data, usage == ORPHAN ? GL_STREAM_DRAW : GL_STATIC_DRAW));
+		}
+		GL_CALL(glBindBuffer(bufferType, 0));
+	}
+	bind();
+}
+void BufferCore::reallocate(const void *data)
+{
+	ring.reset();
+	GL_CALL(glDeleteBuffers(1, &bufferName));
+	GL_CALL(glGenBuffers(1, &bufferName));
+	allocate(data);
+}
+void BufferCore::bind()
+{
+	if (ring)
+	{
+		GL_CALL(glBindBufferRange(bufferType, bufferBindPoint, bufferName, ring->getOffset(), size ? size : 1));
+	}
+	else
+	{
+		GL_CALL(glBindBufferBase(bufferType, bufferBindPoint, bufferName));
+	}
+}
 void BufferCore::setData(void *data, size_t size)
 {
+	const bool resized = size != 0 && size != this->size;
 	this->size = size == 0 ? this->size : size;
 	assert(this->size < maxSize(bufferType));
-	GL_CALL(glBindBuffer(bufferType, bufferName));
-	GL_CALL(glBufferData(bufferType, this->size, data, GL_STATIC_DRAW));
-	GL_CALL(glBindBuffer(bufferType, 0));
+	if (usage == MUTABLE || (usage == ORPHAN && resized))
+	{//glBufferData() already orphans the previous storage
+		GL_CALL(glBindBuffer(bufferType, bufferName));
+		GL_CALL(glBufferData(bufferType, this->size, data, usage == ORPHAN ? GL_STREAM_DRAW : GL_STATIC_DRAW));
+		GL_CALL(glBindBuffer(bufferType, 0));
+	}
+	else if (resized)
+	{//Immutable storage can't be resized
+		reallocate(data);
+	}
+	else if (usage == STREAM)
+	{
+		ring->write(data, this->size);
+		bind();
+	}
+	else
+	{
+		if (usage == ORPHAN)
+		{
+			GL_CALL(glInvalidateBufferData(bufferName));
+		}
+		if (data)
+			setData(data, this->size, 0);
+	}
 }
 void BufferCore::setData(void *data, size_t size, size_t offset){
 	assert(size + offset <= this->size);
+	if (ring)
+	{
+		ring->write(data, size, offset);
+		bind();
+		return;
+	}
 	GL_CALL(glBindBuffer(bufferType, bufferName));
 	GL_CALL(glBufferSubData(bufferType, offset, size, (void*)data));
 	GL_CALL(glBindBuffer(bufferType, 0));
@@ -36,6 +105,11 @@ void BufferCore::setData(void *data, size_t size, size_t offset){
 void BufferCore::getData(void *dataReturn, size_t size, size_t offset)
 {
 	size = size == 0 ? this->size : size;
+	if (ring)
+	{//Reading persistently mapped write only memory would be slow
+		ring->read(dataReturn, size, offset);
+		return;
+	}
 	GL_CALL(glBindBuffer(bufferType, bufferName));
 	GL_CALL(glGetBufferSubData(bufferType, offset, size, (void*)dataReturn));
 	GL_CALL(glBindBuffer(bufferType, 0));
@@ -54,11 +128,41 @@ void *BufferCore::mapBufferReadWrite()
 }
 void *BufferCore::mapBuffer(GLenum access)
 {
+	if (ring)
+	{
+		fprintf(stderr, "BufferCore::mapBuffer(): STREAM buffers are persistently mapped, use setData().\n");
+		return nullptr;
+	}
+	void *rtn = nullptr;
 	GL_CALL(glBindBuffer(bufferType, bufferName));
-	GL_CALL(glMapBuffer(bufferType, access));
+	GL_CALL(rtn = glMapBuffer(bufferType, access));
 	GL_CALL(glBindBuffer(bufferType, 0));
-	void *rtn;
-	GL_CALL(glGetBufferPointerv(bufferType, GL_BUFFER_MAP_POINTER, &rtn));
+	return rtn;
+}
+void *BufferCore::mapBufferRange(size_t offset, size_t length, GLbitfield access)
+{
+	if (ring)
+	{
+		fprintf(stderr, "BufferCore::mapBufferRange(): STREAM buffers are persistently mapped, use setData().\n");
+		return nullptr;
+	}
+	length = length == 0 ? size - offset : length;
+	assert(offset + length <= size);
+	void *rtn = nullptr;
+	GL_CALL(glBindBuffer(bufferType, bufferName));
+	GL_CALL(rtn = glMapBufferRange(bufferType, offset, length, access));
+	GL_CALL(glBindBuffer(bufferType, 0));
+	return rtn;
+}
+void *BufferCore::mapNextRegion()
+{
+	if (!ring)
+	{
+		fprintf(stderr, "BufferCore::mapNextRegion(): Only STREAM buffers have regions.\n");
+		return nullptr;
+	}
+	void *rtn = ring->acquire();
+	bind();
 	return rtn;
 }
 void BufferCore::unmapBuffer()
@@ -153,6 +257,32 @@ GLint BufferCore::maxBuffers(GLenum bufferType)
 	}
 	return 0;
 }
+GLint BufferCore::offsetAlignment(GLenum bufferType)
+{
+	if (bufferType == GL_UNIFORM_BUFFER)
+	{
+		static GLint uniformAlignment = 0;
+		if (!uniformAlignment)
+			GL_CALL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment));//256@1080gtx
+		return uniformAlignment;
+	}
+	else if (bufferType == GL_SHADER_STORAGE_BUFFER)
+	{
+		static GLint ssbAlignment = 0;
+		if (!ssbAlignment)
+			GL_CALL(glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbAlignment));//32@1080gtx
+		return ssbAlignment;
+	}
+	else if (bufferType == GL_TEXTURE_BUFFER)
+	{
+		static GLint tbAlignment = 0;
+		if (!tbAlignment)
+			GL_CALL(glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &tbAlignment));//16@1080gtx
+		return tbAlignment;
+	}
+	//Atomic counter offsets must be a multiple of 4, transform feedback is unconstrained beyond that
+	return 4;
+}
 
 //Comment out this include if not making use of Shaders/ShaderCore
 #include "../ShaderCore.h"
@@ -1,6 +1,8 @@
 #ifndef __Buffer_h__
 #define __Buffer_h__
 #include <GL/glew.h>
+#include <memory>
+#include "StreamRing.h"
 
 /**
  * This class must be specialised e.g. GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER or GL_ATOMIC_COUNTER_BUFFER (not yet implemented the latter two)
@@ -10,6 +12,34 @@
 class BufferCore
 {
 public:
+	/**
+	 * How the buffer's storage is allocated and how setData() writes to it
+	 */
+	enum Usage
+	{
+		/**
+		 * Mutable storage (glBufferData()), written in place
+		 * Suits data which is rarely written, this was the only behaviour prior to the introduction of Usage
+		 */
+		MUTABLE,
+		/**
+		 * Immutable storage (glBufferStorage()), suits static data
+		 * Partial writes are permitted, resizing allocates a new buffer object
+		 */
+		IMMUTABLE,
+		/**
+		 * Mutable storage, which is invalidated (orphaned) before the whole buffer is written
+		 * The driver can then provide fresh memory, rather than stall until in flight draws have finished reading the old contents
+		 * Suits data which is rewritten whole, possibly several times a frame (e.g. bone palettes of a model drawn repeatedly)
+		 */
+		ORPHAN,
+		/**
+		 * A ring of persistently mapped regions (see StreamRing), each write fills the next region and binds it in place of the last
+		 * Suits data which is written once per frame, writes only stall if the GPU falls more than the ring behind
+		 * @note Every write (including partial writes) copies the whole buffer, getName() is bound with an offset (see getOffset())
+		 */
+		STREAM
+	};
 	/**
 	 * Returns the currently allocated size of the buffer
 	 */
@@ -19,6 +49,15 @@ public:
 	 * @note This permits you to manually handle the buffer
 	 */
 	GLint getName() const { return bufferName; }
+	/**
+	 * Returns the byte offset of the buffer's current contents within the buffer object
+	 * This is only non 0 for STREAM buffers, it must be applied when binding or reading getName() manually
+	 */
+	size_t getOffset() const { return ring ? ring->getOffset() : 0; }
+	/**
+	 * Returns the usage mode selected at construction
+	 */
+	Usage getUsage() const { return usage; }
 	/**
 	 * Returns the buffer binding point, this binding point is intended (by sdl_exp) to be unique to all buffers of the same type
 	 * @note glUniformBlockBinding() is used to bind the buffer (via it's binding point) to the shader uniform hosting the buffer
@@ -61,6 +100,23 @@ public:
 	 * @note unmapBuffer() must be called after access is completed
 	 */
 	void *mapBufferReadWrite();
+	/**
+	 * Provides access to a range of the buffer
+	 * @param offset Byte offset of the range
+	 * @param length Length of the range in bytes, 0 maps to the end of the buffer
+	 * @param access Access flags, as passed to glMapBufferRange(), e.g. GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+	 * @note unmapBuffer() must be called after access is completed
+	 * @note STREAM buffers are already persistently mapped, so can't be mapped, use setData()
+	 */
+	void *mapBufferRange(size_t offset, size_t length, GLbitfield access);
+	/**
+	 * Advances a STREAM buffer to its next region and binds it, returning the region's persistently mapped memory
+	 * Writing here avoids the copy made by setData(), however the whole buffer must be written before it is next used
+	 * @return nullptr if the buffer's usage is not STREAM
+	 * @note Unlike the other map methods, unmapBuffer() must not be called
+	 * @see StreamRing::acquire()
+	 */
+	void *mapNextRegion();
 	/**
 	 * Unmaps a buffer
 	 */
@@ -73,9 +129,13 @@ public:
 
 	static GLint maxSize(GLenum bufferType);
 	static GLint maxBuffers(GLenum bufferType);
+	/**
+	 * Returns the required alignment of offsets passed to glBindBufferRange() for the buffer type
+	 */
+	static GLint offsetAlignment(GLenum bufferType);
 	//Do version for max per shader too, e.g. MAX_COMBINED_UNIFORM_BLOCKS, MAX_COMBINED_SHADER_STORAGE_BLOCKS
 protected:
-	BufferCore(GLenum bufferType, GLint bindPoint, size_t bytes, void* data = nullptr);
+	BufferCore(GLenum bufferType, GLint bindPoint, size_t bytes, void* data = nullptr, Usage usage = MUTABLE);
 	virtual ~BufferCore();
 private:
 	/**
@@ -83,8 +143,26 @@ private:
 	 * @param access The access level provided: GL_READ_ONLY, GL_WRITE_ONLY, GL_READ_WRITE
 	 */
 	void *mapBuffer(GLenum access);
+	/**
+	 * Allocates storage of the current size, according to usage, then binds it to the binding point
+	 * @note Immutable storage can't be reallocated, the existing buffer object must first be replaced (see reallocate())
+	 */
+	void allocate(const void *data);
+	/**
+	 * Replaces the buffer object with a new one of the current size
+	 */
+	void reallocate(const void *data);
+	/**
+	 * Binds the buffer (the current region of STREAM buffers) to the binding point
+	 */
+	void bind();
 	size_t size;
 	GLuint bufferName;
+	const Usage usage;
+	/**
+	 * The persistently mapped regions of STREAM buffers
+	 */
+	std::unique_ptr<StreamRing> ring;
 protected:
 	const GLuint bufferBindPoint;
 	const GLenum bufferType;
@@ -4,12 +4,16 @@
 #include <cassert>
 
 std::set<GLint> ShaderStorageBuffer::allocatedBindPoints;
-ShaderStorageBuffer::ShaderStorageBuffer(size_t size, void* data)
-	: BufferCore(GL_SHADER_STORAGE_BUFFER, allocateBindPoint(), size, data)
+ShaderStorageBuffer::ShaderStorageBuffer(size_t size, void* data, Usage usage)
+	: BufferCore(GL_SHADER_STORAGE_BUFFER, allocateBindPoint(), size, data, usage)
 { }
 ShaderStorageBuffer::~ShaderStorageBuffer()
 {
-	allocatedBindPoints.erase(bufferBindPoint);
+	releaseBindPoint(bufferBindPoint);
+}
+void ShaderStorageBuffer::releaseBindPoint(GLint bindPoint)
+{
+	allocatedBindPoints.erase(bindPoint);
 }
 
 GLint ShaderStorageBuffer::allocateBindPoint()
@@ -13,12 +13,26 @@
 class ShaderStorageBuffer : public BufferCore
 {
 public:
-	ShaderStorageBuffer(size_t bytes, void* data = nullptr);
+	/**
+	 * @param bytes Size of the buffer
+	 * @param data Initial contents, nullptr leaves them undefined
+	 * @param usage How the buffer's storage is allocated and written, see BufferCore::Usage
+	 */
+	ShaderStorageBuffer(size_t bytes, void* data = nullptr, Usage usage = MUTABLE);
 	~ShaderStorageBuffer();
 	static GLint MaxSize();
 	static GLint MaxBuffers();
+	/**
+	 * Reserves a unique shader storage binding point
+	 * This permits buffers not owned by a ShaderStorageBuffer (e.g. a vbo read via vertex pulling) to be bound as storage
+	 * @note The binding point must be returned with releaseBindPoint() when nolonger required
+	 */
+	static GLint allocateBindPoint();
+	/**
+	 * Returns a binding point reserved with allocateBindPoint()
+	 */
+	static void releaseBindPoint(GLint bindPoint);
 private:
-	GLint allocateBindPoint();
 	static std::set<GLint> allocatedBindPoints;
 };
 
@@ -0,0 +1,86 @@
+#include "StreamRing.h"
+#include "../../util/GLcheck.h"
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	/**
+	 * Fences are polled at this interval, in nanoseconds, whilst waiting for a region
+	 */
+	const GLuint64 FENCE_TIMEOUT = 1000000;
+	const GLbitfield MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+}
+
+StreamRing::StreamRing(GLenum target, GLuint name, size_t size, GLint alignment, const void *data, unsigned int regions)
+	: size(size)
+	//Empty buffers still require a valid range to bind
+	, stride(((size ? size : 1) + alignment - 1) / alignment * alignment)
+	, regions(regions ? regions : 1)
+	, region(0)
+	, mapped(nullptr)
+	, fences(this->regions, nullptr)
+	, contents(size, 0)
+	, contentsValid(true)
+{
+	GL_CALL(glBindBuffer(target, name));
+	GL_CALL(glBufferStorage(target, getCapacity(), nullptr, MAP_FLAGS));
+	GL_CALL(mapped = (unsigned char*)glMapBufferRange(target, 0, getCapacity(), MAP_FLAGS));
+	GL_CALL(glBindBuffer(target, 0));
+	if (!mapped)
+		fprintf(stderr, "StreamRing::StreamRing(): Persistent mapping failed, buffer contents will not be written.\n");
+	if (data && size)
+		memcpy(contents.data(), data, size);
+	if (mapped && size)
+		memcpy(mapped, contents.data(), size);
+}
+StreamRing::~StreamRing()
+{
+	for (auto &&f : fences)
+	{
+		if (f)
+		{
+			GL_CALL(glDeleteSync(f));
+		}
+	}
+}
+void StreamRing::advance()
+{
+	//Every command issued since the current region was written may read it
+	GL_CALL(fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	region = (region + 1) % regions;
+	if (fences[region])
+	{
+		GLenum status = GL_TIMEOUT_EXPIRED;
+		while (status == GL_TIMEOUT_EXPIRED)
+		{
+			GL_CALL(status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT));
+		}
+		GL_CALL(glDeleteSync(fences[region]));
+		fences[region] = nullptr;
+	}
+}
+size_t StreamRing::write(const void *data, size_t bytes, size_t offset)
+{
+	assert(bytes + offset <= size);
+	assert(contentsValid || (data && offset == 0 && bytes == size));
+	advance();
+	contentsValid = contentsValid || (data && offset == 0 && bytes == size);
+	if (data && bytes)
+		memcpy(contents.data() + offset, data, bytes);
+	if (mapped && size)
+		memcpy(mapped + getOffset(), contents.data(), size);
+	return getOffset();
+}
+void *StreamRing::acquire()
+{
+	advance();
+	contentsValid = false;
+	return mapped ? mapped + getOffset() : nullptr;
+}
+void StreamRing::read(void *dataReturn, size_t bytes, size_t offset) const
+{
+	assert(bytes + offset <= size);
+	assert(contentsValid);
+	memcpy(dataReturn, contents.data() + offset, bytes);
+}
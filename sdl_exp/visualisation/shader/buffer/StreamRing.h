@@ -0,0 +1,85 @@
+#ifndef __StreamRing_h__
+#define __StreamRing_h__
+#include <GL/glew.h>
+#include <vector>
+
+/**
+ * Backs a buffer with a ring of equally sized regions, which are persistently and coherently mapped
+ * Each write copies the buffer's contents into the next region, so the CPU never writes memory which in flight commands may read
+ * A fence is placed when a region is left, writes only wait if the ring wraps around onto a region the GPU has not finished with
+ * The owner binds the region returned by write() (e.g. glBindBufferRange(), glTexBufferRange()) in place of the previous region
+ * @note Deleting the buffer object unmaps it, the owner should delete the StreamRing first
+ */
+class StreamRing
+{
+public:
+	/**
+	 * The number of regions allocated, unless specified otherwise
+	 * Allows the region in use by the GPU, the region being written and a frame of latency
+	 */
+	static const unsigned int DEFAULT_REGIONS = 3;
+	/**
+	 * Allocates immutable storage for the ring, to the buffer object name
+	 * @param target Binding target used to allocate the storage, e.g. GL_UNIFORM_BUFFER
+	 * @param name The buffer object, this must not already have storage
+	 * @param size Size of the buffer's contents, in bytes
+	 * @param alignment Required alignment of the offset of each region, e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	 * @param data Initial contents of the buffer, copied into the first region, nullptr leaves them zero
+	 * @param regions The number of regions in the ring
+	 */
+	StreamRing(GLenum target, GLuint name, size_t size, GLint alignment, const void *data = nullptr, unsigned int regions = DEFAULT_REGIONS);
+	/**
+	 * Deletes outstanding fences
+	 */
+	~StreamRing();
+	StreamRing(const StreamRing&) = delete;
+	StreamRing &operator=(const StreamRing&) = delete;
+	/**
+	 * Advances to the next region, waiting until the GPU has finished reading it, then writes the buffer's contents to it
+	 * The contents are the previous contents, with [offset, offset+bytes) replaced by data
+	 * @param data The data to write, nullptr leaves the contents unchanged
+	 * @param bytes The number of bytes to write
+	 * @param offset Byte offset of the write, within the buffer's contents
+	 * @return Byte offset of the new region, within the buffer object
+	 */
+	size_t write(const void *data, size_t bytes, size_t offset = 0);
+	/**
+	 * Advances to the next region, waiting until the GPU has finished reading it, then returns it for the caller to write directly
+	 * This avoids write()'s copy, however the caller must write the whole contents before issuing commands which read them
+	 * @note The CPU side copy is not updated, so read() and partial writes are invalid until the next whole write()
+	 */
+	void *acquire();
+	/**
+	 * Copies the buffer's contents (as last written) from a CPU side copy
+	 */
+	void read(void *dataReturn, size_t bytes, size_t offset = 0) const;
+	/**
+	 * @return Byte offset of the current region, within the buffer object
+	 */
+	size_t getOffset() const { return region * stride; }
+	/**
+	 * @return Size of the buffer object, in bytes
+	 */
+	size_t getCapacity() const { return stride * regions; }
+private:
+	/**
+	 * Fences the current region, then advances to the next once the GPU has finished reading it
+	 */
+	void advance();
+	const size_t size;
+	const size_t stride;
+	const unsigned int regions;
+	unsigned int region;
+	unsigned char *mapped;
+	std::vector<GLsync> fences;
+	/**
+	 * The buffer's contents, partial writes are applied here so that each region can be written whole
+	 */
+	std::vector<unsigned char> contents;
+	/**
+	 * False once regions have been written via acquire(), as contents is then stale
+	 */
+	bool contentsValid;
+};
+
+#endif //__StreamRing_h__
@@ -0,0 +1,168 @@
+#include "UniformBlockAllocator.h"
+#include "UniformBuffer.h"
+#include "../../util/GLcheck.h"
+#include <cassert>
+#include <algorithm>
+
+std::weak_ptr<UniformBlockAllocator> UniformBlockAllocator::instance;
+UniformBlockAllocator::Stats UniformBlockAllocator::currentFrame;
+UniformBlockAllocator::Stats UniformBlockAllocator::lastFrame;
+
+UniformBlock::UniformBlock(std::shared_ptr<UniformBlockAllocator> allocator, unsigned int page, TLSF::Allocation range, size_t size)
+	: allocator(allocator)
+	, page(page)
+	, range(range)
+	, size(size)
+{ }
+UniformBlock::~UniformBlock()
+{
+	allocator->pages[page].allocator.free(range.node);
+	--allocator->blockCount;
+	//Forget bindings of the range, so a block later allocated in its place isn't mistaken as bound
+	for (auto b = allocator->bound.begin(); b != allocator->bound.end();)
+	{
+		if (b->second.name == getName() && b->second.offset == getOffset())
+			b = allocator->bound.erase(b);
+		else
+			++b;
+	}
+}
+size_t UniformBlock::getOffset() const
+{
+	return (size_t)range.offset * allocator->alignment;
+}
+GLuint UniformBlock::getName() const
+{
+	return allocator->pages[page].name;
+}
+void UniformBlock::setData(const void *data, size_t size, size_t offset)
+{
+	size = size ? size : this->size - offset;
+	assert(size + offset <= this->size);
+	//Copy targets don't disturb the indexed uniform buffer bindings
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, getName()));
+	GL_CALL(glBufferSubData(GL_COPY_WRITE_BUFFER, getOffset() + offset, size, data));
+	GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+void UniformBlock::bind(GLuint bindPoint) const
+{
+	UniformBlockAllocator::Binding &b = allocator->bound[bindPoint];
+	if (b.name == getName() && b.offset == getOffset() && b.size == size)
+	{
+		++UniformBlockAllocator::currentFrame.redundantBinds;
+		return;
+	}
+	b = { getName(), getOffset(), size };
+	GL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, bindPoint, b.name, b.offset, b.size));
+	++UniformBlockAllocator::currentFrame.binds;
+}
+
+std::shared_ptr<UniformBlockAllocator> UniformBlockAllocator::get()
+{
+	std::shared_ptr<UniformBlockAllocator> rtn = instance.lock();
+	if (!rtn)
+	{//Constructor is private, so make_shared() can't be used
+		rtn = std::shared_ptr<UniformBlockAllocator>(new UniformBlockAllocator());
+		instance = rtn;
+	}
+	return rtn;
+}
+void UniformBlockAllocator::report(FILE *out)
+{
+	fprintf(out, "blocks,pages,bind_points,bytes_used,bytes_capacity,binds,redundant_binds\n");
+	Utilisation u = {};
+	if (auto allocator = instance.lock())
+		u = allocator->getUtilisation();
+	fprintf(out, "%u,%u,%u,%llu,%llu,%u,%u\n", u.blocks, u.pages, u.bindPoints, (unsigned long long)u.bytesUsed, (unsigned long long)u.bytesCapacity, lastFrame.binds, lastFrame.redundantBinds);
+}
+void UniformBlockAllocator::endFrame()
+{
+	lastFrame = currentFrame;
+	currentFrame = Stats();
+}
+UniformBlockAllocator::UniformBlockAllocator()
+	: alignment((size_t)std::max(BufferCore::offsetAlignment(GL_UNIFORM_BUFFER), 1))
+	, blockCount(0)
+{ }
+UniformBlockAllocator::~UniformBlockAllocator()
+{
+	for (auto &&p : pages)
+	{
+		GL_CALL(glDeleteBuffers(1, &p.name));
+	}
+	for (auto &&b : bindPoints)
+		UniformBuffer::releaseBindPoint(b.second);
+}
+std::shared_ptr<UniformBlock> UniformBlockAllocator::allocate(size_t bytes)
+{
+	if (bytes > (size_t)BufferCore::maxSize(GL_UNIFORM_BUFFER))
+	{
+		fprintf(stderr, "UniformBlockAllocator::allocate(): %llu bytes exceeds GL_MAX_UNIFORM_BLOCK_SIZE (%d).\n", (unsigned long long)bytes, BufferCore::maxSize(GL_UNIFORM_BUFFER));
+		return nullptr;
+	}
+	const unsigned int units = (unsigned int)((std::max<size_t>(bytes, 1) + alignment - 1) / alignment);
+	unsigned int page = 0;
+	TLSF::Allocation range = { 0, TLSF::NONE };
+	for (; page < pages.size(); ++page)
+	{
+		range = pages[page].allocator.allocate(units);
+		if (range.node != TLSF::NONE)
+			break;
+	}
+	if (page == pages.size())
+	{
+		const size_t pageBytes = std::max<size_t>((size_t)PAGE_SIZE, (size_t)units * alignment);
+		Page p = { 0, TLSF((unsigned int)(pageBytes / alignment)) };
+		GL_CALL(glGenBuffers(1, &p.name));
+		GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, p.name));
+		GL_CALL(glBufferData(GL_COPY_WRITE_BUFFER, pageBytes, nullptr, GL_DYNAMIC_DRAW));
+		GL_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+		range = p.allocator.allocate(units);
+		pages.push_back(std::move(p));
+	}
+	assert(range.node != TLSF::NONE);
+	++blockCount;
+	return std::shared_ptr<UniformBlock>(new UniformBlock(shared_from_this(), page, range, bytes));
+}
+GLuint UniformBlockAllocator::getBindPoint(const std::string &blockName)
+{
+	auto b = bindPoints.find(blockName);
+	if (b != bindPoints.end())
+		return b->second;
+	const GLuint rtn = (GLuint)UniformBuffer::allocateBindPoint();
+	bindPoints.emplace(blockName, rtn);
+	return rtn;
+}
+UniformBlockAllocator::Utilisation UniformBlockAllocator::getUtilisation() const
+{
+	Utilisation rtn;
+	rtn.blocks = blockCount;
+	rtn.pages = (unsigned int)pages.size();
+	rtn.bindPoints = (unsigned int)bindPoints.size();
+	rtn.bytesUsed = 0;
+	rtn.bytesCapacity = 0;
+	for (auto &&p : pages)
+	{
+		rtn.bytesUsed += (size_t)p.allocator.getUsed() * alignment;
+		rtn.bytesCapacity += (size_t)p.allocator.getSize() * alignment;
+	}
+	return rtn;
+}
+
+//Comment out this include if not making use of Shaders/ShaderCore
+#include "../ShaderCore.h"
+#ifdef __ShaderCore_h__
+bool ShaderCore::addBuffer(const char *bufferNameInShader, const std::shared_ptr<const UniformBlock> &block)
+{
+	if (!block)
+	{
+		removeBuffer(bufferNameInShader);
+		return false;
+	}
+	const GLuint bindPoint = block->getAllocator().getBindPoint(bufferNameInShader);
+	const bool rtn = addBuffer(bufferNameInShader, GL_UNIFORM_BUFFER, bindPoint);
+	//Recorded after addBuffer(), as it purges any existing entry
+	uniformBlocks.emplace(bufferNameInShader, std::make_pair(bindPoint, block));
+	return rtn;
+}
+#endif //__ShaderCore_h__
@@ -0,0 +1,148 @@
+#ifndef __UniformBlockAllocator_h__
+#define __UniformBlockAllocator_h__
+#include <GL/glew.h>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../../util/TLSF.h"
+
+class UniformBlockAllocator;
+/**
+ * A range of one of UniformBlockAllocator's pages, used in place of a UniformBuffer
+ * Attach to shaders with ShaderCore::addBuffer(const char *, const std::shared_ptr<const UniformBlock> &)
+ * The range is released when the block is destroyed
+ */
+class UniformBlock
+{
+	friend class UniformBlockAllocator;
+public:
+	~UniformBlock();
+	UniformBlock(const UniformBlock&) = delete;
+	UniformBlock &operator=(const UniformBlock&) = delete;
+	/**
+	 * Passes data to the block
+	 * @param size The number of bytes to write, 0 writes the whole block
+	 * @note The value of size+offset cannot exceed that returned by getSize()
+	 */
+	void setData(const void *data, size_t size = 0, size_t offset = 0);
+	/**
+	 * Binds the block's range to the binding point with glBindBufferRange(), unless it is already bound there
+	 */
+	void bind(GLuint bindPoint) const;
+	size_t getSize() const { return size; }
+	/**
+	 * @return The byte offset of the block within its page, this is a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	 */
+	size_t getOffset() const;
+	/**
+	 * @return The GL name of the page holding the block
+	 */
+	GLuint getName() const;
+	UniformBlockAllocator &getAllocator() const { return *allocator; }
+private:
+	UniformBlock(std::shared_ptr<UniformBlockAllocator> allocator, unsigned int page, TLSF::Allocation range, size_t size);
+	/**
+	 * Held so that the allocator outlives its blocks
+	 */
+	std::shared_ptr<UniformBlockAllocator> allocator;
+	const unsigned int page;
+	const TLSF::Allocation range;
+	const size_t size;
+};
+/**
+ * Sub allocates uniform blocks from a few large uniform buffers (pages), so that the number of blocks isn't limited by GL_MAX_UNIFORM_BUFFER_BINDINGS
+ * Each block is bound with glBindBufferRange() when a shader it's attached to is used, redundant binds are skipped
+ * Blocks attached to uniform blocks of the same name share a binding point, so binding points scale with the number of distinct block names rather than the number of blocks
+ * Usage:
+ *   auto bones = UniformBlockAllocator::get()->allocate(sizeof(glm::mat4) * boneCount);
+ *   bones->setData(transforms);
+ *   shaders->addBuffer("_bones", bones);//Bound each time shaders->useProgram() is called
+ * @note Pages are written with glBufferSubData(), so blocks suit data written at most once per frame
+ */
+class UniformBlockAllocator : public std::enable_shared_from_this<UniformBlockAllocator>
+{
+	friend class UniformBlock;
+public:
+	/**
+	 * The size of each page, blocks larger than this are given a page of their own
+	 */
+	static const size_t PAGE_SIZE = 1 << 20;
+	struct Stats
+	{
+		/**
+		 * Calls to glBindBufferRange()
+		 */
+		unsigned int binds = 0;
+		/**
+		 * Binds skipped, as the block was already bound
+		 */
+		unsigned int redundantBinds = 0;
+	};
+	struct Utilisation
+	{
+		unsigned int blocks;
+		unsigned int pages;
+		unsigned int bindPoints;
+		size_t bytesUsed, bytesCapacity;
+	};
+	/**
+	 * Returns the shared allocator, creating it if necessary
+	 * The allocator (and it's binding points) are released when the final block is destroyed
+	 */
+	static std::shared_ptr<UniformBlockAllocator> get();
+	/**
+	 * Prints the utilisation of the live allocator, and the bind counts of the previous frame, as CSV
+	 */
+	static void report(FILE *out = stdout);
+	/**
+	 * Stores the bind counts of the frame which has ended, and resets the counters
+	 * @note This is called by Visualisation at the end of each frame
+	 */
+	static void endFrame();
+	/**
+	 * @return The bind counts of the previous frame
+	 */
+	static Stats getFrameStats() { return lastFrame; }
+	~UniformBlockAllocator();
+	UniformBlockAllocator(const UniformBlockAllocator&) = delete;
+	UniformBlockAllocator &operator=(const UniformBlockAllocator&) = delete;
+	/**
+	 * Sub allocates a block, creating a page if none have sufficient space
+	 * @return nullptr if bytes exceeds GL_MAX_UNIFORM_BLOCK_SIZE
+	 */
+	std::shared_ptr<UniformBlock> allocate(size_t bytes);
+	/**
+	 * Returns the binding point shared by blocks attached to the named uniform block, reserving one if necessary
+	 */
+	GLuint getBindPoint(const std::string &blockName);
+	Utilisation getUtilisation() const;
+private:
+	UniformBlockAllocator();
+	struct Page
+	{
+		GLuint name;
+		/**
+		 * Allocates in units of alignment
+		 */
+		TLSF allocator;
+	};
+	/**
+	 * The range last bound to a binding point
+	 */
+	struct Binding
+	{
+		GLuint name;
+		size_t offset, size;
+	};
+	static std::weak_ptr<UniformBlockAllocator> instance;
+	static Stats currentFrame, lastFrame;
+	const size_t alignment;
+	std::vector<Page> pages;
+	std::map<std::string, GLuint> bindPoints;
+	std::map<GLuint, Binding> bound;
+	unsigned int blockCount;
+};
+
+#endif //__UniformBlockAllocator_h__
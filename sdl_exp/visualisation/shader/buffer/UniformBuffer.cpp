@@ -4,12 +4,16 @@
 #include <cassert>
 
 std::set<GLint> UniformBuffer::allocatedBindPoints;
-UniformBuffer::UniformBuffer(size_t size, void* data)
-	: BufferCore(GL_UNIFORM_BUFFER, allocateBindPoint(), size, data)
+UniformBuffer::UniformBuffer(size_t size, void* data, Usage usage)
+	: BufferCore(GL_UNIFORM_BUFFER, allocateBindPoint(), size, data, usage)
 { }
 UniformBuffer::~UniformBuffer()
 {
-	allocatedBindPoints.erase(bufferBindPoint);
+	releaseBindPoint(bufferBindPoint);
+}
+void UniformBuffer::releaseBindPoint(GLint bindPoint)
+{
+	allocatedBindPoints.erase(bindPoint);
 }
 
 GLint UniformBuffer::allocateBindPoint()
@@ -40,12 +44,3 @@ GLint UniformBuffer::MaxBuffers()
 {
 	return BufferCore::maxBuffers(GL_UNIFORM_BUFFER);
 }
-
-//Comment out this include if not making use of Shaders/ShaderCore
-#include "../Shaders.h"
-#ifdef __Shaders_h__
-bool Shaders::setMaterialBuffer(const std::shared_ptr<UniformBuffer> &buffer)
-{
-	return addBuffer(MATERIAL_UNIFORM_BLOCK_NAME, buffer);
-};
-#endif //__Shaders_h__
\ No newline at end of file
@@ -13,12 +13,26 @@
 class UniformBuffer : public BufferCore
 {
 public:
-	UniformBuffer(size_t bytes, void* data = nullptr);
+	/**
+	 * @param bytes Size of the buffer
+	 * @param data Initial contents, nullptr leaves them undefined
+	 * @param usage How the buffer's storage is allocated and written, see BufferCore::Usage
+	 */
+	UniformBuffer(size_t bytes, void* data = nullptr, Usage usage = MUTABLE);
 	~UniformBuffer();
 	static GLint MaxSize();
 	static GLint MaxBuffers();
+	/**
+	 * Reserves a unique uniform buffer binding point
+	 * This permits ranges of buffers not owned by a UniformBuffer (e.g. UniformBlockAllocator pages) to be bound
+	 * @note The binding point must be returned with releaseBindPoint() when nolonger required
+	 */
+	static GLint allocateBindPoint();
+	/**
+	 * Returns a binding point reserved with allocateBindPoint()
+	 */
+	static void releaseBindPoint(GLint bindPoint);
 private:
-	GLint allocateBindPoint();
 	static std::set<GLint> allocatedBindPoints;
 };
 
@@ -29,6 +29,7 @@ public:
 	using PointLight::Diffuse;
 	using PointLight::Specular;
 	using PointLight::ConstantAttenuation;
+	using PointLight::CastShadows;
 private:
 	//Directional light needs no position, or fancy attenuation (as it has no position)
 	using PointLight::Position;
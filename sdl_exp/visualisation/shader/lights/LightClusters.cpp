@@ -0,0 +1,176 @@
+#include "LightClusters.h"
+#include <cmath>
+#include <cfloat>
+#include "../../util/GLcheck.h"
+#include "../Shaders.h"
+
+namespace
+{
+	const char *CLUSTER_SHADER_PATH = "cluster_lights.comp";
+	/**
+	 * Must match local_size_x in cluster_lights.comp
+	 */
+	const unsigned int CLUSTER_WORKGROUP_SIZE = 128;
+	const unsigned int INITIAL_LIGHTS_CAPACITY = 64;
+	bool intersects(const glm::vec3 &position, float range, const glm::vec3 &min, const glm::vec3 &max)
+	{
+		if (range < 0)
+			return true;
+		const glm::vec3 d = glm::clamp(position, min, max) - position;
+		return glm::dot(d, d) <= range*range;
+	}
+	float maxComponent(const glm::vec3 &v)
+	{
+		return glm::max(v.x, glm::max(v.y, v.z));
+	}
+}
+
+const glm::uvec3 LightClusters::DEFAULT_DIMS = glm::uvec3(16, 9, 24);
+const float LightClusters::RANGE_THRESHOLD = 1.0f / 256.0f;
+std::map<GLuint, const LightClusters*> LightClusters::instances;
+
+LightClusters::LightClusters(GLuint lightsBindPoint, const glm::uvec3 &dims)
+	: lightsBindPoint(lightsBindPoint)
+	, header()
+	, lightsCapacity(INITIAL_LIGHTS_CAPACITY)
+	, lights(std::make_unique<ShaderStorageBuffer>(INITIAL_LIGHTS_CAPACITY * sizeof(LightProperties)))
+	, clusters(std::make_unique<ShaderStorageBuffer>(sizeof(Header) + dims.x * dims.y * dims.z * sizeof(glm::uvec2)))
+	, indices(std::make_unique<ShaderStorageBuffer>((1 + dims.x * dims.y * dims.z * MAX_LIGHTS_PER_CLUSTER) * sizeof(GLuint)))
+	, binShader(nullptr)
+{
+	header.dims = dims;
+	header.lightsCount = 0;
+	instances[lightsBindPoint] = this;
+}
+LightClusters::~LightClusters()
+{
+	auto it = instances.find(lightsBindPoint);
+	if (it != instances.end() && it->second == this)
+		instances.erase(it);
+}
+const LightClusters *LightClusters::find(GLuint lightsBindPoint)
+{
+	auto it = instances.find(lightsBindPoint);
+	return it == instances.end() ? nullptr : it->second;
+}
+bool LightClusters::reserve(unsigned int count)
+{
+	if (count <= lightsCapacity)
+		return false;
+	//Grow the lights buffer geometrically, so that adding lights rarely reallocates
+	while (lightsCapacity < count)
+		lightsCapacity *= 2;
+	lights->setData(nullptr, lightsCapacity * sizeof(LightProperties));
+	return true;
+}
+void LightClusters::update(const glm::mat4 &projection, unsigned int count, bool lightsChanged)
+{
+	const bool headerChanged = projection != header.projection || count != header.lightsCount;
+	if (!headerChanged && !lightsChanged)
+		return;//Previous binning remains valid
+	if (headerChanged)
+	{
+		header = makeHeader(projection, header.dims, count);
+		clusters->setData(&header, sizeof(Header), 0);
+	}
+	GLuint zero = 0;
+	indices->setData(&zero, sizeof(GLuint), 0);
+	if (!binShader)
+	{
+		binShader = std::make_unique<ComputeShader>(CLUSTER_SHADER_PATH);
+		binShader->addBuffer(Shaders::LIGHT_STORAGE_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, getLightsBindPoint());
+		binShader->addBuffer(Shaders::LIGHT_CLUSTERS_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, getClustersBindPoint());
+		binShader->addBuffer(Shaders::LIGHT_INDICES_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, getIndicesBindPoint());
+	}
+	const unsigned int clusterCount = header.dims.x * header.dims.y * header.dims.z;
+	binShader->launch((clusterCount + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE);
+	//Cluster lists must be written before fragment shaders read them
+	GL_CALL(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+}
+void LightClusters::getResult(std::vector<glm::uvec2> &clusters, std::vector<unsigned int> &indices)
+{
+	clusters.resize(header.dims.x * header.dims.y * header.dims.z);
+	this->clusters->getData(clusters.data(), clusters.size() * sizeof(glm::uvec2), sizeof(Header));
+	GLuint indexCount = 0;
+	this->indices->getData(&indexCount, sizeof(GLuint), 0);
+	indices.resize(indexCount);
+	if (indexCount)
+		this->indices->getData(indices.data(), indexCount * sizeof(GLuint), sizeof(GLuint));
+}
+LightClusters::Header LightClusters::makeHeader(const glm::mat4 &projection, const glm::uvec3 &dims, unsigned int lightsCount)
+{
+	Header rtn;
+	rtn.projection = projection;
+	rtn.inverseProjection = glm::inverse(projection);
+	rtn.dims = dims;
+	rtn.lightsCount = lightsCount;
+	//Recover the clip planes from the perspective projection
+	float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+	float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+	if (!std::isfinite(zFar) || zFar <= zNear)
+		zFar = zNear * 10000.0f;//Infinite far plane
+	const float logRatio = std::log(zFar / zNear);
+	rtn.depth = glm::vec4(zNear, zFar, dims.z / logRatio, -(dims.z * std::log(zNear)) / logRatio);
+	return rtn;
+}
+void LightClusters::getClusterBounds(const Header &header, unsigned int cluster, glm::vec3 &min, glm::vec3 &max)
+{
+	const glm::uvec3 id(cluster % header.dims.x, (cluster / header.dims.x) % header.dims.y, cluster / (header.dims.x * header.dims.y));
+	//Slice depths are exponentially distributed between the near and far planes
+	const float ratio = header.depth.y / header.depth.x;
+	const float zNear = -header.depth.x * std::pow(ratio, id.z / (float)header.dims.z);
+	const float zFar = -header.depth.x * std::pow(ratio, (id.z + 1) / (float)header.dims.z);
+	const glm::vec2 ndcMin = glm::vec2(id.x, id.y) / glm::vec2(header.dims.x, header.dims.y) * 2.0f - 1.0f;
+	const glm::vec2 ndcMax = glm::vec2(id.x + 1, id.y + 1) / glm::vec2(header.dims.x, header.dims.y) * 2.0f - 1.0f;
+	min = glm::vec3(FLT_MAX);
+	max = glm::vec3(-FLT_MAX);
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		//Ray from the eye through the tile's corner on the near plane
+		const glm::vec4 corner = header.inverseProjection * glm::vec4(i & 1 ? ndcMax.x : ndcMin.x, i & 2 ? ndcMax.y : ndcMin.y, -1.0f, 1.0f);
+		const glm::vec3 ray = glm::vec3(corner) / corner.w;
+		const glm::vec3 pNear = ray * (zNear / ray.z);
+		const glm::vec3 pFar = ray * (zFar / ray.z);
+		min = glm::min(min, glm::min(pNear, pFar));
+		max = glm::max(max, glm::max(pNear, pFar));
+	}
+}
+float LightClusters::calculateRange(const LightProperties &light)
+{
+	if (light.spotCosCutoff > 1.0f)
+		return -1.0f;//Directional
+	const float brightest = glm::max(maxComponent(light.ambient), glm::max(maxComponent(light.diffuse), maxComponent(light.specular)));
+	//Solve k_{c} + k_{l}d + k_{q}d^{2} = brightest/threshold
+	const float limit = brightest / RANGE_THRESHOLD;
+	if (light.constantAttenuation >= limit)
+		return 0.0f;
+	if (light.quadraticAttenuation > 0)
+	{
+		const float discriminant = light.linearAttenuation * light.linearAttenuation - 4.0f * light.quadraticAttenuation * (light.constantAttenuation - limit);
+		return (-light.linearAttenuation + std::sqrt(discriminant)) / (2.0f * light.quadraticAttenuation);
+	}
+	if (light.linearAttenuation > 0)
+		return (limit - light.constantAttenuation) / light.linearAttenuation;
+	return -1.0f;//No falloff
+}
+void LightClusters::bin(const Header &header, const LightProperties *eyeLights, std::vector<glm::uvec2> &clusters, std::vector<unsigned int> &indices)
+{
+	clusters.resize(header.dims.x * header.dims.y * header.dims.z);
+	indices.clear();
+	glm::vec3 min, max;
+	for (unsigned int c = 0; c < clusters.size(); ++c)
+	{
+		getClusterBounds(header, c, min, max);
+		const unsigned int offset = (unsigned int)indices.size();
+		unsigned int count = 0;
+		for (unsigned int l = 0; l < header.lightsCount && count < MAX_LIGHTS_PER_CLUSTER; ++l)
+		{
+			if (intersects(eyeLights[l].position, eyeLights[l].range, min, max))
+			{
+				indices.push_back(l);
+				++count;
+			}
+		}
+		clusters[c] = glm::uvec2(offset, count);
+	}
+}
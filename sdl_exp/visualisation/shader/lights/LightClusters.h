@@ -0,0 +1,137 @@
+#ifndef __LightClusters_h__
+#define __LightClusters_h__
+#include <memory>
+#include <vector>
+#include <map>
+#include <glm/glm.hpp>
+#include "../buffer/ShaderStorageBuffer.h"
+#include "../ComputeShader.h"
+#include "../ShaderHeader.h"
+
+/**
+ * Bins lights into a 3D grid of view frustum clusters (froxels) for clustered forward lighting
+ * The grid is uniform in screen space and exponential in depth, each cluster receives a compact list of the lights that reach it
+ * Binning is performed each frame by cluster_lights.comp, bin() provides an equivalent CPU reference implementation
+ * Shaders built with the CLUSTERED define read the lights via these buffers, rather than the _lights uniform block
+ * @note Instances are owned by LightsBuffer, they are located by Shaders::setLightsBuffer() via find()
+ */
+class LightClusters
+{
+public:
+	/**
+	 * Matches the head of the _lightClusters storage block (std430)
+	 */
+	struct Header
+	{
+		glm::mat4 projection;
+		glm::mat4 inverseProjection;
+		glm::uvec3 dims;
+		unsigned int lightsCount;
+		/**
+		 * x: near plane, y: far plane
+		 * z,w: scale and bias, such that slice = log(-eyeZ)*z + w
+		 */
+		glm::vec4 depth;
+	};
+	/**
+	 * 16x9 tiles, 24 depth slices
+	 */
+	static const glm::uvec3 DEFAULT_DIMS;
+	/**
+	 * Lights beyond this many within a single cluster are dropped
+	 * @note Must match CLUSTER_MAX_LIGHTS in cluster_lights.comp
+	 */
+	static const unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+	/**
+	 * Lights whose contribution falls below this are treated as out of range
+	 */
+	static const float RANGE_THRESHOLD;
+	/**
+	 * Allocates the storage buffers, the compute shader is not built until the first call to update()
+	 * @param lightsBindPoint Binding point of the owning LightsBuffer, used to locate this instance via find()
+	 * @param dims The number of clusters along each axis
+	 */
+	explicit LightClusters(GLuint lightsBindPoint, const glm::uvec3 &dims = DEFAULT_DIMS);
+	~LightClusters();
+	/**
+	 * Grows the lights storage buffer, so that it can hold at least count lights
+	 * @param count The number of lights
+	 * @return True if the buffer was reallocated, discarding its contents
+	 */
+	bool reserve(unsigned int count);
+	/**
+	 * Bins the lights within the lights storage buffer into clusters on the GPU
+	 * The lights must already have been written in eye space, with range set (LightsBuffer::update() does so via transform_lights.comp)
+	 * Binning is skipped if neither the lights nor the projection have changed since the previous call
+	 * @param projection The projection matrix the clusters are to be fitted to
+	 * @param count The number of lights in the lights storage buffer
+	 * @param lightsChanged Whether the lights have been rewritten since the previous call
+	 */
+	void update(const glm::mat4 &projection, unsigned int count, bool lightsChanged);
+	/**
+	 * Reads back the most recent GPU binning result, for comparison against bin()
+	 * @param clusters Returns the (offset, count) of each cluster's lights within indices
+	 * @param indices Returns the light indices of all clusters
+	 * @note This stalls the pipeline, it is intended for testing
+	 */
+	void getResult(std::vector<glm::uvec2> &clusters, std::vector<unsigned int> &indices);
+	/**
+	 * Returns the cluster storage's grid dimensions
+	 */
+	const glm::uvec3 &getDims() const { return header.dims; }
+	GLuint getLightsBindPoint() const { return lights->getBufferBindPoint(); }
+	GLuint getClustersBindPoint() const { return clusters->getBufferBindPoint(); }
+	GLuint getIndicesBindPoint() const { return indices->getBufferBindPoint(); }
+	/**
+	 * @param lightsBindPoint Binding point of a LightsBuffer
+	 * @return The clusters owned by the LightsBuffer bound at lightsBindPoint, nullptr if there are none
+	 */
+	static const LightClusters *find(GLuint lightsBindPoint);
+	/**
+	 * Builds the header describing a cluster grid fitted to a perspective projection
+	 * @param projection The perspective projection matrix
+	 * @param dims The number of clusters along each axis
+	 * @param lightsCount The total number of lights
+	 */
+	static Header makeHeader(const glm::mat4 &projection, const glm::uvec3 &dims, unsigned int lightsCount);
+	/**
+	 * Calculates the eye space bounding box of a cluster
+	 * @param header Description of the cluster grid
+	 * @param cluster Linear index of the cluster, x varies fastest
+	 * @param min Returns the minimum corner
+	 * @param max Returns the maximum corner
+	 */
+	static void getClusterBounds(const Header &header, unsigned int cluster, glm::vec3 &min, glm::vec3 &max);
+	/**
+	 * Calculates the distance beyond which a light's contribution falls below RANGE_THRESHOLD
+	 * @return The light's range, negative if it is unbounded (directional lights, or lights without attenuation)
+	 */
+	static float calculateRange(const LightProperties &light);
+	/**
+	 * CPU reference implementation of cluster_lights.comp
+	 * Light order within each cluster matches the GPU, however the order of the clusters within indices may differ
+	 * @param header Description of the cluster grid
+	 * @param eyeLights Lights in eye space, with range set
+	 * @param clusters Returns the (offset, count) of each cluster's lights within indices
+	 * @param indices Returns the light indices of all clusters
+	 */
+	static void bin(const Header &header, const LightProperties *eyeLights, std::vector<glm::uvec2> &clusters, std::vector<unsigned int> &indices);
+private:
+	const GLuint lightsBindPoint;
+	Header header;
+	/**
+	 * The number of lights the lights buffer currently has space for
+	 */
+	unsigned int lightsCapacity;
+	std::unique_ptr<ShaderStorageBuffer> lights;
+	std::unique_ptr<ShaderStorageBuffer> clusters;
+	std::unique_ptr<ShaderStorageBuffer> indices;
+	std::unique_ptr<ComputeShader> binShader;
+	/**
+	 * Key: Binding point of the owning LightsBuffer
+	 * Val: The LightsBuffer's clusters
+	 */
+	static std::map<GLuint, const LightClusters*> instances;
+};
+
+#endif //__LightClusters_h__
@@ -2,92 +2,234 @@
 #include "PointLight.h"
 #include "SpotLight.h"
 #include "DirectionalLight.h"
+#include <cstddef>
+#include "../../util/Profiler.h"
+#include "../../util/GLcheck.h"
+#include "../Shaders.h"
+
+namespace
+{
+	const char *TRANSFORM_SHADER_PATH = "transform_lights.comp";
+	/**
+	 * Must match WORKGROUP_SIZE in transform_lights.comp
+	 */
+	const unsigned int TRANSFORM_WORKGROUP_SIZE = 64;
+	const unsigned int INITIAL_LIGHTS_CAPACITY = 64;
+}
 
 LightsBuffer::LightsBuffer(const glm::mat4 *viewMatPtr)
-	: UniformBuffer(MAX_LIGHTS*sizeof(LightProperties))
-	, tProperties()
+	: UniformBuffer(sizeof(LightUniformBlock))
+	, worldStorage(std::make_unique<ShaderStorageBuffer>(INITIAL_LIGHTS_CAPACITY * sizeof(LightProperties)))
+	, worldCapacity(INITIAL_LIGHTS_CAPACITY)
+	, uniformStorageBindPoint(ShaderStorageBuffer::allocateBindPoint())
+	, transformShader(nullptr)
+	, transformClustered(false)
+	, transformCount(0)
+	, eyeViewMat(1.0f)
+	, invalidated(true)
+	, uniformCount(0)
+	, clustered(false)
+	, clusters(getBufferBindPoint())
 	, viewMatPtr(viewMatPtr)
 	, projMatPtr(nullptr)
 {
-	uniformBlock.lightsCount = 0;
+	GLuint zero[4] = { 0 };
+	setData(zero, sizeof(zero), 0);
+	//transform_lights.comp writes the lights array of the uniform block directly
+	GL_CALL(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, uniformStorageBindPoint, getName()));
+}
+LightsBuffer::~LightsBuffer()
+{
+	ShaderStorageBuffer::releaseBindPoint(uniformStorageBindPoint);
+}
+void LightsBuffer::setClustered(bool state)
+{
+	//The clusters' storage buffer must receive every light
+	if (state && !clustered)
+		invalidated = true;
+	clustered = state;
 }
 PointLight LightsBuffer::addPointLight()
 {
-	if (uniformBlock.lightsCount<MAX_LIGHTS)
+	if (canAdd())
 	{
-		unsigned int index = uniformBlock.lightsCount++;
-		return PointLight(&uniformBlock.lights[index], &tProperties[index], index);
+		unsigned int index = getCount();
+		properties.emplace_back();
+		tProperties.emplace_back();
+		return PointLight(&properties[index], &tProperties[index], index);
 	}
 	throw std::runtime_error("LightsBuffer::addPointLight(): Max lights exceeded in light buffer.\n");
 }
 SpotLight LightsBuffer::addSpotLight()
 {
-	if (uniformBlock.lightsCount<MAX_LIGHTS)
+	if (canAdd())
 	{
-		unsigned int index = uniformBlock.lightsCount++;
-		return SpotLight(&uniformBlock.lights[index], &tProperties[index], index);
+		unsigned int index = getCount();
+		properties.emplace_back();
+		tProperties.emplace_back();
+		return SpotLight(&properties[index], &tProperties[index], index);
 	}
 	throw std::runtime_error("LightsBuffer::addSpotLight(): Max lights exceeded in light buffer.\n");
 }
 DirectionalLight LightsBuffer::addDirectionalLight()
 {
-	if (uniformBlock.lightsCount<MAX_LIGHTS)
+	if (canAdd())
 	{
-		unsigned int index = uniformBlock.lightsCount++;
-		return DirectionalLight(&uniformBlock.lights[index], &tProperties[index], index);
+		unsigned int index = getCount();
+		properties.emplace_back();
+		tProperties.emplace_back();
+		return DirectionalLight(&properties[index], &tProperties[index], index);
 	}
 	throw std::runtime_error("LightsBuffer::addSpotLight(): Max lights exceeded in light buffer.\n");
 }
 PointLight LightsBuffer::getPointLight(unsigned int index)
 {
-	if (index<uniformBlock.lightsCount)
+	if (index<getCount())
 	{
-		return PointLight(&uniformBlock.lights[index], &tProperties[index], index, false);
+		return PointLight(&properties[index], &tProperties[index], index, false);
 	}
 	throw std::runtime_error("LightsBuffer::getSpotLight(): Light index is invalid.\n");
 }
 SpotLight LightsBuffer::getSpotLight(unsigned int index)
 {
-	if (index<uniformBlock.lightsCount)
+	if (index<getCount())
 	{
-		return SpotLight(&uniformBlock.lights[index], &tProperties[index], index, false);
+		return SpotLight(&properties[index], &tProperties[index], index, false);
 	}
 	throw std::runtime_error("LightsBuffer::getSpotLight(): Light index is invalid.\n");
 }
 DirectionalLight LightsBuffer::getDirectionalLight(unsigned int index)
 {
-	if (index<uniformBlock.lightsCount)
+	if (index<getCount())
 	{
-		return DirectionalLight(&uniformBlock.lights[index], &tProperties[index], index, false);
+		return DirectionalLight(&properties[index], &tProperties[index], index, false);
 	}
 	throw std::runtime_error("LightsBuffer::getDirectionalLight(): Light index is invalid.\n");
 }
+const LightsBuffer::TLightProperties &LightsBuffer::getWorldProperties(unsigned int index) const
+{
+	if (index<getCount())
+	{
+		return tProperties[index];
+	}
+	throw std::runtime_error("LightsBuffer::getWorldProperties(): Light index is invalid.\n");
+}
+LightProperties LightsBuffer::getEyeProperties(unsigned int index) const
+{
+	if (index<getCount())
+	{
+		LightProperties rtn = properties[index];
+		rtn.position = glm::vec3(eyeViewMat * tProperties[index].position);
+		rtn.spotDirection = glm::vec3(eyeViewMat * tProperties[index].spotDirection);
+		rtn.range = LightClusters::calculateRange(rtn);
+		return rtn;
+	}
+	throw std::runtime_error("LightsBuffer::getEyeProperties(): Light index is invalid.\n");
+}
+void LightsBuffer::setShadow(unsigned int index, int first, unsigned int count)
+{
+	if (index>=getCount())
+		throw std::runtime_error("LightsBuffer::setShadow(): Light index is invalid.\n");
+	if (count == 0)
+		first = -1;
+	if (properties[index].shadowIndex == first && properties[index].shadowCount == count)
+		return;
+	properties[index].shadowIndex = first;
+	properties[index].shadowCount = count;
+	tProperties[index].dirty = true;
+}
 void LightsBuffer::update()
 {
+	Profiler::Scope scope("LightsBuffer::update", true);
 	static bool once = true;
-	if (viewMatPtr)
+	if (!viewMatPtr && once)
+	{
+		fprintf(stderr, "Warning: viewMatPtr has not been passed to LightsBuffer, lights will not be transformed to eye space.\n");
+		once = false;
+	}
+	const glm::mat4 viewMat = viewMatPtr ? *viewMatPtr : glm::mat4(1.0f);
+	const unsigned int count = getCount();
+	//Grow the world space storage geometrically, so that adding lights rarely reallocates
+	if (count > worldCapacity)
+	{
+		while (worldCapacity < count)
+			worldCapacity *= 2;
+		worldStorage->setData(nullptr, worldCapacity * sizeof(LightProperties));
+		//Reallocation discards the existing lights
+		invalidated = true;
+	}
+	worldLights.resize(count);
+	//Upload each contiguous run of modified lights, so that far apart lights don't upload those between them
+	bool lightsChanged = false;
+	unsigned int runBegin = count;
+	for (unsigned int i = 0; i <= count; ++i)
 	{
-		//Transform light values into eye space
-		for (unsigned int i = 0; i < uniformBlock.lightsCount; ++i)
+		if (i < count && (invalidated || tProperties[i].dirty))
 		{
-			uniformBlock.lights[i].position = (*viewMatPtr) * tProperties[i].position;
-			uniformBlock.lights[i].spotDirection = (*viewMatPtr) * tProperties[i].spotDirection;
+			LightProperties &l = worldLights[i];
+			l = properties[i];
+			l.position = glm::vec3(tProperties[i].position);
+			l.spotDirection = glm::vec3(tProperties[i].spotDirection);
+			l.PADDING2 = tProperties[i].position.w;
+			//Attenuation is unaffected by the view, so range is calculated once per change
+			l.range = LightClusters::calculateRange(l);
+			tProperties[i].dirty = false;
+			if (runBegin == count)
+				runBegin = i;
 		}
+		else if (runBegin < i)
+		{
+			worldStorage->setData(&worldLights[runBegin], (i - runBegin) * sizeof(LightProperties), runBegin * sizeof(LightProperties));
+			lightsChanged = true;
+			runBegin = count;
+		}
+	}
+	invalidated = false;
+	//The uniform buffer holds the first MAX_LIGHTS lights
+	if (uniformCount != glm::min(count, MAX_LIGHTS))
+	{
+		uniformCount = glm::min(count, MAX_LIGHTS);
+		setData(&uniformCount, sizeof(unsigned int), offsetof(LightUniformBlock, lightsCount));
 	}
-	else
+	//In clustered mode, the clusters' storage buffer receives every light
+	const bool storageReallocated = clustered && clusters.reserve(count);
+	const bool transform = count && (lightsChanged || storageReallocated || viewMat != eyeViewMat);
+	eyeViewMat = viewMat;
+	if (transform)
 	{
-		if (once)
+		if (!transformShader || transformClustered != clustered)
 		{
-			fprintf(stderr, "Warning: viewMatPtr has not been passed to LightsBuffer, lights will not be transformed to eye space.\n");
-			once = false;
+			ComputeShader::Defines defines;
+			if (clustered)
+				defines["CLUSTERED"] = "";
+			transformShader = std::make_unique<ComputeShader>(TRANSFORM_SHADER_PATH, defines);
+			transformShader->addDynamicUniform("_viewMat", &eyeViewMat);
+			transformShader->addDynamicUniform("_lightsCount", &transformCount);
+			transformShader->addBuffer("_worldLights", GL_SHADER_STORAGE_BUFFER, worldStorage->getBufferBindPoint());
+			transformShader->addBuffer("_uniformLights", GL_SHADER_STORAGE_BUFFER, uniformStorageBindPoint);
+			if (clustered)
+				transformShader->addBuffer(Shaders::LIGHT_STORAGE_BLOCK_NAME, GL_SHADER_STORAGE_BUFFER, clusters.getLightsBindPoint());
+			transformClustered = clustered;
 		}
-		for (unsigned int i = 0; i < uniformBlock.lightsCount; ++i)
+		transformCount = count;
+		transformShader->launch((count + TRANSFORM_WORKGROUP_SIZE - 1) / TRANSFORM_WORKGROUP_SIZE);
+		//Eye space lights must be written before binning and shaders read them
+		GL_CALL(glMemoryBarrier(GL_UNIFORM_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT));
+	}
+	if (clustered)
+	{
+		static bool onceClustered = true;
+		if (!projMatPtr)
 		{
-			uniformBlock.lights[i].position = tProperties[i].position;
-			uniformBlock.lights[i].spotDirection = tProperties[i].spotDirection;
+			if (onceClustered)
+			{
+				fprintf(stderr, "Warning: projMatPtr has not been passed to LightsBuffer, lights cannot be clustered.\n");
+				onceClustered = false;
+			}
+			return;
 		}
+		clusters.update(*projMatPtr, count, transform);
 	}
-	setData(&uniformBlock, sizeof(glm::vec4) + (uniformBlock.lightsCount * sizeof(LightProperties)));//sizeof(LightUniformBlock)
 }
 //Rendering stuff
 void LightsBuffer::initModels()
@@ -112,15 +254,15 @@ void LightsBuffer::render()
 {
 	if (!modelPointLight)
 		initModels();
-	for (unsigned int i = 0; i < uniformBlock.lightsCount; ++i)
+	for (unsigned int i = 0; i < getCount(); ++i)
 	{
-		if (uniformBlock.lights[i].spotCosCutoff<0)
+		if (properties[i].spotCosCutoff<0)
 		{//Pointlight
-			modelPointLight->render(tProperties[i].position, uniformBlock.lights[i].diffuse);
+			modelPointLight->render(tProperties[i].position, properties[i].diffuse);
 		}
-		else if (uniformBlock.lights[i].spotCosCutoff<=1)
+		else if (properties[i].spotCosCutoff<=1)
 		{//Spotlight
-			modelSpotLight->render(tProperties[i].position, tProperties[i].spotDirection, tProperties[i].spotCutoff, uniformBlock.lights[i].diffuse);
+			modelSpotLight->render(tProperties[i].position, tProperties[i].spotDirection, tProperties[i].spotCutoff, properties[i].diffuse);
 		}
 		else
 		{//Directional light
@@ -1,7 +1,12 @@
 #ifndef __LightsBuffer_h__
 #define __LightsBuffer_h__
+#include <deque>
+#include <vector>
 #include "../buffer/UniformBuffer.h"
+#include "../buffer/ShaderStorageBuffer.h"
+#include "../ComputeShader.h"
 #include "../ShaderHeader.h"
+#include "LightClusters.h"
 #include "PointLightModel.h"
 #include "SpotLightModel.h"
 
@@ -14,6 +19,9 @@ class DirectionalLight;
  * You can add and get existing lights via the contained methods
  * It is recommended that you store the returned lights in your own data structure
  * They can be created and cast via the copy constructor, but will always refer to their index in the parent LightsBuffer
+ * By default the uniform buffer limits the number of lights to MAX_LIGHTS
+ * In clustered mode there is no limit, lights are binned into view frustum clusters each frame for shaders built with the CLUSTERED define
+ * Shaders without CLUSTERED continue to receive the first MAX_LIGHTS lights
  */
 class LightsBuffer : private UniformBuffer
 {
@@ -27,6 +35,8 @@ public:
 			: spotCutoff(180.0f)
 			, position(0, 0, 1, 1)
 			, spotDirection(0, 0, -1, 0)
+			, dirty(true)
+			, castShadows(false)
 		{
 			
 		}
@@ -34,21 +44,26 @@ public:
 		float spotCutoff;
 		glm::vec4 position;
 		glm::vec4 spotDirection;
+		//Set by the light's setters, the light is re-uploaded by the next update()
+		bool dirty;
+		//Whether a ShadowPass should allocate shadow maps to the light
+		bool castShadows;
 	};
 	LightsBuffer(const glm::mat4 *viewMatPtr = nullptr);
+	~LightsBuffer();
 	/**
 	 * Increments the number of lights and returns the newest light as a point light
-	 * @throws runtime_error If the number of lights would exceed MAX_LIGHTS
+	 * @throws runtime_error If the number of lights would exceed MAX_LIGHTS, whilst not in clustered mode
 	 */
 	PointLight addPointLight();
 	/**
 	 * Increments the number of lights and returns the newest light as a spot light
-	 * @throws runtime_error If the number of lights would exceed MAX_LIGHTS
+	 * @throws runtime_error If the number of lights would exceed MAX_LIGHTS, whilst not in clustered mode
 	 */
 	SpotLight addSpotLight();
 	/**
 	 * Increments the number of lights and returns the newest light as a directional light
-	 * @throws runtime_error If the number of lights would exceed MAX_LIGHTS
+	 * @throws runtime_error If the number of lights would exceed MAX_LIGHTS, whilst not in clustered mode
 	 */
 	DirectionalLight addDirectionalLight();
 	/**
@@ -70,18 +85,50 @@ public:
 	DirectionalLight getDirectionalLight(unsigned int index);
 	/**
 	 * Asks the buffer to update the GPU copy if necessary
-	 * Computes eye transform of position/spotDirection
-	 * Could go further and negate spotDirection, 
+	 * Only lights modified since the previous call are uploaded (in world space), each contiguous run of modified lights is uploaded separately
+	 * The eye transform of position/spotDirection is then computed on the GPU by transform_lights.comp, if the lights or the view matrix have changed
+	 * In clustered mode, this also bins the lights into clusters (requires the projection matrix pointer)
 	 */
 	void update();
+	/**
+	 * Returns the world space properties of the light at the given index
+	 * @throws runtime_error if index does not point to a current light
+	 */
+	const TLightProperties &getWorldProperties(unsigned int index) const;
+	/**
+	 * Returns the eye space properties of the light at the given index, as transformed by the most recent update()
+	 * These are calculated on demand, the GPU copy is not read back
+	 * @throws runtime_error if index does not point to a current light
+	 */
+	LightProperties getEyeProperties(unsigned int index) const;
+	/**
+	 * Sets the range of shadow maps, within a ShadowPass's _shadowMaps, which belong to the light at the given index
+	 * The light is only re-uploaded if the range has changed
+	 * @param index Index of the light
+	 * @param first Index of the light's first shadow map, negative if the light has no shadow maps
+	 * @param count The number of shadow maps
+	 * @throws runtime_error if index does not point to a current light
+	 */
+	void setShadow(unsigned int index, int first, unsigned int count);
 	/**
 	 * Returns the number of allocated lights
 	 */
-	unsigned int getCount() const { return uniformBlock.lightsCount; }
+	unsigned int getCount() const { return (unsigned int)properties.size(); }
 	/**
-	 * Returns the maximum number of lights that can be allocated
+	 * Returns the maximum number of lights that can be allocated, whilst not in clustered mode
 	 */
 	static unsigned int getMaxCount() { return MAX_LIGHTS; }
+	/**
+	 * Enables clustered lighting, lifting the MAX_LIGHTS limit
+	 * @param state If false, no further lights can be added once MAX_LIGHTS is reached
+	 * @note Only shaders built with the CLUSTERED define can see lights beyond the first MAX_LIGHTS
+	 */
+	void setClustered(bool state);
+	bool isClustered() const { return clustered; }
+	/**
+	 * Provides access to the light clusters, e.g. to compare the GPU result with LightClusters::bin()
+	 */
+	LightClusters &getClusters() { return clusters; }
 	using BufferCore::getName;
 	using BufferCore::getType;
 	using BufferCore::getBufferBindPoint;
@@ -100,8 +147,52 @@ public:
 	void setRenderScale(const float &scale);
 	void render();
 private:
-	LightUniformBlock uniformBlock;
-	TLightProperties tProperties[MAX_LIGHTS];
+	/**
+	 * Returns whether another light can be added
+	 */
+	bool canAdd() const { return clustered || properties.size() < MAX_LIGHTS; }
+	/**
+	 * Deques, as lights hold pointers to their elements
+	 */
+	std::deque<LightProperties> properties;
+	std::deque<TLightProperties> tProperties;
+	/**
+	 * World space copy of all lights, with range set and position.w stored in PADDING2
+	 * Modified lights are uploaded to worldStorage, from which transform_lights.comp writes the eye space lights
+	 */
+	std::vector<LightProperties> worldLights;
+	std::unique_ptr<ShaderStorageBuffer> worldStorage;
+	/**
+	 * The number of lights worldStorage currently has space for
+	 */
+	unsigned int worldCapacity;
+	/**
+	 * Shader storage binding point of this buffer, so that transform_lights.comp can write the uniform block
+	 */
+	GLint uniformStorageBindPoint;
+	/**
+	 * Built on first use, rebuilt if clustered mode is toggled
+	 */
+	std::unique_ptr<ComputeShader> transformShader;
+	bool transformClustered;
+	/**
+	 * The number of lights transformed by the most recent launch of transformShader
+	 */
+	GLuint transformCount;
+	/**
+	 * The view matrix the lights were most recently transformed by
+	 */
+	glm::mat4 eyeViewMat;
+	/**
+	 * If true the next update() uploads and transforms every light
+	 */
+	bool invalidated;
+	/**
+	 * The number of lights in the uniform buffer
+	 */
+	unsigned int uniformCount;
+	bool clustered;
+	LightClusters clusters;
 	const glm::mat4 *viewMatPtr;
 	const glm::mat4 *projMatPtr;
 	void initModels();
@@ -78,6 +78,13 @@ public:
 	 */
 	inline void QuadraticAttenuation(const float &factor);
 	float QuadraticAttenuation() const{ return properties->quadraticAttenuation; }
+	/**
+	 * Whether a ShadowPass should render shadow maps for the light
+	 * Point lights receive 6 cube faces, spot lights a single map and directional lights a set of cascades
+	 * @note Default value false
+	 */
+	inline void CastShadows(const bool &state);
+	bool CastShadows() const { return tProperties->castShadows; }
 };
 
 #include "PointLight.imp"
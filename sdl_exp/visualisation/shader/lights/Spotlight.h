@@ -50,6 +50,7 @@ public:
 	using PointLight::ConstantAttenuation;
 	using PointLight::LinearAttenuation;
 	using PointLight::QuadraticAttenuation;
+	using PointLight::CastShadows;
 };
 #include "SpotLight.imp"
 #endif //__SpotLight_h__
\ No newline at end of file
@@ -85,6 +85,10 @@ public:
 	 * @note Currently we are not set up to have more textures of any type than the number of unique units (~92)
 	 */
 	GLenum getTextureUnit() const { return textureUnit; }
+	/**
+	 * @return The format specifiers the texture was created with
+	 */
+	const Format &getFormat() const { return format; }
 	/**
 	 * @return The name assigned to the texture
 	 * @note For textures loaded from file, this will be the file path
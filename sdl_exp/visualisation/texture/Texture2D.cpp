@@ -223,6 +223,22 @@ void GaussianBlur::blurR32F(std::shared_ptr<Texture2D> inTex, std::shared_ptr<Te
 #ifdef _DEBUG
 	assert(inTex->getDimensions() == outTex->getDimensions());
 #endif
-	blurR32F(inTex->getName(), outTex->getName(), inTex->getDimensions());
+	blur(inTex->getName(), outTex->getName(), inTex->getDimensions(), GL_R32F);
+}
+void GaussianBlur::blur(std::shared_ptr<Texture2D> inTex, std::shared_ptr<Texture2D> outTex)
+{
+#ifdef _DEBUG
+	assert(inTex->getDimensions() == outTex->getDimensions());
+	assert(inTex->getFormat().internalFormat == outTex->getFormat().internalFormat);
+#endif
+	blur(inTex->getName(), outTex->getName(), inTex->getDimensions(), inTex->getFormat().internalFormat);
+}
+void GaussianBlur::dualFilter(std::shared_ptr<Texture2D> inTex, std::shared_ptr<Texture2D> outTex, unsigned int iterations, float offset)
+{
+#ifdef _DEBUG
+	assert(inTex->getDimensions() == outTex->getDimensions());
+	assert(inTex->getFormat().internalFormat == outTex->getFormat().internalFormat);
+#endif
+	dualFilter(inTex->getName(), outTex->getName(), inTex->getDimensions(), inTex->getFormat().internalFormat, iterations, offset);
 }
 #endif
\ No newline at end of file
@@ -8,10 +8,12 @@ const char *TextureBuffer<T>::RAW_TEXTURE_FLAG = "TextureBuffer";
  * Constructors
  */
 template<class T>
-TextureBuffer<T>::TextureBuffer(const unsigned int elementCount, const unsigned int componentCount, T *data)
+TextureBuffer<T>::TextureBuffer(const unsigned int elementCount, const unsigned int componentCount, T *data, BufferCore::Usage usage)
 	: Texture(GL_TEXTURE_BUFFER, genTextureUnit(), Format(_getFormat(componentCount), _getInternalFormat(componentCount), componentCount*sizeof(T), _getType()), RAW_TEXTURE_FLAG, 0)
     , elementCount(elementCount)
     , componentCount(componentCount)
+    , usage(usage)
+    , ring(nullptr)
 #ifdef __CUDACC__
     , cuTexBuf(0)
     , handleDeallocation(true)
@@ -20,18 +22,32 @@ TextureBuffer<T>::TextureBuffer(const unsigned int elementCount, const unsigned
     //Gen buffer
     GL_CALL(glGenBuffers(1, &TBO));
     //Size buffer and tie to tex
-    GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, TBO));
-    GL_CALL(glBufferData(GL_TEXTURE_BUFFER, format.pixelSize*elementCount, (void*)data, GL_STATIC_DRAW));
-    GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, glName));
-	GL_CALL(glTexBuffer(GL_TEXTURE_BUFFER, _getInternalFormat(componentCount), TBO));
-    GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
-    GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, 0));
+    if (usage == BufferCore::STREAM)
+    {
+        ring = std::make_unique<StreamRing>(GL_TEXTURE_BUFFER, TBO, format.pixelSize*elementCount, BufferCore::offsetAlignment(GL_TEXTURE_BUFFER), data);
+    }
+    else
+    {
+        GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, TBO));
+        if (usage == BufferCore::IMMUTABLE)
+        {
+            GL_CALL(glBufferStorage(GL_TEXTURE_BUFFER, format.pixelSize*elementCount, (void*)data, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT));
+        }
+        else
+        {
+            GL_CALL(glBufferData(GL_TEXTURE_BUFFER, format.pixelSize*elementCount, (void*)data, usage == BufferCore::ORPHAN ? GL_STREAM_DRAW : GL_STATIC_DRAW));
+        }
+        GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+    }
+    attachBuffer();
 }
 template<class T>
 TextureBuffer<T>::TextureBuffer(const TextureBuffer<T>& b)
 	: Texture(GL_TEXTURE_BUFFER, genTextureUnit(), b.format, b.reference, 0)
 	, elementCount(b.elementCount)
 	, componentCount(b.componentCount)
+	, usage(BufferCore::MUTABLE)
+	, ring(nullptr)
 #ifdef __CUDACC__
 	, cuTexBuf(0)
 	, handleDeallocation(true)
@@ -62,6 +78,8 @@ TextureBuffer<T>::TextureBuffer(CUDATextureBuffer<T> *cuTexBuf, bool handleDeall
     , elementCount(cuTexBuf->elementCount)
     , componentCount(cuTexBuf->componentCount)
     , TBO(cuTexBuf->glTBO)
+    , usage(BufferCore::MUTABLE)
+    , ring(nullptr)
 { }
 #endif
 /*
@@ -81,7 +99,8 @@ TextureBuffer<T>::~TextureBuffer(){
     else
 #endif
     {
-        //Deallocate the buffer object
+        //Deallocate the buffer object, this unmaps the ring
+        ring.reset();
         GL_CALL(glDeleteBuffers(1, &TBO));
         TBO = 0;
     }
@@ -90,9 +109,9 @@ TextureBuffer<T>::~TextureBuffer(){
  * Factories
  */
 template<class T>
-std::shared_ptr<TextureBuffer<T>> TextureBuffer<T>::make(const unsigned int elementCount, const unsigned int componentCount, T *data)
+std::shared_ptr<TextureBuffer<T>> TextureBuffer<T>::make(const unsigned int elementCount, const unsigned int componentCount, T *data, BufferCore::Usage usage)
 {
-	return std::shared_ptr<TextureBuffer<T>>(new TextureBuffer<T>(elementCount, componentCount, data));
+	return std::shared_ptr<TextureBuffer<T>>(new TextureBuffer<T>(elementCount, componentCount, data, usage));
 }
 
 #ifdef __CUDACC__
@@ -109,7 +128,18 @@ template<class T>
 void TextureBuffer<T>::setData(const T *data, size_t size, size_t offset){
     if (size == 0)
 		size = format.pixelSize*elementCount;
+    if (ring)
+    {
+        ring->write(data, size, offset);
+        attachBuffer();
+        return;
+    }
     GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, TBO));
+    //Orphan the old contents, so the write doesn't wait for draws reading them
+    if (usage == BufferCore::ORPHAN && offset == 0 && size == format.pixelSize*elementCount)
+    {
+        GL_CALL(glInvalidateBufferData(TBO));
+    }
     GL_CALL(glBufferSubData(GL_TEXTURE_BUFFER, offset, size, (void*)data));
     GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
     //GL_CALL(glNamedBufferSubData(TBO, offset, size, (void*)data));//GL4.5+
@@ -118,10 +148,29 @@ template<class T>
 void TextureBuffer<T>::getData(T *dataReturn, size_t size, size_t offset) const{
     if (size == 0)
 		size = format.pixelSize*elementCount;
+    if (ring)
+    {
+        ring->read(dataReturn, size, offset);
+        return;
+    }
     GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, TBO));
     GL_CALL(glGetBufferSubData(GL_TEXTURE_BUFFER, offset, size, (void*)dataReturn));
     GL_CALL(glBindBuffer(GL_TEXTURE_BUFFER, 0));
 }
+template<class T>
+void TextureBuffer<T>::attachBuffer()
+{
+    GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, glName));
+    if (ring)
+    {
+        GL_CALL(glTexBufferRange(GL_TEXTURE_BUFFER, _getInternalFormat(componentCount), TBO, ring->getOffset(), format.pixelSize*elementCount));
+    }
+    else
+    {
+        GL_CALL(glTexBuffer(GL_TEXTURE_BUFFER, _getInternalFormat(componentCount), TBO));
+    }
+    GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, 0));
+}
 /**
  * Static enum calculators
  */
@@ -1,6 +1,7 @@
 #ifndef __TexturBuffer_h__
 #define __TexturBuffer_h__
 #include "Texture.h"
+#include "../shader/buffer/BufferCore.h"
 #ifdef __CUDACC__
 #include "../util/cuda.cuh"
 #endif
@@ -17,8 +18,10 @@ public:
 	 * Creates the texture buffer
 	 * @param elementCount The number of elements to be stored in the buffer
 	 * @param componentCount The number of components per element (1-4)
+	 * @param data Initial contents, nullptr leaves them undefined
+	 * @param usage How the buffer's storage is allocated and written, see BufferCore::Usage
 	 */
-	static std::shared_ptr<TextureBuffer<T>> make(const unsigned int elementCount, const unsigned int componentCount = 1, T *data = nullptr);
+	static std::shared_ptr<TextureBuffer<T>> make(const unsigned int elementCount, const unsigned int componentCount = 1, T *data = nullptr, BufferCore::Usage usage = BufferCore::MUTABLE);
 #ifdef __CUDACC__
 	/**
 	 * Creates a handle to the texture buffer from a preallocated CUDATextureBuffer
@@ -60,9 +63,9 @@ public:
 private:
 	/**
 	 * Private constructor
-	 * @see make(const unsigned int, const unsigned int, T*)
+	 * @see make(const unsigned int, const unsigned int, T*, BufferCore::Usage)
 	 */
-	TextureBuffer(const unsigned int elementCount, const unsigned int componentCount = 1, T *data = nullptr);
+	TextureBuffer(const unsigned int elementCount, const unsigned int componentCount = 1, T *data = nullptr, BufferCore::Usage usage = BufferCore::MUTABLE);
 #ifdef __CUDACC__
 	/**
 	 * Private constructor
@@ -89,10 +92,19 @@ private:
 	 * @return The stprage type of each texel (element)
 	 */
 	static GLenum _getType();
+	/**
+	 * Attaches the buffer (the current region of STREAM buffers) to the texture
+	 */
+	void attachBuffer();
     //GL TexBuf
     const unsigned int elementCount;
     const unsigned int componentCount;
     GLuint TBO;
+    const BufferCore::Usage usage;
+    /**
+     * The persistently mapped regions of STREAM buffers
+     */
+    std::unique_ptr<StreamRing> ring;
 #ifdef __CUDACC__
     //Cuda TexBuf
     CUDATextureBuffer<T> *cuTexBuf;
@@ -0,0 +1,422 @@
+#include "BVH.h"
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+	/**
+	 * Bins per axis evaluated by the surface area heuristic
+	 */
+	const unsigned int SAH_BINS = 16;
+	struct Bounds
+	{
+		Bounds() : min(FLT_MAX), max(-FLT_MAX) { }
+		void include(const glm::vec3 &p) { min = glm::min(min, p); max = glm::max(max, p); }
+		void include(const Bounds &b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+		/**
+		 * Half the surface area, which is proportional to the probability of a random ray hitting it
+		 */
+		float area() const
+		{
+			if (min.x > max.x)
+				return 0.0f;
+			const glm::vec3 d = max - min;
+			return d.x * d.y + d.y * d.z + d.z * d.x;
+		}
+		glm::vec3 min, max;
+	};
+}
+
+struct BVH::Builder
+{
+	struct Primitive
+	{
+		glm::vec3 centroid;
+		unsigned int index;
+	};
+	Builder(std::vector<Node> &nodes, const std::vector<glm::vec3> &mins, const std::vector<glm::vec3> &maxs)
+		: nodes(nodes)
+		, mins(mins)
+		, maxs(maxs)
+	{
+		prims.resize(mins.size());
+		for (unsigned int i = 0; i < prims.size(); ++i)
+			prims[i] = { (mins[i] + maxs[i]) * 0.5f, i };
+	}
+	Bounds bounds(unsigned int begin, unsigned int end) const
+	{
+		Bounds rtn;
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			rtn.include(mins[prims[i].index]);
+			rtn.include(maxs[prims[i].index]);
+		}
+		return rtn;
+	}
+	/**
+	 * Partitions the range in two
+	 * @return The first primitive of the second half
+	 */
+	unsigned int split(unsigned int begin, unsigned int end, unsigned int depth)
+	{
+		Bounds centroids;
+		for (unsigned int i = begin; i < end; ++i)
+			centroids.include(prims[i].centroid);
+		const glm::vec3 extent = centroids.max - centroids.min;
+		const int longest = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		if (depth < SAH_DEPTH)
+		{
+			//Find the cheapest plane between bins, cost is proportional to area * primitives of each side
+			float bestCost = FLT_MAX;
+			int bestAxis = -1;
+			unsigned int bestBin = 0;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (extent[axis] <= 0)
+					continue;
+				const float scale = SAH_BINS / extent[axis] * 0.9999f;
+				Bounds bins[SAH_BINS];
+				unsigned int counts[SAH_BINS] = {};
+				for (unsigned int i = begin; i < end; ++i)
+				{
+					const unsigned int b = (unsigned int)((prims[i].centroid[axis] - centroids.min[axis]) * scale);
+					++counts[b];
+					bins[b].include(mins[prims[i].index]);
+					bins[b].include(maxs[prims[i].index]);
+				}
+				float rightArea[SAH_BINS];
+				unsigned int rightCount[SAH_BINS];
+				Bounds right;
+				unsigned int n = 0;
+				for (unsigned int b = SAH_BINS - 1; b > 0; --b)
+				{
+					right.include(bins[b]);
+					n += counts[b];
+					rightArea[b] = right.area();
+					rightCount[b] = n;
+				}
+				Bounds left;
+				n = 0;
+				for (unsigned int b = 1; b < SAH_BINS; ++b)
+				{
+					left.include(bins[b - 1]);
+					n += counts[b - 1];
+					const float cost = left.area() * n + rightArea[b] * rightCount[b];
+					if (n && rightCount[b] && cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+			if (bestAxis >= 0)
+			{
+				const float scale = SAH_BINS / extent[bestAxis] * 0.9999f;
+				const float origin = centroids.min[bestAxis];
+				Primitive *mid = std::partition(&prims[begin], &prims[0] + end, [=](const Primitive &p){
+					return (unsigned int)((p.centroid[bestAxis] - origin) * scale) < bestBin;
+				});
+				return (unsigned int)(mid - &prims[0]);
+			}
+		}
+		//Coincident centroids, or too deep, so split at the median
+		const unsigned int mid = (begin + end) / 2;
+		std::nth_element(&prims[begin], &prims[mid], &prims[0] + end, [=](const Primitive &a, const Primitive &b){
+			return a.centroid[longest] < b.centroid[longest];
+		});
+		return mid;
+	}
+	/**
+	 * Splits the range into up to 4 children of nodes[node], recursing into those too large for a leaf
+	 */
+	void buildNode(unsigned int node, unsigned int begin, unsigned int end, unsigned int depth)
+	{
+		//Repeatedly split the child of largest area, until there are 4 or all are leaves
+		struct Range { unsigned int begin, end; Bounds bounds; };
+		Range ranges[4];
+		unsigned int rangeCount = 1;
+		ranges[0] = { begin, end, bounds(begin, end) };
+		while (rangeCount < 4)
+		{
+			int widest = -1;
+			for (unsigned int i = 0; i < rangeCount; ++i)
+			{
+				if (ranges[i].end - ranges[i].begin > LEAF_SIZE && (widest < 0 || ranges[i].bounds.area() > ranges[widest].bounds.area()))
+					widest = (int)i;
+			}
+			if (widest < 0)
+				break;
+			const Range r = ranges[widest];
+			const unsigned int mid = split(r.begin, r.end, depth);
+			ranges[widest] = { r.begin, mid, bounds(r.begin, mid) };
+			ranges[rangeCount++] = { mid, r.end, bounds(mid, r.end) };
+		}
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			Node &n = nodes[node];
+			if (c >= rangeCount)
+			{
+				for (int a = 0; a < 3; ++a)
+				{
+					n.bounds[a][c] = INFINITY;
+					n.bounds[a + 3][c] = -INFINITY;
+				}
+				n.child[c] = EMPTY;
+				n.count[c] = 0;
+				continue;
+			}
+			const Range &r = ranges[c];
+			for (int a = 0; a < 3; ++a)
+			{
+				n.bounds[a][c] = r.bounds.min[a];
+				n.bounds[a + 3][c] = r.bounds.max[a];
+			}
+			if (r.end - r.begin <= LEAF_SIZE)
+			{
+				n.child[c] = r.begin;
+				n.count[c] = r.end - r.begin;
+			}
+			else
+			{
+				//nodes may reallocate, so n mustn't be used after this
+				const unsigned int child = (unsigned int)nodes.size();
+				n.child[c] = child;
+				n.count[c] = 0;
+				nodes.emplace_back();
+				buildNode(child, r.begin, r.end, depth + 1);
+			}
+		}
+	}
+	std::vector<Node> &nodes;
+	const std::vector<glm::vec3> &mins, &maxs;
+	std::vector<Primitive> prims;
+};
+
+std::vector<unsigned int> BVH::build(const std::vector<glm::vec3> &mins, const std::vector<glm::vec3> &maxs)
+{
+	nodes.clear();
+	rootMin = rootMax = glm::vec3(0);
+	std::vector<unsigned int> rtn;
+	if (mins.empty())
+		return rtn;
+	Builder builder(nodes, mins, maxs);
+	//4 wide nodes with small leaves need roughly 1 node per 2 primitives
+	nodes.reserve(mins.size() / 2 + 1);
+	nodes.emplace_back();
+	builder.buildNode(0, 0, (unsigned int)mins.size(), 0);
+	nodes.shrink_to_fit();
+	const Bounds root = builder.bounds(0, (unsigned int)mins.size());
+	rootMin = root.min;
+	rootMax = root.max;
+	rtn.reserve(mins.size());
+	for (auto &&p : builder.prims)
+		rtn.push_back(p.index);
+	return rtn;
+}
+
+MeshBVH::MeshBVH(const glm::vec3 *vertices, const unsigned int *indices, unsigned int triangleCount, const unsigned int *elements)
+{
+	std::vector<glm::vec3> mins(triangleCount), maxs(triangleCount);
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		const glm::vec3 &a = vertices[indices[i * 3]], &b = vertices[indices[i * 3 + 1]], &c = vertices[indices[i * 3 + 2]];
+		mins[i] = glm::min(a, glm::min(b, c));
+		maxs[i] = glm::max(a, glm::max(b, c));
+	}
+	const std::vector<unsigned int> order = bvh.build(mins, maxs);
+	//Store triangles in leaf order, so each leaf's triangles are contiguous
+	triangles.resize(triangleCount);
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		const unsigned int t = order[i];
+		const glm::vec3 &a = vertices[indices[t * 3]], &b = vertices[indices[t * 3 + 1]], &c = vertices[indices[t * 3 + 2]];
+		triangles[i] = { a, b - a, c - a, t };
+	}
+	if (elements)
+		this->elements.assign(elements, elements + triangleCount);
+}
+bool MeshBVH::intersectTriangle(const Ray &ray, const Triangle &tri, float &tMax, RayHit &hit) const
+{
+	//Moller-Trumbore, triangles are hit from either side
+	const glm::vec3 p = glm::cross(ray.direction, tri.e2);
+	const float det = glm::dot(tri.e1, p);
+	if (fabsf(det) < 1e-12f)
+		return false;
+	const float invDet = 1.0f / det;
+	const glm::vec3 s = ray.origin - tri.v0;
+	const float u = glm::dot(s, p) * invDet;
+	if (u < 0 || u > 1)
+		return false;
+	const glm::vec3 q = glm::cross(s, tri.e1);
+	const float v = glm::dot(ray.direction, q) * invDet;
+	if (v < 0 || u + v > 1)
+		return false;
+	const float t = glm::dot(tri.e2, q) * invDet;
+	if (t < 0 || t >= tMax)
+		return false;
+	tMax = t;
+	hit.t = t;
+	hit.triangle = tri.index;
+	hit.element = elements.empty() ? 0 : elements[tri.index];
+	hit.barycentric = glm::vec2(u, v);
+	hit.normal = glm::normalize(glm::cross(tri.e1, tri.e2));
+	return true;
+}
+RayHit MeshBVH::intersect(const Ray &ray) const
+{
+	RayHit rtn;
+	intersect(ray, rtn);
+	return rtn;
+}
+bool MeshBVH::intersect(const Ray &ray, RayHit &hit) const
+{
+	bool rtn = false;
+	bvh.traverse(ray, std::min(ray.tMax, hit.t), [&](unsigned int first, unsigned int count, float &tMax){
+		for (unsigned int i = first; i < first + count; ++i)
+			rtn = intersectTriangle(ray, triangles[i], tMax, hit) || rtn;
+		return false;
+	});
+	return rtn;
+}
+bool MeshBVH::occluded(const Ray &ray) const
+{
+	bool rtn = false;
+	RayHit hit;
+	bvh.traverse(ray, ray.tMax, [&](unsigned int first, unsigned int count, float &tMax){
+		for (unsigned int i = first; i < first + count && !rtn; ++i)
+			rtn = intersectTriangle(ray, triangles[i], tMax, hit);
+		return rtn;
+	});
+	return rtn;
+}
+void MeshBVH::intersect(const Ray *rays, RayHit *hits, unsigned int count) const
+{
+	for (unsigned int i = 0; i < count; i += 4)
+	{
+		const unsigned int n = std::min(count - i, 4u);
+		for (unsigned int r = 0; r < n; ++r)
+		{
+			hits[i + r] = RayHit();
+			hits[i + r].t = rays[i + r].tMax;
+		}
+		const int updated = intersectPacket(rays + i, hits + i, (1 << n) - 1);
+		//Rays which hit nothing report the default t
+		for (unsigned int r = 0; r < n; ++r)
+			if (!(updated & (1 << r)))
+				hits[i + r].t = FLT_MAX;
+	}
+}
+int MeshBVH::intersectPacket(const Ray *rays, RayHit *hits, int mask) const
+{
+	typedef BVH::Float4 Float4;
+	//Lane i of each vector holds ray i
+	float o[3][4] = {}, d[3][4] = {};
+	for (int r = 0; r < 4; ++r)
+	{
+		if (!(mask & (1 << r)))
+			continue;
+		for (int a = 0; a < 3; ++a)
+		{
+			o[a][r] = rays[r].origin[a];
+			d[a][r] = rays[r].direction[a];
+		}
+	}
+	const Float4 ox = Float4::load(o[0]), oy = Float4::load(o[1]), oz = Float4::load(o[2]);
+	const Float4 dx = Float4::load(d[0]), dy = Float4::load(d[1]), dz = Float4::load(d[2]);
+	const Float4 zero(0.0f), one(1.0f);
+	float tMax[4];
+	for (int r = 0; r < 4; ++r)
+		tMax[r] = hits[r].t;
+	int rtn = 0;
+	bvh.traversePacket(rays, mask, tMax, [&](unsigned int first, unsigned int count, int active, float *tMax){
+		for (unsigned int i = first; i < first + count; ++i)
+		{
+			//Moller-Trumbore, each triangle is tested against all rays of the packet together
+			const Triangle &tri = triangles[i];
+			const Float4 e1x(tri.e1.x), e1y(tri.e1.y), e1z(tri.e1.z);
+			const Float4 e2x(tri.e2.x), e2y(tri.e2.y), e2z(tri.e2.z);
+			const Float4 px = dy * e2z - dz * e2y, py = dz * e2x - dx * e2z, pz = dx * e2y - dy * e2x;
+			const Float4 det = e1x * px + e1y * py + e1z * pz;
+			const Float4 sx = ox - Float4(tri.v0.x), sy = oy - Float4(tri.v0.y), sz = oz - Float4(tri.v0.z);
+			const Float4 qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+			float fDet[4], fU[4], fV[4], fT[4];
+			det.store(fDet);
+			(sx * px + sy * py + sz * pz).store(fU);
+			(dx * qx + dy * qy + dz * qz).store(fV);
+			(e2x * qx + e2y * qy + e2z * qz).store(fT);
+			for (int r = 0; r < 4; ++r)
+			{
+				if (!(active & (1 << r)) || fabsf(fDet[r]) < 1e-12f)
+					continue;
+				const float invDet = 1.0f / fDet[r];
+				const float u = fU[r] * invDet, v = fV[r] * invDet, t = fT[r] * invDet;
+				if (u < 0 || v < 0 || u + v > 1 || t < 0 || t >= tMax[r])
+					continue;
+				tMax[r] = t;
+				hits[r].t = t;
+				hits[r].triangle = tri.index;
+				hits[r].element = elements.empty() ? 0 : elements[tri.index];
+				hits[r].barycentric = glm::vec2(u, v);
+				hits[r].normal = glm::normalize(glm::cross(tri.e1, tri.e2));
+				rtn |= 1 << r;
+			}
+		}
+		return active;
+	});
+	return rtn;
+}
+
+//Comment out this include if not making use of Entity
+#include "../Entity.h"
+#ifdef __Entity_h__
+std::shared_ptr<MeshBVH> Entity::buildBVH() const
+{
+	if (!positions.data || !faces.data || positions.componentType != GL_FLOAT || faces.components != 3)
+		return nullptr;
+	std::vector<glm::vec3> vertices(positions.count);
+	for (unsigned int i = 0; i < positions.count; ++i)
+		vertices[i] = glm::make_vec3(static_cast<const float *>(positions.data) + i * positions.components);
+	return std::make_shared<MeshBVH>(vertices.data(), static_cast<const unsigned int *>(faces.data), faces.count);
+}
+#endif //__Entity_h__
+//Comment out this include if not making use of Model
+#include "../model/Model.h"
+#ifdef __Model_h__
+namespace
+{
+	/**
+	 * Appends the triangles of the node's meshes, and its children's, posed in bind pose
+	 */
+	void gatherTriangles(const ModelData &data, const ModelNode &node, glm::mat4 transform, std::vector<glm::vec3> &vertices, std::vector<unsigned int> &elements)
+	{
+		transform *= data.transforms[node.transformOffset];
+		for (auto &&mesh : node.meshes)
+		{
+			if (mesh->getFaceType() != GL_TRIANGLES)
+				continue;
+			for (unsigned int i = 0; i + 2 < mesh->getFaceCount(); i += 3)
+			{
+				for (unsigned int v = 0; v < 3; ++v)
+					vertices.push_back(glm::vec3(transform * glm::vec4(data.vertices[data.faces[mesh->getFirstFace() + i + v]], 1.0f)));
+				elements.push_back(mesh->getIndex());
+			}
+		}
+		for (auto &&child : node.children)
+			gatherTriangles(data, *child, transform, vertices, elements);
+	}
+}
+std::shared_ptr<MeshBVH> Model::buildBVH() const
+{
+	if (!root || !data)
+		return nullptr;
+	//Triangles are unindexed, as meshes of different nodes share vertices under different transforms
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> elements;
+	gatherTriangles(*data, *root, glm::mat4(1), vertices, elements);
+	std::vector<unsigned int> indices(vertices.size());
+	for (unsigned int i = 0; i < indices.size(); ++i)
+		indices[i] = i;
+	return std::make_shared<MeshBVH>(vertices.data(), indices.data(), (unsigned int)elements.size(), elements.data());
+}
+#endif //__Model_h__
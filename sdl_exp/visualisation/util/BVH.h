@@ -0,0 +1,389 @@
+#ifndef __BVH_h__
+#define __BVH_h__
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+/**
+ * A ray, the points origin + t * direction for t within [0, tMax]
+ * The direction need not be normalised, t is measured in multiples of it
+ */
+struct Ray
+{
+	Ray(const glm::vec3 &origin = glm::vec3(0), const glm::vec3 &direction = glm::vec3(0, 0, -1), float tMax = FLT_MAX)
+		: origin(origin)
+		, direction(direction)
+		, tMax(tMax)
+	{ }
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tMax;
+};
+/**
+ * The closest intersection found along a ray
+ */
+struct RayHit
+{
+	static const unsigned int NONE = UINT_MAX;
+	RayHit()
+		: t(FLT_MAX)
+		, object(NONE)
+		, element(0)
+		, triangle(NONE)
+		, barycentric(0)
+		, normal(0)
+	{ }
+	bool hit() const { return triangle != NONE; }
+	float t;
+	/**
+	 * The ID returned by RayCaster::add(), NONE for queries of a lone MeshBVH
+	 */
+	unsigned int object;
+	/**
+	 * Index of the mesh within a Model (Mesh::getIndex()), 0 for Entities
+	 */
+	unsigned int element;
+	/**
+	 * Index of the triangle, in the order triangles were passed to MeshBVH
+	 */
+	unsigned int triangle;
+	/**
+	 * Weights of the triangle's 2nd and 3rd vertices at the hit
+	 */
+	glm::vec2 barycentric;
+	/**
+	 * Normalised geometric normal of the triangle, in the space of the query (world space for RayCaster)
+	 */
+	glm::vec3 normal;
+};
+/**
+ * A bounding volume hierarchy of 4 wide nodes, built with the binned surface area heuristic
+ * The 4 children of a node are tested against a ray together with SIMD (SSE, with a scalar fallback)
+ * This holds only the hierarchy, primitives are intersected by the leaf callback passed to traverse()
+ * @see MeshBVH and RayCaster
+ */
+class BVH
+{
+public:
+	/**
+	 * Ranges with at most this many primitives become leaves
+	 */
+	static const unsigned int LEAF_SIZE = 4;
+	/**
+	 * Depth after which ranges are split at the median rather than by SAH, bounding the traversal stack
+	 */
+	static const unsigned int SAH_DEPTH = 32;
+	static const unsigned int STACK_SIZE = 256;
+	/**
+	 * 4 floats, operated on with SSE when available
+	 */
+	struct Float4
+	{
+#ifdef BVH_SSE
+		__m128 v;
+		Float4() { }
+		Float4(__m128 v) : v(v) { }
+		explicit Float4(float f) : v(_mm_set1_ps(f)) { }
+		static Float4 load(const float *p) { return _mm_loadu_ps(p); }
+		void store(float *p) const { _mm_storeu_ps(p, v); }
+		Float4 operator+(const Float4 &b) const { return _mm_add_ps(v, b.v); }
+		Float4 operator-(const Float4 &b) const { return _mm_sub_ps(v, b.v); }
+		Float4 operator*(const Float4 &b) const { return _mm_mul_ps(v, b.v); }
+		static Float4 min(const Float4 &a, const Float4 &b) { return _mm_min_ps(a.v, b.v); }
+		static Float4 max(const Float4 &a, const Float4 &b) { return _mm_max_ps(a.v, b.v); }
+		/**
+		 * @return Bit i is set if lane i of this <= lane i of b
+		 */
+		int lessEqual(const Float4 &b) const { return _mm_movemask_ps(_mm_cmple_ps(v, b.v)); }
+#else
+		float v[4];
+		Float4() { }
+		explicit Float4(float f) { v[0] = v[1] = v[2] = v[3] = f; }
+		static Float4 load(const float *p) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+		void store(float *p) const { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+		Float4 operator+(const Float4 &b) const { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = v[i] + b.v[i]; return r; }
+		Float4 operator-(const Float4 &b) const { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = v[i] - b.v[i]; return r; }
+		Float4 operator*(const Float4 &b) const { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = v[i] * b.v[i]; return r; }
+		static Float4 min(const Float4 &a, const Float4 &b) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+		static Float4 max(const Float4 &a, const Float4 &b) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+		int lessEqual(const Float4 &b) const { int r = 0; for (int i = 0; i < 4; ++i) r |= (v[i] <= b.v[i]) << i; return r; }
+#endif
+	};
+	/**
+	 * @return 1/d, with zero components replaced by a large finite value so slab tests never produce NaN
+	 */
+	static glm::vec3 reciprocal(const glm::vec3 &d)
+	{
+		glm::vec3 rtn;
+		for (int i = 0; i < 3; ++i)
+			rtn[i] = 1.0f / (fabsf(d[i]) > 1e-20f ? d[i] : (d[i] < 0 ? -1e-20f : 1e-20f));
+		return rtn;
+	}
+	/**
+	 * Builds the hierarchy over the primitives' bounding boxes
+	 * @param mins, maxs Bounds of each primitive
+	 * @return The order primitives must be stored in, leaves reference the range [first, first+count) of this order
+	 */
+	std::vector<unsigned int> build(const std::vector<glm::vec3> &mins, const std::vector<glm::vec3> &maxs);
+	bool empty() const { return nodes.empty(); }
+	unsigned int getNodeCount() const { return (unsigned int)nodes.size(); }
+	size_t getMemory() const { return nodes.size() * sizeof(Node); }
+	glm::vec3 getMin() const { return rootMin; }
+	glm::vec3 getMax() const { return rootMax; }
+	/**
+	 * Visits the leaves the ray passes through, nearest first
+	 * @param leaf bool(unsigned int first, unsigned int count, float &tMax), reduces tMax to the nearest hit, returns true to end traversal
+	 */
+	template<class Leaf>
+	void traverse(const Ray &ray, float tMax, Leaf &&leaf) const;
+	/**
+	 * Visits the leaves any of up to 4 rays pass through, the rays are tested against each child together
+	 * @param mask Bit i is set if rays[i] is active
+	 * @param tMax Per ray, as above
+	 * @param leaf int(unsigned int first, unsigned int count, int mask, float *tMax), returns the rays which remain active
+	 */
+	template<class Leaf>
+	void traversePacket(const Ray *rays, int mask, float *tMax, Leaf &&leaf) const;
+private:
+	/**
+	 * Child bounds are stored as structure of arrays, so each axis of the 4 children loads as one vector
+	 */
+	struct Node
+	{
+		/**
+		 * minX, minY, minZ, maxX, maxY, maxZ, empty children have inverted (infinite) bounds
+		 */
+		float bounds[6][4];
+		/**
+		 * Index of the child node, or the first primitive of a leaf
+		 */
+		unsigned int child[4];
+		/**
+		 * The number of primitives of a leaf, 0 for child nodes and empty children
+		 */
+		unsigned int count[4];
+	};
+	/**
+	 * Stack entries of leaves are tagged, and identify the node and child holding the leaf
+	 */
+	static const unsigned int LEAF_BIT = 0x80000000u;
+	static const unsigned int EMPTY = UINT_MAX;
+	struct Builder;
+	std::vector<Node> nodes;
+	glm::vec3 rootMin, rootMax;
+};
+
+template<class Leaf>
+void BVH::traverse(const Ray &ray, float tMax, Leaf &&leaf) const
+{
+	if (nodes.empty())
+		return;
+	const glm::vec3 inv = reciprocal(ray.direction);
+	//Select the near and far planes of each axis by the direction's sign, so the slab test needs no min/max
+	const int nearX = inv.x < 0 ? 3 : 0, nearY = inv.y < 0 ? 4 : 1, nearZ = inv.z < 0 ? 5 : 2;
+	const int farX = (nearX + 3) % 6, farY = (nearY + 3) % 6, farZ = (nearZ + 3) % 6;
+	const Float4 ox(ray.origin.x), oy(ray.origin.y), oz(ray.origin.z);
+	const Float4 ix(inv.x), iy(inv.y), iz(inv.z);
+	unsigned int stack[STACK_SIZE];
+	float stackT[STACK_SIZE];
+	unsigned int sp = 0;
+	stack[sp] = 0;
+	stackT[sp++] = 0;
+	while (sp)
+	{
+		--sp;
+		if (stackT[sp] > tMax)
+			continue;
+		const unsigned int code = stack[sp];
+		if (code & LEAF_BIT)
+		{
+			const Node &n = nodes[(code & ~LEAF_BIT) >> 2];
+			if (leaf(n.child[code & 3], n.count[code & 3], tMax))
+				return;
+			continue;
+		}
+		const Node &n = nodes[code];
+		const Float4 tNear = Float4::max(
+			Float4::max((Float4::load(n.bounds[nearX]) - ox) * ix, (Float4::load(n.bounds[nearY]) - oy) * iy),
+			Float4::max((Float4::load(n.bounds[nearZ]) - oz) * iz, Float4(0.0f)));
+		const Float4 tFar = Float4::min(
+			Float4::min((Float4::load(n.bounds[farX]) - ox) * ix, (Float4::load(n.bounds[farY]) - oy) * iy),
+			Float4::min((Float4::load(n.bounds[farZ]) - oz) * iz, Float4(tMax)));
+		const int hitMask = tNear.lessEqual(tFar);
+		if (!hitMask)
+			continue;
+		//Push hit children farthest first, so the nearest is visited next
+		float tn[4];
+		tNear.store(tn);
+		unsigned int order[4], hits = 0;
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			if (!(hitMask & (1 << c)) || n.child[c] == EMPTY)
+				continue;
+			unsigned int i = hits++;
+			for (; i > 0 && tn[order[i - 1]] < tn[c]; --i)
+				order[i] = order[i - 1];
+			order[i] = c;
+		}
+		for (unsigned int i = 0; i < hits; ++i)
+		{
+			const unsigned int c = order[i];
+			stack[sp] = n.count[c] ? LEAF_BIT | (code << 2) | c : n.child[c];
+			stackT[sp++] = tn[c];
+		}
+	}
+}
+template<class Leaf>
+void BVH::traversePacket(const Ray *rays, int mask, float *tMax, Leaf &&leaf) const
+{
+	if (nodes.empty() || !mask)
+		return;
+	//Lane i of each vector holds ray i, inactive lanes are masked from results
+	float o[3][4] = {}, inv[3][4] = {};
+	for (int r = 0; r < 4; ++r)
+	{
+		if (!(mask & (1 << r)))
+			continue;
+		const glm::vec3 i = reciprocal(rays[r].direction);
+		for (int a = 0; a < 3; ++a)
+		{
+			o[a][r] = rays[r].origin[a];
+			inv[a][r] = i[a];
+		}
+	}
+	const Float4 ox = Float4::load(o[0]), oy = Float4::load(o[1]), oz = Float4::load(o[2]);
+	const Float4 ix = Float4::load(inv[0]), iy = Float4::load(inv[1]), iz = Float4::load(inv[2]);
+	unsigned int stack[STACK_SIZE];
+	int stackMask[STACK_SIZE];
+	unsigned int sp = 0;
+	stack[sp] = 0;
+	stackMask[sp++] = mask;
+	while (sp)
+	{
+		--sp;
+		const int active = stackMask[sp] & mask;
+		if (!active)
+			continue;
+		const unsigned int code = stack[sp];
+		if (code & LEAF_BIT)
+		{
+			const Node &n = nodes[(code & ~LEAF_BIT) >> 2];
+			mask &= leaf(n.child[code & 3], n.count[code & 3], active, tMax) | ~active;
+			continue;
+		}
+		const Node &n = nodes[code];
+		const Float4 t = Float4::load(tMax);
+		unsigned int order[4], hits = 0;
+		int childMask[4];
+		float childNear[4];
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			if (n.child[c] == EMPTY)
+				continue;
+			//Rays may differ in direction, so both planes of each slab are tested
+			const Float4 x0 = (Float4(n.bounds[0][c]) - ox) * ix, x1 = (Float4(n.bounds[3][c]) - ox) * ix;
+			const Float4 y0 = (Float4(n.bounds[1][c]) - oy) * iy, y1 = (Float4(n.bounds[4][c]) - oy) * iy;
+			const Float4 z0 = (Float4(n.bounds[2][c]) - oz) * iz, z1 = (Float4(n.bounds[5][c]) - oz) * iz;
+			const Float4 tNear = Float4::max(Float4::max(Float4::min(x0, x1), Float4::min(y0, y1)), Float4::max(Float4::min(z0, z1), Float4(0.0f)));
+			const Float4 tFar = Float4::min(Float4::min(Float4::max(x0, x1), Float4::max(y0, y1)), Float4::min(Float4::max(z0, z1), t));
+			childMask[c] = tNear.lessEqual(tFar) & active;
+			if (!childMask[c])
+				continue;
+			//Order children by the nearest entry of any ray
+			float tn[4];
+			tNear.store(tn);
+			childNear[c] = FLT_MAX;
+			for (int r = 0; r < 4; ++r)
+				if (childMask[c] & (1 << r))
+					childNear[c] = tn[r] < childNear[c] ? tn[r] : childNear[c];
+			unsigned int i = hits++;
+			for (; i > 0 && childNear[order[i - 1]] < childNear[c]; --i)
+				order[i] = order[i - 1];
+			order[i] = c;
+		}
+		for (unsigned int i = 0; i < hits; ++i)
+		{
+			const unsigned int c = order[i];
+			stack[sp] = n.count[c] ? LEAF_BIT | (code << 2) | c : n.child[c];
+			stackMask[sp++] = childMask[c];
+		}
+	}
+}
+
+/**
+ * A BVH over a triangle mesh, for CPU ray queries (line of sight, picking, terrain following)
+ * Triangles are copied, in leaf order, as a vertex and two edges, so the source geometry may be freed
+ * Usage:
+ *   std::shared_ptr<MeshBVH> bvh = entity->buildBVH();
+ *   RayHit hit = bvh->intersect(Ray(origin, direction));
+ *   if (hit.hit()) ...origin + hit.t * direction...
+ * @note Queries are const, so may be made from many jobs at once
+ * @see RayCaster, which places the meshes of Entities and Models within a scene
+ */
+class MeshBVH
+{
+	friend class RayCaster;
+public:
+	/**
+	 * @param vertices Vertex positions
+	 * @param indices Triangle list, 3 indices per triangle
+	 * @param triangleCount The number of triangles
+	 * @param elements Optional, the element (e.g. Model mesh index) of each triangle reported by hits
+	 */
+	MeshBVH(const glm::vec3 *vertices, const unsigned int *indices, unsigned int triangleCount, const unsigned int *elements = nullptr);
+	/**
+	 * @return The nearest intersection within the ray's range
+	 */
+	RayHit intersect(const Ray &ray) const;
+	/**
+	 * As above, hit is only updated if an intersection nearer than hit.t is found
+	 * @return True if hit was updated
+	 */
+	bool intersect(const Ray &ray, RayHit &hit) const;
+	/**
+	 * Intersects rays in packets of 4, this is faster than single rays when rays of each packet are coherent (e.g. neighbouring pixels)
+	 * @param hits Receives the nearest intersection of each ray
+	 */
+	void intersect(const Ray *rays, RayHit *hits, unsigned int count) const;
+	/**
+	 * @return True if any triangle intersects the ray, this ends at the first intersection found
+	 */
+	bool occluded(const Ray &ray) const;
+	unsigned int getTriangleCount() const { return (unsigned int)triangles.size(); }
+	unsigned int getNodeCount() const { return bvh.getNodeCount(); }
+	size_t getMemory() const { return bvh.getMemory() + triangles.size() * sizeof(Triangle) + elements.size() * sizeof(unsigned int); }
+	glm::vec3 getMin() const { return bvh.getMin(); }
+	glm::vec3 getMax() const { return bvh.getMax(); }
+private:
+	struct Triangle
+	{
+		glm::vec3 v0, e1, e2;
+		unsigned int index;
+	};
+	/**
+	 * Intersects up to 4 rays, hits are only updated where an intersection nearer than their t is found
+	 * @return Bit i is set if hits[i] was updated
+	 */
+	int intersectPacket(const Ray *rays, RayHit *hits, int mask) const;
+	/**
+	 * Intersects the ray with a triangle, writing the hit if it is nearer than tMax
+	 */
+	bool intersectTriangle(const Ray &ray, const Triangle &tri, float &tMax, RayHit &hit) const;
+	BVH bvh;
+	std::vector<Triangle> triangles;
+	/**
+	 * Element of each triangle, by its original index, empty if none were provided
+	 */
+	std::vector<unsigned int> elements;
+};
+
+#endif //__BVH_h__
@@ -0,0 +1,131 @@
+#include "FileWatcher.h"
+#include <cstdio>
+#include <filesystem>
+#ifdef _MSC_VER
+#define filesystem tr2::sys
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+FileWatcher::FileWatcher(const std::string &directory, std::chrono::milliseconds scanInterval)
+	: directory(canonicalPath(directory))
+#ifdef __linux__
+	, fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+	(void)scanInterval;
+	if (fd < 0)
+	{
+		fprintf(stderr, "FileWatcher: inotify_init1() failed (%d), '%s' will not be watched.\n", errno, this->directory.c_str());
+		return;
+	}
+	addWatch(this->directory);
+}
+#else
+	, scanInterval(scanInterval)
+	, lastScan(std::chrono::steady_clock::now())
+{
+	//Record the initial modification times
+	scan(nullptr);
+}
+#endif
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (fd >= 0)
+		close(fd);
+#endif
+}
+std::string FileWatcher::canonicalPath(const std::string &path)
+{
+	std::error_code ec;
+	std::filesystem::path rtn = std::filesystem::canonical(std::filesystem::path(path), ec);
+	return ec ? path : rtn.string();
+}
+#ifdef __linux__
+void FileWatcher::addWatch(const std::string &path)
+{
+	//Editors commonly save by writing a temporary file and renaming it over the original, hence IN_MOVED_TO
+	int wd = inotify_add_watch(fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF);
+	if (wd < 0)
+		return;
+	watches[wd] = path;
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it(std::filesystem::path(path), ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (std::filesystem::is_directory(it->status()))
+			addWatch(it->path().string());
+	}
+}
+std::vector<std::string> FileWatcher::poll()
+{
+	std::vector<std::string> rtn;
+	if (fd < 0)
+		return rtn;
+	alignas(inotify_event) char buffer[4096];
+	while (true)
+	{
+		ssize_t len = read(fd, buffer, sizeof(buffer));
+		if (len <= 0)
+			break;//EAGAIN, no further events
+		for (char *ptr = buffer; ptr < buffer + len; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event*>(ptr)->len)
+		{
+			const inotify_event *event = reinterpret_cast<inotify_event*>(ptr);
+			auto watch = watches.find(event->wd);
+			if (watch == watches.end())
+				continue;
+			if (event->mask & IN_IGNORED)
+			{
+				watches.erase(watch);
+				continue;
+			}
+			if (!event->len)
+				continue;
+			std::string path = watch->second + "/" + event->name;
+			if (event->mask & IN_ISDIR)
+			{//Watch new subdirectories
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+					addWatch(path);
+			}
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				rtn.push_back(path);
+			}
+		}
+	}
+	return rtn;
+}
+#else
+void FileWatcher::scan(std::vector<std::string> *changed)
+{
+	std::error_code ec;
+	for (std::filesystem::recursive_directory_iterator it(std::filesystem::path(directory), ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (!std::filesystem::is_regular_file(it->status()))
+			continue;
+		const std::string path = it->path().string();
+		const FileTime modified = std::filesystem::last_write_time(it->path(), ec);
+		if (ec)
+			continue;
+		auto known = modifiedTimes.find(path);
+		if (known == modifiedTimes.end() || known->second != modified)
+		{
+			if (changed)
+				changed->push_back(path);
+			modifiedTimes[path] = modified;
+		}
+	}
+}
+std::vector<std::string> FileWatcher::poll()
+{
+	std::vector<std::string> rtn;
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - lastScan < scanInterval)
+		return rtn;
+	lastScan = now;
+	scan(&rtn);
+	return rtn;
+}
+#endif
@@ -0,0 +1,84 @@
+#ifndef __FileWatcher_h__
+#define __FileWatcher_h__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#ifndef __linux__
+#include <filesystem>
+#endif
+
+/**
+ * Reports files within a directory (and it's subdirectories) which have been modified
+ * On Linux this uses inotify, so poll() costs nothing until changes occur
+ * On other platforms the directory is rescanned for changed modification times, at most once per scanInterval
+ */
+class FileWatcher
+{
+public:
+	/**
+	 * Begins watching the provided directory
+	 * @param directory Path to the directory to be watched
+	 * @param scanInterval Minimum time between rescans of the directory, where inotify is not available
+	 */
+	explicit FileWatcher(const std::string &directory, std::chrono::milliseconds scanInterval = std::chrono::milliseconds(500));
+	/**
+	 * Stops watching the directory
+	 */
+	~FileWatcher();
+	/**
+	 * Returns the paths of files which have been modified since the previous call
+	 * Paths are canonical, so they can be compared against those returned by FileWatcher::canonicalPath()
+	 * @note This call does not block
+	 */
+	std::vector<std::string> poll();
+	/**
+	 * @param path Path to an existing file
+	 * @return The canonical form of path, path itself if it could not be resolved
+	 */
+	static std::string canonicalPath(const std::string &path);
+	/**
+	 * @return The canonical path of the watched directory
+	 */
+	const std::string &getDirectory() const { return directory; }
+private:
+	std::string directory;
+#ifdef __linux__
+	/**
+	 * Adds an inotify watch to the provided directory and all of it's subdirectories
+	 */
+	void addWatch(const std::string &path);
+	/**
+	 * inotify instance
+	 */
+	int fd;
+	/**
+	 * Key: Watch descriptor
+	 * Val: Path of the watched directory
+	 */
+	std::map<int, std::string> watches;
+#else
+	/**
+	 * Scans the directory, appending files whose modification times differ from those in modifiedTimes
+	 */
+	void scan(std::vector<std::string> *changed);
+	/**
+	 * std::filesystem::file_time_type, or time_t where std::filesystem is VS2013's tr2::sys
+	 */
+#ifdef _MSC_VER
+	typedef decltype(std::tr2::sys::last_write_time(std::tr2::sys::path())) FileTime;
+#else
+	typedef decltype(std::filesystem::last_write_time(std::filesystem::path())) FileTime;
+#endif
+	std::chrono::milliseconds scanInterval;
+	std::chrono::steady_clock::time_point lastScan;
+	/**
+	 * Key: File path
+	 * Val: Modification time of the file when last scanned
+	 */
+	std::map<std::string, FileTime> modifiedTimes;
+#endif
+};
+
+#endif //__FileWatcher_h__
@@ -0,0 +1,313 @@
+#include "FrameCapture.h"
+#include "StringUtils.h"
+#include <algorithm>
+#include <cstring>
+#include <SDL/SDL_image.h>
+
+namespace
+{
+	/**
+	 * Timeout of each wait on a readback's fence, in nanoseconds
+	 */
+	const GLuint64 FENCE_TIMEOUT = 100000000;
+	unsigned int encoderCount(FrameCapture::Format format)
+	{
+		if (format != FrameCapture::PNG)
+			return 1;
+		//Leave a core for the render thread
+		const unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 2 ? cores - 1 : 1;
+	}
+}
+
+FrameCapture::FrameCapture(const std::string &path, Format format, unsigned int fps)
+	: path(path)
+	, format(format)
+	, fps(fps)
+	, good(true)
+	, finished(false)
+	, file(nullptr)
+	, streamDims(0)
+	, ringHead(0)
+	, ringCount(0)
+	, frameIndex(0)
+	, resolveFramebuffer(0)
+	, resolveRenderbuffer(0)
+	, resolveDims(0)
+	, stopEncoders(false)
+	, framesWritten(0)
+{
+	if (format != PNG)
+	{
+		file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			fprintf(stderr, "FrameCapture: Unable to open '%s' for writing.\n", path.c_str());
+			good = false;
+			finished = true;
+			return;
+		}
+	}
+	for (auto &&slot : ring)
+	{
+		slot.size = 0;
+		slot.fence = nullptr;
+		slot.index = 0;
+		slot.dims = glm::uvec2(0);
+	}
+	GLuint pbos[RING_SIZE];
+	GL_CALL(glGenBuffers(RING_SIZE, pbos));
+	for (unsigned int i = 0; i < RING_SIZE; ++i)
+		ring[i].pbo = pbos[i];
+	for (unsigned int i = 0; i < encoderCount(format); ++i)
+		encoders.emplace_back(&FrameCapture::encodeLoop, this);
+}
+FrameCapture::~FrameCapture()
+{
+	finish();
+}
+void FrameCapture::capture(GLuint framebuffer, glm::uvec2 dims)
+{
+	if (finished || dims.x == 0 || dims.y == 0)
+		return;
+	//Hand completed readbacks to the encoders, waiting only if the ring is full
+	while (ringCount && retire(ringCount == RING_SIZE))
+	{ }
+	Slot &slot = ring[(ringHead + ringCount) % RING_SIZE];
+	GLint previousRead = 0, previousPack = 0;
+	GL_CALL(glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead));
+	GL_CALL(glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previousPack));
+	const GLuint source = resolve(framebuffer, dims);
+	GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, source));
+	GL_CALL(glReadBuffer(source ? GL_COLOR_ATTACHMENT0 : GL_BACK));
+	GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo));
+	const size_t size = dims.x * dims.y * 4;
+	if (slot.size != size)
+	{
+		GL_CALL(glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ));
+		slot.size = size;
+	}
+	GL_CALL(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+	//With a pack buffer bound this returns immediately, the copy completes asynchronously
+	GL_CALL(glReadPixels(0, 0, dims.x, dims.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.index = frameIndex++;
+	slot.dims = dims;
+	++ringCount;
+	GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, previousPack));
+	GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead));
+}
+GLuint FrameCapture::resolve(GLuint framebuffer, glm::uvec2 dims)
+{
+	//The default framebuffer resolves implicitly on read, multisampled framebuffer objects must be blit
+	if (!framebuffer)
+		return framebuffer;
+	GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer));
+	GLint samples = 0;
+	GL_CALL(glGetIntegerv(GL_SAMPLES, &samples));
+	if (samples <= 1)
+		return framebuffer;
+	if (!resolveFramebuffer)
+	{
+		GL_CALL(glGenFramebuffers(1, &resolveFramebuffer));
+		GL_CALL(glGenRenderbuffers(1, &resolveRenderbuffer));
+	}
+	GLint previousDraw = 0;
+	GL_CALL(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw));
+	GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer));
+	if (resolveDims != dims)
+	{
+		GLint previousRenderbuffer = 0;
+		GL_CALL(glGetIntegerv(GL_RENDERBUFFER_BINDING, &previousRenderbuffer));
+		GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, resolveRenderbuffer));
+		GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, dims.x, dims.y));
+		GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, previousRenderbuffer));
+		GL_CALL(glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveRenderbuffer));
+		resolveDims = dims;
+	}
+	GL_CALL(glReadBuffer(GL_COLOR_ATTACHMENT0));
+	GL_CALL(glDrawBuffer(GL_COLOR_ATTACHMENT0));
+	GL_CALL(glBlitFramebuffer(0, 0, dims.x, dims.y, 0, 0, dims.x, dims.y, GL_COLOR_BUFFER_BIT, GL_NEAREST));
+	GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw));
+	return resolveFramebuffer;
+}
+bool FrameCapture::retire(bool wait)
+{
+	Slot &slot = ring[ringHead];
+	GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? FENCE_TIMEOUT : 0);
+	while (wait && status == GL_TIMEOUT_EXPIRED)
+		status = glClientWaitSync(slot.fence, 0, FENCE_TIMEOUT);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+	GL_CALL(glDeleteSync(slot.fence));
+	slot.fence = nullptr;
+	ringHead = (ringHead + 1) % RING_SIZE;
+	--ringCount;
+	Frame frame;
+	{
+		//Block whilst the encoders are too far behind
+		std::unique_lock<std::mutex> lock(mutex);
+		queueChanged.wait(lock, [this](){ return queue.size() < MAX_QUEUED_FRAMES; });
+		if (!spare.empty())
+		{
+			frame = std::move(spare.back());
+			spare.pop_back();
+		}
+	}
+	frame.index = slot.index;
+	frame.dims = slot.dims;
+	frame.pixels.resize(slot.size);
+	GLint previousPack = 0;
+	GL_CALL(glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previousPack));
+	GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo));
+	const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+	if (mapped)
+	{
+		memcpy(frame.pixels.data(), mapped, slot.size);
+		GL_CALL(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+	}
+	GL_CALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, previousPack));
+	if (!mapped)
+	{
+		fprintf(stderr, "FrameCapture: Failed to map frame %llu.\n", slot.index);
+		return true;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(frame));
+	}
+	queueChanged.notify_all();
+	return true;
+}
+void FrameCapture::finish()
+{
+	if (!encoders.empty() || ringCount)
+	{
+		while (ringCount)
+			retire(true);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopEncoders = true;
+		}
+		queueChanged.notify_all();
+		for (auto &&t : encoders)
+			t.join();
+		encoders.clear();
+	}
+	if (!finished)
+	{
+		GLuint pbos[RING_SIZE];
+		for (unsigned int i = 0; i < RING_SIZE; ++i)
+			pbos[i] = ring[i].pbo;
+		GL_CALL(glDeleteBuffers(RING_SIZE, pbos));
+		if (resolveFramebuffer)
+		{
+			GL_CALL(glDeleteFramebuffers(1, &resolveFramebuffer));
+			GL_CALL(glDeleteRenderbuffers(1, &resolveRenderbuffer));
+		}
+	}
+	if (file)
+	{
+		if (ferror(file))
+			good = false;
+		fclose(file);
+		file = nullptr;
+	}
+	finished = true;
+}
+void FrameCapture::encodeLoop()
+{
+	while (true)
+	{
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queueChanged.wait(lock, [this](){ return stopEncoders || !queue.empty(); });
+			if (queue.empty())
+				return;
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+		queueChanged.notify_all();
+		if (format == PNG)
+			writePNG(frame);
+		else
+			writeYUV(frame);
+		std::lock_guard<std::mutex> lock(mutex);
+		spare.push_back(std::move(frame));
+	}
+}
+void FrameCapture::writePNG(const Frame &frame)
+{
+	//Flip rows, so that the top row is first
+	const size_t pitch = frame.dims.x * 4;
+	std::vector<unsigned char> flipped(frame.pixels.size());
+	for (unsigned int y = 0; y < frame.dims.y; ++y)
+		memcpy(flipped.data() + y * pitch, frame.pixels.data() + (frame.dims.y - 1 - y) * pitch, pitch);
+	SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(flipped.data(), frame.dims.x, frame.dims.y, 32, (int)pitch, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+	const std::string suffix = su::format("%06llu.png", frame.index);
+	if (!surface || IMG_SavePNG(surface, (path + suffix).c_str()))
+	{
+		fprintf(stderr, "FrameCapture: Failed to write '%s%s': %s\n", path.c_str(), suffix.c_str(), SDL_GetError());
+		good = false;
+	}
+	else
+	{
+		++framesWritten;
+	}
+	SDL_FreeSurface(surface);
+}
+void FrameCapture::writeYUV(const Frame &frame)
+{
+	if (streamDims == glm::uvec2(0))
+	{
+		streamDims = frame.dims;
+		if (format == Y4M)
+			fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", streamDims.x, streamDims.y, fps);
+	}
+	else if (frame.dims != streamDims)
+	{
+		fprintf(stderr, "FrameCapture: Frame %llu skipped, dimensions differ from the stream.\n", frame.index);
+		return;
+	}
+	const unsigned int w = frame.dims.x, h = frame.dims.y;
+	const unsigned int cw = (w + 1) / 2, ch = (h + 1) / 2;
+	yuv.resize(w * h + 2 * cw * ch);
+	unsigned char *Y = yuv.data();
+	unsigned char *U = Y + w * h;
+	unsigned char *V = U + cw * ch;
+	//Returns the pixel at (x, y), with y = 0 as the top row
+	auto rgb = [&frame, w, h](unsigned int x, unsigned int y)
+	{
+		const unsigned char *p = frame.pixels.data() + ((h - 1 - glm::min(y, h - 1)) * w + glm::min(x, w - 1)) * 4;
+		return glm::ivec3(p[0], p[1], p[2]);
+	};
+	//Fixed point BT.601 limited range coefficients
+	for (unsigned int y = 0; y < h; ++y)
+	{
+		for (unsigned int x = 0; x < w; ++x)
+		{
+			const glm::ivec3 c = rgb(x, y);
+			Y[y * w + x] = (unsigned char)(((66 * c.r + 129 * c.g + 25 * c.b + 128) >> 8) + 16);
+		}
+	}
+	//Chroma is subsampled, each sample averages a 2x2 block
+	for (unsigned int y = 0; y < ch; ++y)
+	{
+		for (unsigned int x = 0; x < cw; ++x)
+		{
+			const glm::ivec3 c = (rgb(2 * x, 2 * y) + rgb(2 * x + 1, 2 * y) + rgb(2 * x, 2 * y + 1) + rgb(2 * x + 1, 2 * y + 1) + 2) / 4;
+			U[y * cw + x] = (unsigned char)(((-38 * c.r - 74 * c.g + 112 * c.b + 128) >> 8) + 128);
+			V[y * cw + x] = (unsigned char)(((112 * c.r - 94 * c.g - 18 * c.b + 128) >> 8) + 128);
+		}
+	}
+	if (format == Y4M)
+		fputs("FRAME\n", file);
+	if (fwrite(yuv.data(), 1, yuv.size(), file) != yuv.size())
+	{
+		fprintf(stderr, "FrameCapture: Failed to write frame %llu.\n", frame.index);
+		good = false;
+		return;
+	}
+	++framesWritten;
+}
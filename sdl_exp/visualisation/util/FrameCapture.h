@@ -0,0 +1,160 @@
+#ifndef __FrameCapture_h__
+#define __FrameCapture_h__
+
+#include "GLcheck.h"
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Records rendered frames to disk without stalling the render loop
+ * Each frame is read back asynchronously into a ring of pixel pack buffers, these are mapped RING_SIZE-1 frames later (once their fence has signalled)
+ * The pixels are then passed to encoder threads, which write either a PNG sequence or a raw YUV 4:2:0 stream (e.g. for piping into ffmpeg)
+ * If the encoders fall behind by more than MAX_QUEUED_FRAMES, capture() blocks, frames are never dropped
+ * Usage:
+ *   FrameCapture capture("run.y4m", FrameCapture::Y4M, 60);
+ *   ...render frame...
+ *   capture.capture(0, windowDims);//Before SDL_GL_SwapWindow()
+ * @note All methods must be called from the thread owning the GL context
+ */
+class FrameCapture
+{
+public:
+	enum Format
+	{
+		/**
+		 * One PNG per frame, the path is used as a prefix (e.g. "capture/frame_" -> "capture/frame_000000.png")
+		 */
+		PNG,
+		/**
+		 * YUV4MPEG2 stream, playable directly and accepted by ffmpeg -i
+		 */
+		Y4M,
+		/**
+		 * Headerless planar YUV 4:2:0 (I420) stream, for ffmpeg -f rawvideo -pix_fmt yuv420p -s WxH
+		 */
+		YUV
+	};
+	/**
+	 * The number of pixel pack buffers in the ring
+	 */
+	static const unsigned int RING_SIZE = 4;
+	/**
+	 * The number of mapped frames that may await encoding, before capture() blocks
+	 */
+	static const unsigned int MAX_QUEUED_FRAMES = 8;
+	/**
+	 * Opens the output and starts the encoder threads
+	 * @param path Output file (Y4M, YUV) or prefix of the output files (PNG)
+	 * @param format The output format
+	 * @param fps Frame rate written to Y4M headers
+	 */
+	FrameCapture(const std::string &path, Format format, unsigned int fps = 60);
+	/**
+	 * Calls finish()
+	 */
+	~FrameCapture();
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture &operator=(const FrameCapture&) = delete;
+	/**
+	 * Begins reading back color attachment 0 of the framebuffer (or the back buffer if framebuffer is 0)
+	 * Completed readbacks from earlier frames are handed to the encoders
+	 * @param framebuffer Name of the framebuffer to capture, multisampled framebuffers are resolved first
+	 * @param dims Dimensions of the region to capture, from the framebuffer's origin
+	 * @note Y4M and YUV streams require every frame to share the dimensions of the first, other frames are skipped
+	 */
+	void capture(GLuint framebuffer, glm::uvec2 dims);
+	/**
+	 * Waits for outstanding readbacks, encodes them and closes the output
+	 * Subsequent calls to capture() are ignored
+	 */
+	void finish();
+	/**
+	 * @return The number of frames written to the output
+	 */
+	unsigned long long getFramesWritten() const { return framesWritten; }
+	/**
+	 * @return False if the output could not be opened, or writing has failed
+	 */
+	bool isGood() const { return good; }
+private:
+	struct Frame
+	{
+		unsigned long long index;
+		glm::uvec2 dims;
+		/**
+		 * RGBA8 pixels, bottom row first (as returned by glReadPixels())
+		 */
+		std::vector<unsigned char> pixels;
+	};
+	struct Slot
+	{
+		GLuint pbo;
+		size_t size;
+		GLsync fence;
+		unsigned long long index;
+		glm::uvec2 dims;
+	};
+	/**
+	 * Maps the oldest in flight slot, copies it's pixels into a Frame and queues it for encoding
+	 * @param wait If false, returns false without blocking if the slot's fence has not signalled
+	 */
+	bool retire(bool wait);
+	/**
+	 * Resolves a multisampled framebuffer into resolveFramebuffer
+	 * @return The framebuffer to read from
+	 */
+	GLuint resolve(GLuint framebuffer, glm::uvec2 dims);
+	/**
+	 * Encoder thread body, pops frames until finish() is called and the queue is empty
+	 */
+	void encodeLoop();
+	void writePNG(const Frame &frame);
+	/**
+	 * Converts to BT.601 (limited range) I420, flipping rows so the top row is first, and appends to the output
+	 */
+	void writeYUV(const Frame &frame);
+	const std::string path;
+	const Format format;
+	const unsigned int fps;
+	std::atomic<bool> good;
+	bool finished;
+	FILE *file;
+	/**
+	 * Dimensions of the stream, set by the first frame (Y4M, YUV)
+	 */
+	glm::uvec2 streamDims;
+	Slot ring[RING_SIZE];
+	/**
+	 * Index of the oldest in flight slot and the number of slots in flight
+	 */
+	unsigned int ringHead;
+	unsigned int ringCount;
+	unsigned long long frameIndex;
+	GLuint resolveFramebuffer;
+	GLuint resolveRenderbuffer;
+	glm::uvec2 resolveDims;
+	//Encoder state, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable queueChanged;
+	std::deque<Frame> queue;
+	/**
+	 * Frames whose pixel buffers can be reused, saves reallocating each frame
+	 */
+	std::vector<Frame> spare;
+	bool stopEncoders;
+	std::atomic<unsigned long long> framesWritten;
+	/**
+	 * PNG frames are independent so are encoded in parallel, streams use a single thread to preserve order
+	 */
+	std::vector<std::thread> encoders;
+	std::vector<unsigned char> yuv;
+};
+
+#endif //__FrameCapture_h__
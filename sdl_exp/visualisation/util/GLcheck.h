@@ -31,10 +31,18 @@ inline static void HandleGLError(const char *file, int line) {
 
 #endif //ifdef  _DEBUG
 
-inline static void InitGlew() {
+/**
+ * @param headless If true, the absence of a GLX display is not an error (contexts created via EGL have none)
+ */
+inline static void InitGlew(bool headless = false) {
     //https://www.opengl.org/wiki/OpenGL_Loading_Library#GLEW_.28OpenGL_Extension_Wrangler.29
     glewExperimental = GL_TRUE;
     GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    //GL entry points have already been loaded when glewInit() fails to find a display
+    if (headless && err == GLEW_ERROR_NO_GLX_DISPLAY)
+        err = GLEW_OK;
+#endif
     if (GLEW_OK != err)
     {
         fprintf(stderr, "Error: %s\n", (char *)glewGetErrorString(err));
@@ -44,5 +52,6 @@ inline static void InitGlew() {
 	GLuint error = glGetError();//This error can be ignored, GL_INVALID_ENUMERANT
 }
 #define GLEW_INIT() (InitGlew())
+#define GLEW_INIT_HEADLESS() (InitGlew(true))
 
 #endif //ifndef __GLcheck_h__
@@ -0,0 +1,3 @@
+#include "Interpolated.h"
+
+std::mutex InterpolatedBase::tickMutex;
@@ -0,0 +1,131 @@
+#ifndef __Interpolated_h__
+#define __Interpolated_h__
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <mutex>
+
+/**
+ * Linear interpolation, for locations and times
+ */
+struct LerpLinear
+{
+	template<typename T>
+	T operator()(const T &a, const T &b, float alpha) const { return glm::mix(a, b, alpha); }
+};
+/**
+ * Spherical interpolation of rotations stored as glm::vec4(axis.x, axis.y, axis.z, degrees)
+ */
+struct LerpAxisAngle
+{
+	glm::vec4 operator()(const glm::vec4 &a, const glm::vec4 &b, float alpha) const
+	{
+		if (a == b)
+			return a;
+		const glm::quat q = glm::slerp(toQuat(a), toQuat(b), alpha);
+		const float angle = glm::angle(q);
+		if (angle == 0.0f)
+			return glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		return glm::vec4(glm::axis(q), glm::degrees(angle));
+	}
+private:
+	static glm::quat toQuat(const glm::vec4 &r)
+	{
+		//A zero axis or angle represents no rotation
+		if (r.w == 0.0f || (r.x == 0.0f && r.y == 0.0f && r.z == 0.0f))
+			return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		return glm::angleAxis(glm::radians(r.w), glm::normalize(glm::vec3(r)));
+	}
+};
+/**
+ * State shared by every Interpolated
+ */
+class InterpolatedBase
+{
+public:
+	/**
+	 * Held by Visualisation whilst a tick is committed or interpolated, and by set() and getSimulated()
+	 * This permits the renderer to read simulated values whilst the simulation thread writes them
+	 */
+	static std::mutex tickMutex;
+};
+/**
+ * Double buffered state of a value, which is written by a fixed timestep simulation and read by the renderer
+ * set() and getSimulated() belong to the simulation, commit() latches the value at the end of each tick
+ * interpolate() blends the two most recently committed ticks, get() then returns the blended value to the renderer
+ * Until a tick has been interpolated (e.g. the visualisation is not running a fixed timestep), get() returns the latest set() value
+ * @note commit() and interpolate() must be called whilst holding tickMutex, so must not call set() or getSimulated()
+ * @see Visualisation::setSimulationTimestep()
+ */
+template<typename T, typename Lerp = LerpLinear>
+class Interpolated : public InterpolatedBase
+{
+public:
+	Interpolated(const T &value = T())
+		: value(value)
+		, previous(value)
+		, current(value)
+		, rendered(value)
+		, committed(false)
+		, interpolated(false)
+	{ }
+	void set(const T &value)
+	{
+		std::lock_guard<std::mutex> lock(tickMutex);
+		this->value = value;
+	}
+	/**
+	 * The most recently set() value, this may be called from any thread
+	 */
+	T getSimulated() const
+	{
+		std::lock_guard<std::mutex> lock(tickMutex);
+		return value;
+	}
+	/**
+	 * The value to render
+	 */
+	const T &get() const { return interpolated ? rendered : value; }
+	/**
+	 * Called at the end of each simulation tick
+	 */
+	void commit()
+	{
+		previous = committed ? current : value;
+		current = value;
+		committed = true;
+	}
+	/**
+	 * Called by the renderer before it reads get()
+	 * @param alpha Progress from the previous tick to the current tick [0, 1]
+	 */
+	void interpolate(float alpha)
+	{
+		if (!committed)
+			return;
+		rendered = Lerp()(previous, current, alpha);
+		interpolated = true;
+	}
+	/**
+	 * @return True once a tick has been committed, i.e. the value is driven by a fixed timestep simulation
+	 */
+	bool isTicked() const { return committed; }
+	/**
+	 * Discards committed ticks, so that get() returns the latest set() value again
+	 * Called when the visualisation stops running a fixed timestep
+	 */
+	void reset()
+	{
+		previous = current = rendered = value;
+		committed = false;
+		interpolated = false;
+	}
+private:
+	T value;
+	T previous, current;
+	T rendered;
+	bool committed;
+	bool interpolated;
+};
+
+#endif //__Interpolated_h__
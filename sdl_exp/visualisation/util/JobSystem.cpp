@@ -0,0 +1,192 @@
+#include "JobSystem.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+
+namespace
+{
+	/**
+	 * Chunks per thread selected by parallelFor() when grain is 0, more chunks balance uneven work at the cost of overhead
+	 */
+	const unsigned int CHUNKS_PER_THREAD = 4;
+	/**
+	 * Backs global(), function local statics aren't initialised thread safely by all supported compilers (VS2013)
+	 */
+	std::once_flag globalOnce;
+	std::unique_ptr<JobSystem> globalSystem;
+}
+
+JobSystem::JobSystem(unsigned int threads)
+	: queued(0)
+	, stop(false)
+{
+	if (!threads)
+		threads = glm::max(std::thread::hardware_concurrency(), 1u);
+	//The final queue is shared by threads which aren't workers
+	for (unsigned int i = 0; i < threads; ++i)
+		queues.push_back(std::make_unique<Queue>());
+	//Workers wait on sleepMutex until their indices have been recorded
+	std::lock_guard<std::mutex> lock(sleepMutex);
+	for (unsigned int i = 0; i + 1 < threads; ++i)
+	{
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+		workerIndices.emplace(workers.back().get_id(), i);
+	}
+}
+JobSystem::~JobSystem()
+{
+	stop = true;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+	for (auto &&w : workers)
+		w.join();
+}
+JobSystem &JobSystem::global()
+{
+	std::call_once(globalOnce, []{ globalSystem = std::make_unique<JobSystem>(); });
+	return *globalSystem;
+}
+unsigned int JobSystem::queueIndex() const
+{
+	auto it = workerIndices.find(std::this_thread::get_id());
+	return it != workerIndices.end() ? it->second : (unsigned int)workers.size();
+}
+JobSystem::TaskHandle JobSystem::submit(std::function<void()> job, const std::vector<TaskHandle> &dependencies)
+{
+	TaskHandle task = std::make_shared<Task>(std::move(job));
+	for (auto &&d : dependencies)
+	{
+		if (!d)
+			continue;
+		//Completion takes the same lock, so the dependency can't complete without seeing this task
+		std::lock_guard<std::mutex> lock(d->mutex);
+		if (!d->complete)
+		{
+			++task->pending;
+			d->dependents.push_back(task);
+		}
+	}
+	if (--task->pending == 0)
+		enqueue(task);
+	return task;
+}
+void JobSystem::enqueue(TaskHandle task)
+{
+	Queue &q = *queues[queueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.tasks.push_back(std::move(task));
+	}
+	++queued;
+	//Taking the lock ensures a worker can't miss the notification between testing queued and sleeping
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+JobSystem::TaskHandle JobSystem::take(unsigned int index)
+{
+	if (!queued)
+		return nullptr;
+	const unsigned int count = (unsigned int)queues.size();
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		Queue &q = *queues[(index + i) % count];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.tasks.empty())
+			continue;
+		TaskHandle task;
+		//Own queue is LIFO (cache warm), stolen tasks are the oldest
+		if (i == 0)
+		{
+			task = std::move(q.tasks.back());
+			q.tasks.pop_back();
+		}
+		else
+		{
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+		}
+		--queued;
+		return task;
+	}
+	return nullptr;
+}
+void JobSystem::execute(const TaskHandle &task)
+{
+	task->job();
+	//Release anything captured by the job
+	task->job = nullptr;
+	std::vector<TaskHandle> dependents;
+	{
+		std::lock_guard<std::mutex> lock(task->mutex);
+		task->complete = true;
+		dependents.swap(task->dependents);
+	}
+	for (auto &&d : dependents)
+	{
+		if (--d->pending == 0)
+			enqueue(d);
+	}
+}
+void JobSystem::workerLoop(unsigned int index)
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	while (!stop)
+	{
+		if (TaskHandle task = take(index))
+		{
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]{ return stop || queued > 0; });
+	}
+}
+void JobSystem::wait(const TaskHandle &task)
+{
+	const unsigned int index = queueIndex();
+	while (!isComplete(task))
+	{
+		if (TaskHandle t = take(index))
+			execute(t);
+		else
+			std::this_thread::yield();
+	}
+}
+bool JobSystem::isComplete(const TaskHandle &task)
+{
+	return !task || task->complete;
+}
+JobSystem::TaskHandle JobSystem::parallelForAsync(unsigned int begin, unsigned int end, unsigned int grain, std::function<void(unsigned int, unsigned int)> job, const std::vector<TaskHandle> &dependencies)
+{
+	const unsigned int count = end > begin ? end - begin : 0;
+	if (!grain)
+		grain = glm::max((count + getThreadCount() * CHUNKS_PER_THREAD - 1) / (getThreadCount() * CHUNKS_PER_THREAD), 1u);
+	//Chunks share the job, rather than each copying it
+	auto shared = std::make_shared<std::function<void(unsigned int, unsigned int)>>(std::move(job));
+	std::vector<TaskHandle> chunks;
+	chunks.reserve((count + grain - 1) / grain);
+	for (unsigned int offset = 0; offset < count; offset += glm::min(grain, count - offset))
+	{
+		const unsigned int chunkBegin = begin + offset;
+		const unsigned int chunkEnd = chunkBegin + glm::min(grain, count - offset);
+		chunks.push_back(submit([shared, chunkBegin, chunkEnd]{ (*shared)(chunkBegin, chunkEnd); }, dependencies));
+	}
+	return chunks.size() == 1 ? chunks[0] : submit([]{}, chunks.empty() ? dependencies : chunks);
+}
+void JobSystem::parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &job)
+{
+	if (end <= begin)
+		return;
+	//Not worth the overhead of tasks
+	if (workers.empty() || (grain && end - begin <= grain))
+	{
+		job(begin, end);
+		return;
+	}
+	wait(parallelForAsync(begin, end, grain, job));
+}
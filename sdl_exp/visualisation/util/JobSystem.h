@@ -0,0 +1,135 @@
+#ifndef __JobSystem_h__
+#define __JobSystem_h__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A small work stealing thread pool for CPU side per frame work (animation, light transforms, culling, etc)
+ * Tasks may depend on other tasks, forming a graph, they are queued once every dependency has completed
+ * Each worker pops from the back of its own queue and steals from the front of the others when empty
+ * Threads which wait() on a task execute queued tasks until it completes, so tasks may submit and wait on tasks themselves
+ * Usage:
+ *   JobSystem &jobs = JobSystem::global();
+ *   auto animate = jobs.submit([&]{ model->update(t); });
+ *   auto bounds = jobs.submit([&]{ ... }, { animate });
+ *   jobs.parallelFor(0, count, 64, [&](unsigned int begin, unsigned int end){ ... });
+ *   jobs.wait(bounds);
+ * @note Tasks must not use the GL context, which belongs to the render thread
+ */
+class JobSystem
+{
+public:
+	class Task;
+	typedef std::shared_ptr<Task> TaskHandle;
+	/**
+	 * @param threads The number of threads which execute tasks, including the thread which waits, 0 selects std::thread::hardware_concurrency()
+	 */
+	explicit JobSystem(unsigned int threads = 0);
+	/**
+	 * Waits for the workers to finish their current tasks, queued tasks are discarded
+	 */
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem &operator=(const JobSystem&) = delete;
+	/**
+	 * Returns the shared job system, used by scenes for their built in per frame work
+	 */
+	static JobSystem &global();
+	/**
+	 * Queues a task, to execute once all of its dependencies have completed
+	 * @param job The work to execute
+	 * @param dependencies Tasks which must complete first, null handles are ignored
+	 * @return Handle to the task, to wait on or to depend upon
+	 */
+	TaskHandle submit(std::function<void()> job, const std::vector<TaskHandle> &dependencies = {});
+	/**
+	 * Executes queued tasks until task has completed
+	 */
+	void wait(const TaskHandle &task);
+	/**
+	 * @return True if task is null or has completed
+	 */
+	static bool isComplete(const TaskHandle &task);
+	/**
+	 * Splits [begin, end) into chunks of (at most) grain elements, which are processed in parallel
+	 * @param grain Elements per chunk, 0 selects enough chunks to balance across the threads
+	 * @param job Called once per chunk, with the chunk's range [begin, end)
+	 * @param dependencies Tasks which must complete before any chunk executes
+	 * @return A task which completes once every chunk has
+	 */
+	TaskHandle parallelForAsync(unsigned int begin, unsigned int end, unsigned int grain, std::function<void(unsigned int, unsigned int)> job, const std::vector<TaskHandle> &dependencies = {});
+	/**
+	 * As parallelForAsync(), but returns once every chunk has completed
+	 * Ranges smaller than a single chunk are executed directly by the calling thread
+	 */
+	void parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &job);
+	/**
+	 * @return The number of threads which execute tasks, including the waiting thread
+	 */
+	unsigned int getThreadCount() const { return (unsigned int)workers.size() + 1; }
+	class Task
+	{
+		friend class JobSystem;
+	public:
+		explicit Task(std::function<void()> job) : job(std::move(job)), pending(1), complete(false) { }
+	private:
+		std::function<void()> job;
+		/**
+		 * Incomplete dependencies, plus one whilst the task is being submitted
+		 */
+		std::atomic<int> pending;
+		std::atomic<bool> complete;
+		/**
+		 * Guards dependents against the task completing whilst they are added
+		 */
+		std::mutex mutex;
+		std::vector<TaskHandle> dependents;
+	};
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<TaskHandle> tasks;
+	};
+	/**
+	 * Pushes a task whose dependencies have completed onto the calling thread's queue
+	 */
+	void enqueue(TaskHandle task);
+	/**
+	 * Pops from the back of queue index, else steals from the front of another queue
+	 * @return nullptr if every queue is empty
+	 */
+	TaskHandle take(unsigned int index);
+	/**
+	 * Executes the task, then queues any dependents which it unblocks
+	 */
+	void execute(const TaskHandle &task);
+	void workerLoop(unsigned int index);
+	/**
+	 * Index of the calling thread's queue, threads which aren't workers share the final queue
+	 */
+	unsigned int queueIndex() const;
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Queue>> queues;
+	/**
+	 * The number of tasks within queues, workers sleep whilst this is 0
+	 */
+	std::atomic<unsigned int> queued;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<bool> stop;
+	/**
+	 * Queue index of each worker thread, built before the workers begin taking tasks and constant thereafter
+	 */
+	std::unordered_map<std::thread::id, unsigned int> workerIndices;
+};
+
+#endif //__JobSystem_h__
@@ -0,0 +1,229 @@
+#include "Profiler.h"
+#include <cstdio>
+
+namespace
+{
+	/**
+	 * Writes str as a JSON string literal
+	 */
+	void writeJSONString(FILE *f, const char *str)
+	{
+		fputc('"', f);
+		for (; *str; ++str)
+		{
+			if (*str == '"' || *str == '\\')
+				fputc('\\', f);
+			if ((unsigned char)*str >= 0x20)
+				fputc(*str, f);
+		}
+		fputc('"', f);
+	}
+}
+
+bool Profiler::enabled = true;
+bool Profiler::inFrame = false;
+std::thread::id Profiler::frameThread;
+unsigned long long Profiler::frameIndex = 0;
+std::chrono::steady_clock::time_point Profiler::epoch = std::chrono::steady_clock::now();
+Profiler::Frame Profiler::current;
+std::vector<unsigned int> Profiler::open;
+Profiler::Frame Profiler::pending[BUFFERED_FRAMES];
+bool Profiler::pendingValid[BUFFERED_FRAMES] = {};
+std::vector<GLuint> Profiler::queries[BUFFERED_FRAMES];
+unsigned int Profiler::queriesUsed[BUFFERED_FRAMES] = {};
+std::deque<Profiler::Frame> Profiler::history;
+std::unordered_set<std::string> Profiler::names;
+
+Profiler::Scope::Scope(const char *name, bool gpu)
+	: event(-1)
+	, frame(0)
+{
+	if (frameThread != std::this_thread::get_id() || !enabled || !inFrame)
+		return;
+	frame = frameIndex;
+	Event e;
+	e.name = name;
+	e.depth = (unsigned int)open.size();
+	e.cpuBegin = now() - current.start;
+	e.cpuEnd = e.cpuBegin;
+	e.gpuBegin = -1.0;
+	e.gpuEnd = -1.0;
+	e.gpuQuery = gpu ? queryTimestamp() : -1;
+	if (gpu)
+		queryTimestamp();//End query is reserved now, so that the pair are adjacent
+	event = (int)current.events.size();
+	current.events.push_back(e);
+	open.push_back(event);
+}
+Profiler::Scope::Scope(const std::string &name, bool gpu)
+	: Scope(frameThread == std::this_thread::get_id() && enabled && inFrame ? intern(name) : nullptr, gpu)
+{ }
+Profiler::Scope::~Scope()
+{
+	//Scopes which outlive their frame are ignored
+	if (event < 0 || frameThread != std::this_thread::get_id() || !inFrame || frame != frameIndex)
+		return;
+	Event &e = current.events[event];
+	e.cpuEnd = now() - current.start;
+	if (e.gpuQuery >= 0)
+	{
+		GL_CALL(glQueryCounter(queries[frameIndex % BUFFERED_FRAMES][e.gpuQuery + 1], GL_TIMESTAMP));
+	}
+	if (!open.empty() && open.back() == (unsigned int)event)
+		open.pop_back();
+}
+double Profiler::now()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - epoch).count();
+}
+int Profiler::queryTimestamp()
+{
+	const unsigned int slot = frameIndex % BUFFERED_FRAMES;
+	std::vector<GLuint> &pool = queries[slot];
+	if (queriesUsed[slot] == pool.size())
+	{//Grow the pool geometrically
+		const size_t oldSize = pool.size();
+		pool.resize(oldSize ? oldSize * 2 : 64);
+		GL_CALL(glGenQueries((GLsizei)(pool.size() - oldSize), pool.data() + oldSize));
+	}
+	//Even numbered queries are issued immediately, odd numbered are issued by the end of a scope or frame
+	if (queriesUsed[slot] % 2 == 0)
+	{
+		GL_CALL(glQueryCounter(pool[queriesUsed[slot]], GL_TIMESTAMP));
+	}
+	return (int)queriesUsed[slot]++;
+}
+void Profiler::beginFrame()
+{
+	if (inFrame)
+		endFrame();
+	const unsigned int slot = frameIndex % BUFFERED_FRAMES;
+	//Collect the frame which last used this slot's queries
+	if (pendingValid[slot])
+		resolve(slot);
+	if (!enabled)
+		return;
+	frameThread = std::this_thread::get_id();
+	inFrame = true;
+	current.index = frameIndex;
+	current.start = now();
+	current.cpuTime = 0.0;
+	current.gpuTime = -1.0;
+	current.events.clear();
+	open.clear();
+	queriesUsed[slot] = 0;
+	queryTimestamp();
+	queryTimestamp();
+}
+void Profiler::endFrame()
+{
+	if (!inFrame)
+		return;
+	const unsigned int slot = frameIndex % BUFFERED_FRAMES;
+	current.cpuTime = now() - current.start;
+	//Close any scopes left open
+	for (unsigned int i : open)
+	{
+		current.events[i].cpuEnd = current.cpuTime;
+		if (current.events[i].gpuQuery >= 0)
+		{
+			GL_CALL(glQueryCounter(queries[slot][current.events[i].gpuQuery + 1], GL_TIMESTAMP));
+		}
+	}
+	GL_CALL(glQueryCounter(queries[slot][1], GL_TIMESTAMP));
+	std::swap(pending[slot], current);
+	pendingValid[slot] = true;
+	inFrame = false;
+	++frameIndex;
+}
+void Profiler::resolve(unsigned int slot)
+{
+	Frame &frame = pending[slot];
+	pendingValid[slot] = false;
+	//Timestamps complete in order, the frame's end (issued by endFrame() after every scope's end) is the last issued, so if it's available all of them are
+	GLint available = 0;
+	GL_CALL(glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available));
+	if (available)
+	{
+		std::vector<GLuint64> results(queriesUsed[slot]);
+		for (unsigned int i = 0; i < queriesUsed[slot]; ++i)
+		{
+			GL_CALL(glGetQueryObjectui64v(queries[slot][i], GL_QUERY_RESULT, &results[i]));
+		}
+		const GLuint64 origin = results[0];
+		frame.gpuTime = (results[1] - origin) / 1e6;
+		for (auto &&e : frame.events)
+		{
+			if (e.gpuQuery < 0)
+				continue;
+			e.gpuBegin = (results[e.gpuQuery] - origin) / 1e6;
+			e.gpuEnd = (results[e.gpuQuery + 1] - origin) / 1e6;
+		}
+	}
+	history.push_back(std::move(frame));
+	while (history.size() > HISTORY_LENGTH)
+		history.pop_front();
+}
+void Profiler::setEnabled(bool enabled)
+{
+	if (!enabled)
+		endFrame();
+	Profiler::enabled = enabled;
+}
+const char *Profiler::intern(const std::string &name)
+{
+	//Elements of unordered_set are never relocated, so the pointer remains valid
+	return names.insert(name).first->c_str();
+}
+void Profiler::clear()
+{
+	inFrame = false;
+	open.clear();
+	current.events.clear();
+	history.clear();
+	for (unsigned int i = 0; i < BUFFERED_FRAMES; ++i)
+	{
+		pendingValid[i] = false;
+		queriesUsed[i] = 0;
+		if (!queries[i].empty())
+		{
+			GL_CALL(glDeleteQueries((GLsizei)queries[i].size(), queries[i].data()));
+		}
+		queries[i].clear();
+	}
+}
+bool Profiler::exportTrace(const std::string &path)
+{
+	FILE *f = fopen(path.c_str(), "w");
+	if (!f)
+	{
+		fprintf(stderr, "Profiler::exportTrace(): Unable to open '%s' for writing.\n", path.c_str());
+		return false;
+	}
+	//Timestamps are in microseconds, tid 1 is the CPU, tid 2 is the GPU
+	fprintf(f, "{\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+	for (auto &&frame : history)
+	{
+		fprintf(f, ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}", frame.start * 1000.0, frame.cpuTime * 1000.0, frame.index);
+		if (frame.gpuTime >= 0)
+			fprintf(f, ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}", frame.start * 1000.0, frame.gpuTime * 1000.0, frame.index);
+		for (auto &&e : frame.events)
+		{
+			fprintf(f, ",\n{\"name\":");
+			writeJSONString(f, e.name);
+			fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}", (frame.start + e.cpuBegin) * 1000.0, (e.cpuEnd - e.cpuBegin) * 1000.0);
+			if (e.gpuBegin >= 0)
+			{
+				fprintf(f, ",\n{\"name\":");
+				writeJSONString(f, e.name);
+				fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}", (frame.start + e.gpuBegin) * 1000.0, (e.gpuEnd - e.gpuBegin) * 1000.0);
+			}
+		}
+	}
+	fprintf(f, "\n]}\n");
+	const bool success = !ferror(f);
+	fclose(f);
+	return success;
+}
@@ -0,0 +1,179 @@
+#ifndef __Profiler_h__
+#define __Profiler_h__
+
+#include "GLcheck.h"
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Records the CPU (and optionally GPU) time spent within named scopes of each frame
+ * GPU times are measured with GL_TIMESTAMP queries, results are collected BUFFERED_FRAMES frames later so reading them never stalls the pipeline
+ * Usage:
+ *   Profiler::beginFrame();
+ *   {
+ *       Profiler::Scope scope("Shadows", true);
+ *       ...
+ *   }
+ *   Profiler::endFrame();
+ * @note Scopes are only recorded between beginFrame() and endFrame(), and only from the thread which called beginFrame()
+ * @see ProfilerGraph for displaying the results on the HUD
+ */
+class Profiler
+{
+public:
+	/**
+	 * The number of frames whose queries may be in flight, this is the latency of GPU results
+	 */
+	static const unsigned int BUFFERED_FRAMES = 2;
+	/**
+	 * The number of completed frames retained by getHistory()
+	 */
+	static const unsigned int HISTORY_LENGTH = 300;
+	/**
+	 * A single execution of a scope
+	 */
+	struct Event
+	{
+		/**
+		 * Name of the scope, this pointer remains valid for the life of the program
+		 */
+		const char *name;
+		/**
+		 * The number of scopes which enclose this scope
+		 */
+		unsigned int depth;
+		/**
+		 * Times relative to the start of the frame, in milliseconds
+		 * gpuBegin and gpuEnd are negative if the scope was not timed on the GPU, or the results were not ready in time
+		 */
+		double cpuBegin, cpuEnd;
+		double gpuBegin, gpuEnd;
+		/**
+		 * Index of the event's first timestamp query within its frame's pool, -1 if not timed on the GPU
+		 */
+		int gpuQuery;
+	};
+	struct Frame
+	{
+		unsigned long long index;
+		/**
+		 * Time the frame began, in milliseconds since the profiler was first used
+		 */
+		double start;
+		/**
+		 * Duration of the frame, in milliseconds
+		 * gpuTime is the duration between GPU timestamps issued by beginFrame() and endFrame(), negative if unavailable
+		 */
+		double cpuTime, gpuTime;
+		/**
+		 * Events ordered by their beginning
+		 */
+		std::vector<Event> events;
+	};
+	/**
+	 * Times the enclosing C++ scope, from construction to destruction
+	 */
+	class Scope
+	{
+	public:
+		/**
+		 * @param name Name of the scope, this must remain valid for the life of the program (e.g. a string literal)
+		 * @param gpu If true, the GPU time of commands issued within the scope is also measured
+		 */
+		explicit Scope(const char *name, bool gpu = false);
+		/**
+		 * @param name Name of the scope, this is interned, so may be temporary
+		 * @param gpu If true, the GPU time of commands issued within the scope is also measured
+		 */
+		explicit Scope(const std::string &name, bool gpu = false);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope &operator=(const Scope&) = delete;
+	private:
+		/**
+		 * Index of the scope's event within the current frame, -1 if the scope is not being recorded
+		 */
+		int event;
+		unsigned long long frame;
+	};
+	/**
+	 * Begins recording a frame, this also collects the GPU results of the frame BUFFERED_FRAMES ago
+	 */
+	static void beginFrame();
+	/**
+	 * Completes the current frame, any scopes still open are ignored
+	 */
+	static void endFrame();
+	/**
+	 * When disabled, scopes and frames cost next to nothing and are not recorded
+	 * @note Enabled by default
+	 */
+	static void setEnabled(bool enabled);
+	static bool isEnabled() { return enabled; }
+	/**
+	 * Returns the completed frames, oldest first
+	 * @note The most recent BUFFERED_FRAMES frames are not included, as their GPU results are still pending
+	 */
+	static const std::deque<Frame> &getHistory() { return history; }
+	/**
+	 * Writes the history in Chrome's trace event format, this can be viewed with chrome://tracing or ui.perfetto.dev
+	 * CPU and GPU events appear as separate threads, GPU events are aligned to the start of their CPU frame
+	 * @param path Path of the JSON file to be written
+	 * @return True on success
+	 */
+	static bool exportTrace(const std::string &path);
+	/**
+	 * Returns a pointer to a copy of name, which remains valid for the life of the program
+	 * Identical names share the same pointer
+	 */
+	static const char *intern(const std::string &name);
+	/**
+	 * Discards the history and any pending frames, and releases the GL queries
+	 * @note This must be called before the GL context is destroyed
+	 */
+	static void clear();
+private:
+	/**
+	 * @return Milliseconds since the profiler was first used
+	 */
+	static double now();
+	/**
+	 * Issues a timestamp query from the current frame's pool
+	 * @return The index of the query within the pool
+	 */
+	static int queryTimestamp();
+	/**
+	 * Collects the GPU results of the frame held in the slot and appends it to the history
+	 * If the results are not yet available the frame is appended without them, rather than stalling
+	 */
+	static void resolve(unsigned int slot);
+	static bool enabled;
+	static bool inFrame;
+	/**
+	 * The thread which last called beginFrame(), scopes on other threads (e.g. the simulation thread) are ignored
+	 */
+	static std::thread::id frameThread;
+	static unsigned long long frameIndex;
+	static std::chrono::steady_clock::time_point epoch;
+	static Frame current;
+	/**
+	 * Indices of the scopes currently open within the current frame
+	 */
+	static std::vector<unsigned int> open;
+	/**
+	 * Frames awaiting GPU results, and their timestamp query pools
+	 * Queries 0 and 1 of each pool hold the frame's begin and end timestamps
+	 */
+	static Frame pending[BUFFERED_FRAMES];
+	static bool pendingValid[BUFFERED_FRAMES];
+	static std::vector<GLuint> queries[BUFFERED_FRAMES];
+	static unsigned int queriesUsed[BUFFERED_FRAMES];
+	static std::deque<Frame> history;
+	static std::unordered_set<std::string> names;
+};
+
+#endif //__Profiler_h__
@@ -0,0 +1,156 @@
+#include "RayCaster.h"
+#include <algorithm>
+
+RayCaster::RayCaster(JobSystem &jobs)
+	: jobs(jobs)
+	, nextID(0)
+{ }
+unsigned int RayCaster::add(std::function<std::shared_ptr<const MeshBVH>()> build, Transform transform)
+{
+	Object o;
+	o.built = std::make_shared<std::shared_ptr<const MeshBVH>>();
+	auto built = o.built;
+	o.build = jobs.submit([built, build](){ *built = build(); });
+	o.transform = transform;
+	objects.emplace(nextID, std::move(o));
+	return nextID++;
+}
+unsigned int RayCaster::add(const std::shared_ptr<const MeshBVH> &mesh, Transform transform)
+{
+	Object o;
+	o.mesh = mesh;
+	o.transform = transform;
+	objects.emplace(nextID, std::move(o));
+	return nextID++;
+}
+void RayCaster::remove(unsigned int object)
+{
+	objects.erase(object);
+}
+void RayCaster::update()
+{
+	instances.clear();
+	std::vector<glm::vec3> mins, maxs;
+	for (auto &&it : objects)
+	{
+		Object &o = it.second;
+		if (o.build)
+		{
+			jobs.wait(o.build);
+			o.mesh = *o.built;
+			o.build.reset();
+			o.built.reset();
+		}
+		if (!o.mesh || !o.mesh->getTriangleCount())
+			continue;
+		const glm::mat4 m = o.transform ? o.transform() : glm::mat4(1);
+		instances.push_back({ o.mesh, glm::inverse(m), glm::transpose(glm::inverse(glm::mat3(m))), it.first });
+		//World bounds of the object's bounds' corners
+		const glm::vec3 lo = o.mesh->getMin(), hi = o.mesh->getMax();
+		glm::vec3 wMin(FLT_MAX), wMax(-FLT_MAX);
+		for (int c = 0; c < 8; ++c)
+		{
+			const glm::vec3 p = glm::vec3(m * glm::vec4(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z, 1.0f));
+			wMin = glm::min(wMin, p);
+			wMax = glm::max(wMax, p);
+		}
+		mins.push_back(wMin);
+		maxs.push_back(wMax);
+	}
+	const std::vector<unsigned int> order = tlas.build(mins, maxs);
+	std::vector<Instance> ordered;
+	ordered.reserve(order.size());
+	for (auto &&i : order)
+		ordered.push_back(std::move(instances[i]));
+	instances.swap(ordered);
+}
+RayHit RayCaster::intersect(const Ray &ray) const
+{
+	RayHit rtn;
+	tlas.traverse(ray, ray.tMax, [&](unsigned int first, unsigned int count, float &tMax){
+		for (unsigned int i = first; i < first + count; ++i)
+		{
+			const Instance &inst = instances[i];
+			//The direction isn't renormalised, so t is equal in both spaces
+			const Ray local(glm::vec3(inst.toObject * glm::vec4(ray.origin, 1.0f)), glm::mat3(inst.toObject) * ray.direction, tMax);
+			if (inst.mesh->intersect(local, rtn))
+			{
+				rtn.object = inst.object;
+				rtn.normal = glm::normalize(inst.normalToWorld * rtn.normal);
+				tMax = rtn.t;
+			}
+		}
+		return false;
+	});
+	return rtn;
+}
+bool RayCaster::occluded(const Ray &ray) const
+{
+	bool rtn = false;
+	tlas.traverse(ray, ray.tMax, [&](unsigned int first, unsigned int count, float &tMax){
+		for (unsigned int i = first; i < first + count && !rtn; ++i)
+		{
+			const Instance &inst = instances[i];
+			rtn = inst.mesh->occluded(Ray(glm::vec3(inst.toObject * glm::vec4(ray.origin, 1.0f)), glm::mat3(inst.toObject) * ray.direction, tMax));
+		}
+		return rtn;
+	});
+	return rtn;
+}
+void RayCaster::intersect(const Ray *rays, RayHit *hits, unsigned int count) const
+{
+	for (unsigned int i = 0; i < count; i += 4)
+	{
+		const unsigned int n = std::min(count - i, 4u);
+		RayHit *h = hits + i;
+		float tMax[4] = {};
+		for (unsigned int r = 0; r < n; ++r)
+		{
+			h[r] = RayHit();
+			h[r].t = tMax[r] = rays[i + r].tMax;
+		}
+		tlas.traversePacket(rays + i, (1 << n) - 1, tMax, [&](unsigned int first, unsigned int count, int active, float *tMax){
+			for (unsigned int j = first; j < first + count; ++j)
+			{
+				const Instance &inst = instances[j];
+				Ray local[4];
+				for (unsigned int r = 0; r < n; ++r)
+				{
+					if (active & (1 << r))
+						local[r] = Ray(glm::vec3(inst.toObject * glm::vec4(rays[i + r].origin, 1.0f)), glm::mat3(inst.toObject) * rays[i + r].direction, tMax[r]);
+				}
+				const int updated = inst.mesh->intersectPacket(local, h, active);
+				for (unsigned int r = 0; r < n; ++r)
+				{
+					if (!(updated & (1 << r)))
+						continue;
+					h[r].object = inst.object;
+					h[r].normal = glm::normalize(inst.normalToWorld * h[r].normal);
+					tMax[r] = h[r].t;
+				}
+			}
+			return active;
+		});
+		//Rays which hit nothing report the default t
+		for (unsigned int r = 0; r < n; ++r)
+			if (!h[r].hit())
+				h[r].t = FLT_MAX;
+	}
+}
+
+//Comment out this include if not making use of Entity
+#include "../Entity.h"
+#ifdef __Entity_h__
+unsigned int RayCaster::add(const std::shared_ptr<Entity> &entity)
+{
+	return add([entity](){ return std::shared_ptr<const MeshBVH>(entity->buildBVH()); }, [entity](){ return entity->getModelMat(); });
+}
+#endif //__Entity_h__
+//Comment out this include if not making use of Model
+#include "../model/Model.h"
+#ifdef __Model_h__
+unsigned int RayCaster::add(const std::shared_ptr<Model> &model)
+{
+	return add([model](){ return std::shared_ptr<const MeshBVH>(model->buildBVH()); }, [model](){ return model->getModelMat(); });
+}
+#endif //__Model_h__
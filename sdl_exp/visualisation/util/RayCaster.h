@@ -0,0 +1,114 @@
+#ifndef __RayCaster_h__
+#define __RayCaster_h__
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "BVH.h"
+#include "JobSystem.h"
+
+class Entity;
+class Model;
+
+/**
+ * CPU ray queries against Entities and Models placed within a scene, e.g. agent line of sight, picking without the GPU, terrain following
+ * Each object's MeshBVH is built by a job when it is added, so many meshes build in parallel
+ * update() samples each object's transform and rebuilds a top level BVH over their world bounds
+ * Rays are transformed into each object's space, so moving objects never require their MeshBVH to be rebuilt
+ * Usage:
+ *   RayCaster rays;
+ *   const unsigned int terrainID = rays.add(terrain);
+ *   rays.add(model);
+ *   ...once per tick, after objects have moved...
+ *   rays.update();
+ *   RayHit hit = rays.intersect(Ray(agentPos + glm::vec3(0, 100, 0), glm::vec3(0, -1, 0)));
+ *   if (hit.hit() && hit.object == terrainID) ...agentPos.y = 100 - hit.t...
+ * @note Queries are const, so may be made from many jobs at once, but not during update()
+ * @note Models are posed in bind pose, animation isn't reflected
+ */
+class RayCaster
+{
+public:
+	/**
+	 * Returns an object's model matrix, from object to world space
+	 */
+	typedef std::function<glm::mat4()> Transform;
+	/**
+	 * @param jobs The job system which builds each object's MeshBVH
+	 */
+	explicit RayCaster(JobSystem &jobs = JobSystem::global());
+	/**
+	 * Adds the entity, placed by Entity::getModelMat()
+	 * @return ID of the object, reported by hits
+	 */
+	unsigned int add(const std::shared_ptr<Entity> &entity);
+	/**
+	 * Adds the model, placed by Model::getModelMat(), hits report the index of the mesh hit as their element
+	 * @return ID of the object, reported by hits
+	 */
+	unsigned int add(const std::shared_ptr<Model> &model);
+	/**
+	 * Adds an existing BVH, this allows one BVH to be placed many times (e.g. instances)
+	 * @param transform Returns the object's model matrix, called by update()
+	 * @return ID of the object, reported by hits
+	 */
+	unsigned int add(const std::shared_ptr<const MeshBVH> &mesh, Transform transform);
+	/**
+	 * Adds an object whose MeshBVH is returned by build, which is submitted as a job (e.g. for generated geometry)
+	 * @param transform Returns the object's model matrix, called by update(), nullptr for identity
+	 * @return ID of the object, reported by hits
+	 */
+	unsigned int add(std::function<std::shared_ptr<const MeshBVH>()> build, Transform transform);
+	/**
+	 * Removes the object, this takes effect at the next update()
+	 */
+	void remove(unsigned int object);
+	/**
+	 * Waits for outstanding MeshBVH builds, samples each object's transform and rebuilds the top level BVH
+	 * Call after objects have moved, prior to querying
+	 */
+	void update();
+	/**
+	 * @return The nearest intersection within the ray's range, in world space
+	 */
+	RayHit intersect(const Ray &ray) const;
+	/**
+	 * Intersects rays in packets of 4, this is faster than single rays when rays of each packet are coherent
+	 * @param hits Receives the nearest intersection of each ray
+	 */
+	void intersect(const Ray *rays, RayHit *hits, unsigned int count) const;
+	/**
+	 * @return True if any object intersects the ray, e.g. line of sight is blocked
+	 */
+	bool occluded(const Ray &ray) const;
+	unsigned int getObjectCount() const { return (unsigned int)objects.size(); }
+private:
+	struct Object
+	{
+		std::shared_ptr<const MeshBVH> mesh;
+		/**
+		 * Receives the mesh from its build job, collected by update()
+		 */
+		std::shared_ptr<std::shared_ptr<const MeshBVH>> built;
+		JobSystem::TaskHandle build;
+		Transform transform;
+	};
+	/**
+	 * An object as placed by the last update(), stored in leaf order of the top level BVH
+	 */
+	struct Instance
+	{
+		std::shared_ptr<const MeshBVH> mesh;
+		glm::mat4 toObject;
+		glm::mat3 normalToWorld;
+		unsigned int object;
+	};
+	JobSystem &jobs;
+	std::map<unsigned int, Object> objects;
+	std::vector<Instance> instances;
+	BVH tlas;
+	unsigned int nextID;
+};
+
+#endif //__RayCaster_h__
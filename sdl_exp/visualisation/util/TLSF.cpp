@@ -0,0 +1,260 @@
+#include "TLSF.h"
+#include <cassert>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	/**
+	 * Index of the most significant set bit, x must be non zero
+	 */
+	unsigned int findLastSet(unsigned int x)
+	{
+#ifdef _MSC_VER
+		unsigned long i;
+		_BitScanReverse(&i, x);
+		return (unsigned int)i;
+#else
+		return 31 - __builtin_clz(x);
+#endif
+	}
+	/**
+	 * Index of the least significant set bit, x must be non zero
+	 */
+	unsigned int findFirstSet(unsigned int x)
+	{
+#ifdef _MSC_VER
+		unsigned long i;
+		_BitScanForward(&i, x);
+		return (unsigned int)i;
+#else
+		return __builtin_ctz(x);
+#endif
+	}
+	/**
+	 * Mask of the bits at or above index
+	 */
+	unsigned int bitsFrom(unsigned int index)
+	{
+		return index >= 32 ? 0 : ~0u << index;
+	}
+}
+
+TLSF::TLSF(unsigned int size)
+{
+	reset(size);
+}
+void TLSF::mapping(unsigned int size, unsigned int &fl, unsigned int &sl)
+{
+	if (size < SL_COUNT)
+	{//Small sizes have a bin each
+		fl = 0;
+		sl = size;
+	}
+	else
+	{
+		const unsigned int log2 = findLastSet(size);
+		sl = (size >> (log2 - SL_BITS)) ^ SL_COUNT;
+		fl = log2 - SL_BITS + 1;
+	}
+}
+void TLSF::mappingSearch(unsigned int size, unsigned int &fl, unsigned int &sl)
+{
+	if (size >= SL_COUNT)
+	{//Round up to the next bin, so any block within it is large enough
+		const unsigned int round = (1u << (findLastSet(size) - SL_BITS)) - 1;
+		size = size > UINT_MAX - round ? UINT_MAX : size + round;
+	}
+	mapping(size, fl, sl);
+}
+unsigned int TLSF::createNode(unsigned int offset, unsigned int size)
+{
+	unsigned int i;
+	if (spareNodes.empty())
+	{
+		i = (unsigned int)nodes.size();
+		nodes.push_back(Node());
+	}
+	else
+	{
+		i = spareNodes.back();
+		spareNodes.pop_back();
+	}
+	Node &n = nodes[i];
+	n.offset = offset;
+	n.size = size;
+	n.prevPhysical = n.nextPhysical = NONE;
+	n.prevFree = n.nextFree = NONE;
+	n.isFree = false;
+	return i;
+}
+void TLSF::releaseNode(unsigned int node)
+{
+	spareNodes.push_back(node);
+}
+void TLSF::insertFree(unsigned int node)
+{
+	Node &n = nodes[node];
+	unsigned int fl, sl;
+	mapping(n.size, fl, sl);
+	n.isFree = true;
+	n.prevFree = NONE;
+	n.nextFree = freeLists[fl][sl];
+	if (n.nextFree != NONE)
+		nodes[n.nextFree].prevFree = node;
+	freeLists[fl][sl] = node;
+	flBitmap |= 1u << fl;
+	slBitmap[fl] |= 1u << sl;
+}
+void TLSF::removeFree(unsigned int node)
+{
+	Node &n = nodes[node];
+	unsigned int fl, sl;
+	mapping(n.size, fl, sl);
+	if (n.prevFree != NONE)
+		nodes[n.prevFree].nextFree = n.nextFree;
+	else
+		freeLists[fl][sl] = n.nextFree;
+	if (n.nextFree != NONE)
+		nodes[n.nextFree].prevFree = n.prevFree;
+	if (freeLists[fl][sl] == NONE)
+	{
+		slBitmap[fl] &= ~(1u << sl);
+		if (!slBitmap[fl])
+			flBitmap &= ~(1u << fl);
+	}
+	n.isFree = false;
+}
+TLSF::Allocation TLSF::allocate(unsigned int size)
+{
+	Allocation rtn = { 0, NONE };
+	size = size ? size : 1;
+	unsigned int fl, sl;
+	mappingSearch(size, fl, sl);
+	if (fl >= FL_COUNT)
+		return rtn;
+	//Find the smallest non empty bin of at least (fl, sl)
+	unsigned int slMap = slBitmap[fl] & bitsFrom(sl);
+	if (!slMap)
+	{
+		const unsigned int flMap = flBitmap & bitsFrom(fl + 1);
+		if (!flMap)
+			return rtn;
+		fl = findFirstSet(flMap);
+		slMap = slBitmap[fl];
+	}
+	sl = findFirstSet(slMap);
+	const unsigned int node = freeLists[fl][sl];
+	assert(node != NONE && nodes[node].size >= size);
+	removeFree(node);
+	//Return the remainder to the free lists
+	if (nodes[node].size > size)
+	{
+		const unsigned int remainder = createNode(nodes[node].offset + size, nodes[node].size - size);
+		//createNode() may have reallocated nodes
+		Node &n = nodes[node];
+		Node &r = nodes[remainder];
+		r.prevPhysical = node;
+		r.nextPhysical = n.nextPhysical;
+		if (n.nextPhysical != NONE)
+			nodes[n.nextPhysical].prevPhysical = remainder;
+		else
+			lastNode = remainder;
+		n.nextPhysical = remainder;
+		n.size = size;
+		insertFree(remainder);
+	}
+	used += nodes[node].size;
+	++allocations;
+	rtn.offset = nodes[node].offset;
+	rtn.node = node;
+	return rtn;
+}
+void TLSF::free(unsigned int node)
+{
+	if (node == NONE)
+		return;
+	assert(node < nodes.size() && !nodes[node].isFree);
+	used -= nodes[node].size;
+	--allocations;
+	//Merge with the previous block
+	const unsigned int prev = nodes[node].prevPhysical;
+	if (prev != NONE && nodes[prev].isFree)
+	{
+		removeFree(prev);
+		nodes[prev].size += nodes[node].size;
+		nodes[prev].nextPhysical = nodes[node].nextPhysical;
+		if (nodes[node].nextPhysical != NONE)
+			nodes[nodes[node].nextPhysical].prevPhysical = prev;
+		else
+			lastNode = prev;
+		releaseNode(node);
+		node = prev;
+	}
+	//Merge with the next block
+	const unsigned int next = nodes[node].nextPhysical;
+	if (next != NONE && nodes[next].isFree)
+	{
+		removeFree(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].nextPhysical = nodes[next].nextPhysical;
+		if (nodes[next].nextPhysical != NONE)
+			nodes[nodes[next].nextPhysical].prevPhysical = node;
+		else
+			lastNode = node;
+		releaseNode(next);
+	}
+	insertFree(node);
+}
+void TLSF::grow(unsigned int size)
+{
+	if (size <= this->size)
+		return;
+	const unsigned int extra = size - this->size;
+	if (lastNode != NONE && nodes[lastNode].isFree)
+	{//Extend the trailing free block
+		removeFree(lastNode);
+		nodes[lastNode].size += extra;
+		insertFree(lastNode);
+	}
+	else
+	{
+		const unsigned int node = createNode(this->size, extra);
+		nodes[node].prevPhysical = lastNode;
+		if (lastNode != NONE)
+			nodes[lastNode].nextPhysical = node;
+		lastNode = node;
+		insertFree(node);
+	}
+	this->size = size;
+}
+void TLSF::reset(unsigned int size)
+{
+	nodes.clear();
+	spareNodes.clear();
+	flBitmap = 0;
+	for (unsigned int i = 0; i < FL_COUNT; ++i)
+	{
+		slBitmap[i] = 0;
+		for (unsigned int j = 0; j < SL_COUNT; ++j)
+			freeLists[i][j] = NONE;
+	}
+	lastNode = NONE;
+	this->size = 0;
+	used = 0;
+	allocations = 0;
+	grow(size);
+}
+unsigned int TLSF::getLargestFree() const
+{
+	if (!flBitmap)
+		return 0;
+	//The largest blocks are all within the highest non empty bin
+	const unsigned int fl = findLastSet(flBitmap);
+	const unsigned int sl = findLastSet(slBitmap[fl]);
+	unsigned int rtn = 0;
+	for (unsigned int i = freeLists[fl][sl]; i != NONE; i = nodes[i].nextFree)
+		rtn = nodes[i].size > rtn ? nodes[i].size : rtn;
+	return rtn;
+}
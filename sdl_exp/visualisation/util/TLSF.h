@@ -0,0 +1,110 @@
+#ifndef __TLSF_h__
+#define __TLSF_h__
+
+#include <climits>
+#include <vector>
+
+/**
+ * Two level segregated fit allocator, manages offsets into a range of units (e.g. vertices of a buffer) rather than memory
+ * Free blocks are binned by size into power of two first level classes, each split into SL_COUNT linear second level classes
+ * Bitmaps of the non empty bins find a suitable block in constant time, freed blocks are merged with free neighbours immediately
+ * Usage:
+ *   TLSF vertices(65536);
+ *   TLSF::Allocation a = vertices.allocate(1200);
+ *   if (a.node != TLSF::NONE) ...write to [a.offset, a.offset + 1200)...
+ *   vertices.free(a.node);
+ */
+class TLSF
+{
+public:
+	static const unsigned int NONE = UINT_MAX;
+	struct Allocation
+	{
+		unsigned int offset;
+		/**
+		 * Identifies the allocation when freeing, NONE if allocation failed
+		 */
+		unsigned int node;
+	};
+	/**
+	 * @param size The number of units managed, all initially free
+	 */
+	explicit TLSF(unsigned int size = 0);
+	/**
+	 * Allocates a contiguous range of size units
+	 * @return The allocation, its node is NONE if no free block is large enough
+	 * @note Requests are rounded up to the granularity of their size class when searching, so a block may be found only once the total free space is somewhat larger than size
+	 */
+	Allocation allocate(unsigned int size);
+	/**
+	 * Releases an allocation, passing NONE is ignored
+	 */
+	void free(unsigned int node);
+	/**
+	 * Extends the managed range to size units, the new units are free
+	 * Existing allocations are unaffected, shrinking is not supported
+	 */
+	void grow(unsigned int size);
+	/**
+	 * Frees every allocation, and resizes the managed range to size units
+	 */
+	void reset(unsigned int size);
+	unsigned int getSize() const { return size; }
+	unsigned int getUsed() const { return used; }
+	unsigned int getAllocationCount() const { return allocations; }
+	/**
+	 * @return The size of the largest free block
+	 */
+	unsigned int getLargestFree() const;
+	/**
+	 * @return The size of an allocation
+	 */
+	unsigned int getSize(unsigned int node) const { return nodes[node].size; }
+private:
+	static const unsigned int SL_BITS = 4;
+	static const unsigned int SL_COUNT = 1 << SL_BITS;
+	static const unsigned int FL_COUNT = 32 - SL_BITS + 1;
+	struct Node
+	{
+		unsigned int offset;
+		unsigned int size;
+		/**
+		 * Neighbouring blocks by offset
+		 */
+		unsigned int prevPhysical, nextPhysical;
+		/**
+		 * Neighbouring blocks within the same free list
+		 */
+		unsigned int prevFree, nextFree;
+		bool isFree;
+	};
+	/**
+	 * Returns the bin holding blocks of size
+	 */
+	static void mapping(unsigned int size, unsigned int &fl, unsigned int &sl);
+	/**
+	 * Returns the first bin whose every block holds at least size
+	 */
+	static void mappingSearch(unsigned int size, unsigned int &fl, unsigned int &sl);
+	unsigned int createNode(unsigned int offset, unsigned int size);
+	void releaseNode(unsigned int node);
+	void insertFree(unsigned int node);
+	void removeFree(unsigned int node);
+	std::vector<Node> nodes;
+	/**
+	 * Indices of unused elements of nodes
+	 */
+	std::vector<unsigned int> spareNodes;
+	unsigned int flBitmap;
+	unsigned int slBitmap[FL_COUNT];
+	unsigned int freeLists[FL_COUNT][SL_COUNT];
+	/**
+	 * The block with the highest offset
+	 */
+	unsigned int lastNode;
+	unsigned int size;
+	unsigned int used;
+	unsigned int allocations;
+};
+
+#endif //__TLSF_h__
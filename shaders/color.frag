@@ -1,27 +1,5 @@
 #version 430
-struct LightProperties
-{
-    vec3 ambient;              // Aclarri   
-    float spotExponent;        // Srli   
-    vec3 diffuse;              // Dcli   
-    float PADDING1;            // Crli   (ex spot cutoff, this value is nolonger set internally)                             
-    vec3 specular;             // Scli   
-    float spotCosCutoff;       // Derived: cos(Crli) (range: [1.0,0.0],-1.0)   
-    vec3 position;             // Ppli   
-    float constantAttenuation; // K0   
-    vec3 halfVector;           // Derived: Hi  (This is calculated as the vector half way between vector-light and vector-viewer) 
-    float linearAttenuation;   // K1   
-    vec3 spotDirection;        // Sdli   
-    float quadraticAttenuation;// K2  
-};
-const uint MAX_LIGHTS = 50;
-
-uniform _lights
-{
-  uint lightsCount;
-  //<12 bytes of padding>
-  LightProperties light[MAX_LIGHTS];
-};
+#include "include/lights.glsl"
 
 in vec3 eyeVertex;
 in vec3 eyeNormal;
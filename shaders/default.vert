@@ -1,22 +1,60 @@
 #version 430
+/**
+ * Permutations:
+ * SHADOWED: Output shadowCoord for single light source shadow mapping
+ * PICK: Output the instance index, for pick.frag
+ * DEPTH_ONLY: Only read _vertex and output gl_Position, e.g. for a DepthPrePass drawing position only vertex streams
+ */
 
 uniform mat3 _normalMat;
 uniform mat4 _modelViewProjectionMat;
 uniform mat4 _modelViewMat;
 
+//Invariant, so depth written by a DEPTH_ONLY pre-pass exactly matches later passes (glDepthFunc(GL_EQUAL))
+invariant gl_Position;
 in vec3 _vertex;
+#ifndef DEPTH_ONLY
 in vec3 _normal;
 in vec2 _texCoords;
+#endif
 
+#ifndef DEPTH_ONLY
 out vec3 eyeVertex;
 out vec3 eyeNormal;
 out vec2 texCoords;
+#endif
+
+#ifdef SHADOWED
+//Shadow attribs
+uniform mat4 _modelMat;
+uniform mat4 spotlightViewMat;
+uniform mat4 spotlightProjectionMat;
+
+out vec4 shadowCoord;
+#endif
+
+#ifdef PICK
+flat out uint pickInstance;
+#endif
 
 void main()
 {
   gl_Position = _modelViewProjectionMat * vec4(_vertex,1.0f);
 
+#ifndef DEPTH_ONLY
   eyeNormal = normalize(_normalMat * _normal) ;
   eyeVertex = (_modelViewMat * vec4(_vertex, 1.0f)).rgb;
   texCoords = _texCoords;
+#endif
+#ifdef PICK
+  pickInstance = uint(gl_InstanceID);
+#endif
+#ifdef SHADOWED
+
+  //Lighting attribs (We can only handle shadows for a couple of lights before we need to do deferred rendering)
+  shadowCoord = spotlightProjectionMat * spotlightViewMat * _modelMat * vec4(_vertex,1.0f);
+  //Convert screen coords to normalised/tex coords (-1 - 1 to 0 - 1)
+  shadowCoord /= 2.0f;
+  shadowCoord += vec4(0.5);
+#endif
 }
\ No newline at end of file
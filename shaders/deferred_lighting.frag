@@ -0,0 +1,59 @@
+#version 430
+/**
+ * Full screen lighting pass of deferred shading (see DeferredLightingPass)
+ * Each pixel of the G-buffer is lit by the lights binned to its tile by tile_lights.comp, with the same phong model as material.frag
+ * Permutations:
+ * CLUSTERED: Read lights from the clustered storage buffers, lifting the MAX_LIGHTS limit (see LightsBuffer::setClustered())
+ * SHADOW_MAPS: Apply per light shadow maps from a ShadowPass's atlas
+ */
+#include "include/material.glsl"
+#include "include/lights.glsl"
+#ifdef SHADOW_MAPS
+#include "include/shadow_maps.glsl"
+#endif
+#include "include/phong.glsl"
+#include "include/deferred.glsl"
+
+uniform sampler2D _gAlbedo;
+uniform sampler2D _gSurface;
+uniform sampler2D _gDepth;
+uniform mat4 _inverseProjection;
+
+out vec4 fragColor;
+
+void main()
+{
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  float depth = texelFetch(_gDepth, pixel, 0).r;
+  //Background, the target's clear colour remains
+  if(depth >= 1.0f)
+    discard;
+  ivec2 size = textureSize(_gDepth, 0);
+  vec4 albedo = texelFetch(_gAlbedo, pixel, 0);
+  vec3 eyeNormal;
+  uint id;
+  float shininess;
+  unpackSurface(texelFetch(_gSurface, pixel, 0), eyeNormal, id, shininess);
+  vec3 eyeVertex = reconstructEyeVertex((vec2(pixel) + 0.5f) / vec2(size), depth, _inverseProjection);
+  //Ambient textures are approximated by the albedo, specular textures by their intensity
+  vec3 ambient = material[id].has(B_AMBIENT) ? albedo.rgb : material[id].ambient;
+  vec3 diffuse = albedo.rgb;
+  vec3 specular = material[id].has(B_SPECULAR) ? vec3(albedo.a) : material[id].specular;
+  
+  //No lights, so render full bright
+  if(lightsCount>0)
+  {
+    vec3 lightAmbient = vec3(0);
+    vec3 lightDiffuse = vec3(0);
+    vec3 lightSpecular = vec3(0);
+    uint base = tileBase(uvec2(pixel) / TILE_SIZE, (uint(size.x) + TILE_SIZE - 1u) / TILE_SIZE);
+    for(uint j = 0; j < tileLights[base]; ++j)
+      phongLight(tileLights[base + 1u + j], eyeVertex, eyeNormal, shininess, lightAmbient, lightDiffuse, lightSpecular);
+    ambient *= lightAmbient;
+    diffuse *= lightDiffuse;
+    specular *= lightSpecular;
+  }
+  fragColor = vec4(clamp(ambient + diffuse + specular, 0, 1), 1.0f);
+  //Forward passes which follow are depth tested against the G-buffer
+  gl_FragDepth = depth;
+}
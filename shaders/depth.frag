@@ -0,0 +1,6 @@
+#version 430
+//Depth only fragment shader, e.g. for rendering shadow map casters (see ShadowPass)
+//The depth buffer is written by the fixed function pipeline, so no output is required
+void main()
+{
+}
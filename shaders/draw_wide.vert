@@ -0,0 +1,70 @@
+#version 430
+/**
+ * Expands Draw states into screen space quads by pulling vertices from storage buffers
+ * Each segment is drawn as 6 vertices (2 triangles), gl_VertexID identifies the segment and corner
+ * Points are expanded as screen aligned squares
+ */
+uniform mat4 _modelViewProjectionMat;
+uniform vec2 _viewportDims;
+
+layout(std430) buffer _drawVertices
+{
+  float vertices[];
+};
+layout(std430) buffer _drawColors
+{
+  vec4 colors[];
+};
+layout(std430) buffer _drawWidths
+{
+  float widths[];
+};
+
+//Per draw (instanced) attribute, x: Offset of the draw state's first vertex, y: Draw type (0: Points, 1: Lines, 2: Polyline)
+in uvec2 _drawState;
+
+out vec4 color;
+
+//x: Segment end, y: Side of the segment
+const vec2 CORNERS[6] = vec2[6](vec2(0, -1), vec2(1, -1), vec2(0, 1), vec2(0, 1), vec2(1, -1), vec2(1, 1));
+
+vec3 fetchVertex(uint i)
+{
+  return vec3(vertices[i * 3], vertices[(i * 3) + 1], vertices[(i * 3) + 2]);
+}
+void main()
+{
+  uint segment = uint(gl_VertexID) / 6;
+  vec2 corner = CORNERS[gl_VertexID % 6];
+  uint a, b;
+  if (_drawState.y == 0)
+  {//Points
+    a = _drawState.x + segment;
+    b = a;
+  }
+  else if (_drawState.y == 1)
+  {//Lines
+    a = _drawState.x + (2 * segment);
+    b = a + 1;
+  }
+  else
+  {//Polyline
+    a = _drawState.x + segment;
+    b = a + 1;
+  }
+  uint v = corner.x == 0 ? a : b;
+  vec4 clipA = _modelViewProjectionMat * vec4(fetchVertex(a), 1.0f);
+  vec4 clipB = _modelViewProjectionMat * vec4(fetchVertex(b), 1.0f);
+  //Direction of the segment in pixels
+  vec2 dir = ((clipB.xy / clipB.w) - (clipA.xy / clipA.w)) * _viewportDims;
+  bool isPoint = a == b || dot(dir, dir) < 1e-8f;
+  dir = isPoint ? vec2(1, 0) : normalize(dir);
+  float halfWidth = 0.5f * widths[v];
+  vec2 offsetPx = vec2(-dir.y, dir.x) * corner.y * halfWidth;
+  if (isPoint)
+    offsetPx += dir * ((corner.x * 2.0f) - 1.0f) * halfWidth;
+  //Pixels to clip space (NDC spans 2 units across the viewport)
+  vec4 clip = corner.x == 0 ? clipA : clipB;
+  gl_Position = clip + vec4(offsetPx * (2.0f / _viewportDims) * clip.w, 0.0f, 0.0f);
+  color = colors[v];
+}
@@ -0,0 +1,11 @@
+#version 430
+/**
+ * Covers the viewport with a single triangle, draw 3 vertices without any attributes bound
+ */
+out vec2 texCoords;
+
+void main()
+{
+  texCoords = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  gl_Position = vec4(texCoords * 2.0f - 1.0f, 0.0f, 1.0f);
+}
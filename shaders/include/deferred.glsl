@@ -0,0 +1,71 @@
+/**
+ * G-buffer packing and tiled light lists, for deferred shading (see GBufferPass and DeferredLightingPass)
+ * G-buffer layout, 16 bytes per pixel:
+ * 0: RGBA8 albedo (rgb: diffuse colour, a: specular intensity)
+ * 1: RGBA16 surface (xy: octahedral eye space normal, z: material ID, w: roughness)
+ * Depth: Eye space positions are reconstructed from depth, via the inverse projection
+ * Define TILE_ACCESS to override the access qualifier of _tileLights
+ */
+//Must match DeferredLightingPass::TILE_SIZE
+#define TILE_SIZE 16
+//Must match DeferredLightingPass::MAX_LIGHTS_PER_TILE
+#define TILE_MAX_LIGHTS 255
+#ifndef TILE_ACCESS
+#define TILE_ACCESS readonly
+#endif
+//Each tile holds its light count, followed by up to TILE_MAX_LIGHTS light indices
+layout(std430) TILE_ACCESS buffer _tileLights
+{
+  uint tileLights[];
+};
+uint tileBase(uvec2 tile, uint tilesX)
+{
+  return (tile.x + tile.y * tilesX) * (TILE_MAX_LIGHTS + 1u);
+}
+
+vec2 signNotZero(vec2 v)
+{
+  return vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+/**
+ * Octahedral normal encoding (Cigolle et al. 2014), maps a unit vector to [0, 1]^2
+ */
+vec2 octEncode(vec3 n)
+{
+  vec2 p = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+  p = n.z >= 0.0f ? p : (1.0f - abs(p.yx)) * signNotZero(p);
+  return p * 0.5f + 0.5f;
+}
+vec3 octDecode(vec2 e)
+{
+  e = e * 2.0f - 1.0f;
+  vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+  if(n.z < 0.0f)
+    n.xy = (1.0f - abs(n.yx)) * signNotZero(n.xy);
+  return normalize(n);
+}
+/**
+ * Phong exponents are packed as roughness, sqrt(2/(shininess+2)), so that precision favours rough surfaces
+ * 0 shininess (no specular) packs as 1
+ */
+vec4 packSurface(vec3 eyeNormal, uint materialID, float shininess)
+{
+  return vec4(octEncode(eyeNormal), float(materialID) / 65535.0f, sqrt(2.0f / (shininess + 2.0f)));
+}
+void unpackSurface(vec4 surface, out vec3 eyeNormal, out uint materialID, out float shininess)
+{
+  eyeNormal = octDecode(surface.xy);
+  materialID = uint(round(surface.z * 65535.0f));
+  shininess = surface.w >= 1.0f ? 0.0f : 2.0f / (surface.w * surface.w) - 2.0f;
+}
+/**
+ * @param uv Texture coordinate of the pixel within the G-buffer
+ * @param depth The pixel's depth
+ * @param inverseProjection Inverse of the projection the G-buffer was rendered with
+ * @return The pixel's eye space position
+ */
+vec3 reconstructEyeVertex(vec2 uv, float depth, mat4 inverseProjection)
+{
+  vec4 eye = inverseProjection * vec4(vec3(uv, depth) * 2.0f - 1.0f, 1.0f);
+  return eye.xyz / eye.w;
+}
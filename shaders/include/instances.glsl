@@ -0,0 +1,17 @@
+/**
+ * Per instance data, must match InstanceBuffer::Instance (std430)
+ */
+struct Instance
+{
+  vec4 location;//xyz: location, w: uniform scale
+  vec4 rotation;//Unit quaternion (x, y, z, w)
+  vec4 color;
+  uvec4 state;
+};
+/**
+ * Rotates v by the unit quaternion q
+ */
+vec3 rotateQuat(vec4 q, vec3 v)
+{
+  return v + 2.0f * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
@@ -0,0 +1,92 @@
+/**
+ * Light properties and their uniform block
+ * Define MAX_LIGHTS to override the number of lights held by _lights
+ * Define CLUSTERED to instead read all lights from storage buffers, binned per view frustum cluster (see LightClusters)
+ * Define LIGHT_PROPERTIES_ONLY to declare only the struct, e.g. for shaders which write the light buffers (see transform_lights.comp)
+ * Iterate lights via findLights() and lightIndex(), which work with either layout
+ */
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 50
+#endif
+struct LightProperties
+{
+    vec3 ambient;              // Aclarri   
+    float spotExponent;        // Srli   
+    vec3 diffuse;              // Dcli   
+    float range;               // Derived: Distance at which attenuation makes the light negligible, negative == unbounded (used by clustered lighting)
+    vec3 specular;             // Scli   
+    float spotCosCutoff;       // Derived: cos(Crli) (Valid spotlight range: [1.0,0.0]), negative == pointlight, greater than 1.0 == directional light
+    vec3 position;             // Ppli   
+    float constantAttenuation; // K0   
+    int shadowIndex;           // Derived: Index of the light's first shadow map within _shadowMaps, negative == no shadows (used by ShadowPass)
+    uint shadowCount;          // Derived: Number of consecutive shadow maps (cascades/cube faces) belonging to the light
+    float PADDING2;
+    float linearAttenuation;   // K1   
+    vec3 spotDirection;        // Sdli   
+    float quadraticAttenuation;// K2  
+};
+
+#ifndef LIGHT_PROPERTIES_ONLY
+#ifdef CLUSTERED
+//Binning writes to the cluster buffers, everything else only reads
+#ifndef CLUSTER_ACCESS
+#define CLUSTER_ACCESS readonly
+#endif
+layout(std430) readonly buffer _lightStorage
+{
+  LightProperties light[];
+};
+layout(std430) CLUSTER_ACCESS buffer _lightClusters
+{
+  mat4 clusterProjection;
+  mat4 clusterInverseProjection;
+  uvec3 clusterDims;
+  uint lightsCount;
+  //x: near plane, y: far plane, slice = log(-eyeZ)*z + w
+  vec4 clusterDepth;
+  //(offset, count) of each cluster's lights within lightIndices
+  uvec2 cluster[];
+};
+layout(std430) CLUSTER_ACCESS buffer _lightIndices
+{
+  uint lightIndicesCount;
+  uint lightIndices[];
+};
+#else
+uniform _lights
+{
+  uint lightsCount;
+  //<12 bytes of padding>
+  LightProperties light[MAX_LIGHTS];
+};
+#endif
+
+/**
+ * @param eyeVertex Eye space position of the surface being lit
+ * @return The (first, count) range of lights which may reach eyeVertex, to be passed to lightIndex()
+ */
+uvec2 findLights(vec3 eyeVertex)
+{
+#ifdef CLUSTERED
+  vec4 clip = clusterProjection * vec4(eyeVertex, 1.0f);
+  uvec2 tile = uvec2(clamp(ivec2((clip.xy / clip.w * 0.5f + 0.5f) * vec2(clusterDims.xy)), ivec2(0), ivec2(clusterDims.xy) - 1));
+  uint slice = uint(clamp(int(log(-eyeVertex.z) * clusterDepth.z + clusterDepth.w), 0, int(clusterDims.z) - 1));
+  return cluster[tile.x + clusterDims.x * (tile.y + clusterDims.y * slice)];
+#else
+  return uvec2(0, lightsCount);
+#endif
+}
+/**
+ * @param lights A range returned by findLights()
+ * @param i Index within the range
+ * @return Index of the light within light[]
+ */
+uint lightIndex(uvec2 lights, uint i)
+{
+#ifdef CLUSTERED
+  return lightIndices[lights.x + i];
+#else
+  return lights.x + i;
+#endif
+}
+#endif //LIGHT_PROPERTIES_ONLY
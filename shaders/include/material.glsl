@@ -0,0 +1,50 @@
+/**
+ * Material properties, their storage block and texture arrays (see MaterialBuffer)
+ * Textures should be sampled with materialTexture(), the arrays are indexed by _materialID so it must remain uniform across the draw
+ */
+const uint MAX_MATERIAL_ARRAYS = 8;
+const uint MAX_MATERIAL_TEXTURES = 3;
+const uint B_NONE         = 1<<0;
+const uint B_AMBIENT      = 1<<1;
+const uint B_DIFFUSE      = 1<<2;
+const uint B_SPECULAR     = 1<<3;
+const uint B_EMISSIVE     = 1<<4;
+const uint B_HEIGHT       = 1<<5;
+const uint B_NORMAL       = 1<<6;
+const uint B_SHININESS    = 1<<7;
+const uint B_OPACITY      = 1<<8;
+const uint B_DISPLACEMENT = 1<<9;
+const uint B_LIGHT        = 1<<10;
+const uint B_REFLECTION   = 1<<11;
+const uint B_UNKNOWN      = 1<<12;
+struct MaterialProperties
+{
+    vec3 ambient;           //Ambient color
+    float opacity;
+    vec3 diffuse;           //Diffuse color
+    float shininess;
+    vec3 specular;          //Specular color
+    float shininessStrength;
+    vec3 emissive;          //Emissive color (light emitted)
+    float refractionIndex;
+    vec3 transparent;       //Transparent color, multiplied with translucent light to construct final color
+    uint bitmask;
+    uvec4 textures;         //Ambient, diffuse and specular texture handles (array<<16|layer), w is unused
+    bool has(uint check) { return (bitmask&check)!=0;}
+};
+
+uniform uint _materialID;
+layout(std430) readonly buffer _materials
+{
+  MaterialProperties material[];
+};
+
+uniform sampler2DArray t_materialArrays[MAX_MATERIAL_ARRAYS];
+//Textures which didn't fit within the arrays, handle>>16 == MAX_MATERIAL_ARRAYS
+uniform sampler2D t_materialTextures[MAX_MATERIAL_TEXTURES];
+vec4 materialTexture(uint handle, vec2 texCoords)
+{
+  if((handle>>16) == MAX_MATERIAL_ARRAYS)
+    return texture(t_materialTextures[handle&0xFFFFu], texCoords);
+  return texture(t_materialArrays[handle>>16], vec3(texCoords, float(handle&0xFFFFu)));
+}
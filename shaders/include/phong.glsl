@@ -0,0 +1,64 @@
+/**
+ * Phong lighting of a surface by a single light, shared by material.frag and deferred_lighting.frag
+ * Requires include/lights.glsl, and include/shadow_maps.glsl if SHADOW_MAPS is defined
+ * @param i Index of the light within light[]
+ * @param eyeVertex Eye space position of the surface being lit
+ * @param eyeNormal Eye space normal of the surface being lit
+ * @param shininess Specular exponent of the surface, 0 disables specular
+ * @param lightAmbient, lightDiffuse, lightSpecular The light's contributions are added to these
+ */
+void phongLight(uint i, vec3 eyeVertex, vec3 eyeNormal, float shininess, inout vec3 lightAmbient, inout vec3 lightDiffuse, inout vec3 lightSpecular)
+{
+  float attenuation;
+  float intensity = 1.0f;
+  vec3 surfaceToLight;
+  //Init light specific values
+  if(light[i].spotCosCutoff>1.0f)
+  {//Light is directional      
+    attenuation = light[i].constantAttenuation;
+    surfaceToLight = -light[i].spotDirection;
+  }
+  else
+  {
+    surfaceToLight = light[i].position.xyz - eyeVertex;
+    float dist2 = dot(surfaceToLight, surfaceToLight);
+    float dist = sqrt(dist2);
+    surfaceToLight /= dist;
+    if(light[i].spotCosCutoff>=0.0f)
+    {//Spotlight
+      float spotCos = dot(surfaceToLight,-light[i].spotDirection);
+      //Step works as (spotCos>light[i].spotCosCutoff?0:1)
+      //Handle spotExponent
+      intensity = step(light[i].spotCosCutoff, spotCos) * pow(spotCos, light[i].spotExponent);
+    }
+    //Pointlight(or in range spotlight)      
+    attenuation = (light[i].constantAttenuation)+(light[i].linearAttenuation*dist)+(light[i].quadraticAttenuation*dist2);
+  }
+  attenuation = clamp(intensity/attenuation,0.0f,1.0f);
+#ifdef SHADOW_MAPS
+  //Shadows only occlude direct light
+  float visibility = attenuation * shadowVisibility(light[i], eyeVertex);
+#else
+  float visibility = attenuation;
+#endif
+  
+  //Process Ambient
+  {
+    lightAmbient += light[i].ambient * attenuation;
+  }
+  //Process Diffuse
+  {
+    float lambertian = max(dot(surfaceToLight,eyeNormal),0.0f);//phong
+    lightDiffuse += light[i].diffuse.rgb * lambertian * visibility;
+  }
+  
+  //Process Specular
+  if (shininess == 0)
+    return;//Skip if no shiny
+  {
+    vec3 reflectDir = reflect(-surfaceToLight, eyeNormal);
+    float specAngle = max(dot(reflectDir, normalize(-eyeVertex)), 0.0);
+    float spec = clamp(pow(specAngle, shininess/4.0), 0.0f, 1.0f); 
+    lightSpecular += light[i].specular * spec * visibility;
+  }
+}
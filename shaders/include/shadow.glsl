@@ -0,0 +1,49 @@
+/**
+ * Single light source shadow map visibility code
+**/
+in highp vec4 shadowCoord;
+uniform sampler2D _shadowMap;
+uniform mat4 spotlightProjectionMat;
+
+float makeLinearDepth(float depthNorm)
+{
+  int isOrtho = int(spotlightProjectionMat[3][3]);//This coord is 1 for ortho, 0 for proj
+  int isProj = int(-spotlightProjectionMat[2][3]);//This coord is -1 for proj, 0 for ortho
+  if(isOrtho==1)//Ortho starts out with linear depth
+      return depthNorm;
+  //Depth in the normalised range 0 to +1
+  //depthNorm
+  //Depth in device range -1 to +1
+  float depthDevice = (depthNorm * 2.0) - 1.0;
+  //Linear depth in range znear - zfar
+  //http://stackoverflow.com/a/16597492/1646387
+  vec4 unprojected = inverse(spotlightProjectionMat) * vec4(0, 0, depthDevice, 1.0);
+  float depthView = -(unprojected.z / unprojected.w);//Negate why? Is it because using ortho matrix
+  //Get projection near/far planes from column major matrices
+  //http://stackoverflow.com/a/12926655/1646387
+  float zNear = (spotlightProjectionMat[3][2] / (spotlightProjectionMat[2][2] - 1.0f));
+  float zFar = (spotlightProjectionMat[3][2] / (spotlightProjectionMat[2][2] + 1.0f));
+  //Linear depth in range 0-1
+	return (depthView-zNear)/(zFar-zNear);
+}
+float makeVisibility()
+{
+	/*
+	//Basic shadow with bias
+	const float bias = 0.005;
+	float visibility = texture(_shadowMap, shadowCoord.xy ).r<shadowCoord.z-bias?0.0f:1.0f;
+	*/
+	
+	//Exponential Shadow Maps - Thomas Allen (http://discovery.ucl.ac.uk/10001/1/10001.pdf)
+	//Todo: divide values by shadowCoord.w to support projection matrices/spot lights
+	//Higher exponent value is closer to the hard-shadow step function
+	//Too high and the visibility will overflow
+	const float LIGHT_EXPONENT = 80.0f;//Fig 2.0
+  //Make linear (same as shadowMap)
+	float reciever = makeLinearDepth(shadowCoord.z);
+	//cz, corresponding shadow map value
+	//(we should really precompute this when creating the shadow map)
+	float occluder = exp(LIGHT_EXPONENT*texture(_shadowMap, shadowCoord.xy).r);
+	//visibility = e^(-cd)e^(cz), clamped to bounds
+	return clamp(exp(-LIGHT_EXPONENT * reciever) *occluder,0.0,1.0);
+}
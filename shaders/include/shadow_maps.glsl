@@ -0,0 +1,56 @@
+/**
+ * Shadow map visibility, for the SHADOW_MAPS permutation
+ * Each light's maps (cascades, cube faces or a single spot map) are rendered into a shared depth atlas by ShadowPass
+ * Requires include/lights.glsl
+ * Define SHADOW_BIAS to override the depth bias applied to receivers
+ */
+#ifndef SHADOW_BIAS
+#define SHADOW_BIAS 0.0005f
+#endif
+struct ShadowMap
+{
+  //Transforms from eye space to the light's clip space
+  mat4 eyeToLight;
+  //xy: offset, zw: scale of the map's tile within the atlas
+  vec4 tile;
+};
+layout(std430) readonly buffer _shadowMaps
+{
+  ShadowMap shadowMap[];
+};
+uniform sampler2DShadow _shadowAtlas;
+
+/**
+ * @param l The light
+ * @param eyeVertex Eye space position of the surface being lit
+ * @return The fraction of the light which reaches eyeVertex, in the range 0-1
+ * @note The first of the light's maps which covers eyeVertex is used, so cascades must be ordered nearest first
+ */
+float shadowVisibility(LightProperties l, vec3 eyeVertex)
+{
+  for(uint m = 0; m < l.shadowCount; ++m)
+  {
+    ShadowMap s = shadowMap[uint(l.shadowIndex) + m];
+    vec4 clip = s.eyeToLight * vec4(eyeVertex, 1.0f);
+    if(clip.w <= 0.0f)
+      continue;
+    vec3 ndc = clip.xyz / clip.w;
+    if(any(greaterThan(abs(ndc), vec3(1.0f))))
+      continue;//Outside of this map
+    vec3 coord = ndc * 0.5f + 0.5f;
+    vec2 texel = 1.0f / vec2(textureSize(_shadowAtlas, 0));
+    //Keep the filter footprint within the tile, neighbouring tiles belong to other maps
+    vec2 tileMin = s.tile.xy + texel * 0.5f;
+    vec2 tileMax = s.tile.xy + s.tile.zw - texel * 0.5f;
+    vec2 uv = s.tile.xy + coord.xy * s.tile.zw;
+    //3x3 percentage closer filtering, each tap is bilinearly filtered by the hardware
+    float visibility = 0.0f;
+    for(int y = -1; y <= 1; ++y)
+    {
+      for(int x = -1; x <= 1; ++x)
+        visibility += texture(_shadowAtlas, vec3(clamp(uv + vec2(x, y) * texel, tileMin, tileMax), coord.z - SHADOW_BIAS));
+    }
+    return visibility / 9.0f;
+  }
+  return 1.0f;
+}
@@ -0,0 +1,62 @@
+#version 430
+/**
+ * Draws the instances of an InstanceBuffer, after they have been culled and compacted by instance_cull.comp
+ * Each instance is scaled, rotated and then translated, before the entity's model matrix is applied
+ * Pair with the INSTANCE_COLOR permutation of material.frag to apply per instance colours
+ * Permutations:
+ * PICK: Output the index each instance had before culling, for pick.frag
+ * DEPTH_ONLY: Only read _vertex and output gl_Position, e.g. for a DepthPrePass
+ */
+#include "include/instances.glsl"
+
+uniform mat3 _normalMat;
+uniform mat4 _modelViewProjectionMat;
+uniform mat4 _modelViewMat;
+
+//Invariant, so depth written by a DEPTH_ONLY pre-pass exactly matches later passes (glDepthFunc(GL_EQUAL))
+invariant gl_Position;
+in vec3 _vertex;
+#ifndef DEPTH_ONLY
+in vec3 _normal;
+in vec2 _texCoords;
+#endif
+
+layout(std430) buffer _instanceData
+{
+  Instance instances[];
+};
+
+#ifndef DEPTH_ONLY
+out vec3 eyeVertex;
+out vec3 eyeNormal;
+out vec2 texCoords;
+out vec4 instanceColor;
+#endif
+
+#ifdef PICK
+//Index of each survivor within the instances written by the CPU
+layout(std430) readonly buffer _instanceIndices
+{
+  uint instanceIndices[];
+};
+flat out uint pickInstance;
+#endif
+
+void main()
+{
+  Instance instance = instances[gl_InstanceID];
+  vec4 vertex = vec4(rotateQuat(instance.rotation, _vertex * instance.location.w) + instance.location.xyz, 1.0f);
+
+  gl_Position = _modelViewProjectionMat * vertex;
+
+#ifndef DEPTH_ONLY
+  //Scale is uniform, so rotating the normal is sufficient
+  eyeNormal = normalize(_normalMat * rotateQuat(instance.rotation, _normal));
+  eyeVertex = (_modelViewMat * vertex).xyz;
+  texCoords = _texCoords;
+  instanceColor = instance.color;
+#endif
+#ifdef PICK
+  pickInstance = instanceIndices[gl_InstanceID];
+#endif
+}
@@ -0,0 +1,114 @@
+#version 430
+/**
+ * Material shader, permutations:
+ * FLAT: Normals are calculated per face, rather than interpolated
+ * SHADOWED: Apply single light source shadow map visibility (requires the SHADOWED vertex shader)
+ * CLUSTERED: Only visit the lights binned to the fragment's cluster, lifting the MAX_LIGHTS limit (see LightsBuffer::setClustered())
+ * SHADOW_MAPS: Apply per light shadow maps from a ShadowPass's atlas
+ * INSTANCE_COLOR: Multiply the ambient and diffuse colours by the vertex shader's instanceColor (see instanced.vert)
+ * OIT: Output weighted blended order independent transparency accumulation and revealage (see OITPass)
+ * GBUFFER: Output the surface to a G-buffer, lighting is deferred to DeferredLightingPass (see GBufferPass)
+ */
+#include "include/material.glsl"
+#include "include/lights.glsl"
+#ifdef SHADOW_MAPS
+#include "include/shadow_maps.glsl"
+#endif
+#include "include/phong.glsl"
+#ifdef GBUFFER
+#include "include/deferred.glsl"
+#endif
+
+in vec3 eyeVertex;
+#ifndef FLAT
+in vec3 eyeNormal;
+#endif
+in vec2 texCoords;
+#ifdef INSTANCE_COLOR
+in vec4 instanceColor;
+#endif
+
+#ifdef OIT
+layout(location = 0) out vec4 fragAccum;
+layout(location = 1) out float fragRevealage;
+vec4 fragColor;
+#elif defined(GBUFFER)
+layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec4 gSurface;
+vec4 fragColor;
+#else
+out vec4 fragColor;
+#endif
+
+#ifdef SHADOWED
+float makeVisibility();
+#endif
+void main()
+{
+#ifdef FLAT
+  //Calculate face normal
+  vec3 eyeNormal  = normalize(cross(dFdx(eyeVertex), dFdy(eyeVertex)));
+
+#endif
+  //Find material colours for each type of light
+  vec3 ambient = material[_materialID].has(B_AMBIENT) ? materialTexture(material[_materialID].textures.x, texCoords).rgb : material[_materialID].ambient;
+  vec4 diffuse = material[_materialID].has(B_DIFFUSE) ? materialTexture(material[_materialID].textures.y, texCoords) : vec4(material[_materialID].diffuse, 1.0f);
+  vec3 specular = material[_materialID].has(B_SPECULAR) ? materialTexture(material[_materialID].textures.z, texCoords).rgb : material[_materialID].specular;
+#ifdef INSTANCE_COLOR
+  ambient *= instanceColor.rgb;
+  diffuse *= instanceColor;
+#endif
+#ifdef SHADOWED
+  //Apply shadow visibility (1 shadow map shadows all lights, but meh)
+  float visibility = makeVisibility();
+  diffuse.rgb *= visibility;
+  specular *= visibility;
+#endif
+  
+#ifdef GBUFFER
+  if(min(diffuse.a, material[_materialID].opacity)<=0.0f)
+    discard;
+  //Specular textures are reduced to a grey intensity, stored in the albedo's alpha
+  gAlbedo = vec4(diffuse.rgb, material[_materialID].has(B_SPECULAR) ? max(specular.r, max(specular.g, specular.b)) : 1.0f);
+  gSurface = packSurface(normalize(eyeNormal), _materialID, material[_materialID].shininessStrength == 0 ? 0.0f : material[_materialID].shininess);
+  return;
+#endif
+  //No lights, so render full bright
+  if(lightsCount>0)
+  {
+    //Init colours to build light values in
+    vec3 lightAmbient = vec3(0);
+    vec3 lightDiffuse = vec3(0);
+    vec3 lightSpecular = vec3(0);
+    
+    //Init general values used in light computation
+    uvec2 lights = findLights(eyeVertex);
+    for(uint j = 0;j<lights.y;j++)
+    {
+      //Materials without shininess strength have no specular
+      phongLight(lightIndex(lights, j), eyeVertex, eyeNormal, material[_materialID].shininessStrength == 0 ? 0.0f : material[_materialID].shininess, lightAmbient, lightDiffuse, lightSpecular);
+    } 
+    
+    //Export lights
+    ambient *= lightAmbient;
+    diffuse *= vec4(lightDiffuse, 1.0f);
+    specular *= lightSpecular;   
+  }
+
+  vec3 color = clamp(ambient + diffuse.rgb + specular,0,1);
+
+  fragColor = vec4(color, min(diffuse.a, material[_materialID].opacity));//What to do with opac?
+  
+  //Discard full alpha fragments (removes requirement of back to front render/glblend)
+  if(fragColor.a<=0.0f)
+    discard;
+#ifdef OIT
+  //Weight favours nearer fragments (McGuire & Bavoil 2013), accumulation is additive and revealage multiplicative
+  float weight = clamp(fragColor.a * 3e3f * pow(1.0f - gl_FragCoord.z, 3.0f), 1e-2f, 3e3f);
+  fragAccum = vec4(fragColor.rgb * fragColor.a, fragColor.a) * weight;
+  fragRevealage = fragColor.a;
+#endif
+}
+#ifdef SHADOWED
+#include "include/shadow.glsl"
+#endif
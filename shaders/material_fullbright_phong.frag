@@ -1,42 +1,5 @@
 #version 430
-const uint B_NONE         = 1<<0;
-const uint B_AMBIENT      = 1<<1;
-const uint B_DIFFUSE      = 1<<2;
-const uint B_SPECULAR     = 1<<3;
-const uint B_EMISSIVE     = 1<<4;
-const uint B_HEIGHT       = 1<<5;
-const uint B_NORMAL       = 1<<6;
-const uint B_SHININESS    = 1<<7;
-const uint B_OPACITY      = 1<<8;
-const uint B_DISPLACEMENT = 1<<9;
-const uint B_LIGHT        = 1<<10;
-const uint B_REFLECTION   = 1<<11;
-const uint B_UNKNOWN      = 1<<12;
-struct MaterialProperties
-{
-    vec3 ambient;           //Ambient color
-    float opacity;
-    vec3 diffuse;           //Diffuse color
-    float shininess;
-    vec3 specular;          //Specular color
-    float shininessStrength;
-    vec3 emissive;          //Emissive color (light emitted)
-    float refractionIndex;
-    vec3 transparent;       //Transparent color, multiplied with translucent light to construct final color
-    uint bitmask;
-    bool has(uint check) { return (bitmask&check)!=0;}
-};
-const uint MAX_MATERIALS = 50;
-
-uniform uint _materialID;
-uniform _materials
-{
-  MaterialProperties material[MAX_MATERIALS];
-};
-
-uniform sampler2D t_ambient;
-uniform sampler2D t_diffuse;
-uniform sampler2D t_specular;
+#include "include/material.glsl"
 
 in vec3 eyeVertex;
 in vec3 eyeNormal;
@@ -47,9 +10,9 @@ out vec4 fragColor;
 void main()
 {
   //Find material colours for each type of light
-  vec3 ambient = material[_materialID].has(B_AMBIENT) ? texture(t_ambient, texCoords).rgb : material[_materialID].ambient;
-  vec4 diffuse = material[_materialID].has(B_DIFFUSE) ? texture(t_diffuse, texCoords) : vec4(material[_materialID].diffuse, 1.0f);
-  vec3 specular = material[_materialID].has(B_SPECULAR) ? texture(t_specular, texCoords).rgb : material[_materialID].specular;
+  vec3 ambient = material[_materialID].has(B_AMBIENT) ? materialTexture(material[_materialID].textures.x, texCoords).rgb : material[_materialID].ambient;
+  vec4 diffuse = material[_materialID].has(B_DIFFUSE) ? materialTexture(material[_materialID].textures.y, texCoords) : vec4(material[_materialID].diffuse, 1.0f);
+  vec3 specular = material[_materialID].has(B_SPECULAR) ? materialTexture(material[_materialID].textures.z, texCoords).rgb : material[_materialID].specular;
   
   //No lights, so render full bright pretending eye is the light source
   vec3 surfaceToLight = normalize(-eyeVertex);
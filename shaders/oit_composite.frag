@@ -0,0 +1,23 @@
+#version 430
+/**
+ * Resolves weighted blended order independent transparency over the opaque image (see OITPass)
+ * Blend with glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+ */
+uniform sampler2D _accum;
+uniform sampler2D _revealage;
+
+out vec4 fragColor;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_FragCoord.xy);
+  float revealage = texelFetch(_revealage, texel, 0).r;
+  //Fully revealed, nothing transparent covers the pixel
+  if(revealage>=1.0f)
+    discard;
+  vec4 accum = texelFetch(_accum, texel, 0);
+  //Guard against overflow of the half float accumulation
+  if(isinf(accum.a))
+    accum.a = max(max(accum.r, accum.g), accum.b);
+  fragColor = vec4(accum.rgb / max(accum.a, 1e-5f), 1.0f - revealage);
+}
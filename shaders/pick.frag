@@ -0,0 +1,15 @@
+#version 430
+//Writes the ID of each fragment's object to a single R32UI color attachment (see PickPass)
+//The ID is the object's first ID, offset by the index of the mesh (Model) or instance (Entity) drawn
+//Pair with the PICK permutation of the vertex shader, which outputs the instance index
+uniform uint _pickID;
+uniform uint _meshID;
+
+flat in uint pickInstance;
+
+out uint fragID;
+
+void main()
+{
+  fragID = _pickID + _meshID + pickInstance;
+}